@@ -49,6 +49,8 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         self.arcfeed = []; self.arcfeed_append = self.arcfeed.append
         # dwell list - [line number, color, pos x, pos y, pos z, plane]
         self.dwells = []; self.dwells_append = self.dwells.append
+        # vertex arrays of the segment lists, see segments()
+        self._segments = {}
         self.choice = None
         self.feedrate = 1
         self.lo = (0,) * 9
@@ -126,8 +128,23 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         self.state = st
         self.lineno = self.state.sequence_number
 
+    def segments(self, lines, geometry=None):
+        """Return the vertex arrays of a segment list, with the segments
+        appended since the last call added"""
+        geometry = geometry or self.geometry
+        # the entry holds on to the list, so its id can't be reused
+        # for another one while the entry exists
+        key = id(lines), geometry
+        e = self._segments.get(key)
+        if e is None or e[0] is not lines or len(e[1]) > len(lines):
+            e = self._segments[key] = (lines, linuxcnc.segments(geometry))
+        s = e[1]
+        if len(s) < len(lines):
+            s.extend(lines, len(s))
+        return s
+
     def draw_lines(self, lines, for_selection, j=0, geometry=None):
-        return linuxcnc.draw_lines(geometry or self.geometry, lines, for_selection)
+        return self.segments(lines, geometry).draw(for_selection)
 
     def colored_lines(self, color, lines, for_selection, j=0):
         if self.is_foam:
@@ -246,33 +263,18 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         glLineWidth(3)
         c = self.colors['selected']
         glColor3f(*c)
-        glBegin(GL_LINES)
-        coords = []
-        for line in self.traverse:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.arcfeed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.feed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        glEnd()
+        sx = sy = sz = 0.0
+        n = 0
+        for lines in (self.traverse, self.arcfeed, self.feed):
+            x, y, z, k = self.segments(lines, geometry).highlight(lineno)
+            sx += x; sy += y; sz += z; n += k
         for line in self.dwells:
             if line[0] != lineno: continue
             self.draw_dwells([(line[0], c) + line[2:]], 2, 0)
-            coords.append(line[2:5])
+            sx += line[2]; sy += line[3]; sz += line[4]; n += 1
         glLineWidth(1)
-        if coords:
-            x = reduce(lambda x,y:x+y, [c[0] for c in coords]) / len(coords)
-            y = reduce(lambda x,y:x+y, [c[1] for c in coords]) / len(coords)
-            z = reduce(lambda x,y:x+y, [c[2] for c in coords]) / len(coords)
+        if n:
+            x, y, z = sx / n, sy / n, sz / n
         else:
             x = (self.min_extents[0] + self.max_extents[0])/2
             y = (self.min_extents[1] + self.max_extents[1])/2
@@ -98,6 +98,7 @@ public:
             double settings[ACTIVE_SETTINGS],
             StateTag const &tag);
     int restore_from_tag(StateTag const &tag);
+    int begin_run(int line);
     void set_loglevel(int level);
     FILE *f;
     char filename[PATH_MAX];
@@ -731,6 +732,8 @@ void Canterp::active_settings(double sets[]) { std::fill(sets, sets + ACTIVE_SET
 //NOT necessary for canterp
 int Canterp::restore_from_tag(StateTag const &tag) {return -1;}
 
+int Canterp::begin_run(int line) {return 0;}
+
 int Canterp::active_modes(int g_codes[ACTIVE_G_CODES],
         int m_codes[ACTIVE_M_CODES],
         double settings[ACTIVE_SETTINGS],
@@ -56,6 +56,7 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "hal.h"		/* access to HAL functions/definitions */
 #include "rtapi.h"		/* rtapi_print_msg */
@@ -69,6 +70,7 @@
 #include "timer.hh"
 #include "rcs_print.hh"
 #include "tool_parse.h"
+#include "toolstore.hh"
 
 static RCS_CMD_CHANNEL *emcioCommandBuffer = 0;
 static RCS_CMD_MSG *emcioCommand = 0;
@@ -79,6 +81,8 @@ static NML *emcErrorBuffer = 0;
 static char *ttcomments[CANON_POCKETS_MAX];
 static int fms[CANON_POCKETS_MAX];
 static int random_toolchanger = 0;
+static ToolStore *toolstore;
+static int tool_serial;
 
 
 struct iocontrol_str {
@@ -253,67 +257,28 @@ static int iniLoad(const char *filename)
 
 /********************************************************************
 *
-* Description: saveToolTable(const char *filename, CANON_TOOL_TABLE toolTable[])
-*		Saves the tool table from toolTable[] array into file filename.
-*		  Array is CANON_TOOL_MAX + 1 entries, since 0 is included.
-*
-* Return Value: Zero on success or -1 if file not found.
-*
-* Side Effects: Default setting used if the parameter not found in
-*		the ini file.
-*
-* Called By: main()
+* Description: pocket_changed(int pocket)
+*		Called whenever toolTable[pocket] was modified. Bumps the
+*		pocket's serial so task and the interpreter copy just the
+*		changed entries, and queues the pocket for the tool store.
 *
 ********************************************************************/
-static int saveToolTable(const char *filename,
-			 CANON_TOOL_TABLE toolTable[])
+static void pocket_changed(int pocket)
 {
-    int pocket;
-    FILE *fp;
-    const char *name;
-    int start_pocket;
-
-    // check filename
-    if (filename[0] == 0) {
-	name = tool_table_file;
-    } else {
-	// point to name provided
-	name = filename;
-    }
-
-    // open tool table file
-    if (NULL == (fp = fopen(name, "w"))) {
-	// can't open file
-	return -1;
-    }
+    if (++tool_serial == 0)
+	tool_serial = 1;
+    emcioStatus.tool.pocketSerial[pocket] = tool_serial;
+    toolstore->update(pocket);
+}
 
-    if(random_toolchanger) {
-        start_pocket = 0;
-    } else {
-        start_pocket = 1;
-    }
-    for (pocket = start_pocket; pocket < CANON_POCKETS_MAX; pocket++) {
-        if (toolTable[pocket].toolno != -1) {
-            fprintf(fp, "T%d P%d", toolTable[pocket].toolno, random_toolchanger? pocket: fms[pocket]);
-            if (toolTable[pocket].diameter) fprintf(fp, " D%f", toolTable[pocket].diameter);
-            if (toolTable[pocket].offset.tran.x) fprintf(fp, " X%+f", toolTable[pocket].offset.tran.x);
-            if (toolTable[pocket].offset.tran.y) fprintf(fp, " Y%+f", toolTable[pocket].offset.tran.y);
-            if (toolTable[pocket].offset.tran.z) fprintf(fp, " Z%+f", toolTable[pocket].offset.tran.z);
-            if (toolTable[pocket].offset.a) fprintf(fp, " A%+f", toolTable[pocket].offset.a);
-            if (toolTable[pocket].offset.b) fprintf(fp, " B%+f", toolTable[pocket].offset.b);
-            if (toolTable[pocket].offset.c) fprintf(fp, " C%+f", toolTable[pocket].offset.c);
-            if (toolTable[pocket].offset.u) fprintf(fp, " U%+f", toolTable[pocket].offset.u);
-            if (toolTable[pocket].offset.v) fprintf(fp, " V%+f", toolTable[pocket].offset.v);
-            if (toolTable[pocket].offset.w) fprintf(fp, " W%+f", toolTable[pocket].offset.w);
-            if (toolTable[pocket].frontangle) fprintf(fp, " I%+f", toolTable[pocket].frontangle);
-            if (toolTable[pocket].backangle) fprintf(fp, " J%+f", toolTable[pocket].backangle);
-            if (toolTable[pocket].orientation) fprintf(fp, " Q%d", toolTable[pocket].orientation);
-            fprintf(fp, " ;%s\n", ttcomments[pocket]);
-        }
+// after reading the whole table: the store is up to date
+static void table_loaded(void)
+{
+    for (int i = 0; i < CANON_POCKETS_MAX; i++) {
+	if (++tool_serial == 0)
+	    tool_serial = 1;
+	emcioStatus.tool.pocketSerial[i] = tool_serial;
     }
-
-    fclose(fp);
-    return 0;
 }
 
 static int done = 0;
@@ -602,7 +567,9 @@ void load_tool(int pocket) {
         ttcomments[0] = ttcomments[pocket];
         ttcomments[pocket] = comment_temp;
 
-        if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable))
+        pocket_changed(0);
+        pocket_changed(pocket);
+        if (0 != toolstore->flush())
             emcioStatus.status = RCS_ERROR;
     } else if(pocket == 0) {
         // on non-random tool-changers, asking for pocket 0 is the secret
@@ -613,9 +580,11 @@ void load_tool(int pocket) {
         emcioStatus.tool.toolTable[0].frontangle = 0.0;
         emcioStatus.tool.toolTable[0].backangle = 0.0;
         emcioStatus.tool.toolTable[0].orientation = 0;
+        pocket_changed(0);
     } else {
         // just copy the desired tool to the spindle
         emcioStatus.tool.toolTable[0] = emcioStatus.tool.toolTable[pocket];
+        pocket_changed(0);
     }
 }
 
@@ -763,10 +732,19 @@ int main(int argc, char *argv[])
         ttcomments[0][0] = '\0';
     }
 
-    if (0 != loadToolTable(tool_table_file, emcioStatus.tool.toolTable,
-		fms, ttcomments, random_toolchanger)) {
+    toolstore = ToolStore::create(tool_table_file, random_toolchanger,
+				  emcioStatus.tool.toolTable, fms, ttcomments);
+    if (toolstore == NULL) {
+	rcs_print_error("can't open tool table '%s'.\n", tool_table_file);
+	return -1;
+    }
+    // distinct from the serials of an earlier iocontrol instance task
+    // may still hold
+    tool_serial = time(NULL);
+    if (0 != toolstore->load()) {
 	rcs_print_error("can't load tool table.\n");
     }
+    table_loaded();
 
     done = 0;
 
@@ -832,8 +810,8 @@ int main(int argc, char *argv[])
 
 	case EMC_TOOL_INIT_TYPE:
 	    rtapi_print_msg(RTAPI_MSG_DBG, "EMC_TOOL_INIT\n");
-	    loadToolTable(tool_table_file, emcioStatus.tool.toolTable,
-		    fms, ttcomments, random_toolchanger);
+	    toolstore->load();
+	    table_loaded();
 	    reload_tool_number(emcioStatus.tool.toolInSpindle);
 	    break;
 
@@ -919,11 +897,12 @@ int main(int argc, char *argv[])
 		    ((EMC_TOOL_LOAD_TOOL_TABLE *) emcioCommand)->file;
 		if(!strlen(filename)) filename = tool_table_file;
 		rtapi_print_msg(RTAPI_MSG_DBG, "EMC_TOOL_LOAD_TOOL_TABLE\n");
-		if (0 != loadToolTable(filename, emcioStatus.tool.toolTable,
-				  fms, ttcomments, random_toolchanger))
+		if (0 != toolstore->load(filename))
 		    emcioStatus.status = RCS_ERROR;
-		else
+		else {
+		    table_loaded();
 		    reload_tool_number(emcioStatus.tool.toolInSpindle);
+		}
 	    }
 	    break;
 
@@ -952,12 +931,14 @@ int main(int argc, char *argv[])
                 emcioStatus.tool.toolTable[p].frontangle = f;
                 emcioStatus.tool.toolTable[p].backangle = b;
                 emcioStatus.tool.toolTable[p].orientation = o;
+                pocket_changed(p);
 
                 if (emcioStatus.tool.toolInSpindle == t) {
                     emcioStatus.tool.toolTable[0] = emcioStatus.tool.toolTable[p];
+                    pocket_changed(0);
                 }                    
             }
-	    if (0 != saveToolTable(tool_table_file, emcioStatus.tool.toolTable))
+	    if (0 != toolstore->flush())
 		emcioStatus.status = RCS_ERROR;
 	    break;
 
@@ -1074,6 +1055,7 @@ int main(int argc, char *argv[])
 	emcioCommandBuffer = 0;
     }
 
+    delete toolstore;
     for(int i=0; i<CANON_POCKETS_MAX; i++) {
         free(ttcomments[i]);
     }
@@ -339,6 +339,8 @@ check_stuff ( "after compute_screw_comp()" );
 check_stuff ( "after output_to_hal()" );
     update_status();
 check_stuff ( "after update_status()" );
+    postrace_sample();
+    jointhist_sample();
     /* here ends the core of the controller */
     emcmotStatus->heartbeat++;
     /* set tail to head, to indicate work complete */
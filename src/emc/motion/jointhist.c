@@ -0,0 +1,123 @@
+/********************************************************************
+* Description: jointhist.c
+*   Writes the joint history of the motion controller into the
+*   motion.history HAL ring, see jointhist.h for the format.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+
+#include "rtapi.h"
+#include "rtapi_string.h"	/* memset */
+#include "hal.h"
+#include "hal_ring.h"
+#include "motion.h"
+#include "mot_priv.h"
+#include "jointhist.h"
+
+// Mark strings for translation, but defer translation to userspace
+#define _(s) (s)
+
+/***********************************************************************
+*                  LOCAL VARIABLE DECLARATIONS                         *
+************************************************************************/
+
+static ringbuffer_t hist_rb;
+static int active;
+static int decimate;
+static __u32 cycle;
+static double last_vel[EMCMOT_MAX_JOINTS];
+
+/***********************************************************************
+*                        PUBLIC FUNCTION CODE                          *
+************************************************************************/
+
+int jointhist_init(int size, int decimation)
+{
+    jointhist_shared_t *sp;
+    int retval;
+
+    if (size <= 0)
+	return 0;
+    retval = hal_ring_newf(size, sizeof(jointhist_shared_t),
+			   RINGTYPE_RECORD, JOINTHIST_RING);
+    if (retval == 0) {
+	retval = hal_ring_attachf(&hist_rb, NULL, JOINTHIST_RING);
+	if (retval < 0)
+	    hal_ring_deletef(JOINTHIST_RING);
+    }
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: couldn't create ring '" JOINTHIST_RING "': %d\n"),
+	    retval);
+	return -1;
+    }
+    decimate = (decimation > 1) ? decimation : 1;
+    sp = hist_rb.scratchpad;
+    sp->records = sp->dropped = 0;
+    sp->period = 0.0;		/* until the first servo cycle */
+    sp->decimate = decimate;
+    active = 1;
+    return 0;
+}
+
+void jointhist_exit(void)
+{
+    if (!active)
+	return;
+    /* as for the trace rings, deleting fails while a reader is still
+       attached */
+    hal_ring_detach(&hist_rb);
+    hal_ring_deletef(JOINTHIST_RING);
+    active = 0;
+}
+
+/* called at the end of each servo cycle, after the controller set
+   servo_period from the period of the thread it runs in */
+void jointhist_sample(void)
+{
+    struct {
+	jointhist_record_t r;
+	jointhist_sample_t js[EMCMOT_MAX_JOINTS];
+    } rec;
+    jointhist_record_t *r = &rec.r;
+    jointhist_sample_t *js = rec.js;
+    jointhist_shared_t *sp;
+    emcmot_joint_t *joint;
+    int n, size;
+
+    if (!active)
+	return;
+    cycle++;
+
+    /* the acceleration from the velocities one servo cycle apart */
+    if (cycle % decimate) {
+	for (n = 0; n < num_joints; n++)
+	    last_vel[n] = joints[n].vel_cmd;
+	return;
+    }
+
+    r->cycle = cycle;
+    r->line = emcmotStatus->id;
+    r->motion_type = emcmotStatus->motionType;
+    r->joints = num_joints;
+    memset(r->__pad, 0, sizeof(r->__pad));
+    for (n = 0; n < num_joints; n++) {
+	joint = &joints[n];
+	js[n].pos_cmd = joint->pos_cmd;
+	js[n].pos_fb = joint->pos_fb;
+	js[n].ferror = joint->ferror;
+	js[n].vel_cmd = joint->vel_cmd;
+	js[n].acc_cmd = (joint->vel_cmd - last_vel[n]) / servo_period;
+	js[n].output = joint->motor_pos_cmd;
+	last_vel[n] = joint->vel_cmd;
+    }
+    size = sizeof(jointhist_record_t) + num_joints * sizeof(jointhist_sample_t);
+
+    sp = hist_rb.scratchpad;
+    sp->period = servo_period;
+    if (record_write(&hist_rb, &rec, size))
+	sp->dropped++;
+    else
+	sp->records++;
+}
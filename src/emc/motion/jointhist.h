@@ -0,0 +1,206 @@
+/********************************************************************
+* Description: jointhist.h
+*   Joint history of the motion controller: the record format of the
+*   motion.history HAL ring, and the move statistics its readers
+*   compute from it.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+#ifndef JOINTHIST_H
+#define JOINTHIST_H
+
+#include "rtapi.h"
+#include "emcmotcfg.h"		/* EMCMOT_MAX_JOINTS */
+
+/* With the motmod parameter history_size=<bytes>, motion writes a
+   record to the record ring JOINTHIST_RING every history_decimate'th
+   servo cycle: a jointhist_record_t, followed by a jointhist_sample_t
+   for each of its joints. Unlike the position trace (postrace.h) the
+   samples are not compressed, they are what a halscope capture of the
+   joint pins would show. The ring has one reader; when it is full,
+   samples are dropped and counted in the scratchpad.
+
+   The statistics below split the samples into moves by the line tag
+   (emcmotStatus->id) and report, per joint, the RMS and peak following
+   error and the time the following error takes to settle after the
+   commanded velocity went to zero. */
+
+#define JOINTHIST_RING "motion.history"
+
+/* the scratchpad of the history ring */
+typedef struct {
+    __u32 records;		/* written */
+    __u32 dropped;		/* lost to a full ring */
+    double period;		/* seconds per servo cycle, 0 until motion ran */
+    int decimate;		/* servo cycles per record */
+} jointhist_shared_t;
+
+typedef struct {
+    __u32 cycle;		/* servo cycle count */
+    __s32 line;			/* emcmotStatus->id */
+    __u8 motion_type;
+    __u8 joints;		/* samples following */
+    __u8 __pad[6];		/* keeps the samples 8 byte aligned */
+} jointhist_record_t;
+
+/* fails to compile if the record isn't 16 bytes */
+typedef char jointhist_record_size_check[(sizeof(jointhist_record_t) == 16) ? 1 : -1];
+
+typedef struct {
+    double pos_cmd;
+    double pos_fb;
+    double ferror;
+    double vel_cmd;
+    double acc_cmd;		/* change of vel_cmd per second */
+    double output;		/* motor-pos-cmd, with backlash and comp */
+} jointhist_sample_t;
+
+#ifdef ULAPI
+#include <string.h>
+#include <math.h>
+
+/* the statistics of a finished move */
+typedef struct {
+    int line;			/* line tag */
+    int joints;
+    __u32 start_cycle;
+    __u32 samples;
+    double rms_ferror[EMCMOT_MAX_JOINTS];
+    double peak_ferror[EMCMOT_MAX_JOINTS];	/* signed, largest magnitude */
+    __u32 peak_cycle[EMCMOT_MAX_JOINTS];
+    /* seconds from the first sample after the commanded stop until the
+       following error was within settle_band; 0 if the joint did not
+       stop or was within the band, -1 if it did not settle in time */
+    double settle_time[EMCMOT_MAX_JOINTS];
+} jointhist_move_t;
+
+typedef struct {
+    double period;
+    double settle_band;
+    double settle_timeout;	/* seconds */
+    int active;			/* in a move */
+    __u32 cycle;		/* of the last sample */
+    double sum_sq[EMCMOT_MAX_JOINTS];
+    int moved[EMCMOT_MAX_JOINTS];	/* since the last stop */
+    int stopping[EMCMOT_MAX_JOINTS];	/* waiting to settle */
+    __u32 stop_cycle[EMCMOT_MAX_JOINTS];
+    jointhist_move_t move;
+} jointhist_stats_t;
+
+static inline void jointhist_stats_init(jointhist_stats_t *s, double period,
+					double settle_band,
+					double settle_timeout)
+{
+    memset(s, 0, sizeof(*s));
+    s->period = period;
+    s->settle_band = settle_band;
+    s->settle_timeout = settle_timeout;
+}
+
+static inline void jointhist_move_begin(jointhist_stats_t *s,
+					const jointhist_record_t *r)
+{
+    int j;
+
+    memset(&s->move, 0, sizeof(s->move));
+    s->move.line = r->line;
+    s->move.joints = r->joints;
+    s->move.start_cycle = r->cycle;
+    for (j = 0; j < EMCMOT_MAX_JOINTS; j++) {
+	s->sum_sq[j] = 0.0;
+	s->moved[j] = 0;
+	s->stopping[j] = 0;
+    }
+    s->active = 1;
+}
+
+static inline void jointhist_move_end(jointhist_stats_t *s,
+				      jointhist_move_t *done)
+{
+    int j;
+
+    for (j = 0; j < s->move.joints; j++) {
+	if (s->move.samples)
+	    s->move.rms_ferror[j] = sqrt(s->sum_sq[j] / s->move.samples);
+	if (s->stopping[j])
+	    s->move.settle_time[j] = -1.0;
+    }
+    *done = s->move;
+    s->active = 0;
+}
+
+/* apply one record: returns 1 if it finished a move, which is then in
+   *done, 0 if not, -1 if the record is malformed. A move ends when the
+   line tag changes, or when all joints were commanded to stop and have
+   settled or timed out. */
+static inline int jointhist_stats_update(jointhist_stats_t *s,
+					 const void *rec, size_t size,
+					 jointhist_move_t *done)
+{
+    const jointhist_record_t *r = (const jointhist_record_t *) rec;
+    const jointhist_sample_t *js;
+    int j, moving = 0, waiting = 0, finished = 0;
+
+    if (size < sizeof(*r) || r->joints > EMCMOT_MAX_JOINTS ||
+	size != sizeof(*r) + r->joints * sizeof(jointhist_sample_t))
+	return -1;
+    js = (const jointhist_sample_t *) (r + 1);
+    for (j = 0; j < r->joints; j++)
+	if (js[j].vel_cmd != 0.0)
+	    moving = 1;
+
+    if (s->active && (r->line != s->move.line || r->joints != s->move.joints)) {
+	jointhist_move_end(s, done);
+	finished = 1;
+    }
+    if (!s->active) {
+	if (!moving) {
+	    s->cycle = r->cycle;
+	    return finished;
+	}
+	jointhist_move_begin(s, r);
+    }
+
+    s->move.samples++;
+    for (j = 0; j < r->joints; j++) {
+	double fe = js[j].ferror;
+	s->sum_sq[j] += fe * fe;
+	if (fabs(fe) > fabs(s->move.peak_ferror[j])) {
+	    s->move.peak_ferror[j] = fe;
+	    s->move.peak_cycle[j] = r->cycle;
+	}
+	if (js[j].vel_cmd != 0.0) {
+	    s->moved[j] = 1;
+	    s->stopping[j] = 0;
+	} else if (s->moved[j]) {
+	    /* commanded to stop after the previous sample: the settle
+	       time counts from this one, 0 if the joint is in the band */
+	    s->moved[j] = 0;
+	    s->stopping[j] = 1;
+	    s->stop_cycle[j] = r->cycle;
+	}
+	if (s->stopping[j]) {
+	    double t = (r->cycle - s->stop_cycle[j]) * s->period;
+	    if (fabs(fe) <= s->settle_band) {
+		s->move.settle_time[j] = t;
+		s->stopping[j] = 0;
+	    } else if (t > s->settle_timeout) {
+		s->move.settle_time[j] = -1.0;
+		s->stopping[j] = 0;
+	    } else {
+		waiting = 1;
+	    }
+	}
+    }
+    s->cycle = r->cycle;
+
+    if (!moving && !waiting && !finished) {
+	jointhist_move_end(s, done);
+	finished = 1;
+    }
+    return finished;
+}
+#endif
+
+#endif
@@ -329,6 +329,17 @@ extern void refresh_jog_limits(emcmot_joint_t *joint);
 extern void clearHomes(int joint_num);
 
 extern void emcmot_config_change(void);
+
+/* position trace, postrace.c */
+extern int postrace_init(int rings, int size, double resolution,
+			 int decimation, int keyframe_interval);
+extern void postrace_exit(void);
+extern void postrace_sample(void);
+
+/* joint history, jointhist.c */
+extern int jointhist_init(int size, int decimation);
+extern void jointhist_exit(void);
+extern void jointhist_sample(void);
 extern void reportError(const char *fmt, ...) __attribute((format(printf,1,2))); /* Use the rtapi_print call */
 
  /* rtapi_get_time() returns a nanosecond value. In time, we should use a u64
@@ -70,6 +70,20 @@ static char *kins = "trivkins";
 RTAPI_MP_STRING(kins, "kinematics vtable name");
 static char *tp = "tp";
 RTAPI_MP_STRING(tp, "tp vtable name");
+static int trace_rings = 0;		/* position trace, see postrace.h */
+RTAPI_MP_INT(trace_rings, "number of position trace rings, 0 (default) disables the trace");
+static int trace_size = 65536;
+RTAPI_MP_INT(trace_size, "size of a position trace ring in bytes");
+static int trace_decimate = 1;
+RTAPI_MP_INT(trace_decimate, "compare positions every n'th servo cycle for the trace");
+static int trace_resolution = 100;
+RTAPI_MP_INT(trace_resolution, "position trace resolution in 1e-9 machine units");
+static int trace_keyframe = 1000;
+RTAPI_MP_INT(trace_keyframe, "records between absolute positions in the trace");
+static int history_size = 0;		/* joint history, see jointhist.h */
+RTAPI_MP_INT(history_size, "size of the joint history ring in bytes, 0 disables it");
+static int history_decimate = 1;
+RTAPI_MP_INT(history_decimate, "write the joint history every n'th servo cycle");
 
 /***********************************************************************
 *                  GLOBAL VARIABLE DEFINITIONS                         *
@@ -250,10 +264,35 @@ int rtapi_app_main(void)
 	return -1;
     }
 
+    /* position trace rings, written by the controller */
+    if (trace_resolution < 1) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: trace_resolution is %d, must be at least 1\n"),
+	    trace_resolution);
+	hal_exit(mot_comp_id);
+	return -1;
+    }
+    retval = postrace_init(trace_rings, trace_size, trace_resolution * 1e-9,
+			   trace_decimate, trace_keyframe);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, _("MOTION: postrace_init() failed\n"));
+	hal_exit(mot_comp_id);
+	return -1;
+    }
+    retval = jointhist_init(history_size, history_decimate);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, _("MOTION: jointhist_init() failed\n"));
+	postrace_exit();
+	hal_exit(mot_comp_id);
+	return -1;
+    }
+
     /* set up for realtime execution of code */
     retval = init_threads();
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR, _("MOTION: init_threads() failed\n"));
+	jointhist_exit();
+	postrace_exit();
 	hal_exit(mot_comp_id);
 	return -1;
     }
@@ -287,6 +326,9 @@ void rtapi_app_exit(void)
     // release the tp vtable
     hal_unreference_vtable(emcmotConfig->tp_vid);
 
+    jointhist_exit();
+    postrace_exit();
+
     /* free shared memory */
     retval = rtapi_shmem_delete(emc_shmem_id, mot_comp_id);
     if (retval < 0) {
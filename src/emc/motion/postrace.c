@@ -0,0 +1,205 @@
+/********************************************************************
+* Description: postrace.c
+*   Writes the position trace of the motion controller into the
+*   motion.trace.<n> HAL rings, see postrace.h for the format.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+
+#include "rtapi.h"
+#include "hal.h"
+#include "hal_ring.h"
+#include "motion.h"
+#include "mot_priv.h"
+#include "postrace.h"
+
+// Mark strings for translation, but defer translation to userspace
+#define _(s) (s)
+
+/***********************************************************************
+*                  LOCAL VARIABLE DECLARATIONS                         *
+************************************************************************/
+
+static ringbuffer_t trace_rb[POSTRACE_MAX_RINGS];
+static int need_key[POSTRACE_MAX_RINGS];
+static int nrings;
+static double quantum;
+static int decimate;
+static int keyframe;
+
+/* what the readers rebuild from the records written so far */
+static postrace_reader_t last;
+static unsigned since_key;	/* records */
+
+static __u32 cycle;
+static __u32 dropped;
+
+/***********************************************************************
+*                         LOCAL FUNCTIONS                              *
+************************************************************************/
+
+static void pose_to_array(const EmcPose *p, double a[POSTRACE_AXES])
+{
+    a[0] = p->tran.x; a[1] = p->tran.y; a[2] = p->tran.z;
+    a[3] = p->a; a[4] = p->b; a[5] = p->c;
+    a[6] = p->u; a[7] = p->v; a[8] = p->w;
+}
+
+/* write rec to every ring; a ring which can't take it needs a key next.
+   Returns non-zero if at least one ring got the record. */
+static int write_rings(void *rec, int size)
+{
+    int n, written = 0;
+
+    for (n = 0; n < nrings; n++) {
+	postrace_shared_t *sp = trace_rb[n].scratchpad;
+	if (record_write(&trace_rb[n], rec, size)) {
+	    sp->dropped++;
+	    dropped++;
+	    need_key[n] = 1;
+	} else {
+	    sp->records++;
+	    written = 1;
+	}
+    }
+    return written;
+}
+
+static void write_key(const double cmd[], const double act[],
+		      const double tool_offset[], int line, int motion_type)
+{
+    postrace_key_t k;
+    int n, i;
+
+    k.kind = POSTRACE_KEY;
+    k.motion_type = motion_type;
+    k.__pad = 0;
+    k.line = line;
+    k.cycle = cycle;
+    k.dropped = dropped;
+    k.quantum = quantum;
+    for (i = 0; i < POSTRACE_AXES; i++) {
+	k.cmd[i] = cmd[i];
+	k.act[i] = act[i];
+	k.tool_offset[i] = tool_offset[i];
+    }
+    for (n = 0; n < nrings; n++)
+	need_key[n] = 0;
+    if (!write_rings(&k, sizeof(k)))
+	return;
+    for (n = 0; n < nrings; n++)
+	if (!need_key[n])
+	    ((postrace_shared_t *) trace_rb[n].scratchpad)->keys++;
+
+    postrace_decode(&last, &k, sizeof(k));
+    since_key = 0;
+}
+
+/***********************************************************************
+*                        PUBLIC FUNCTION CODE                          *
+************************************************************************/
+
+int postrace_init(int rings, int size, double resolution, int decimation,
+		  int keyframe_interval)
+{
+    postrace_shared_t *sp;
+    int n, retval;
+
+    if (rings <= 0 || size <= 0)
+	return 0;
+    if (rings > POSTRACE_MAX_RINGS) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: trace_rings is %d, must be at most %d\n"),
+	    rings, POSTRACE_MAX_RINGS);
+	return -1;
+    }
+    quantum = resolution;
+    decimate = decimation;
+    keyframe = keyframe_interval;
+    for (n = 0; n < rings; n++) {
+	retval = hal_ring_newf(size, sizeof(postrace_shared_t),
+			       RINGTYPE_RECORD, POSTRACE_RING, n);
+	if (retval == 0) {
+	    retval = hal_ring_attachf(&trace_rb[n], NULL, POSTRACE_RING, n);
+	    if (retval < 0)
+		hal_ring_deletef(POSTRACE_RING, n);
+	}
+	if (retval < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		_("MOTION: couldn't create ring '" POSTRACE_RING "': %d\n"),
+		n, retval);
+	    postrace_exit();
+	    return -1;
+	}
+	sp = trace_rb[n].scratchpad;
+	sp->want_key = 0;
+	sp->records = sp->keys = sp->dropped = 0;
+	sp->quantum = quantum;
+	sp->decimate = decimate;
+	need_key[n] = 1;
+	nrings = n + 1;
+    }
+    return 0;
+}
+
+void postrace_exit(void)
+{
+    int n;
+
+    /* deleting fails while a reader is still attached, the ring
+       then goes away with hal_lib */
+    for (n = 0; n < nrings; n++) {
+	hal_ring_detach(&trace_rb[n]);
+	hal_ring_deletef(POSTRACE_RING, n);
+    }
+    nrings = 0;
+}
+
+/* called at the end of each servo cycle */
+void postrace_sample(void)
+{
+    double cmd[POSTRACE_AXES], act[POSTRACE_AXES], tool_offset[POSTRACE_AXES];
+    __u8 rec[POSTRACE_MAX_DELTA];
+    int line, motion_type, key = 0, size, n, i;
+
+    if (!nrings)
+	return;
+    cycle++;
+
+    line = emcmotStatus->id;
+    motion_type = emcmotStatus->motionType;
+    if (line == last.line && motion_type == last.motion_type
+	&& decimate > 1 && cycle - last.cycle < (__u32) decimate)
+	return;
+
+    pose_to_array(&emcmotStatus->carte_pos_cmd, cmd);
+    pose_to_array(&emcmotStatus->carte_pos_fb, act);
+    pose_to_array(&emcmotStatus->tool_offset, tool_offset);
+
+    for (n = 0; n < nrings; n++) {
+	postrace_shared_t *sp = trace_rb[n].scratchpad;
+	if (sp->want_key) {
+	    sp->want_key = 0;
+	    need_key[n] = 1;
+	}
+	key |= need_key[n];
+    }
+    if (keyframe > 0 && since_key >= (unsigned) keyframe)
+	key = 1;
+    for (i = 0; i < POSTRACE_AXES && !key; i++)
+	if (tool_offset[i] != last.tool_offset[i])
+	    key = 1;
+
+    size = key ? -1 : postrace_encode(&last, rec, cmd, act, line,
+				      motion_type, cycle);
+    if (size < 0) {
+	write_key(cmd, act, tool_offset, line, motion_type);
+	return;
+    }
+    if (size == 0 || !write_rings(rec, size))
+	return;
+    /* keep what the readers see */
+    postrace_decode(&last, rec, size);
+    since_key++;
+}
@@ -0,0 +1,224 @@
+/********************************************************************
+* Description: postrace.h
+*   Position trace of the motion controller: the record format of the
+*   motion.trace.<n> HAL rings, and the decoder for their readers.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+#ifndef POSTRACE_H
+#define POSTRACE_H
+
+#include "rtapi.h"
+
+/* Every servo cycle motion compares the commanded and actual tool
+   positions, the executing line (emcmotStatus->id) and the motion type
+   with what it last traced, and writes a record if anything changed.
+   Positions are quantized to 'quantum' machine units; a record carries
+   the change in quanta, so nothing is lost between records whatever the
+   speed. With the motmod parameter trace_decimate=<n>, positions are
+   compared only every n'th cycle, a change of line or motion type is
+   traced in the cycle it happens.
+
+   There are trace_rings record rings, POSTRACE_RING with n = 0.., each
+   for one reader: the AXIS position logger takes ring 0, haltalk can
+   publish another (see haltalk_ringview.cc). Two kinds of record:
+
+   POSTRACE_KEY    a postrace_key_t with the absolute positions and the
+                   tool offset in effect
+   POSTRACE_DELTA  kind, motion type, then varints: the servo cycles
+                   since the previous record, a mask (bits 0-8 commanded
+                   X Y Z A B C U V W, bits 9-17 actual, bit 18 the line),
+                   then for each set bit in that order, zigzag encoded,
+                   the change of the line number and the changes of the
+                   positions in quanta
+
+   A key is written after the tool offset changed, after a record was
+   lost to a full ring, every trace_keyframe records, and when a reader
+   asks for one by setting want_key in the ring's scratchpad. A reader
+   skips deltas until it has seen a key. */
+
+#define POSTRACE_RING "motion.trace.%d"
+#define POSTRACE_MAX_RINGS 4
+#define POSTRACE_AXES 9
+#define POSTRACE_LINE_BIT (2 * POSTRACE_AXES)
+/* size of the largest delta record */
+#define POSTRACE_MAX_DELTA (2 + 5 + 3 + (2 * POSTRACE_AXES + 1) * 5)
+
+enum {
+    POSTRACE_KEY = 1,
+    POSTRACE_DELTA = 2,
+};
+
+/* the scratchpad of a trace ring */
+typedef struct {
+    int want_key;		/* set by the reader, cleared by motion */
+    __u32 records;		/* written */
+    __u32 keys;			/* of which keys */
+    __u32 dropped;		/* lost to a full ring */
+    double quantum;
+    int decimate;
+} postrace_shared_t;
+
+typedef struct {
+    __u8 kind;			/* POSTRACE_KEY */
+    __u8 motion_type;
+    __u16 __pad;
+    __s32 line;
+    __u32 cycle;		/* servo cycle count */
+    __u32 dropped;		/* records lost so far */
+    double quantum;
+    double cmd[POSTRACE_AXES];
+    double act[POSTRACE_AXES];
+    double tool_offset[POSTRACE_AXES];
+} postrace_key_t;
+
+static inline __u8 *postrace_put_varint(__u8 *p, __u32 v)
+{
+    while (v >= 0x80) {
+	*p++ = (v & 0x7f) | 0x80;
+	v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static inline __u32 postrace_zigzag(__s32 v)
+{
+    return ((__u32) v << 1) ^ (__u32) (v >> 31);
+}
+
+/* NULL if the varint runs past end */
+static inline const __u8 *postrace_get_varint(const __u8 *p, const __u8 *end,
+					      __u32 *v)
+{
+    int shift;
+
+    *v = 0;
+    for (shift = 0; (p < end) && (shift < 35); shift += 7) {
+	__u8 b = *p++;
+	*v |= (__u32) (b & 0x7f) << shift;
+	if (!(b & 0x80))
+	    return p;
+    }
+    return 0;
+}
+
+static inline __s32 postrace_unzigzag(__u32 v)
+{
+    return (__s32) (v >> 1) ^ -(__s32) (v & 1);
+}
+
+/* the state of a trace as rebuilt by a reader */
+typedef struct {
+    int synced;			/* a key was seen */
+    int motion_type;
+    int line;
+    __u32 cycle;
+    __u32 dropped;		/* as of the last key */
+    double quantum;
+    double cmd[POSTRACE_AXES];
+    double act[POSTRACE_AXES];
+    double tool_offset[POSTRACE_AXES];
+} postrace_reader_t;
+
+/* apply one record to r: returns 1 if r now holds a new sample, 0 if
+   the record was skipped waiting for a key, -1 if it is malformed */
+static inline int postrace_decode(postrace_reader_t *r, const void *rec,
+				  size_t size)
+{
+    const __u8 *p = (const __u8 *) rec, *end = p + size;
+    __u32 v, mask;
+    int i;
+
+    if (size < 2)
+	return -1;
+    if (p[0] == POSTRACE_KEY) {
+	const postrace_key_t *k = (const postrace_key_t *) rec;
+	if (size != sizeof(postrace_key_t))
+	    return -1;
+	r->motion_type = k->motion_type;
+	r->line = k->line;
+	r->cycle = k->cycle;
+	r->dropped = k->dropped;
+	r->quantum = k->quantum;
+	for (i = 0; i < POSTRACE_AXES; i++) {
+	    r->cmd[i] = k->cmd[i];
+	    r->act[i] = k->act[i];
+	    r->tool_offset[i] = k->tool_offset[i];
+	}
+	r->synced = 1;
+	return 1;
+    }
+    if (p[0] != POSTRACE_DELTA)
+	return -1;
+    if (!r->synced)
+	return 0;
+    r->motion_type = p[1];
+    p += 2;
+    if (!(p = postrace_get_varint(p, end, &v)))
+	return -1;
+    r->cycle += v;
+    if (!(p = postrace_get_varint(p, end, &mask)))
+	return -1;
+    if (mask & (1 << POSTRACE_LINE_BIT)) {
+	if (!(p = postrace_get_varint(p, end, &v)))
+	    return -1;
+	r->line += postrace_unzigzag(v);
+    }
+    for (i = 0; i < 2 * POSTRACE_AXES; i++) {
+	double *d;
+	if (!(mask & (1 << i)))
+	    continue;
+	if (!(p = postrace_get_varint(p, end, &v)))
+	    return -1;
+	d = (i < POSTRACE_AXES) ? &r->cmd[i] : &r->act[i - POSTRACE_AXES];
+	*d += postrace_unzigzag(v) * r->quantum;
+    }
+    return (p == end) ? 1 : -1;
+}
+
+/* the delta record from what r holds to a sample at cycle into rec, of
+   POSTRACE_MAX_DELTA bytes: returns its size, 0 if nothing changed, -1
+   if a change is too large for a delta and a key is needed. Positions
+   are rounded to r->quantum from what r holds, not from the previous
+   sample, so the rounding errors don't add up; postrace_decode() of the
+   record brings r to the sample. */
+static inline int postrace_encode(const postrace_reader_t *r, __u8 *rec,
+				  const double cmd[POSTRACE_AXES],
+				  const double act[POSTRACE_AXES], int line,
+				  int motion_type, __u32 cycle)
+{
+    __s32 delta[2 * POSTRACE_AXES];
+    __u32 mask = 0;
+    __u8 *p = rec;
+    int i;
+
+    for (i = 0; i < 2 * POSTRACE_AXES; i++) {
+	double d = (i < POSTRACE_AXES) ? cmd[i] - r->cmd[i]
+	    : act[i - POSTRACE_AXES] - r->act[i - POSTRACE_AXES];
+	d /= r->quantum;
+	if (d > 0x3fffffff || d < -0x3fffffff)
+	    return -1;
+	delta[i] = (__s32) (d < 0 ? d - 0.5 : d + 0.5);
+	if (delta[i] != 0)
+	    mask |= 1 << i;
+    }
+    if (line != r->line)
+	mask |= 1 << POSTRACE_LINE_BIT;
+    if (!mask && motion_type == r->motion_type)
+	return 0;
+
+    *p++ = POSTRACE_DELTA;
+    *p++ = motion_type;
+    p = postrace_put_varint(p, cycle - r->cycle);
+    p = postrace_put_varint(p, mask);
+    if (mask & (1 << POSTRACE_LINE_BIT))
+	p = postrace_put_varint(p, postrace_zigzag(line - r->line));
+    for (i = 0; i < 2 * POSTRACE_AXES; i++)
+	if (mask & (1 << i))
+	    p = postrace_put_varint(p, postrace_zigzag(delta[i]));
+    return p - rec;
+}
+
+#endif
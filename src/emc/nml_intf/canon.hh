@@ -852,6 +852,11 @@ extern int GET_EXTERNAL_SELECTED_TOOL_SLOT();
 // in the given pocket
 extern CANON_TOOL_TABLE GET_EXTERNAL_TOOL_TABLE(int pocket);
 
+// Returns a number which changes whenever the entry of the given pocket
+// changes, so the interpreter can skip reading unchanged entries. Zero
+// means changes aren't tracked and the entry must always be read.
+extern int GET_EXTERNAL_TOOL_TABLE_SERIAL(int pocket);
+
 // return the value of iocontrol's toolchanger-fault pin
 extern int GET_EXTERNAL_TC_FAULT();
 
@@ -883,6 +888,7 @@ extern int GET_EXTERNAL_AXIS_MASK();
 extern FILE *_outfile;		/* where to print, set in main */
 extern CANON_TOOL_TABLE _tools[];	/* in canon.cc */
 extern int _pockets_max;		/* in canon.cc */
+extern int _tool_serial[];		/* in canon.cc, see GET_EXTERNAL_TOOL_TABLE_SERIAL */
 extern char _parameter_file_name[];	/* in canon.cc */
 #define PARAMETER_FILE_NAME_LENGTH 100
 
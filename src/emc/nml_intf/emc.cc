@@ -273,6 +273,9 @@ int emcFormat(NMLTYPE type, void *buffer, CMS * cms)
     case EMC_TASK_PLAN_EXECUTE_TYPE:
 	((EMC_TASK_PLAN_EXECUTE *) buffer)->update(cms);
 	break;
+    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+	((EMC_TASK_PLAN_EXECUTE_BATCH *) buffer)->update(cms);
+	break;
     case EMC_TASK_PLAN_INIT_TYPE:
 	((EMC_TASK_PLAN_INIT *) buffer)->update(cms);
 	break;
@@ -631,6 +634,8 @@ const char *emc_symbol_lookup(long type)
 	return "EMC_TASK_PLAN_END";
     case EMC_TASK_PLAN_EXECUTE_TYPE:
 	return "EMC_TASK_PLAN_EXECUTE";
+    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+	return "EMC_TASK_PLAN_EXECUTE_BATCH";
     case EMC_TASK_PLAN_INIT_TYPE:
 	return "EMC_TASK_PLAN_INIT";
     case EMC_TASK_PLAN_OPEN_TYPE:
@@ -903,6 +908,7 @@ void EMC_TOOL_STAT::update(CMS * cms)
     cms->update(toolInSpindle);
     for (int i_toolTable = 0; i_toolTable < CANON_POCKETS_MAX; i_toolTable++)
 	CANON_TOOL_TABLE_update(cms, &(toolTable[i_toolTable]));
+    cms->update(pocketSerial, CANON_POCKETS_MAX);
 
 }
 
@@ -1937,6 +1943,10 @@ void EMC_TASK_STAT::update(CMS * cms)
     cms->update(interpreter_errcode);
     cms->update(input_timeout);
     cms->update(rotation_xy);
+    cms->update(readaheadDepth);
+    cms->update(queuedMDIcommands);
+    cms->update(mdiSerial);
+    cms->update(mdiQueueMax);
 
 }
 
@@ -2660,6 +2670,15 @@ void EMC_TASK_PLAN_EXECUTE::update(CMS * cms)
 
 }
 
+void EMC_TASK_PLAN_EXECUTE_BATCH::update(CMS * cms)
+{
+
+    EMC_TASK_CMD_MSG::update(cms);
+    cms->update(count);
+    cms->update(text, EMC_TASK_BATCH_LEN);
+
+}
+
 /*
 *	NML/CMS Update function for EMC_COOLANT_FLOOD_ON
 *	Automatically generated by NML CodeGen Java Applet.
@@ -1284,6 +1284,28 @@ class EMC_TASK_PLAN_EXECUTE:public EMC_TASK_CMD_MSG {
     char command[LINELEN];
 };
 
+// room for the lines of an EMC_TASK_PLAN_EXECUTE_BATCH, well below the
+// emcCommand buffer size in the .nml files
+#define EMC_TASK_BATCH_LEN 4096
+
+// count MDI lines in one command, each NUL terminated in text. They
+// are queued as if sent one by one, line i with serial number
+// serial_number - count + 1 + i: a batch uses up count serial numbers,
+// its own being the one of the last line.
+class EMC_TASK_PLAN_EXECUTE_BATCH:public EMC_TASK_CMD_MSG {
+  public:
+    EMC_TASK_PLAN_EXECUTE_BATCH():EMC_TASK_CMD_MSG(EMC_TASK_PLAN_EXECUTE_BATCH_TYPE,
+						   sizeof(EMC_TASK_PLAN_EXECUTE_BATCH))
+    {
+    };
+
+    // For internal NML/CMS use only.
+    void update(CMS * cms);
+
+    int count;
+    char text[EMC_TASK_BATCH_LEN];
+};
+
 class EMC_TASK_PLAN_PAUSE:public EMC_TASK_CMD_MSG {
   public:
     EMC_TASK_PLAN_PAUSE():EMC_TASK_CMD_MSG(EMC_TASK_PLAN_PAUSE_TYPE,
@@ -1438,6 +1460,9 @@ class EMC_TASK_STAT:public EMC_TASK_STAT_MSG {
     int task_paused;		// non-zero means task is paused
     double delayLeft;           // delay time left of G4, M66..
     int queuedMDIcommands;      // current length of MDI input queue
+    int readaheadDepth;         // canon messages read ahead of execution
+    int mdiSerial;              // serial of the MDI command last started
+    int mdiQueueMax;            // [TASK] MDI_QUEUED_COMMANDS
 };
 
 // declarations for EMC_TOOL classes
@@ -1588,6 +1613,10 @@ class EMC_TOOL_STAT:public EMC_TOOL_STAT_MSG {
     int pocketPrepped;		// pocket ready for loading from
     int toolInSpindle;		// tool loaded, 0 is no tool
     CANON_TOOL_TABLE toolTable[CANON_POCKETS_MAX];
+    // bumped by iocontrol whenever toolTable[pocket] changes, so readers
+    // can copy just the changed entries. Never 0 once set; 0 means
+    // the writer doesn't track changes.
+    int pocketSerial[CANON_POCKETS_MAX];
 };
 
 // EMC_AUX type declarations
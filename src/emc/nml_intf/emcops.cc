@@ -145,6 +145,9 @@ EMC_TASK_STAT_MSG(EMC_TASK_STAT_TYPE, sizeof(EMC_TASK_STAT))
     task_paused = 0;
     delayLeft = 0.0;
     queuedMDIcommands = 0;
+    readaheadDepth = 0;
+    mdiSerial = 0;
+    mdiQueueMax = 0;
 }
 
 EMC_TOOL_STAT::EMC_TOOL_STAT():
@@ -162,6 +165,7 @@ EMC_TOOL_STAT_MSG(EMC_TOOL_STAT_TYPE, sizeof(EMC_TOOL_STAT))
 	toolTable[t].orientation = 0;
 	toolTable[t].frontangle = 0.0;
 	toolTable[t].backangle = 0.0;
+	pocketSerial[t] = 0;
     }
 }
 
@@ -211,6 +215,7 @@ EMC_TOOL_STAT EMC_TOOL_STAT::operator =(EMC_TOOL_STAT s)
 	toolTable[t].frontangle = s.toolTable[t].frontangle;
 	toolTable[t].backangle = s.toolTable[t].backangle;
 	toolTable[t].orientation = s.toolTable[t].orientation;
+	pocketSerial[t] = s.pocketSerial[t];
     }
 
     return s;
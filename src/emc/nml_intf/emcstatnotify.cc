@@ -0,0 +1,432 @@
+/********************************************************************
+ * Description: emcstatnotify.cc
+ *
+ *   Change notification for the emcStatus NML channel, see
+ *   emcstatnotify.hh.
+ *
+ *   The segment is a plain file in /dev/shm named after a hash of the
+ *   NML file path and the buffer name, so everybody using the same
+ *   emc.nml finds the same segment. A reader blocks on the 'seq' futex
+ *   word; the publisher bumps the generation of each changed section,
+ *   then 'seq', then issues FUTEX_WAKE if anybody is waiting.
+ *   'cmd_seq' works the same way in the opposite direction, with
+ *   the task waiting and the UIs waking it.
+ *
+ * License: GPL Version 2+
+ * System: Linux
+ ********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "emc.hh"
+#include "emc_nml.hh"
+#include "timer.hh"		// etime(), esleep()
+#include "rcs_print.hh"
+#include "emcstatnotify.hh"
+
+#define EMC_STAT_NOTIFY_MAGIC 0x454d5333	// "EMS3"
+
+struct emc_stat_notify_shm {
+    unsigned int magic;
+    unsigned int size;		// sizeof(EMC_STAT) of the publisher
+    int pid;			// publisher
+    int waiters;		// readers currently in FUTEX_WAIT
+    int seq;			// futex word, bumped on every change
+    unsigned int gen[EMC_STAT_NSECT];
+    int cmd_seq;		// futex word, bumped by kick()
+    int cmd_waiters;		// publisher in FUTEX_WAIT on cmd_seq
+    double cmd_time;		// etime() of the last kick()
+};
+
+// byte ranges making up a section. They cover fields only, the
+// padding between fields is left out or, inside the structs listed in
+// clear_padding(), zeroed before the comparison.
+struct stat_range {
+    size_t off, len;
+};
+
+#define STAT_MAX_RANGES 6
+
+static void section_ranges(const EMC_STAT *s,
+			   stat_range r[EMC_STAT_NSECT][STAT_MAX_RANGES])
+{
+    const char *base = (const char *) s;
+    const char *motion = (const char *) &s->motion;
+    const EMC_IO_STAT *io = &s->io;
+
+#define RANGE(sect, n, start, end)				\
+    do {							\
+	r[sect][n].off = (const char *) (start) - base;		\
+	r[sect][n].len = (const char *) (end) - (const char *) (start); \
+    } while (0)
+#define FIELD(sect, n, f) RANGE(sect, n, &(f), &(f) + 1)
+
+    memset(r, 0, sizeof(stat_range) * EMC_STAT_NSECT * STAT_MAX_RANGES);
+    RANGE(0, 0, base, s->source_file + sizeof(s->source_file));
+    FIELD(0, 1, s->debug);
+    FIELD(1, 0, s->task);
+    FIELD(2, 0, s->motion.traj);
+    FIELD(3, 0, s->motion.axis);
+    FIELD(4, 0, s->motion.spindle);
+    RANGE(5, 0, motion, &s->motion.traj);
+    RANGE(5, 1, s->motion.synch_di, motion + sizeof(s->motion));
+    // EMC_IO_STAT and EMC_TOOL_STAT field by field, the compiler can't
+    // clear their padding
+    RANGE(6, 0, &io->command_type, io->source_file + sizeof(io->source_file));
+    RANGE(6, 1, &io->heartbeat, &io->fault + 1);
+    RANGE(6, 2, &io->tool.command_type,
+	  io->tool.source_file + sizeof(io->tool.source_file));
+    RANGE(6, 3, &io->tool.pocketPrepped, &io->tool.toolInSpindle + 1);
+    RANGE(6, 4, io->tool.toolTable, io->tool.pocketSerial + CANON_POCKETS_MAX);
+    RANGE(6, 5, &io->coolant, &io->lube + 1);
+    // EMC_STAT_SECT_HEARTBEAT is compared apart, see diff()
+#undef FIELD
+#undef RANGE
+}
+
+// zero the padding inside the parts of the status which are plain
+// structs, so it can't make a section look changed
+static void clear_padding(EMC_STAT *s)
+{
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_clear_padding)
+    __builtin_clear_padding(&s->task);
+    __builtin_clear_padding(&s->motion);
+    __builtin_clear_padding(&s->io.tool.toolTable);
+    __builtin_clear_padding(&s->io.coolant);
+    __builtin_clear_padding(&s->io.aux);
+    __builtin_clear_padding(&s->io.lube);
+#endif
+#endif
+}
+
+static int futex(int *uaddr, int op, int val, const struct timespec *ts)
+{
+    return syscall(SYS_futex, uaddr, op, val, ts, NULL, 0);
+}
+
+static int segment_path(const char *nmlfile, const char *bufname,
+			char *path, size_t len)
+{
+    char resolved[PATH_MAX];
+    const char *name = realpath(nmlfile, resolved) ? resolved : nmlfile;
+    unsigned int h = 2166136261u;	// FNV-1a
+
+    for (const char *p = name; *p; p++)
+	h = (h ^ (unsigned char) *p) * 16777619u;
+    h = (h ^ ':') * 16777619u;
+    for (const char *p = bufname; *p; p++)
+	h = (h ^ (unsigned char) *p) * 16777619u;
+
+    return snprintf(path, len, "/dev/shm/linuxcnc-stat-%08x", h) >= (int) len;
+}
+
+EmcStatNotify::EmcStatNotify():shm(0), publisher(false), last(0),
+    scratch(0), have_last(false), heartbeat_time(0.0), diff_mask(0),
+    cmd_seen(0)
+{
+    memset(seen, 0, sizeof(seen));
+    memset(heartbeat, 0, sizeof(heartbeat));
+}
+
+EmcStatNotify::~EmcStatNotify()
+{
+    detach();
+}
+
+int EmcStatNotify::attach(const char *nmlfile, const char *bufname,
+			  bool publish)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    int fd;
+
+    detach();
+    if (nmlfile == 0 || bufname == 0 ||
+	segment_path(nmlfile, bufname, path, sizeof(path)))
+	return -1;
+
+    if (publish) {
+	// readers need write access for the waiter count: the group of
+	// the task gets it unless the umask takes it away, a reader
+	// which can't open the segment falls back to polling
+	fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0660);
+	if (fd < 0) {
+	    rcs_print_error("EmcStatNotify: can't create %s: %s\n",
+			    path, strerror(errno));
+	    return -1;
+	}
+	// a segment left by an earlier run may have been made world
+	// writable, take that back
+	if (fstat(fd, &st) == 0 && st.st_uid == geteuid() &&
+	    (st.st_mode & 0117))
+	    fchmod(fd, st.st_mode & 0660);
+	if (ftruncate(fd, sizeof(emc_stat_notify_shm)) < 0) {
+	    close(fd);
+	    return -1;
+	}
+    } else {
+	fd = open(path, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	    return -1;
+	if (fstat(fd, &st) < 0 ||
+	    st.st_size < (off_t) sizeof(emc_stat_notify_shm)) {
+	    close(fd);
+	    return -1;
+	}
+    }
+
+    void *p = mmap(0, sizeof(emc_stat_notify_shm), PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+	return -1;
+    emc_stat_notify_shm *s = (emc_stat_notify_shm *) p;
+
+    if (publish) {
+	// keep the generations of a segment left over by an earlier
+	// run, so readers still attached to it see a change
+	if (s->magic != EMC_STAT_NOTIFY_MAGIC ||
+	    s->size != sizeof(EMC_STAT)) {
+	    memset(s, 0, sizeof(*s));
+	    s->size = sizeof(EMC_STAT);
+	    __atomic_store_n(&s->magic, EMC_STAT_NOTIFY_MAGIC, __ATOMIC_RELEASE);
+	}
+	s->pid = getpid();
+	last = new EMC_STAT;
+	scratch = new EMC_STAT;
+	have_last = false;
+	diff_mask = 0;
+	cmd_seen = __atomic_load_n(&s->cmd_seq, __ATOMIC_ACQUIRE);
+    } else {
+	// a stale segment from a task which is gone, or one built with
+	// a different EMC_STAT layout, is as good as none
+	if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != EMC_STAT_NOTIFY_MAGIC ||
+	    s->size != sizeof(EMC_STAT) ||
+	    (kill(s->pid, 0) < 0 && errno != EPERM)) {
+	    munmap(p, sizeof(emc_stat_notify_shm));
+	    return -1;
+	}
+	// report everything as changed on the first changed() call
+	for (int i = 0; i < EMC_STAT_NSECT; i++)
+	    seen[i] = __atomic_load_n(&s->gen[i], __ATOMIC_ACQUIRE) - 1;
+    }
+    publisher = publish;
+    shm = s;
+    return 0;
+}
+
+void EmcStatNotify::detach()
+{
+    if (shm) {
+	munmap(shm, sizeof(emc_stat_notify_shm));
+	shm = 0;
+    }
+    delete last;
+    delete scratch;
+    last = scratch = 0;
+    have_last = false;
+}
+
+int EmcStatNotify::publish(const EMC_STAT *stat)
+{
+    if (!shm || !publisher)
+	return 0;
+
+    int mask = diff(stat);
+    commit();
+    return mask;
+}
+
+int EmcStatNotify::diff(const EMC_STAT *stat)
+{
+    stat_range r[EMC_STAT_NSECT][STAT_MAX_RANGES];
+    int mask = 0;
+
+    if (!shm || !publisher)
+	return EMC_STAT_SECT_ALL;
+
+    memcpy((void *) scratch, stat, sizeof(EMC_STAT));
+    clear_padding(scratch);
+    scratch->task.heartbeat = 0;
+    scratch->motion.heartbeat = 0;
+    scratch->io.heartbeat = 0;
+
+    if (!have_last ||
+	((stat->task.heartbeat != heartbeat[0] ||
+	  stat->motion.heartbeat != heartbeat[1] ||
+	  stat->io.heartbeat != heartbeat[2]) &&
+	 etime() - heartbeat_time >= EMC_STAT_HEARTBEAT_INTERVAL)) {
+	heartbeat[0] = stat->task.heartbeat;
+	heartbeat[1] = stat->motion.heartbeat;
+	heartbeat[2] = stat->io.heartbeat;
+	heartbeat_time = etime();
+	mask |= EMC_STAT_SECT_HEARTBEAT;
+    }
+
+    section_ranges(scratch, r);
+    for (int i = 0; i < EMC_STAT_NSECT; i++) {
+	if (!have_last) {
+	    mask |= 1 << i;
+	    continue;
+	}
+	for (int n = 0; n < STAT_MAX_RANGES && r[i][n].len; n++) {
+	    if (memcmp((char *) scratch + r[i][n].off,
+		       (char *) last + r[i][n].off, r[i][n].len)) {
+		mask |= 1 << i;
+		break;
+	    }
+	}
+    }
+    diff_mask = mask;
+    return mask;
+}
+
+void EmcStatNotify::commit()
+{
+    if (!shm || !publisher || !diff_mask)
+	return;
+
+    for (int i = 0; i < EMC_STAT_NSECT; i++)
+	if (diff_mask & (1 << i))
+	    __atomic_add_fetch(&shm->gen[i], 1, __ATOMIC_RELEASE);
+    diff_mask = 0;
+
+    EMC_STAT *t = last;
+    last = scratch;
+    scratch = t;
+    have_last = true;
+
+    __atomic_add_fetch(&shm->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shm->waiters, __ATOMIC_SEQ_CST))
+	futex(&shm->seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+void EmcStatNotify::kick()
+{
+    if (!shm)
+	return;
+
+    shm->cmd_time = etime();
+    __atomic_add_fetch(&shm->cmd_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shm->cmd_waiters, __ATOMIC_SEQ_CST))
+	futex(&shm->cmd_seq, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+int EmcStatNotify::waitCommand(double timeout)
+{
+    double end = etime() + timeout;
+
+    if (!shm || !publisher) {
+	esleep(timeout);
+	return 0;
+    }
+
+    for (;;) {
+	int seq = __atomic_load_n(&shm->cmd_seq, __ATOMIC_SEQ_CST);
+	if (seq != cmd_seen) {
+	    cmd_seen = seq;
+	    return 1;
+	}
+
+	double left = end - etime();
+	if (left <= 0.0)
+	    return 0;
+
+	struct timespec ts;
+	ts.tv_sec = (time_t) left;
+	ts.tv_nsec = (long) ((left - ts.tv_sec) * 1e9);
+
+	// same protocol as wait(), roles swapped
+	__atomic_add_fetch(&shm->cmd_waiters, 1, __ATOMIC_SEQ_CST);
+	futex(&shm->cmd_seq, FUTEX_WAIT, seq, &ts);
+	__atomic_sub_fetch(&shm->cmd_waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+double EmcStatNotify::kickTime() const
+{
+    return shm ? shm->cmd_time : 0.0;
+}
+
+int EmcStatNotify::pending(int mask) const
+{
+    int result = 0;
+
+    for (int i = 0; i < EMC_STAT_NSECT; i++) {
+	if ((mask & (1 << i)) &&
+	    __atomic_load_n(&shm->gen[i], __ATOMIC_ACQUIRE) != seen[i])
+	    result |= 1 << i;
+    }
+    return result;
+}
+
+int EmcStatNotify::changed(int mask)
+{
+    int result = 0;
+
+    if (!shm)
+	return mask;
+
+    for (int i = 0; i < EMC_STAT_NSECT; i++) {
+	if (!(mask & (1 << i)))
+	    continue;
+	unsigned int g = __atomic_load_n(&shm->gen[i], __ATOMIC_ACQUIRE);
+	if (g != seen[i]) {
+	    seen[i] = g;
+	    result |= 1 << i;
+	}
+    }
+    return result;
+}
+
+int EmcStatNotify::wait(int mask, double timeout)
+{
+    double end = etime() + timeout;
+
+    if (!shm) {
+	esleep(timeout);
+	return mask;
+    }
+
+    for (;;) {
+	int seq = __atomic_load_n(&shm->seq, __ATOMIC_SEQ_CST);
+	int result = pending(mask);
+	if (result)
+	    return result;
+
+	double left = end - etime();
+	if (left <= 0.0)
+	    return 0;
+
+	struct timespec ts;
+	ts.tv_sec = (time_t) left;
+	ts.tv_nsec = (long) ((left - ts.tv_sec) * 1e9);
+
+	// the publisher bumps seq before looking at waiters, so either
+	// it sees us here or FUTEX_WAIT sees the new seq and returns
+	__atomic_add_fetch(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+	futex(&shm->seq, FUTEX_WAIT, seq, &ts);
+	__atomic_sub_fetch(&shm->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void emcStatWaitChange(EmcStatNotify *n, double timeout)
+{
+    if (n && n->valid())
+	n->wait(EMC_STAT_SECT_ALL, timeout);
+    else
+	esleep(timeout);
+}
@@ -0,0 +1,120 @@
+/********************************************************************
+ * Description: emcstatnotify.hh
+ *
+ *   Change notification for the emcStatus NML channel.
+ *
+ *   The task publishes a small shared segment next to the status
+ *   buffer holding a generation counter per EMC_STAT section and a
+ *   futex word.  Local readers block on the futex until a section
+ *   they care about changes, and only then peek() the status buffer,
+ *   instead of sleeping and copying the whole EMC_STAT on every poll.
+ *
+ *   The heartbeat counters advance every cycle, so they make a section
+ *   of their own which is reported at most every
+ *   EMC_STAT_HEARTBEAT_INTERVAL seconds: readers still see them stop
+ *   when the task dies, without waking up on every cycle.
+ *
+ *   The segment also carries a second futex word in the other
+ *   direction: a UI kick()s it after writing to emcCommand, so a task
+ *   running event driven wakes up right away instead of at the next
+ *   cycle.
+ *
+ * License: GPL Version 2+
+ * System: Linux
+ ********************************************************************/
+
+#ifndef EMCSTATNOTIFY_HH
+#define EMCSTATNOTIFY_HH
+
+// sections of EMC_STAT tracked separately
+enum {
+    EMC_STAT_SECT_HEADER  = 0x01,	// echo_serial_number, status etc, debug
+    EMC_STAT_SECT_TASK    = 0x02,	// task
+    EMC_STAT_SECT_TRAJ    = 0x04,	// motion.traj
+    EMC_STAT_SECT_AXIS    = 0x08,	// motion.axis[]
+    EMC_STAT_SECT_SPINDLE = 0x10,	// motion.spindle
+    EMC_STAT_SECT_MOTION  = 0x20,	// rest of motion: dio/aio, debug
+    EMC_STAT_SECT_IO      = 0x40,	// io
+    EMC_STAT_SECT_HEARTBEAT = 0x80,	// task, motion and io heartbeat
+    EMC_STAT_SECT_ALL     = 0xff
+};
+
+#define EMC_STAT_NSECT 8
+#define EMC_STAT_HEARTBEAT_INTERVAL 0.1
+
+class EMC_STAT;
+struct emc_stat_notify_shm;
+
+class EmcStatNotify {
+  public:
+    EmcStatNotify();
+    ~EmcStatNotify();
+
+    // Attach to the notification segment belonging to the given
+    // buffer in nmlfile. The publisher (task) creates it, readers
+    // fail with -1 if it does not exist, e.g. because the status
+    // channel is remote; they should then fall back to polling.
+    int attach(const char *nmlfile, const char *bufname, bool publisher);
+    void detach();
+    bool valid() const { return shm != 0; }
+
+    // Publisher side: compare stat with what was published last and
+    // wake readers if any section changed. Call right after the
+    // status buffer write.
+    int publish(const EMC_STAT *stat);
+
+    // Publisher side, publish() in two steps: diff() returns the mask
+    // of sections which differ from what was published last, all of
+    // them if not attached. commit() then publishes those, so the
+    // status buffer write can be skipped in between if nothing changed.
+    int diff(const EMC_STAT *stat);
+    void commit();
+
+    // Command side: tell the publisher a command was written to the
+    // command channel, and wake it if it is in waitCommand().
+    void kick();
+
+    // Publisher side: block until kick() was called since the last
+    // return, or timeout seconds elapse. Returns 1 if kicked, 0 on
+    // timeout. Plain esleep() if not attached.
+    int waitCommand(double timeout);
+
+    // Publisher side: etime() of the most recent kick(), 0 if none.
+    double kickTime() const;
+
+    // Reader side: return the mask of sections in 'mask' which
+    // changed since the last call, and mark them seen. Call this
+    // right before peek(); if it returns 0 the copy held by the
+    // status channel is still current and the peek can be skipped.
+    int changed(int mask = EMC_STAT_SECT_ALL);
+
+    // Reader side: block until a section in 'mask' changed since it
+    // was last reported by changed(), or timeout seconds elapse.
+    // Returns the pending mask, 0 on timeout. Does not mark anything
+    // seen, so a following changed()/peek() picks the update up.
+    int wait(int mask, double timeout);
+
+  private:
+    emc_stat_notify_shm *shm;
+    bool publisher;
+    unsigned int seen[EMC_STAT_NSECT];
+    EMC_STAT *last;		// publisher: last published snapshot
+    EMC_STAT *scratch;		// publisher: current, heartbeats masked
+    bool have_last;
+    unsigned long heartbeat[3];	// publisher: as last published
+    double heartbeat_time;	// publisher: etime() of that
+    int diff_mask;		// publisher: sections to commit()
+    int cmd_seen;		// publisher: last cmd_seq returned
+
+    int pending(int mask) const;
+
+    EmcStatNotify(const EmcStatNotify &);
+    EmcStatNotify &operator=(const EmcStatNotify &);
+};
+
+// Sleep for up to 'timeout' seconds, returning early when the status
+// changes if n is attached. Plain esleep() otherwise. Meant for the
+// command wait loops which sleep between status checks.
+extern void emcStatWaitChange(EmcStatNotify *n, double timeout);
+
+#endif /* EMCSTATNOTIFY_HH */
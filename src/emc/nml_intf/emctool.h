@@ -20,7 +20,13 @@
 #include "emcpos.h"
 
 /* Tools are numbered 1..CANON_TOOL_MAX, with tool 0 meaning no tool. */
+/* Lookups by tool number are indexed, so the pocket count can be raised
+   at build time (-DCANON_POCKETS_MAX=n). The tool table is part of the
+   io and task status, so the toolSts and emcStatus buffers in the .nml
+   files must grow by ~110 bytes per pocket to match. */
+#ifndef CANON_POCKETS_MAX
 #define CANON_POCKETS_MAX 56	// max size of carousel handled
+#endif
 #define CANON_TOOL_ENTRY_LEN 512	// how long each file line can be
 #define CANON_TOOL_COMMENT_LEN 256	// how long each comment can be
 
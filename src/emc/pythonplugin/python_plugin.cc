@@ -4,6 +4,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/inotify.h>
 
 #define MAX_ERRMSG_SIZE 256
 
@@ -26,9 +31,65 @@
 
 extern const char *strstore(const char *s);
 
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// resolve module.callable, from the cache if it was resolved before.
+// Throws bp::error_already_set (KeyError) if there is no such name.
+PythonPlugin::callable_entry &PythonPlugin::lookup(const char *module,
+						   const char *callable)
+{
+    callable_entry &e = callables[std::make_pair(std::string(module ? module : ""),
+						 std::string(callable))];
+    if (e.function.ptr() == Py_None) {
+	if (module == NULL) {  // default to function in toplevel module
+	    e.function = main_namespace[callable];
+	} else {
+	    bp::object submod =  main_namespace[module];
+	    bp::object submod_namespace = submod.attr("__dict__");
+	    e.function = submod_namespace[callable];
+	}
+    }
+    return e;
+}
+
+// drop the resolved function objects, the names are looked up again on
+// the next call
+void PythonPlugin::forget_callables()
+{
+    for (callable_map::iterator it = callables.begin(); it != callables.end(); ++it)
+	it->second.function = bp::object();
+}
+
+void PythonPlugin::print_stats()
+{
+    for (callable_map::iterator it = callables.begin(); it != callables.end(); ++it) {
+	callable_entry &e = it->second;
+	if (e.calls == 0)
+	    continue;
+	fprintf(stderr, "PythonPlugin: %s%s%s: %lu calls, %.3fms avg, %.3fms max\n",
+		it->first.first.c_str(), it->first.first.empty() ? "" : ".",
+		it->first.second.c_str(), e.calls,
+		e.total / e.calls * 1e3, e.max * 1e3);
+    }
+}
+
+static void print_stats_atexit()
+{
+    extern PythonPlugin *python_plugin;
+    if (python_plugin)
+	python_plugin->print_stats();
+}
+
 int PythonPlugin::run_string(const char *cmd, bp::object &retval, bool as_file)
 {
     reload();
+    // the code may (re)define any name in the namespace, even if it fails
+    forget_callables();
     try {
 	if (as_file)
 	    retval = bp::exec_file(cmd, main_namespace, main_namespace);
@@ -82,8 +143,6 @@ int PythonPlugin::call_method(bp::object method, bp::object &retval)
 int PythonPlugin::call(const char *module, const char *callable,
 		       bp::object tupleargs, bp::object kwargs, bp::object &retval)
 {
-    bp::object function;
-
     if (callable == NULL)
 	return PLUGIN_NO_CALLABLE;
 
@@ -93,18 +152,23 @@ int PythonPlugin::call(const char *module, const char *callable,
 	return status;
 
     try {
-	if (module == NULL) {  // default to function in toplevel module
-	    function = main_namespace[callable];
-	} else {
-	    bp::object submod =  main_namespace[module];
-	    bp::object submod_namespace = submod.attr("__dict__");
-	    function = submod_namespace[callable];
-	}
+	callable_entry &e = lookup(module, callable);
+
 	// this wont work with boost-python1.34 - needs 1.40
 	//retval = function(*tupleargs, **kwargs);
 
 	// this does
-	PyObject *rv = PyObject_Call(function.ptr(), tupleargs.ptr(), kwargs.ptr());
+	PyObject *rv;
+	if (log_level > 0) {
+	    double start = now();
+	    rv = PyObject_Call(e.function.ptr(), tupleargs.ptr(), kwargs.ptr());
+	    double t = now() - start;
+	    e.calls++;
+	    e.total += t;
+	    if (t > e.max)
+		e.max = t;
+	} else
+	    rv = PyObject_Call(e.function.ptr(), tupleargs.ptr(), kwargs.ptr());
 	if (PyErr_Occurred()) 
 	    bp::throw_error_already_set();
 	if (rv) 
@@ -136,7 +200,6 @@ bool PythonPlugin::is_callable(const char *module,
 {
     bool unexpected = false;
     bool result = false;
-    bp::object function;
 
     reload();
     if ((status != PLUGIN_OK) ||
@@ -144,14 +207,7 @@ bool PythonPlugin::is_callable(const char *module,
 	return false;
     }
     try {
-	if (module == NULL) {  // default to function in toplevel module
-	   function = main_namespace[funcname];
-	} else {
-	    bp::object submod =  main_namespace[module];
-	    bp::object submod_namespace = submod.attr("__dict__");
-	    function = submod_namespace[funcname];
-	}
-	result = PyCallable_Check(function.ptr());
+	result = PyCallable_Check(lookup(module, funcname).function.ptr());
     }
     catch (bp::error_already_set) {
 	// KeyError expected if not callable
@@ -175,20 +231,54 @@ bool PythonPlugin::is_callable(const char *module,
     return result;
 }
 
-// this should be moved to an inotify-based solution and be done with it
+// drain the inotify queue; true if the toplevel module was written or
+// replaced. Editors often save by renaming a new file over the old
+// one, so the directory is watched rather than the file.
+bool PythonPlugin::toplevel_changed()
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[PATH_MAX];
+    bool changed = false;
+    ssize_t len;
+
+    strncpy(path, abs_path, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    const char *base = basename(path);
+
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+	for (char *p = buf; p < buf + len; ) {
+	    struct inotify_event *ev = (struct inotify_event *) p;
+	    if ((ev->mask & IN_Q_OVERFLOW) ||
+		(ev->len && !strcmp(ev->name, base)))
+		changed = true;
+	    p += sizeof(struct inotify_event) + ev->len;
+	}
+    }
+    return changed;
+}
+
 int PythonPlugin::reload()
 {
     struct stat st;
+    bool changed;
+
     if (!reload_on_change)
 	return PLUGIN_OK;
 
-    if (stat(abs_path, &st)) {
-	logPP(0, "reload: stat(%s) returned %s", abs_path, strerror(errno));
-	status = PLUGIN_STAT_FAILED;
-	return status;
+    if (inotify_fd >= 0) {
+	changed = toplevel_changed();
+    } else {
+	// no inotify - fall back to checking the mtime on every call
+	if (stat(abs_path, &st)) {
+	    logPP(0, "reload: stat(%s) returned %s", abs_path, strerror(errno));
+	    status = PLUGIN_STAT_FAILED;
+	    return status;
+	}
+	changed = (st.st_mtime > module_mtime);
+	if (changed)
+	    module_mtime = st.st_mtime;
     }
-    if (st.st_mtime > module_mtime) {
-	module_mtime = st.st_mtime;
+    if (changed) {
 	initialize();
 	logPP(1, "reload():  %s reloaded, status=%d", toplevel, status);
     } else {
@@ -224,6 +314,9 @@ int PythonPlugin::initialize()
     std::string msg;
     if (Py_IsInitialized()) {
 	try {
+	    // any function objects resolved so far belong to the old module
+	    forget_callables();
+
 	    bp::object module = bp::import("__main__");
 	    main_namespace = module.attr("__dict__");
 
@@ -260,6 +353,7 @@ PythonPlugin::PythonPlugin(struct _inittab *inittab) :
     status(0),
     module_mtime(0),
     reload_on_change(0),
+    inotify_fd(-1),
     ini_filename(0),
     section(0),
     inittab_pointer(0),
@@ -324,6 +418,19 @@ int PythonPlugin::configure(const char *iniFilename,
 	abs_path = strstore(real_path);
 	module_mtime = st.st_mtime;      // record timestamp
 
+	if (reload_on_change) {
+	    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	    if ((inotify_fd >= 0) &&
+		(inotify_add_watch(inotify_fd, dirname(real_path),
+				   IN_CLOSE_WRITE | IN_MOVED_TO) < 0)) {
+		close(inotify_fd);
+		inotify_fd = -1;
+	    }
+	    if (inotify_fd < 0)
+		logPP(1, "inotify on '%s' failed: %s, checking mtime instead",
+		      abs_path, strerror(errno));
+	}
+
     } else {
         if (getcwd(real_path, PATH_MAX) == NULL) {
             logPP(1, "path too long");
@@ -336,6 +443,8 @@ int PythonPlugin::configure(const char *iniFilename,
     if ((inistring = inifile.Find("LOG_LEVEL", section)) != NULL)
 	log_level = atoi(inistring);
     else log_level = 0;
+    if (log_level > 0)
+	atexit(print_stats_atexit);
 
     char pycmd[PATH_MAX];
     int n = 1;
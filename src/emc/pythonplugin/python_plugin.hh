@@ -6,6 +6,8 @@ namespace bp = boost::python;
 
 #include <vector>
 #include <string>
+#include <map>
+#include <utility>
 #include <sys/types.h>
 
 
@@ -52,6 +54,7 @@ public:
     int initialize();
     std::string last_exception() { return exception_msg; };
     std::string last_errmsg() { return error_msg; };
+    void print_stats();   // per-callable call counts and times, to stderr
     bp::object main_namespace;
 
 private:
@@ -61,10 +64,28 @@ private:
     ~PythonPlugin() {};
 
     int reload();
+    bool toplevel_changed();
+
+    // callables resolved by call() and is_callable(), keyed by
+    // (module, callable); module "" is the toplevel namespace.
+    // The function objects are dropped by initialize() and
+    // run_string(), the statistics are kept across reloads. Calls
+    // are only timed with LOG_LEVEL > 0.
+    struct callable_entry {
+	bp::object function;
+	unsigned long calls;
+	double total, max;	// seconds spent in the call
+	callable_entry() : calls(0), total(0.0), max(0.0) {}
+    };
+    typedef std::map<std::pair<std::string, std::string>, callable_entry> callable_map;
+    callable_map callables;
+    callable_entry &lookup(const char *module, const char *callable);
+    void forget_callables();
     std::vector<std::string> inittab_entries;
     int status;
     time_t module_mtime;                  // toplevel module - last modification time
     bool reload_on_change;                // auto-reload if toplevel module was changed
+    int inotify_fd;                       // watching the toplevel module's directory, or -1
     const char *ini_filename;
     const char *section;
     struct _inittab *inittab_pointer;
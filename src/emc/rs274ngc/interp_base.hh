@@ -58,6 +58,7 @@ public:
             double settings[ACTIVE_SETTINGS],
             StateTag const &tag) = 0;
     virtual int restore_from_tag(StateTag const &tag) = 0;
+    virtual int begin_run(int line) = 0;
     virtual void set_loglevel(int level) = 0;
 };
 
@@ -0,0 +1,585 @@
+/********************************************************************
+* Description: interp_checkpoint.cc
+*
+* Checkpoints of the interpreter state for run-from-line: while task
+* runs a program, every [RS274NGC]CHECKPOINT_INTERVAL lines the state
+* at the top level is appended to <program>.ckpt (or to
+* [RS274NGC]CHECKPOINT_DIR/<name>.ckpt). Starting at line N restores
+* the nearest checkpoint before N, so only the lines after it are read
+* again instead of the whole program.
+*
+* A checkpoint holds what reading the program up to that line leaves
+* behind: the numbered and the global named parameters, the modal
+* state, the offsets, the o-word labels of the program seen so far and
+* the position in the file. Labels of subs in other files are not kept:
+* a call finds them on SUBROUTINE_PATH again, as edited since. Checkpoints are only taken at call level 0, outside of
+* a sub definition or a skipped block, with cutter compensation and
+* CSS off; anything else is read again from the checkpoint before.
+*
+* The file starts with a hash of the program text and of the state a
+* run starts from: the numbered parameters below #5400 (the user
+* parameters, G28/G30, G92, the coordinate systems), the global named
+* parameters and the tool table. When either differs from the file,
+* its checkpoints are dropped and new ones are written as the run goes.
+* A program which leaves any of these changed at its end starts over
+* on every run.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <boost/python.hpp>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <libgen.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rs274ngc.hh"
+#include "rs274ngc_return.hh"
+#include "interp_internal.hh"
+#include "interp_queue.hh"
+#include "rs274ngc_interp.hh"
+
+#define CHECKPOINT_MAGIC "NGCCKPT1"
+#define FNV_INIT 0xcbf29ce484222325ULL
+
+struct checkpoint_header {
+    char magic[8];
+    uint64_t program_hash;
+    uint64_t start_hash;
+};
+
+struct checkpoint_record {
+    int32_t size;		// of the data following
+    int32_t sequence_number;
+    uint64_t sum;		// FNV-1a of the data
+};
+
+// the plain members of _setup a checkpoint restores, in record order;
+// a change to the record layout needs a new CHECKPOINT_MAGIC
+#define CHECKPOINT_FIELDS(X) \
+    X(AA_axis_offset) X(AA_current) X(AA_origin_offset) \
+    X(BB_axis_offset) X(BB_current) X(BB_origin_offset) \
+    X(CC_axis_offset) X(CC_current) X(CC_origin_offset) \
+    X(u_axis_offset) X(u_current) X(u_origin_offset) \
+    X(v_axis_offset) X(v_current) X(v_origin_offset) \
+    X(w_axis_offset) X(w_current) X(w_origin_offset) \
+    X(arc_not_allowed) \
+    X(axis_offset_x) X(axis_offset_y) X(axis_offset_z) \
+    X(control_mode) X(current_pocket) \
+    X(current_x) X(current_y) X(current_z) \
+    X(cutter_comp_radius) X(cutter_comp_orientation) X(cutter_comp_side) \
+    X(cycle_cc) X(cycle_i) X(cycle_j) X(cycle_k) X(cycle_l) \
+    X(cycle_p) X(cycle_q) X(cycle_r) X(cycle_il) X(cycle_il_flag) \
+    X(distance_mode) X(ijk_distance_mode) \
+    X(feed_mode) X(feed_override) X(feed_rate) \
+    X(flood) X(length_units) X(mist) X(motion_mode) \
+    X(origin_index) X(origin_offset_x) X(origin_offset_y) X(origin_offset_z) \
+    X(rotation_xy) X(percent_flag) X(plane) \
+    X(program_x) X(program_y) X(program_z) \
+    X(retract_mode) X(selected_pocket) X(selected_tool) \
+    X(speed) X(spindle_mode) X(speed_feed_mode) X(speed_override) \
+    X(spindle_turning) X(tool_offset) X(traverse_rate) \
+    X(executed_if) X(test_value) X(return_value) X(value_returned) \
+    X(adaptive_feed) X(feed_hold) X(lathe_diameter_mode)
+
+// named parameters a program can't set, the interpreter provides them
+#define PA_PROVIDED (PA_READONLY | PA_USE_LOOKUP | PA_PYTHON | PA_FROM_INI)
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    while (size--) {
+	h ^= *p++;
+	h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+namespace {
+
+struct checkpoint_writer {
+    std::string buf;
+
+    template <class T> void put(const T &v) {
+	buf.append((const char *) &v, sizeof(v));
+    }
+    void put_string(const char *s) {
+	int32_t len = s ? strlen(s) : -1;
+	put(len);
+	if (len > 0)
+	    buf.append(s, len);
+    }
+};
+
+// the record was checksummed before, so only the size is checked
+struct checkpoint_reader {
+    const char *p, *end;
+    bool ok;
+
+    checkpoint_reader(const char *data, size_t size)
+	: p(data), end(data + size), ok(true) {}
+
+    // the next size bytes, NULL if there aren't as many
+    const char *skip(size_t size) {
+	const char *data = p;
+	if (end - p < (long) size) {
+	    ok = false;
+	    return NULL;
+	}
+	p += size;
+	return data;
+    }
+
+    template <class T> void get(T &v) {
+	if (end - p < (long) sizeof(v)) {
+	    ok = false;
+	    memset(&v, 0, sizeof(v));
+	    return;
+	}
+	memcpy(&v, p, sizeof(v));
+	p += sizeof(v);
+    }
+    // strstore()d, NULL for a NULL string
+    const char *get_string() {
+	int32_t len;
+	get(len);
+	if (!ok || len < 0)
+	    return NULL;
+	if (end - p < len) {
+	    ok = false;
+	    return NULL;
+	}
+	std::string s(p, len);
+	p += len;
+	return strstore(s.c_str());
+    }
+};
+
+}
+
+// the state a run starts from, as far as the checkpoints depend on it
+static uint64_t start_hash(setup_pointer settings)
+{
+    uint64_t h = FNV_INIT;
+    int i;
+
+    parameter_map_iterator pi;
+    parameter_map &named = settings->sub_context[0].named_params;
+
+    // #5400 and up are the tool and the position, which the
+    // interpreter sets itself
+    h = fnv1a(h, &settings->parameters[1], 5399 * sizeof(double));
+    for (pi = named.begin(); pi != named.end(); pi++) {
+	if (pi->second.attr & PA_PROVIDED)
+	    continue;
+	h = fnv1a(h, pi->first, strlen(pi->first) + 1);
+	h = fnv1a(h, &pi->second.value, sizeof(pi->second.value));
+	h = fnv1a(h, &pi->second.attr, sizeof(pi->second.attr));
+    }
+    for (i = 0; i < settings->pockets_max; i++) {
+	CANON_TOOL_TABLE *t = &settings->tool_table[i];
+	double v[] = { t->offset.tran.x, t->offset.tran.y, t->offset.tran.z,
+		       t->offset.a, t->offset.b, t->offset.c,
+		       t->offset.u, t->offset.v, t->offset.w,
+		       t->diameter, t->frontangle, t->backangle };
+	h = fnv1a(h, &t->toolno, sizeof(t->toolno));
+	h = fnv1a(h, v, sizeof(v));
+	h = fnv1a(h, &t->orientation, sizeof(t->orientation));
+    }
+    return h;
+}
+
+static int program_hash(const char *filename, uint64_t *hash)
+{
+    char buf[65536];
+    size_t n;
+    FILE *fp = fopen(filename, "r");
+
+    if (fp == NULL)
+	return -1;
+    *hash = FNV_INIT;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+	*hash = fnv1a(*hash, buf, n);
+    n = ferror(fp);
+    fclose(fp);
+    return n ? -1 : 0;
+}
+
+/*! Interp::begin_run
+
+Returned Value: int
+   the sequence number the interpreter stands at after restoring a
+   checkpoint, 0 if reading starts at the top
+
+Called By: external programs (task, on a run command)
+
+Only acts while nothing of the open program was read yet. Opens the
+checkpoint file of the program, which makes _read() add checkpoints as
+the run goes, then restores the checkpoint nearest before line. Any
+failure just leaves the interpreter at the top of the program.
+
+*/
+
+int Interp::begin_run(int line)
+{
+    std::map<int,long>::iterator it;
+
+    if ((_setup.checkpoint_interval <= 0) ||
+	(_setup.file_pointer == NULL) ||
+	(_setup.call_level != 0) ||
+	(_setup.sequence_number > (_setup.percent_flag ? 1 : 0)))
+	return 0;
+    if (!_setup.checkpoint_fp && (checkpoint_open() != INTERP_OK))
+	return 0;
+
+    it = _setup.checkpoint_index.lower_bound(line);
+    if (it == _setup.checkpoint_index.begin())
+	return 0;
+    --it;
+    if (checkpoint_restore(it->second) != INTERP_OK) {
+	Error("%s: checkpoint at line %d is unusable, reading from the top",
+	      _setup.filename, it->first);
+	return 0;
+    }
+    logDebug("begin_run(%d): restored checkpoint at line %d",
+	     line, _setup.sequence_number);
+    return _setup.sequence_number;
+}
+
+/*! Interp::checkpoint_open
+
+Opens or creates the checkpoint file of _setup.filename and indexes
+the records in it; drops them if the program or the start state
+changed, and a partial record left by a crash.
+
+*/
+
+int Interp::checkpoint_open()
+{
+    char path[PATH_MAX];
+    char name[PATH_MAX];
+    checkpoint_header want, have;
+    checkpoint_record rec;
+    long offset, size;
+    int n;
+
+    memset(&want, 0, sizeof(want));
+    memcpy(want.magic, CHECKPOINT_MAGIC, sizeof(want.magic));
+    if (program_hash(_setup.filename, &want.program_hash)) {
+	Error("checkpoints: can't read %s", _setup.filename);
+	return INTERP_ERROR;
+    }
+    want.start_hash = start_hash(&_setup);
+
+    if (_setup.checkpoint_dir[0]) {
+	strncpy(name, _setup.filename, sizeof(name));
+	name[sizeof(name) - 1] = 0;
+	n = snprintf(path, sizeof(path), "%s/%s.ckpt",
+		     _setup.checkpoint_dir, basename(name));
+    } else {
+	n = snprintf(path, sizeof(path), "%s.ckpt", _setup.filename);
+    }
+    if (n >= (int) sizeof(path))
+	return INTERP_ERROR;
+
+    _setup.checkpoint_fp = fopen(path, "r+");
+    if (_setup.checkpoint_fp == NULL)
+	_setup.checkpoint_fp = fopen(path, "w+");
+    if (_setup.checkpoint_fp == NULL) {
+	Error("checkpoints: can't open %s: %s", path, strerror(errno));
+	return INTERP_ERROR;
+    }
+    _setup.checkpoint_index.clear();
+
+    if ((fread(&have, sizeof(have), 1, _setup.checkpoint_fp) != 1) ||
+	memcmp(&have, &want, sizeof(have))) {
+	logDebug("checkpoints: starting over in %s", path);
+	if (ftruncate(fileno(_setup.checkpoint_fp), 0) ||
+	    fseek(_setup.checkpoint_fp, 0, SEEK_SET) ||
+	    (fwrite(&want, sizeof(want), 1, _setup.checkpoint_fp) != 1) ||
+	    fflush(_setup.checkpoint_fp)) {
+	    Error("checkpoints: can't write %s: %s", path, strerror(errno));
+	    checkpoint_close();
+	    return INTERP_ERROR;
+	}
+	return INTERP_OK;
+    }
+
+    fseek(_setup.checkpoint_fp, 0, SEEK_END);
+    size = ftell(_setup.checkpoint_fp);
+    offset = sizeof(have);
+    while ((fseek(_setup.checkpoint_fp, offset, SEEK_SET) == 0) &&
+	   (fread(&rec, sizeof(rec), 1, _setup.checkpoint_fp) == 1) &&
+	   (rec.size >= 0) &&
+	   (offset + (long) sizeof(rec) + rec.size <= size)) {
+	_setup.checkpoint_index[rec.sequence_number] = offset;
+	offset += sizeof(rec) + rec.size;
+    }
+    if ((offset != size) && ftruncate(fileno(_setup.checkpoint_fp), offset))
+	Error("checkpoints: can't truncate %s: %s", path, strerror(errno));
+    logDebug("checkpoints: %zu in %s", _setup.checkpoint_index.size(), path);
+    return INTERP_OK;
+}
+
+void Interp::checkpoint_close()
+{
+    if (_setup.checkpoint_fp) {
+	fclose(_setup.checkpoint_fp);
+	_setup.checkpoint_fp = NULL;
+    }
+    _setup.checkpoint_index.clear();
+}
+
+/*! Interp::checkpoint_save
+
+Called By: Interp::_read, before reading the next line of the program
+
+Appends a checkpoint of the state after the lines read so far, if
+there is none within the last checkpoint_interval lines and the
+interpreter is at a point it can be restored to.
+
+*/
+
+void Interp::checkpoint_save()
+{
+    int seq = _setup.sequence_number;
+    std::map<int,long>::iterator it;
+    checkpoint_writer w;
+    checkpoint_record rec;
+    parameter_map_iterator pi;
+    offset_map_iterator oi;
+    context *top = &_setup.sub_context[0];
+    long offset;
+    int32_t n;
+    int i;
+
+    if ((_setup.call_level != 0) || (_setup.remap_level != 0) ||
+	_setup.defining_sub || _setup.skipping_o || _setup.skipping_to_sub ||
+	_setup.doing_continue || _setup.doing_break || _setup.mdi_interrupt ||
+	_setup.cutter_comp_side || !qc().empty() ||
+	(_setup.spindle_mode == CONSTANT_SURFACE))
+	return;
+    it = _setup.checkpoint_index.upper_bound(seq);
+    if (it == _setup.checkpoint_index.begin()) {
+	if (seq < _setup.checkpoint_interval)
+	    return;
+    } else if (seq - (--it)->first < _setup.checkpoint_interval) {
+	return;
+    }
+
+    w.put((int64_t) ftell(_setup.file_pointer));
+    w.put(GET_EXTERNAL_MOTION_CONTROL_TOLERANCE());
+#define PUT(f) w.put(_setup.f);
+    CHECKPOINT_FIELDS(PUT)
+#undef PUT
+    w.put(top->context_status);
+    w.put(top->saved_g_codes);
+    w.put(top->saved_m_codes);
+    w.put(top->saved_settings);
+
+    // most numbered parameters are 0
+    for (i = 1, n = 0; i < RS274NGC_MAX_PARAMETERS; i++)
+	n += (_setup.parameters[i] != 0.0);
+    w.put(n);
+    for (i = 1; i < RS274NGC_MAX_PARAMETERS; i++) {
+	if (_setup.parameters[i] != 0.0) {
+	    w.put((int32_t) i);
+	    w.put(_setup.parameters[i]);
+	}
+    }
+
+    for (pi = top->named_params.begin(), n = 0;
+	 pi != top->named_params.end(); pi++)
+	n += !(pi->second.attr & PA_PROVIDED);
+    w.put(n);
+    for (pi = top->named_params.begin(); pi != top->named_params.end(); pi++) {
+	if (pi->second.attr & PA_PROVIDED)
+	    continue;
+	w.put_string(pi->first);
+	w.put(pi->second.value);
+	w.put(pi->second.attr);
+    }
+
+    // only the program's own labels: program_hash() vouches for their
+    // offsets, subs in other files are looked up again when called
+    for (oi = _setup.offset_map.begin(), n = 0;
+	 oi != _setup.offset_map.end(); oi++)
+	n += !strcmp(oi->second.filename, _setup.filename);
+    w.put(n);
+    for (oi = _setup.offset_map.begin(); oi != _setup.offset_map.end(); oi++) {
+	if (strcmp(oi->second.filename, _setup.filename))
+	    continue;
+	w.put_string(oi->first);
+	w.put(oi->second.type);
+	w.put_string(oi->second.filename);
+	w.put((int64_t) oi->second.offset);
+	w.put(oi->second.sequence_number);
+	w.put(oi->second.repeat_count);
+    }
+
+    rec.size = w.buf.size();
+    rec.sequence_number = seq;
+    rec.sum = fnv1a(FNV_INIT, w.buf.data(), w.buf.size());
+    if (fseek(_setup.checkpoint_fp, 0, SEEK_END) ||
+	((offset = ftell(_setup.checkpoint_fp)) < 0) ||
+	(fwrite(&rec, sizeof(rec), 1, _setup.checkpoint_fp) != 1) ||
+	(fwrite(w.buf.data(), w.buf.size(), 1, _setup.checkpoint_fp) != 1) ||
+	fflush(_setup.checkpoint_fp)) {
+	Error("checkpoints: write failed at line %d, no more checkpoints: %s",
+	      seq, strerror(errno));
+	checkpoint_close();
+	return;
+    }
+    _setup.checkpoint_index[seq] = offset;
+}
+
+/*! Interp::checkpoint_restore
+
+Returned Value: int
+   INTERP_OK, or INTERP_ERROR if the record can't be read, fails its
+   checksum or the program file can't be positioned, in which case the
+   interpreter state is unchanged.
+
+Called By: Interp::begin_run
+
+Puts back the state of the checkpoint at offset in the checkpoint
+file, positions the program file after the line it was taken at, and
+brings canon in line with the restored modal state and offsets.
+Positions are left to synch(). The record is decoded completely before
+any of it is stored in _setup.
+
+*/
+
+int Interp::checkpoint_restore(long offset)
+{
+    checkpoint_record rec;
+    context *top = &_setup.sub_context[0];
+    parameter_map_iterator pi;
+    int64_t file_offset;
+    double tolerance;
+    int32_t n;
+    size_t i;
+#define SIZE(f) + sizeof(_setup.f)
+    const size_t fields_size = 0 CHECKPOINT_FIELDS(SIZE) +
+	sizeof(top->context_status) + sizeof(top->saved_g_codes) +
+	sizeof(top->saved_m_codes) + sizeof(top->saved_settings);
+#undef SIZE
+
+    if (fseek(_setup.checkpoint_fp, offset, SEEK_SET) ||
+	(fread(&rec, sizeof(rec), 1, _setup.checkpoint_fp) != 1) ||
+	(rec.size < 0))
+	return INTERP_ERROR;
+    std::string buf(rec.size, '\0');
+    if ((fread(&buf[0], 1, rec.size, _setup.checkpoint_fp) != (size_t) rec.size) ||
+	(fnv1a(FNV_INIT, buf.data(), buf.size()) != rec.sum))
+	return INTERP_ERROR;
+
+    checkpoint_reader r(buf.data(), buf.size());
+    r.get(file_offset);
+    r.get(tolerance);
+    const char *fields = r.skip(fields_size);
+
+    std::vector<double> parameters(RS274NGC_MAX_PARAMETERS, 0.0);
+    r.get(n);
+    while (r.ok && n-- > 0) {
+	int32_t index;
+	double value;
+	r.get(index);
+	r.get(value);
+	if ((index > 0) && (index < RS274NGC_MAX_PARAMETERS))
+	    parameters[index] = value;
+    }
+
+    std::vector<std::pair<const char *, parameter_value> > named;
+    r.get(n);
+    while (r.ok && n-- > 0) {
+	const char *name = r.get_string();
+	parameter_value param;
+	r.get(param.value);
+	r.get(param.attr);
+	if (name)
+	    named.push_back(std::make_pair(name, param));
+    }
+
+    offset_map_type offsets;
+    r.get(n);
+    while (r.ok && n-- > 0) {
+	const char *name = r.get_string();
+	struct offset_struct o;
+	int64_t o_offset;
+	r.get(o.type);
+	o.filename = r.get_string();
+	r.get(o_offset);
+	o.offset = o_offset;
+	r.get(o.sequence_number);
+	r.get(o.repeat_count);
+	if (name && o.filename)
+	    offsets[name] = o;
+    }
+    // the sum matched, so this is a layout change without a new magic
+    CHKS(!r.ok, _("BUG: checkpoint record at %ld doesn't match the layout"),
+	 offset);
+    CHKS(fseek(_setup.file_pointer, file_offset, SEEK_SET),
+	 _("can't seek to the checkpoint at line %d"), rec.sequence_number);
+
+    // all of the record is read, store it
+    checkpoint_reader f(fields, fields_size);
+#define GET(field) f.get(_setup.field);
+    CHECKPOINT_FIELDS(GET)
+#undef GET
+    f.get(top->context_status);
+    f.get(top->saved_g_codes);
+    f.get(top->saved_m_codes);
+    f.get(top->saved_settings);
+
+    memcpy(_setup.parameters, &parameters[0], sizeof(_setup.parameters));
+
+    // what the program set before is replaced by the checkpoint
+    for (pi = top->named_params.begin(); pi != top->named_params.end(); ) {
+	if (pi->second.attr & PA_PROVIDED)
+	    pi++;
+	else
+	    top->named_params.erase(pi++);
+    }
+    for (i = 0; i < named.size(); i++)
+	top->named_params[named[i].first] = named[i].second;
+
+    _setup.offset_map.swap(offsets);
+
+    _setup.sequence_number = rec.sequence_number;
+    write_g_codes((block_pointer) NULL, &_setup);
+    write_m_codes((block_pointer) NULL, &_setup);
+    write_settings(&_setup);
+
+    // what reading the lines would have told canon
+    USE_LENGTH_UNITS(_setup.length_units);
+    SELECT_PLANE(_setup.plane);
+    SET_G5X_OFFSET(_setup.origin_index,
+		   _setup.origin_offset_x, _setup.origin_offset_y,
+		   _setup.origin_offset_z, _setup.AA_origin_offset,
+		   _setup.BB_origin_offset, _setup.CC_origin_offset,
+		   _setup.u_origin_offset, _setup.v_origin_offset,
+		   _setup.w_origin_offset);
+    SET_G92_OFFSET(_setup.axis_offset_x, _setup.axis_offset_y,
+		   _setup.axis_offset_z, _setup.AA_axis_offset,
+		   _setup.BB_axis_offset, _setup.CC_axis_offset,
+		   _setup.u_axis_offset, _setup.v_axis_offset,
+		   _setup.w_axis_offset);
+    SET_XY_ROTATION(_setup.rotation_xy);
+    USE_TOOL_LENGTH_OFFSET(_setup.tool_offset);
+    SET_FEED_MODE(_setup.feed_mode == UNITS_PER_REVOLUTION);
+    SET_FEED_RATE(_setup.feed_rate);
+    SET_MOTION_CONTROL_MODE(_setup.control_mode, tolerance);
+    SET_SPINDLE_SPEED(_setup.speed);
+    return INTERP_OK;
+}
@@ -3829,6 +3829,8 @@ int Interp::convert_setup_tool(block_pointer block, setup_pointer settings) {
     //
     if ((!settings->random_toolchanger) && (settings->current_pocket == pocket)) {
        settings->tool_table[0] = settings->tool_table[pocket];
+       // written here only, read it back on the next refresh
+       settings->tool_serial[0] = 0;
     }
 
     //
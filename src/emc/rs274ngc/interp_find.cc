@@ -711,12 +711,25 @@ int Interp::find_tool_pocket(setup_pointer settings, int toolno, int *pocket)
         *pocket = 0;
         return INTERP_OK;
     }
-    *pocket = -1;
-    for(int i=0; i<CANON_POCKETS_MAX; i++) {
-        if(settings->tool_table[i].toolno == toolno)
-            *pocket = i;
+    std::map<int,int>::iterator it = settings->tool_index.find(toolno);
+    if ((it == settings->tool_index.end()) ||
+        (settings->tool_table[it->second].toolno != toolno)) {
+        // tool_table[] may have been changed from Python
+        index_tool_table(settings);
+        it = settings->tool_index.find(toolno);
     }
-
-    CHKS((*pocket == -1), (_("Requested tool %d not found in the tool table")), toolno);
+    *pocket = -1;
+    CHKS((it == settings->tool_index.end()), (_("Requested tool %d not found in the tool table")), toolno);
+    *pocket = it->second;
     return INTERP_OK;
 }
+
+// rebuild the toolno -> pocket index. Pockets are entered in ascending
+// order, so a tool in the spindle of a nonrandom toolchanger maps to its
+// home pocket rather than pocket 0, like the linear search used to.
+void Interp::index_tool_table(setup_pointer settings)
+{
+    settings->tool_index.clear();
+    for(int i=0; i<CANON_POCKETS_MAX; i++)
+        settings->tool_index[settings->tool_table[i].toolno] = i;
+}
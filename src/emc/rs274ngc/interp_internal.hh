@@ -722,6 +722,9 @@ typedef struct setup_struct
   EmcPose tool_offset;          // tool length offset
   int pockets_max;                 // number of pockets in carousel (including pocket 0, the spindle)
   CANON_TOOL_TABLE tool_table[CANON_POCKETS_MAX];      // index is pocket number
+  int tool_serial[CANON_POCKETS_MAX];  // GET_EXTERNAL_TOOL_TABLE_SERIAL() when read
+  bool tool_table_written;             // tool_table[] handed to Python, reread all
+  std::map<int,int> tool_index;        // toolno -> pocket, see find_tool_pocket()
   double traverse_rate;         // rate for traverse motions
   double orient_offset;         // added to M19 R word, from [RS274NGC]ORIENT_OFFSET
 
@@ -770,6 +773,12 @@ typedef struct setup_struct
 
   bool persistent_g92_offset;
 
+  // interpreter state checkpoints of the open program, see interp_checkpoint.cc
+  int checkpoint_interval;           // [RS274NGC]CHECKPOINT_INTERVAL lines, 0 = off
+  char checkpoint_dir[PATH_MAX];     // [RS274NGC]CHECKPOINT_DIR, default next to the program
+  FILE *checkpoint_fp;               // checkpoint file, open while a run keeps checkpoints
+  std::map<int,long> checkpoint_index; // sequence number -> record offset in checkpoint_fp
+
 #define FEATURE(x) (_setup.feature_set & FEATURE_ ## x)
 #define FEATURE_RETAIN_G43           0x00000001
 #define FEATURE_OWORD_N_ARGS         0x00000002
@@ -780,6 +789,7 @@ typedef struct setup_struct
 #define FEATURE_OWORD_WARNONLY       0x00000020
 
     boost::python::object pythis;  // boost::cref to 'this'
+    boost::python::object pyselfargs;  // (pythis,) - args for handlers taking just self
     const char *on_abort_command;
     int_remap_map  g_remapped,m_remapped;
     remap_map remaps;
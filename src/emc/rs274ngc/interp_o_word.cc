@@ -278,8 +278,8 @@ int Interp::execute_call(setup_pointer settings,
 	    if (remap->remap_py || remap->prolog_func || remap->epilog_func) {
 		CHKS(!PYUSABLE, "%s (remapped) uses Python functions, but the Python plugin is not available", 
 		     remap->name);
-		plist.append(settings->pythis);   //self
-		current_frame->tupleargs = bp::tuple(plist);
+		current_frame->tupleargs = settings->pyselfargs;
+		// fresh dict - add_parameters() decorates it per call
 		current_frame->kwargs = bp::dict();
 	    }
 	    if (remap->argspec && (strchr(remap->argspec, '@') == NULL)) {
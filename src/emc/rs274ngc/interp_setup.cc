@@ -134,6 +134,8 @@ setup_struct::setup_struct() :
     mdi_interrupt(0),
     feature_set(0),
     persistent_g92_offset(true),
+    checkpoint_interval(0),
+    checkpoint_fp(NULL),
     on_abort_command(NULL),
     init_once(1),
     m_remappable(),
@@ -153,7 +155,10 @@ setup_struct::setup_struct() :
     memset(log_file, 0, sizeof(log_file));
     memset(program_prefix, 0, sizeof(program_prefix));
     memset(wizard_root, 0, sizeof(wizard_root));
+    memset(checkpoint_dir, 0, sizeof(checkpoint_dir));
     memset(tool_table, 0, sizeof(tool_table));
+    memset(tool_serial, 0, sizeof(tool_serial));
+    tool_table_written = false;
     ZERO_EMC_POSE(tool_offset);
 
 }
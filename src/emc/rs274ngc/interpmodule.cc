@@ -51,7 +51,11 @@ static  parameters_array parameters_wrapper ( Interp & inst) {
     return parameters_array(inst._setup.parameters);
 }
 
+// Python may change any entry through the array, so the next
+// refresh_tool_table() reads every pocket again, as it did before
+// pockets were change tracked
 static  tool_table_array tool_table_wrapper ( Interp & inst) {
+    inst._setup.tool_table_written = true;
     return tool_table_array(inst._setup.tool_table);
 }
 
@@ -758,6 +762,7 @@ static inline int get_current_tool(Interp &interp)  {
     return interp._setup.tool_table[0].toolno;
 }
 static inline void set_current_tool(Interp &interp, int value)  {
+    interp._setup.tool_table_written = true;
     interp._setup.tool_table[0].toolno = value;
 }
 
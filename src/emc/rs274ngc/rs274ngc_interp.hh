@@ -46,6 +46,8 @@ public:
 
 // load a tool table
  int load_tool_table();
+// reread the tool table pockets changed since the last load
+ int refresh_tool_table();
 
 // open a file of NC code
  int open(const char *filename);
@@ -67,6 +69,12 @@ public:
 // synchronize your internal model with the external world
  int synch();
 
+// start a run of the open program at line: keep checkpoints of the
+// interpreter state while reading it, and restore the nearest one
+// before line. Returns the number of lines the checkpoint stands for,
+// 0 if reading starts at the top
+ int begin_run(int line);
+
 /* Interface functions to call to get information from the interpreter.
    If a function has a return value, the return value contains the information.
    If a function returns nothing, information is copied into one of the
@@ -144,6 +152,11 @@ public:
     remap_pointer remapping(const char *code);
     remap_pointer remapping(const char letter, int number = -1);
  int find_tool_pocket(setup_pointer settings, int toolno, int *pocket);
+ void index_tool_table(setup_pointer settings);
+ int checkpoint_open();
+ void checkpoint_close();
+ void checkpoint_save();
+ int checkpoint_restore(long offset);
 
     // private:
     //protected:  // for boost wrapper access
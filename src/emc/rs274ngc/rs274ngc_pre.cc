@@ -131,6 +131,7 @@ Interp::Interp()
 	// wrapper instance on every init(), abandoning the old one and all user attributes
 	// tacked onto it, so make sure this is done exactly once
 	_setup.pythis =  boost::python::object(boost::cref(*this));
+	_setup.pyselfargs = bp::make_tuple(_setup.pythis);
 	
 	// alias to 'interpreter.this' for the sake of ';py, .... ' comments
 	// besides 'this', eventually use proper instance names to handle
@@ -233,6 +234,7 @@ int Interp::close()
     _setup.file_pointer = NULL;
     _setup.percent_flag = false;
   }
+  checkpoint_close();
   reset();
 
   return INTERP_OK;
@@ -747,14 +749,10 @@ int Interp::exit()
   // interpreter shutdown Python hook
   if (python_plugin->is_callable(NULL, DELETE_FUNC)) {
 
-      bp::object retval, tupleargs, kwargs;
-      bp::list plist;
+      bp::object retval, kwargs;
 
-      plist.append(_setup.pythis); // self
-      tupleargs = bp::tuple(plist);
       kwargs = bp::dict();
-
-      python_plugin->call(NULL, DELETE_FUNC, tupleargs, kwargs, retval);
+      python_plugin->call(NULL, DELETE_FUNC, _setup.pyselfargs, kwargs, retval);
       if (python_plugin->plugin_status() == PLUGIN_EXCEPTION) {
 	  ERM("pycall(%s):\n%s", INIT_FUNC,
 	      python_plugin->last_exception().c_str());
@@ -1013,6 +1011,19 @@ int Interp::init()
 	    logDebug("init:  PERSISTENT_G92_OFFSET = %s (default)",
 		     _setup.persistent_g92_offset ? "TRUE" : "FALSE");
 
+	  // interpreter state checkpoints for run-from-line
+	  _setup.checkpoint_interval = 0;
+	  inifile.Find(&_setup.checkpoint_interval, "CHECKPOINT_INTERVAL", "RS274NGC");
+	  _setup.checkpoint_dir[0] = 0;
+	  if (NULL != (inistring = inifile.Find("CHECKPOINT_DIR", "RS274NGC"))) {
+	      if (inifile.TildeExpansion(inistring, _setup.checkpoint_dir,
+					 sizeof(_setup.checkpoint_dir))) {
+		  logDebug("TildeExpansion failed for: %s", inistring);
+		  _setup.checkpoint_dir[0] = 0;
+	      }
+	  }
+	  logDebug("init:  CHECKPOINT_INTERVAL = %d", _setup.checkpoint_interval);
+
           // close it
         inifile.Close();
       }
@@ -1166,6 +1177,7 @@ int Interp::init()
    ZERO_EMC_POSE(_setup.tool_offset);
 //_setup.tool_max set in Interp::synch
 //_setup.tool_table set in Interp::synch
+  memset(_setup.tool_serial, 0, sizeof(_setup.tool_serial)); // read all pockets
 //_setup.traverse_rate set in Interp::synch
 //_setup.adaptive_feed set in Interp::synch
 //_setup.feed_hold set in Interp::synch
@@ -1235,14 +1247,10 @@ int Interp::init()
 
       if (python_plugin->is_callable(NULL, INIT_FUNC)) {
 
-	  bp::object retval, tupleargs, kwargs;
-	  bp::list plist;
+	  bp::object retval, kwargs;
 
-	  plist.append(_setup.pythis); // self
-	  tupleargs = bp::tuple(plist);
 	  kwargs = bp::dict();
-
-	  python_plugin->call(NULL, INIT_FUNC, tupleargs, kwargs, retval);
+	  python_plugin->call(NULL, INIT_FUNC, _setup.pyselfargs, kwargs, retval);
 	  CHKS(python_plugin->plugin_status() == PLUGIN_EXCEPTION,
 	       "pycall(%s):\n%s", INIT_FUNC,
 	       python_plugin->last_exception().c_str());
@@ -1281,11 +1289,45 @@ int Interp::load_tool_table()
 {
   int n;
 
+  for (n = 0; n < CANON_POCKETS_MAX; n++) {
+    _setup.tool_serial[n] = 0;
+  }
+  return refresh_tool_table();
+}
+
+/*! Interp::refresh_tool_table
+
+Like load_tool_table, but reads only the pockets whose
+GET_EXTERNAL_TOOL_TABLE_SERIAL differs from the one recorded when the
+pocket was last read. synch() runs on every mode change and MDI
+command, and a tool change touches at most two pockets, so with
+iocontrol tracking changes this usually reads nothing.
+
+Once tool_table[] was handed to Python (self.tool_table, current_tool)
+every pocket is read: edits made there are overwritten by the next
+synch(), as they always were.
+
+*/
+
+int Interp::refresh_tool_table()
+{
+  int n, serial;
+  bool changed = false;
+  bool all = _setup.tool_table_written;
+
   CHKS((_setup.pockets_max > CANON_POCKETS_MAX), NCE_POCKET_MAX_TOO_LARGE);
+  _setup.tool_table_written = false;
   for (n = 0; n < _setup.pockets_max; n++) {
+    serial = GET_EXTERNAL_TOOL_TABLE_SERIAL(n);
+    if (!all && serial && (serial == _setup.tool_serial[n]))
+      continue;
     _setup.tool_table[n] = GET_EXTERNAL_TOOL_TABLE(n);
+    _setup.tool_serial[n] = serial;
+    changed = true;
   }
   for (; n < CANON_POCKETS_MAX; n++) {
+    if (_setup.tool_table[n].toolno != -1)
+      changed = true;
     _setup.tool_table[n].toolno = -1;
     ZERO_EMC_POSE(_setup.tool_table[n].offset);
     _setup.tool_table[n].diameter = 0;
@@ -1293,6 +1335,8 @@ int Interp::load_tool_table()
     _setup.tool_table[n].frontangle = 0;
     _setup.tool_table[n].backangle = 0;
   }
+  if (changed)
+    index_tool_table(&_setup);
   set_tool_parameters();
   return INTERP_OK;
 }
@@ -1359,6 +1403,7 @@ int Interp::open(const char *filename) //!< string: the name of the input NC-pro
     }
   CHKS((_setup.file_pointer != NULL), NCE_A_FILE_IS_ALREADY_OPEN);
   CHKS((strlen(filename) > (LINELEN - 1)), NCE_FILE_NAME_TOO_LONG);
+  checkpoint_close();
   _setup.file_pointer = fopen(filename, "r");
   CHKS((_setup.file_pointer == NULL), NCE_UNABLE_TO_OPEN_FILE, filename);
   line = _setup.linetext;
@@ -1408,7 +1453,7 @@ int Interp::read_inputs(setup_pointer settings)
 	CHKS((GET_EXTERNAL_QUEUE_EMPTY() == 0),
 	     _("Queue is not empty after tool change"));
 	refresh_actual_position(&_setup);
-	load_tool_table();
+	refresh_tool_table();
 	settings->toolchange_flag = false;
     }
     // always track toolchanger-fault and toolchanger-reason codes
@@ -1483,7 +1528,7 @@ int Interp::_read(const char *command)  //!< may be NULL or a string to read
     CHKS((GET_EXTERNAL_QUEUE_EMPTY() == 0),
          _("Queue is not empty after tool change"));
     refresh_actual_position(&_setup);
-    load_tool_table();
+    refresh_tool_table();
     _setup.toolchange_flag = false;
   }
   // always track toolchanger-fault and toolchanger-reason codes
@@ -1568,6 +1613,9 @@ int Interp::_read(const char *command)  //!< may be NULL or a string to read
   _setup.parameters[5427] = _setup.v_current;
   _setup.parameters[5428] = _setup.w_current;
 
+  if ((command == NULL) && _setup.checkpoint_fp)
+      checkpoint_save();
+
   if(_setup.file_pointer)
   {
       EXECUTING_BLOCK(_setup).offset = ftell(_setup.file_pointer);
@@ -1993,7 +2041,7 @@ int Interp::synch()
                             RS274NGC_PARAMETER_FILE_NAME_DEFAULT :
                             file_name), _setup.parameters);
 
-  load_tool_table();   /*  must set  _setup.tool_max first */
+  refresh_tool_table();   /*  must set  _setup.tool_max first */
 
   read_inputs(&_setup); // input/probe/toolchange
 
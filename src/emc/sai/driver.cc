@@ -334,7 +334,10 @@ int read_tool_file(  /* ARGUMENTS         */
       tool_file_name = buffer;
     }
 
-  return loadToolTable(tool_file_name, _tools, 0, 0, 0);
+  int retval = loadToolTable(tool_file_name, _tools, 0, 0, 0);
+  for (int n = 0; n < CANON_POCKETS_MAX; n++)
+    _tool_serial[n]++;
+  return retval;
 }
 
 /************************************************************************/
@@ -546,6 +549,7 @@ int main (int argc, char ** argv)
   int go_flag;
   char *inifile = NULL;
   int log_level = -1;
+  int start_line = 0;
   std::string interp;
 
   do_next = 2;  /* 2=stop */
@@ -557,7 +561,7 @@ int main (int argc, char ** argv)
   go_flag = 0;
 
   while(1) {
-      int c = getopt(argc, argv, "p:t:v:bsn:gi:l:T");
+      int c = getopt(argc, argv, "p:t:v:bsn:gi:l:r:T");
       if(c == -1) break;
 
       switch(c) {
@@ -571,6 +575,7 @@ int main (int argc, char ** argv)
           case 'g': go_flag = !go_flag; break;
           case 'i': inifile = optarg; break;
           case 'T': _task = 1; break;
+          case 'r': start_line = atoi(optarg); break;
           case '?': default: goto usage;
       }
   }
@@ -580,7 +585,7 @@ int main (int argc, char ** argv)
 usage:
       fprintf(stderr,
             "Usage: %s [-p interp.so] [-t tool.tbl] [-v var-file.var] [-n 0|1|2]\n"
-            "          [-b] [-s] [-g] [input file [output file]]\n"
+            "          [-b] [-s] [-g] [-r line] [input file [output file]]\n"
             "\n"
             "    -p: Specify the pluggable interpreter to use\n"
             "    -t: Specify the .tbl (tool table) file to use\n"
@@ -595,6 +600,8 @@ usage:
             "    -i: specify the .ini file (default: no ini file)\n"
             "    -T: call task_init()\n"
             "    -l: specify the log_level (default: -1)\n"
+            "    -r: keep checkpoints ([RS274NGC]CHECKPOINT_INTERVAL) and\n"
+            "        start reading at the last one before line\n"
             , argv[0]);
       exit(1);
     }
@@ -681,6 +688,9 @@ usage:
           report_error(status, print_stack);
           exit(1);
         }
+      if (start_line > 0)
+        fprintf(stderr, "begin_run(%d): restored %d lines\n",
+                start_line, pinterp->begin_run(start_line));
       status = interpret_from_file(do_next, block_delete, print_stack);
       file_name(buffer, 5);  /* called to exercise the function */
       file_name(buffer, 79); /* called to exercise the function */
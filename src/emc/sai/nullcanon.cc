@@ -697,6 +697,12 @@ int GET_EXTERNAL_POCKETS_MAX()
   return _pockets_max;
 }
 
+/* _tools[] isn't change tracked: always reread */
+int GET_EXTERNAL_TOOL_TABLE_SERIAL(int pocket)
+{
+  return 0;
+}
+
 /* Returns the CANON_TOOL_TABLE structure associated with the tool
    in the given pocket */
 extern CANON_TOOL_TABLE GET_EXTERNAL_TOOL_TABLE(int pocket)
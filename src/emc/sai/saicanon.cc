@@ -78,6 +78,7 @@ static double            _spindle_speed;
 static CANON_DIRECTION   _spindle_turning;
 int                      _pockets_max = CANON_POCKETS_MAX; /*Not static. Driver reads  */
 CANON_TOOL_TABLE         _tools[CANON_POCKETS_MAX]; /*Not static. Driver writes */
+int                      _tool_serial[CANON_POCKETS_MAX]; /*Not static. Driver bumps */
 /* optional program stop */
 static bool optional_program_stop = ON; //set enabled by default (previous EMC behaviour)
 /* optional block delete */
@@ -625,6 +626,7 @@ void SET_TOOL_TABLE_ENTRY(int pocket, int toolno, EmcPose offset, double diamete
     _tools[pocket].frontangle = frontangle;
     _tools[pocket].backangle = backangle;
     _tools[pocket].orientation = orientation;
+    _tool_serial[pocket]++;
     PRINT14("SET_TOOL_TABLE_ENTRY(%d, %d, %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f, %.4f, %.4f, %d)\n",
             pocket, toolno,
             offset.tran.x, offset.tran.y, offset.tran.z, offset.a, offset.b, offset.c, offset.u, offset.v, offset.w,
@@ -643,6 +645,7 @@ void CHANGE_TOOL(int slot)
   PRINT1("CHANGE_TOOL(%d)\n", slot);
   _active_slot = slot;
   _tools[0] = _tools[slot];
+  _tool_serial[0]++;
 }
 
 void SELECT_POCKET(int slot, int tool)
@@ -1023,6 +1026,12 @@ int GET_EXTERNAL_POCKETS_MAX()
   return _pockets_max;
 }
 
+/* bumped with each change of _tools[pocket], 0 until the tool file is read */
+int GET_EXTERNAL_TOOL_TABLE_SERIAL(int pocket)
+{
+  return _tool_serial[pocket];
+}
+
 /* Returns the CANON_TOOL_TABLE structure associated with the tool
    in the given pocket */
 extern CANON_TOOL_TABLE GET_EXTERNAL_TOOL_TABLE(int pocket)
@@ -907,10 +907,70 @@ struct pt {
 
 static std::vector<struct pt> chained_points;
 
-static void flush_segments(void) {
-    if(chained_points.empty()) return;
+/* Naive CAM: runs of straight feeds are collected in chained_points and
+   sent as one line, or as one arc in the XY plane, as long as all the
+   collected end points stay within the G64 Q tolerance of it.
+
+   The chain starts at canonEndPoint. While it is straight, 'bound' is an
+   upper bound of the distance of the chain points from the line to the
+   last point, so moving the end only needs a rescan of the whole chain
+   once the bound grows past the tolerance. When no line fits, the chain
+   may go on as an arc through its start, middle and last point, with
+   'bound' limiting the radial error the same way.
+
+   Lines may move any axes, distances are taken over all nine with the
+   rotary axes in degrees. All segments of a chain have to move the same
+   kind of axes though, since the merged move gets a single feed rate. */
+
+#define NAIVECAM_MAX_POINTS 1000	// limits how long motion is held back
+#define NAIVECAM_ARC_MIN_POINTS 3
+
+enum { CHAIN_LINE, CHAIN_ARC };
+enum { MOVE_XYZ = 1, MOVE_ABC = 2, MOVE_UVW = 4 };
+
+static struct {
+    int mode;
+    int moving;			// MOVE_* of every segment
+    bool flat;			// all points at the start's Z
+    double bound;
+    double len;			// line: distance start to end
+    double dir[9];		// line: unit vector start to end
+    unsigned int line_points;	// arc: points which fitted the line
+    double cx, cy, r;		// arc: center and radius
+    int rotation;		// arc: 1 ccw, -1 cw
+    double sweep;		// arc: angle from start to last point
+} chain;
+
+static struct {
+    long segments;		// straight segments seen
+    long lines, arcs;		// moves sent for them
+} naivecam_stats;
+
+static void arc(int lineno, double x0, double y0, double x1, double y1,
+                double dx, double dy);
+
+static void pos_coords(const CANON_POSITION &p, double *v) {
+    v[0] = p.x; v[1] = p.y; v[2] = p.z;
+    v[3] = p.a; v[4] = p.b; v[5] = p.c;
+    v[6] = p.u; v[7] = p.v; v[8] = p.w;
+}
+
+static void pt_coords(const struct pt &p, double *v) {
+    v[0] = p.x; v[1] = p.y; v[2] = p.z;
+    v[3] = p.a; v[4] = p.b; v[5] = p.c;
+    v[6] = p.u; v[7] = p.v; v[8] = p.w;
+}
+
+static int move_class(const double *from, const double *to) {
+    int moving = 0;
+    for(int i = 0; i < 9; i++) {
+        if(from[i] != to[i])
+            moving |= i < 3 ? MOVE_XYZ : i < 6 ? MOVE_ABC : MOVE_UVW;
+    }
+    return moving;
+}
 
-    struct pt &pos = chained_points.back();
+static void send_line(const struct pt &pos) {
 
     double x = pos.x, y = pos.y, z = pos.z;
     double a = pos.a, b = pos.b, c = pos.c;
@@ -918,11 +978,6 @@ static void flush_segments(void) {
     
     int line_no = pos.line_no;
 
-#ifdef SHOW_JOINED_SEGMENTS
-    for(unsigned int i=0; i != chained_points.size(); i++) { printf("."); }
-    printf("\n");
-#endif
-
     VelData linedata = getStraightVelocity(x, y, z, a, b, c, u, v, w);
     double vel = linedata.vel;
 
@@ -971,8 +1026,60 @@ static void flush_segments(void) {
         tag_and_send(linearMoveMsg,pos.tag);
     }
     canonUpdateEndPoint(x, y, z, a, b, c, u, v, w);
+    naivecam_stats.lines++;
+}
 
-    chained_points.clear();
+/* Send a chain which went on as an arc. Returns false if it isn't worth
+   an arc, because it is too short or too flat: ARC_FEED would turn the
+   latter into lines again. */
+static bool send_arc(const std::vector<struct pt> &points) {
+    const struct pt &end = points.back();
+
+    if(points.size() < NAIVECAM_ARC_MIN_POINTS
+       || chain.r * (1 - rtapi_cos(chain.sweep / 2))
+          <= 1.01 * canonNaivecamTolerance)
+        return false;
+
+    // arc() works in program coordinates, like the NURBS code using it
+    CANON_POSITION s = canonEndPoint, e = canonEndPoint, c = canonEndPoint;
+    e.x = end.x; e.y = end.y;
+    c.x = chain.cx; c.y = chain.cy;
+    s = unoffset_and_unrotate_pos(s);
+    e = unoffset_and_unrotate_pos(e);
+    c = unoffset_and_unrotate_pos(c);
+    to_prog(s);
+    to_prog(e);
+    to_prog(c);
+
+    StateTag saved = _tag;
+    _tag = end.tag;
+    arc(end.line_no, s.x, s.y, e.x, e.y,
+        -chain.rotation * (s.y - c.y), chain.rotation * (s.x - c.x));
+    _tag = saved;
+    naivecam_stats.arcs++;
+    return true;
+}
+
+static void flush_segments(void) {
+    if(chained_points.empty()) return;
+
+    // sending an arc goes through ARC_FEED, which flushes too
+    std::vector<struct pt> points;
+    points.swap(chained_points);
+
+#ifdef SHOW_JOINED_SEGMENTS
+    for(unsigned int i=0; i != points.size(); i++) { printf("."); }
+    printf(chain.mode == CHAIN_ARC ? " arc\n" : "\n");
+#endif
+
+    if(chain.mode == CHAIN_LINE) {
+        send_line(points.back());
+    } else if(!send_arc(points)) {
+        send_line(points[chain.line_points - 1]);
+        for(unsigned int i = chain.line_points; i < points.size(); i++)
+            send_line(points[i]);
+    }
+    chain.mode = CHAIN_LINE;
 }
 
 static void get_last_pos(double &lx, double &ly, double &lz) {
@@ -988,68 +1095,200 @@ static void get_last_pos(double &lx, double &ly, double &lz) {
     }
 }
 
-static bool
-linkable(double x, double y, double z, 
-         double a, double b, double c, 
-         double u, double v, double w) {
-    struct pt &pos = chained_points.back();
-    if(canonMotionMode != CANON_CONTINUOUS || canonNaivecamTolerance == 0)
-        return false;
-    //FIXME make this length controlled elsewhere?
-    if(chained_points.size() > 100) return false;
-
-    //If ABCUVW motion, then the tangent calculation fails?
-    // TODO is there a fundamental reason that we can't handle 9D motion here?
-    if(a != pos.a) return false;
-    if(b != pos.b) return false;
-    if(c != pos.c) return false;
-    if(u != pos.u) return false;
-    if(v != pos.v) return false;
-    if(w != pos.w) return false;
-
-    if(x==canonEndPoint.x && y==canonEndPoint.y && z==canonEndPoint.z) return false;
-    
+/* Largest distance of the chain points from the line start to end */
+static double line_deviation(const double *s, const double *e) {
+    double m[9], mm = 0, dmax = 0;
+
+    for(int i = 0; i < 9; i++) {
+        m[i] = e[i] - s[i];
+        mm += m[i] * m[i];
+    }
     for(std::vector<struct pt>::iterator it = chained_points.begin();
             it != chained_points.end(); it++) {
-        PM_CARTESIAN M(x-canonEndPoint.x, y-canonEndPoint.y, z-canonEndPoint.z),
-                     B(canonEndPoint.x, canonEndPoint.y, canonEndPoint.z),
-                     P(it->x, it->y, it->z);
-        double t0 = dot(M, P-B) / dot(M, M);
+        double p[9], t0 = 0, d = 0;
+        pt_coords(*it, p);
+        for(int i = 0; i < 9; i++)
+            t0 += m[i] * (p[i] - s[i]);
+        t0 /= mm;
         if(t0 < 0) t0 = 0;
         if(t0 > 1) t0 = 1;
+        for(int i = 0; i < 9; i++) {
+            double di = p[i] - (s[i] + t0 * m[i]);
+            d += di * di;
+        }
+        if(d > dmax) dmax = d;
+    }
+    return rtapi_sqrt(dmax);
+}
 
-        double D = mag(P - (B + t0 * M));
-        if(D > canonNaivecamTolerance) return false;
+/* Check whether the line from s to e passes all chain points, and make
+   it the chain's line if so. */
+static bool line_linkable(const double *s, const double *e) {
+    double dir[9], len = 0, bound = 0;
+
+    for(int i = 0; i < 9; i++) {
+        dir[i] = e[i] - s[i];
+        len += dir[i] * dir[i];
+    }
+    len = rtapi_sqrt(len);
+    if(len == 0) return false;
+    for(int i = 0; i < 9; i++)
+        dir[i] /= len;
+
+    if(!chained_points.empty()) {
+        // a point at distance l from the start along the old line is at
+        // most l * |dir - chain.dir| away from the new one, as long as the
+        // new line is not shorter
+        double dd = 0;
+        for(int i = 0; i < 9; i++)
+            dd += (dir[i] - chain.dir[i]) * (dir[i] - chain.dir[i]);
+        bound = chain.bound + chain.len * rtapi_sqrt(dd);
+        if(len < chain.len || bound > canonNaivecamTolerance)
+            bound = line_deviation(s, e);
+        if(bound > canonNaivecamTolerance) return false;
     }
+
+    chain.bound = bound;
+    chain.len = len;
+    memcpy(chain.dir, dir, sizeof(dir));
     return true;
 }
 
+/* Angle of x, y seen from the center, counted from the start of the chain
+   in the direction of rotation */
+static double arc_angle(double cx, double cy, int rotation,
+                        double x, double y) {
+    double th = rtapi_atan2(y - cy, x - cx)
+        - rtapi_atan2(canonEndPoint.y - cy, canonEndPoint.x - cx);
+    if(rotation < 0) th = -th;
+    while(th < 0) th += 2*M_PI;
+    return th;
+}
+
+/* Largest radial error of the chain points plus x, y, or DBL_MAX if
+   they don't follow the arc in order or a segment strays from it */
+static double arc_deviation(double cx, double cy, double r, int rotation,
+                            double x, double y) {
+    double prev = 0, dmax = 0;
+
+    for(unsigned int i = 0; i <= chained_points.size(); i++) {
+        double px = i < chained_points.size() ? chained_points[i].x : x,
+               py = i < chained_points.size() ? chained_points[i].y : y;
+        double th = arc_angle(cx, cy, rotation, px, py);
+        if(th <= prev
+           || r * (1 - rtapi_cos((th - prev) / 2)) > canonNaivecamTolerance)
+            return DBL_MAX;
+        double d = rtapi_fabs(rtapi_hypot(px - cx, py - cy) - r);
+        if(d > dmax) dmax = d;
+        prev = th;
+    }
+    return dmax;
+}
+
+/* Check whether the chain plus p fits an arc in the XY plane, and make
+   it the chain's arc if so. */
+static bool arc_linkable(const struct pt &p) {
+    unsigned int n = chained_points.size();
+
+    if(activePlane != CANON_PLANE_XY || chain.moving != MOVE_XYZ
+       || !chain.flat || p.z != canonEndPoint.z)
+        return false;
+
+    // circle through start, middle and p
+    const struct pt &m = chained_points[n / 2];
+    double sx = canonEndPoint.x, sy = canonEndPoint.y;
+    double ax = m.x - sx, ay = m.y - sy, bx = p.x - sx, by = p.y - sy;
+    double den = 2 * (ax * by - ay * bx);
+    double aa = ax * ax + ay * ay, bb = bx * bx + by * by;
+    if(aa == 0 || bb == 0 || rtapi_fabs(den) < tiny * rtapi_sqrt(aa * bb))
+        return false;
+    double cx = sx + (by * aa - ay * bb) / den,
+           cy = sy + (ax * bb - bx * aa) / den,
+           r = rtapi_hypot(sx - cx, sy - cy);
+    int rotation = den > 0 ? 1 : -1;
+
+    if(chain.mode == CHAIN_ARC && rotation != chain.rotation) return false;
+
+    double th = arc_angle(cx, cy, rotation, p.x, p.y);
+    double last = arc_angle(cx, cy, rotation,
+                            chained_points[n - 1].x, chained_points[n - 1].y);
+    // stay clear of full circles, where the end is ambiguous
+    if(th <= last || th > 1.9 * M_PI
+       || r * (1 - rtapi_cos((th - last) / 2)) > canonNaivecamTolerance)
+        return false;
+
+    double bound = DBL_MAX;
+    if(chain.mode == CHAIN_ARC)
+        bound = chain.bound + rtapi_hypot(cx - chain.cx, cy - chain.cy)
+            + rtapi_fabs(r - chain.r);
+    if(bound > canonNaivecamTolerance)
+        bound = arc_deviation(cx, cy, r, rotation, p.x, p.y);
+    if(bound > canonNaivecamTolerance) return false;
+
+    if(chain.mode != CHAIN_ARC) {
+        chain.mode = CHAIN_ARC;
+        chain.line_points = n;
+    }
+    chain.bound = bound;
+    chain.cx = cx;
+    chain.cy = cy;
+    chain.r = r;
+    chain.rotation = rotation;
+    chain.sweep = th;
+    return true;
+}
+
+static bool
+linkable(const struct pt &p) {
+    double s[9], prev[9], e[9];
+
+    if(canonMotionMode != CANON_CONTINUOUS || canonNaivecamTolerance == 0)
+        return false;
+    if(chained_points.size() >= NAIVECAM_MAX_POINTS) return false;
+
+    pos_coords(canonEndPoint, s);
+    pt_coords(chained_points.back(), prev);
+    pt_coords(p, e);
+    if(move_class(prev, e) != chain.moving) return false;
+
+    if(chain.mode == CHAIN_LINE && line_linkable(s, e)) return true;
+    return arc_linkable(p);
+}
+
 static void
 see_segment(int line_number,
         StateTag tag,
 	    double x, double y, double z, 
             double a, double b, double c,
             double u, double v, double w) {
-    bool changed_abc = (a != canonEndPoint.a)
-        || (b != canonEndPoint.b)
-        || (c != canonEndPoint.c);
-
-    bool changed_uvw = (u != canonEndPoint.u)
-        || (v != canonEndPoint.v)
-        || (w != canonEndPoint.w);
+    pt pos = {x, y, z, a, b, c, u, v, w, line_number, tag};
 
-    if(!chained_points.empty() && !linkable(x, y, z, a, b, c, u, v, w)) {
+    naivecam_stats.segments++;
+    if(!chained_points.empty() && !linkable(pos)) {
         flush_segments();
     }
-    pt pos = {x, y, z, a, b, c, u, v, w, line_number, tag};
-    chained_points.push_back(pos);
-    if(changed_abc || changed_uvw) {
-        flush_segments();
+    if(chained_points.empty()) {
+        double s[9], e[9];
+        pos_coords(canonEndPoint, s);
+        pt_coords(pos, e);
+        chain.mode = CHAIN_LINE;
+        chain.moving = move_class(s, e);
+        chain.flat = true;
+        chain.len = 0;
+        line_linkable(s, e);
     }
+    if(z != canonEndPoint.z) chain.flat = false;
+    chained_points.push_back(pos);
 }
 
 void FINISH() {
     flush_segments();
+
+    if((emc_debug & EMC_DEBUG_INTERP) && naivecam_stats.segments)
+        printf("naivecam: %ld segments sent as %ld lines and %ld arcs\n",
+               naivecam_stats.segments, naivecam_stats.lines,
+               naivecam_stats.arcs);
+    memset(&naivecam_stats, 0, sizeof(naivecam_stats));
 }
 
 void STRAIGHT_TRAVERSE(int line_number,
@@ -1331,7 +1570,7 @@ arc(int lineno, double x0, double y0, double x1, double y1, double dx, double dy
     if (rtapi_fabs(den) > small) {
         double r = -(x*x+y*y)/den;
         double i = dy*r, j = -dx*r;
-        double cx = x1+i, cy=y1+j;
+        double cx = x0+i, cy=y0+j;
         ARC_FEED(lineno, x1, y1, cx, cy, r<0 ? 1 : -1,
                  p.z, p.a, p.b, p.c, p.u, p.v, p.w);
     } else { 
@@ -2611,6 +2850,13 @@ CANON_TOOL_TABLE GET_EXTERNAL_TOOL_TABLE(int pocket)
     return retval;
 }
 
+int GET_EXTERNAL_TOOL_TABLE_SERIAL(int pocket)
+{
+    if (pocket < 0 || pocket >= CANON_POCKETS_MAX)
+	return 0;
+    return emcStatus->io.tool.pocketSerial[pocket];
+}
+
 CANON_POSITION GET_EXTERNAL_POSITION()
 {
     CANON_POSITION position;
@@ -540,6 +540,18 @@ int emcTaskPlanOpen(const char *file)
 }
 
 
+// returns the lines a restored checkpoint stands for, 0 if none
+int emcTaskPlanBeginRun(int line)
+{
+    int retval = interp.begin_run(line);
+
+    if (emc_debug & EMC_DEBUG_INTERP) {
+        rcs_print("emcTaskPlanBeginRun(%d) returned %d\n", line, retval);
+    }
+
+    return retval;
+}
+
 int emcTaskPlanRead()
 {
     int retval = interp.read();
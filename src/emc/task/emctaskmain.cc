@@ -58,6 +58,7 @@
 #include <ctype.h>		// isspace()
 #include <libintl.h>
 #include <locale.h>
+#include <pthread.h>
 
 
 #if 0
@@ -82,6 +83,8 @@ fpu_control_t __fpu_control = _FPU_IEEE & ~(_FPU_MASK_IM | _FPU_MASK_ZM | _FPU_M
 #include "taskclass.hh"
 #include "motion.h"             // EMCMOT_ORIENT_*
 #include "inihal.hh"
+#include "emcstatnotify.hh"
+#include "rtapi_startup.h"
 
 /* time after which the user interface is declared dead
  * because it would'nt read any more messages
@@ -97,6 +100,8 @@ char **Argv;
 static RCS_CMD_CHANNEL *emcCommandBuffer = 0;
 static RCS_STAT_CHANNEL *emcStatusBuffer = 0;
 static NML *emcErrorBuffer = 0;
+// wakes up local status readers when emcStatus changed
+static EmcStatNotify emcStatNotify;
 
 // NML command channel data pointer
 static RCS_CMD_MSG *emcCommand = 0;
@@ -117,6 +122,34 @@ static int emcTaskNoDelay = 0;
 // space, annd reset otherwise.
 static int emcTaskEager = 0;
 
+// [TASK] EVENT_DRIVEN: while nothing is in progress, block until a UI
+// kicks the command channel instead of cycling, for at most
+// EVENT_TIMEOUT seconds so motion and io status still get picked up.
+// Status is written only when it changed, and every
+// STAT_REFRESH_INTERVAL otherwise to keep the heartbeats going.
+static int emcTaskEventDriven = 0;
+static double emcTaskEventTimeout = 0.05;
+#define STAT_REFRESH_INTERVAL 1.0
+
+// [TASK] READAHEAD_THREAD: while a program runs, the interpreter reads
+// ahead in a thread of its own, in the time the task cycle sleeps, and
+// as long as the interp list has room instead of INTERP_MAX_LEN lines
+// per cycle. The task cycle holds interp_mutex while it runs, the
+// thread hands it back at the next line boundary when main_waiting
+// is set. Sync points (probing, M66, tool change..) stop the readahead
+// as before, through emcTaskPlanSetWait().
+// The thread holds the Python GIL while it reads, the task cycle gets
+// it back with the interpreter. An interpreter error found by the
+// thread is left in readahead_error, the abort is done by the task
+// cycle.
+static int emcTaskReadaheadThread = 0;
+static pthread_t readahead_tid;
+static pthread_mutex_t interp_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readahead_cond = PTHREAD_COND_INITIALIZER;
+static int readahead_go = 0;		// set by emcTaskPlan() while reading
+static volatile int main_waiting = 0;
+static int readahead_error = 0;
+
 static int no_force_homing = 0; // forces the user to home first before allowing MDI and Program run
 //can be overriden by [TRAJ]NO_FORCE_HOMING=1
 
@@ -553,137 +586,220 @@ static int checkInterpList(NML_INTERP_LIST * il, EMC_STAT * stat)
 }
 extern int emcTaskMopup();
 
-void readahead_reading(void)
+// read and execute one line of the program. Returns non-zero if the
+// interpreter is still reading, i.e. another line may follow.
+// on_thread: called by the readahead thread, defer the abort.
+static int readahead_line(int on_thread)
 {
     int readRetval;
     int execRetval;
 
-		if (interp_list.len() <= emc_task_interp_max_len) {
-                    int count = 0;
-interpret_again:
-		    if (emcTaskPlanIsWait()) {
-			// delay reading of next line until all is done
-			if (interp_list.len() == 0 &&
-			    emcTaskCommand == 0 &&
-			    emcStatus->task.execState ==
-			    EMC_TASK_EXEC_DONE) {
-			    emcTaskPlanClearWait();
-			 }
-		    } else {
-			readRetval = emcTaskPlanRead();
-			/*! \todo MGS FIXME
-			   This if() actually evaluates to if (readRetval != INTERP_OK)...
-			   *** Need to look at all calls to things that return INTERP_xxx values! ***
-			   MGS */
-			if (readRetval > INTERP_MIN_ERROR
-				|| readRetval == INTERP_ENDFILE
-				|| readRetval == INTERP_EXIT
-				|| readRetval == INTERP_EXECUTE_FINISH) {
-			    /* emcTaskPlanRead retval != INTERP_OK
-			       Signal to the rest of the system that that the interp
-			       is now in a paused state. */
-			    /*! \todo FIXME The above test *should* be reduced to:
-			       readRetVal != INTERP_OK
-			       (N.B. Watch for negative error codes.) */
-			    emcStatus->task.interpState =
-				EMC_TASK_INTERP_WAITING;
-			} else {
-			    // got a good line
-			    // record the line number and command
-			    emcStatus->task.readLine = emcTaskPlanLine();
-
-			    emcTaskPlanCommand((char *) &emcStatus->task.
-					       command);
-			    // and execute it
-			    execRetval = emcTaskPlanExecute(0);
-			    if (execRetval > INTERP_MIN_ERROR) {
-				emcStatus->task.interpState =
-				    EMC_TASK_INTERP_WAITING;
-				interp_list.clear();
-				emcAbortCleanup(EMC_ABORT_INTERPRETER_ERROR,
-						"interpreter error"); 
-			    } else if (execRetval == -1
-				    || execRetval == INTERP_EXIT ) {
-				emcStatus->task.interpState =
-				    EMC_TASK_INTERP_WAITING;
-			    } else if (execRetval == INTERP_EXECUTE_FINISH) {
-				// INTERP_EXECUTE_FINISH signifies
-				// that no more reading should be done until
-				// everything
-				// outstanding is completed
-				emcTaskPlanSetWait();
-				// and resynch interp WM
-				emcTaskQueueCommand(&taskPlanSynchCmd);
-			    } else if (execRetval != 0) {
-				// end of file
-				emcStatus->task.interpState =
-				    EMC_TASK_INTERP_WAITING;
-                                emcStatus->task.motionLine = 0;
-                                emcStatus->task.readLine = 0;
-			    } else {
-
-				// executed a good line
-			    }
-
-			    // throw the results away if we're supposed to
-			    // read
-			    // through it
-			    if (emcTaskPlanLevel() == 0 &&
-				(programStartLine < 0 ||
-				 emcTaskPlanLine() < programStartLine)) {
-				// we're stepping over lines, so check them
-				// for
-				// limits, etc. and clear then out
-				if (0 != checkInterpList(&interp_list,
-							 emcStatus)) {
-				    // problem with actions, so do same as we
-				    // did
-				    // for a bad read from emcTaskPlanRead()
-				    // above
-				    emcStatus->task.interpState =
-					EMC_TASK_INTERP_WAITING;
-				}
-				// and clear it regardless
-				interp_list.clear();
-			    }
-
-			    if (emcTaskPlanLevel() == 0 &&
-				emcTaskPlanLine() < programStartLine) {
-			    
-				//update the position with our current position, as the other positions are only skipped through
-				CANON_UPDATE_END_POINT(emcStatus->motion.traj.actualPosition.tran.x,
-						       emcStatus->motion.traj.actualPosition.tran.y,
-						       emcStatus->motion.traj.actualPosition.tran.z,
-						       emcStatus->motion.traj.actualPosition.a,
-						       emcStatus->motion.traj.actualPosition.b,
-						       emcStatus->motion.traj.actualPosition.c,
-						       emcStatus->motion.traj.actualPosition.u,
-						       emcStatus->motion.traj.actualPosition.v,
-						       emcStatus->motion.traj.actualPosition.w);
-			    }
-
-			    if ((emcTaskPlanLevel() == 0) &&
-				(emcTaskPlanLine() + 1 == programStartLine))  {
-
-				emcTaskPlanSynch();
-
-				// reset programStartLine so we don't
-				// fall into our stepping routines if
-				// we happen to execute lines before
-				// the current point later (due to
-				// subroutines).
-				programStartLine = 0;
-			    }
-
-                            if (count++ < emc_task_interp_max_len
-                                    && emcStatus->task.interpState == EMC_TASK_INTERP_READING
-                                    && interp_list.len() <= emc_task_interp_max_len * 2/3) {
-                                goto interpret_again;
-                            }
-
-			}	// else read was OK, so execute
-		    }		// else not emcTaskPlanIsWait
-		}		// if interp len is less than max
+    if (emcTaskPlanIsWait()) {
+	// delay reading of next line until all is done
+	if (interp_list.len() == 0 &&
+	    emcTaskCommand == 0 &&
+	    emcStatus->task.execState ==
+	    EMC_TASK_EXEC_DONE) {
+	    emcTaskPlanClearWait();
+	}
+	return 0;
+    }
+
+    readRetval = emcTaskPlanRead();
+    /*! \todo MGS FIXME
+       This if() actually evaluates to if (readRetval != INTERP_OK)...
+       *** Need to look at all calls to things that return INTERP_xxx values! ***
+       MGS */
+    if (readRetval > INTERP_MIN_ERROR
+	    || readRetval == INTERP_ENDFILE
+	    || readRetval == INTERP_EXIT
+	    || readRetval == INTERP_EXECUTE_FINISH) {
+	/* emcTaskPlanRead retval != INTERP_OK
+	   Signal to the rest of the system that that the interp
+	   is now in a paused state. */
+	/*! \todo FIXME The above test *should* be reduced to:
+	   readRetVal != INTERP_OK
+	   (N.B. Watch for negative error codes.) */
+	emcStatus->task.interpState =
+	    EMC_TASK_INTERP_WAITING;
+    } else {
+	// got a good line
+	// record the line number and command
+	emcStatus->task.readLine = emcTaskPlanLine();
+
+	emcTaskPlanCommand((char *) &emcStatus->task.
+			   command);
+	// and execute it
+	execRetval = emcTaskPlanExecute(0);
+	if (execRetval > INTERP_MIN_ERROR) {
+	    emcStatus->task.interpState =
+		EMC_TASK_INTERP_WAITING;
+	    interp_list.clear();
+	    if (on_thread)
+		readahead_error = 1;
+	    else
+		emcAbortCleanup(EMC_ABORT_INTERPRETER_ERROR,
+				"interpreter error");
+	} else if (execRetval == -1
+		|| execRetval == INTERP_EXIT ) {
+	    emcStatus->task.interpState =
+		EMC_TASK_INTERP_WAITING;
+	} else if (execRetval == INTERP_EXECUTE_FINISH) {
+	    // INTERP_EXECUTE_FINISH signifies
+	    // that no more reading should be done until
+	    // everything
+	    // outstanding is completed
+	    emcTaskPlanSetWait();
+	    // and resynch interp WM
+	    emcTaskQueueCommand(&taskPlanSynchCmd);
+	} else if (execRetval != 0) {
+	    // end of file
+	    emcStatus->task.interpState =
+		EMC_TASK_INTERP_WAITING;
+	    emcStatus->task.motionLine = 0;
+	    emcStatus->task.readLine = 0;
+	} else {
+
+	    // executed a good line
+	}
+
+	// throw the results away if we're supposed to
+	// read
+	// through it
+	if (emcTaskPlanLevel() == 0 &&
+	    (programStartLine < 0 ||
+	     emcTaskPlanLine() < programStartLine)) {
+	    // we're stepping over lines, so check them
+	    // for
+	    // limits, etc. and clear then out
+	    if (0 != checkInterpList(&interp_list,
+				     emcStatus)) {
+		// problem with actions, so do same as we
+		// did
+		// for a bad read from emcTaskPlanRead()
+		// above
+		emcStatus->task.interpState =
+		    EMC_TASK_INTERP_WAITING;
+	    }
+	    // and clear it regardless
+	    interp_list.clear();
+	}
+
+	if (emcTaskPlanLevel() == 0 &&
+	    emcTaskPlanLine() < programStartLine) {
+	    
+	    //update the position with our current position, as the other positions are only skipped through
+	    CANON_UPDATE_END_POINT(emcStatus->motion.traj.actualPosition.tran.x,
+				   emcStatus->motion.traj.actualPosition.tran.y,
+				   emcStatus->motion.traj.actualPosition.tran.z,
+				   emcStatus->motion.traj.actualPosition.a,
+				   emcStatus->motion.traj.actualPosition.b,
+				   emcStatus->motion.traj.actualPosition.c,
+				   emcStatus->motion.traj.actualPosition.u,
+				   emcStatus->motion.traj.actualPosition.v,
+				   emcStatus->motion.traj.actualPosition.w);
+	}
+
+	if ((emcTaskPlanLevel() == 0) &&
+	    (emcTaskPlanLine() + 1 == programStartLine))  {
+
+	    emcTaskPlanSynch();
+
+	    // reset programStartLine so we don't
+	    // fall into our stepping routines if
+	    // we happen to execute lines before
+	    // the current point later (due to
+	    // subroutines).
+	    programStartLine = 0;
+	}
+    }
+
+    return emcStatus->task.interpState == EMC_TASK_INTERP_READING;
+}
+
+void readahead_reading(void)
+{
+    if (interp_list.len() <= emc_task_interp_max_len) {
+	int count = 0;
+	while (readahead_line(0)
+	       && count++ < emc_task_interp_max_len
+	       && interp_list.len() <= emc_task_interp_max_len * 2/3)
+	    ;
+    }
+}
+
+static void *readahead_thread(void *arg)
+{
+    pthread_mutex_lock(&interp_mutex);
+    while (!done) {
+	// at least one line per task cycle, then on until the cycle
+	// wants the interpreter back
+	int lines = 0;
+	if (readahead_go) {
+	    int gil = emcTaskPythonEnter();
+	    while (readahead_go && !done
+		   && (lines++ == 0 || !main_waiting)
+		   && emcStatus->task.interpState == EMC_TASK_INTERP_READING
+		   && interp_list.len() <= emc_task_interp_max_len
+		   && readahead_line(1))
+		;
+	    emcTaskPythonLeave(gil);
+	}
+	pthread_cond_wait(&readahead_cond, &interp_mutex);
+    }
+    pthread_mutex_unlock(&interp_mutex);
+    return NULL;
+}
+
+static int readahead_start(void)
+{
+    if (!emcTaskReadaheadThread)
+	return 0;
+    emcTaskPythonThreads();
+    if (pthread_create(&readahead_tid, NULL, readahead_thread, NULL)) {
+	rcs_print_error("can't start the readahead thread\n");
+	emcTaskReadaheadThread = 0;
+	return -1;
+    }
+    return 0;
+}
+
+static void readahead_stop(void)
+{
+    if (!emcTaskReadaheadThread)
+	return;
+    pthread_mutex_lock(&interp_mutex);
+    pthread_cond_signal(&readahead_cond);
+    pthread_mutex_unlock(&interp_mutex);
+    pthread_join(readahead_tid, NULL);
+    emcTaskPythonAcquire();
+    emcTaskReadaheadThread = 0;
+}
+
+// take the interpreter over from the readahead thread for a task cycle
+static void readahead_lock(void)
+{
+    if (!emcTaskReadaheadThread)
+	return;
+    main_waiting = 1;
+    pthread_mutex_lock(&interp_mutex);
+    emcTaskPythonAcquire();
+    main_waiting = 0;
+    readahead_go = 0;
+    if (readahead_error) {
+	readahead_error = 0;
+	emcAbortCleanup(EMC_ABORT_INTERPRETER_ERROR, "interpreter error");
+    }
+}
+
+static void readahead_unlock(void)
+{
+    if (!emcTaskReadaheadThread)
+	return;
+    if (readahead_go)
+	pthread_cond_signal(&readahead_cond);
+    emcTaskPythonRelease();
+    pthread_mutex_unlock(&interp_mutex);
 }
 
 static void mdi_execute_abort(void)
@@ -699,6 +815,44 @@ static void mdi_execute_abort(void)
     emcStatus->task.interpState = EMC_TASK_INTERP_IDLE;
 }
 
+// queue the lines of a batch as single MDI commands, all of them or,
+// if the batch is malformed or the MDI queue has no room, none
+static int mdi_execute_batch(EMC_TASK_PLAN_EXECUTE_BATCH *batch)
+{
+    EMC_TASK_PLAN_EXECUTE execute_msg;
+    const char *p, *end = batch->text + sizeof(batch->text);
+    size_t len;
+    int i;
+
+    if (!all_homed() && !no_force_homing) {
+	emcOperatorError(0, _("Can't issue MDI command when not homed"));
+	return -1;
+    }
+    if (batch->count <= 0)
+	return 0;
+    if (mdi_execute_queue.len() + batch->count > max_mdi_queued_commands) {
+	emcOperatorError(0, _("MDI queue full, %d lines dropped"),
+			 batch->count);
+	return -1;
+    }
+    for (i = 0, p = batch->text; i < batch->count; i++, p += len + 1) {
+	len = strnlen(p, end - p);
+	if (len == (size_t) (end - p) || len >= LINELEN) {
+	    emcOperatorError(0, _("malformed MDI batch, %d lines dropped"),
+			     batch->count);
+	    return -1;
+	}
+    }
+    for (i = 0, p = batch->text; i < batch->count; i++, p += len + 1) {
+	len = strlen(p);
+	strcpy(execute_msg.command, p);
+	execute_msg.serial_number = batch->serial_number - batch->count + 1 + i;
+	mdi_execute_queue.append(execute_msg);
+    }
+    // mdi_execute_hook() starts the first one if nothing is pending
+    return 0;
+}
+
 static void mdi_execute_hook(void)
 {
     if (mdi_execute_wait && emcTaskPlanIsWait()) {
@@ -1185,8 +1339,11 @@ static int emcTaskPlan(void)
 		}		// switch (type) in ON, AUTO, READING
 
                // handle interp readahead logic
-                readahead_reading();
-                
+		if (emcTaskReadaheadThread)
+		    readahead_go = 1;
+		else
+		    readahead_reading();
+
 		break;		// EMC_TASK_INTERP_READING
 
 	    case EMC_TASK_INTERP_PAUSED:	// ON, AUTO, PAUSED
@@ -1427,6 +1584,10 @@ static int emcTaskPlan(void)
                     retval = 0;
                 }
                 break;
+	    case EMC_TASK_PLAN_EXECUTE_BATCH_TYPE:
+		retval = mdi_execute_batch((EMC_TASK_PLAN_EXECUTE_BATCH *)
+					   emcCommand);
+		break;
 	    case EMC_TOOL_LOAD_TOOL_TABLE_TYPE:
 	    case EMC_TOOL_SET_OFFSET_TYPE:
 		// send to IO
@@ -2186,6 +2347,7 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 	    } else {
 		// record initial MDI command
 		strcpy(emcStatus->task.command, execute_msg->command);
+		emcStatus->task.mdiSerial = execute_msg->serial_number;
 	    }
 
 	    int level = emcTaskPlanLevel();
@@ -2264,6 +2426,27 @@ static int emcTaskIssueCommand(NMLmsg * cmd)
 	}
 	run_msg = (EMC_TASK_PLAN_RUN *) cmd;
 	programStartLine = run_msg->line;
+	// a checkpoint of the interpreter state before the start line
+	// replaces reading the lines up to it; what restoring it queued
+	// is thrown away as it would be for the lines themselves
+	{
+	    int restored = emcTaskPlanBeginRun(programStartLine);
+	    if (restored > 0) {
+		interp_list.clear();
+		CANON_UPDATE_END_POINT(emcStatus->motion.traj.actualPosition.tran.x,
+				       emcStatus->motion.traj.actualPosition.tran.y,
+				       emcStatus->motion.traj.actualPosition.tran.z,
+				       emcStatus->motion.traj.actualPosition.a,
+				       emcStatus->motion.traj.actualPosition.b,
+				       emcStatus->motion.traj.actualPosition.c,
+				       emcStatus->motion.traj.actualPosition.u,
+				       emcStatus->motion.traj.actualPosition.v,
+				       emcStatus->motion.traj.actualPosition.w);
+		emcTaskPlanSynch();
+		if (restored + 1 >= programStartLine)
+		    programStartLine = 0;
+	    }
+	}
 	emcStatus->task.interpState = EMC_TASK_INTERP_READING;
 	emcStatus->task.task_paused = 0;
 	retval = 0;
@@ -2813,11 +2996,33 @@ static int emcTaskExecute(void)
     return retval;
 }
 
+// startup trace: task attaches the global segment only in
+// emcMotionInit(), so the spans are kept here until startup is done
+#define TASK_SPANS 16
+static rtapi_span_t task_spans[TASK_SPANS];
+static int n_task_spans;
+
+static rtapi_span_t *task_span_begin(const char *name)
+{
+    rtapi_span_t *s = &task_spans[n_task_spans < TASK_SPANS - 1 ?
+				  n_task_spans++ : TASK_SPANS - 1];
+    rtapi_span_begin(s, "task %s", name);
+    return s;
+}
+
+static void task_spans_write(void)
+{
+    for (int i = 0; i < n_task_spans; i++)
+	rtapi_span_write(&task_spans[i]);
+    n_task_spans = 0;
+}
+
 // called to allocate and init resources
 static int emctask_startup()
 {
     double end;
     int good;
+    rtapi_span_t *span;
 
 #define RETRY_TIME 10.0		// seconds to wait for subsystems to come up
 #define RETRY_INTERVAL 1.0	// seconds between wait tries for a subsystem
@@ -2831,6 +3036,7 @@ static int emctask_startup()
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
 	// messages
     }
+    span = task_span_begin("emcCommand");
     end = RETRY_TIME;
     good = 0;
     do {
@@ -2851,6 +3057,7 @@ static int emctask_startup()
 	    exit(1);
 	}
     } while (end > 0.0);
+    rtapi_span_stop(span);
     set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
     // messages
     if (!good) {
@@ -2865,6 +3072,7 @@ static int emctask_startup()
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
 	// messages
     }
+    span = task_span_begin("emcStatus");
     end = RETRY_TIME;
     good = 0;
     do {
@@ -2885,17 +3093,21 @@ static int emctask_startup()
 	    exit(1);
 	}
     } while (end > 0.0);
+    rtapi_span_stop(span);
     set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
     // messages
     if (!good) {
 	rcs_print_error("can't get emcStatus buffer\n");
 	return -1;
     }
+    // not fatal, readers fall back to polling without it
+    emcStatNotify.attach(emc_nmlfile, "emcStatus", true);
 
     if (!(emc_debug & EMC_DEBUG_NML)) {
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
 	// messages
     }
+    span = task_span_begin("emcError");
     end = RETRY_TIME;
     good = 0;
     do {
@@ -2915,6 +3127,7 @@ static int emctask_startup()
 	    exit(1);
 	}
     } while (end > 0.0);
+    rtapi_span_stop(span);
     set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
     // messages
     if (!good) {
@@ -2933,6 +3146,7 @@ static int emctask_startup()
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
 	// messages
     }
+    span = task_span_begin("io init");
     end = RETRY_TIME;
     good = 0;
     do {
@@ -2968,6 +3182,7 @@ static int emctask_startup()
 	    exit(1);
 	}
     } while (end > 0.0);
+    rtapi_span_stop(span);
     if (!good) {
 	rcs_print_error("can't read IO status\n");
 	return -1;
@@ -2976,6 +3191,7 @@ static int emctask_startup()
 
     // now motion
 
+    span = task_span_begin("motion init");
     end = RETRY_TIME;
     good = 0;
     do {
@@ -3009,16 +3225,19 @@ static int emctask_startup()
 	    exit(1);
 	}
     } while (end > 0.0);
+    rtapi_span_stop(span);
     if (!good) {
 	rcs_print_error("can't read motion status\n");
 	return -1;
     }
     // now the interpreter
 
+    span = task_span_begin("interp init");
     if (0 != emcTaskPlanInit()) {
 	rcs_print_error("can't initialize interpreter\n");
 	return -1;
     }
+    rtapi_span_stop(span);
 
     if (done ) {
 	emctask_shutdown();
@@ -3057,6 +3276,7 @@ static int emctask_shutdown(void)
 	emcErrorBuffer = 0;
     }
 
+    emcStatNotify.detach();
     if (0 != emcStatusBuffer) {
 	delete emcStatusBuffer;
 	emcStatusBuffer = 0;
@@ -3174,6 +3394,30 @@ static int iniLoad(const char *filename)
 		  filename, emc_task_cycle_time);
     }
 
+    if (NULL != (inistring = inifile.Find("EVENT_DRIVEN", "TASK"))) {
+	if (1 != sscanf(inistring, "%d", &emcTaskEventDriven)) {
+	    emcTaskEventDriven = 0;
+	    rcs_print("invalid [TASK] EVENT_DRIVEN in %s (%s); using default %d\n",
+		      filename, inistring, emcTaskEventDriven);
+	}
+    }
+    if (NULL != (inistring = inifile.Find("READAHEAD_THREAD", "TASK"))) {
+	if (1 != sscanf(inistring, "%d", &emcTaskReadaheadThread)) {
+	    emcTaskReadaheadThread = 0;
+	    rcs_print("invalid [TASK] READAHEAD_THREAD in %s (%s); using default %d\n",
+		      filename, inistring, emcTaskReadaheadThread);
+	}
+    }
+    if (NULL != (inistring = inifile.Find("EVENT_TIMEOUT", "TASK"))) {
+	saveDouble = emcTaskEventTimeout;
+	if ((1 != sscanf(inistring, "%lf", &emcTaskEventTimeout)) ||
+	    (emcTaskEventTimeout <= 0.0)) {
+	    emcTaskEventTimeout = saveDouble;
+	    rcs_print("invalid [TASK] EVENT_TIMEOUT in %s (%s); using default %f\n",
+		      filename, inistring, emcTaskEventTimeout);
+	}
+    }
+
 
     if (NULL != (inistring = inifile.Find("NO_FORCE_HOMING", "TRAJ"))) {
 	if (1 == sscanf(inistring, "%d", &no_force_homing)) {
@@ -3213,13 +3457,37 @@ static int iniLoad(const char *filename)
 /*
   syntax: a.out {-d -ini <inifile>} {-nml <nmlfile>} {-shm <key>}
   */
+// nothing in progress which needs task to keep cycling: no command
+// executing, interpreter idle, motion at rest
+static int emcTaskQuiescent(void)
+{
+    if (emcStatus->status == RCS_EXEC ||
+	emcStatus->motion.traj.queue > 0 ||
+	!emcStatus->motion.traj.inpos ||
+	emcStatus->motion.traj.current_vel != 0.0)
+	return 0;
+    for (int i = 0; i < emcStatus->motion.traj.axes && i < EMC_AXIS_MAX; i++)
+	if (!emcStatus->motion.axis[i].inpos ||
+	    emcStatus->motion.axis[i].homing)
+	    return 0;
+    return 1;
+}
+
 int main(int argc, char *argv[])
 {
     int taskPlanError = 0;
     int taskExecuteError = 0;
     double startTime, endTime, deltaTime;
     double minTime, maxTime;
-
+    rtapi_span_t *startup, *span;
+    double lastStatWrite = 0.0;
+    // command latency: from a UI's kick() to the end of the task cycle
+    // which picked the command up and issued it
+    double kickSeen = 0.0, cmdKick = 0.0;
+    double latMin = DBL_MAX, latMax = 0.0, latSum = 0.0;
+    int latCount = 0;
+
+    startup = task_span_begin("startup");
     bindtextdomain("linuxcnc", EMC2_PO_DIR);
     setlocale(LC_MESSAGES,"");
     setlocale(LC_CTYPE,"");
@@ -3267,7 +3535,9 @@ int main(int argc, char *argv[])
 	exit(1);
     }
     // get configuration information
+    span = task_span_begin("iniLoad");
     iniLoad(emc_inifile);
+    rtapi_span_stop(span);
 
     if (done) {
 	emctask_shutdown();
@@ -3281,7 +3551,9 @@ int main(int argc, char *argv[])
     // get the Python plugin going
 
     // inistantiate task methods object, too
+    span = task_span_begin("methods");
     emcTaskOnce(emc_inifile);
+    rtapi_span_stop(span);
     if (task_methods == NULL) {
 	set_rcs_print_destination(RCS_PRINT_TO_STDOUT);	// restore diag
 	rcs_print_error("can't initialize Task methods\n");
@@ -3290,13 +3562,17 @@ int main(int argc, char *argv[])
     }
 
     // this is the place to run any post-HAL-creation halcmd files
+    span = task_span_begin("halfiles");
     emcRunHalFiles(emc_inifile);
+    rtapi_span_stop(span);
 
     // initialize everything
     if (0 != emctask_startup()) {
 	emctask_shutdown();
 	exit(1);
     }
+    rtapi_span_stop(startup);
+    task_spans_write();
     // set the default startup modes
     emcTaskSetState(EMC_TASK_STATE_ESTOP);
     emcTaskSetMode(EMC_TASK_MODE_MANUAL);
@@ -3325,13 +3601,19 @@ int main(int argc, char *argv[])
     minTime = DBL_MAX;		// set to value that can never be exceeded
     maxTime = 0.0;		// set to value that can never be underset
 
+    // falls back to reading in the task cycle if it can't be started
+    readahead_start();
+
     while (!done) {
+	readahead_lock();
         check_ini_hal_items();
 	// read command
 	if (0 != emcCommandBuffer->peek()) {
 	    // got a new command, so clear out errors
 	    taskPlanError = 0;
 	    taskExecuteError = 0;
+	    if (emcStatNotify.kickTime() > kickSeen)
+		cmdKick = kickSeen = emcStatNotify.kickTime();
 	}
 	// run control cycle
 	if (0 != emcTaskPlan()) {
@@ -3340,6 +3622,16 @@ int main(int argc, char *argv[])
 	if (0 != emcTaskExecute()) {
 	    taskExecuteError = 1;
 	}
+	if (cmdKick > 0.0) {
+	    double lat = etime() - cmdKick;
+	    if (lat < latMin)
+		latMin = lat;
+	    if (lat > latMax)
+		latMax = lat;
+	    latSum += lat;
+	    latCount++;
+	    cmdKick = 0.0;
+	}
 	// update subordinate status
 
 	emcIoUpdate(&emcStatus->io);
@@ -3458,6 +3750,9 @@ int main(int argc, char *argv[])
 	// do task
 	emcStatus->task.command_type = emcCommand->type;
 	emcStatus->task.echo_serial_number = emcCommand->serial_number;
+	emcStatus->task.readaheadDepth = interp_list.len();
+	emcStatus->task.queuedMDIcommands = mdi_execute_queue.len();
+	emcStatus->task.mdiQueueMax = max_mdi_queued_commands;
 
 	// do top level
 	emcStatus->command_type = emcCommand->type;
@@ -3487,7 +3782,14 @@ int main(int argc, char *argv[])
 	// since emcStatus was passed to the WM init functions, it
 	// will be updated in the _update() functions above. There's
 	// no need to call the individual functions on all WM items.
-	emcStatusBuffer->write(emcStatus);
+	// Event driven, skip the write if nothing changed.
+	if (emcStatNotify.diff(emcStatus) || !emcTaskEventDriven ||
+	    etime() - lastStatWrite >= STAT_REFRESH_INTERVAL) {
+	    emcStatusBuffer->write(emcStatus);
+	    lastStatWrite = etime();
+	}
+	emcStatNotify.commit();
+	readahead_unlock();
 
 	// wait on timer cycle, if specified, or calculate actual
 	// interval if ini file says to run full out via
@@ -3505,12 +3807,16 @@ int main(int argc, char *argv[])
 
 	if ((emcTaskNoDelay) || (emcTaskEager)) {
 	    emcTaskEager = 0;
+	} else if (emcTaskEventDriven && emcStatNotify.valid() &&
+		   emcTaskQuiescent()) {
+	    emcStatNotify.waitCommand(emcTaskEventTimeout);
 	} else {
 	    timer->wait();
 	}
     }
     // end of while (! done)
 
+    readahead_stop();
     // clean up everything
     emctask_shutdown();
     /* debugging */
@@ -3520,6 +3826,11 @@ int main(int argc, char *argv[])
 	       maxTime);
 	}
     }
+    if ((emc_debug & EMC_DEBUG_TASK_ISSUE) && latCount) {
+	rcs_print("command latency (seconds, %s): %f min, %f avg, %f max, %d commands\n",
+		  emcTaskEventDriven ? "event driven" : "polled",
+		  latMin, latSum / latCount, latMax, latCount);
+    }
     // and leave
     exit(0);
 }
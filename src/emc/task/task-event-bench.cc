@@ -0,0 +1,149 @@
+/********************************************************************
+* Description: task-event-bench.cc
+*   Time the task main loop, polled and event driven ([TASK]
+*   EVENT_DRIVEN), around the emcStatus notification segment: wakeups
+*   and status writes per second, CPU used, and how long a command
+*   waits between a UI's kick() and the cycle that picks it up.
+*
+*   The loop is the one of emctaskmain.cc with nothing in progress,
+*   the status write is a copy of EMC_STAT. A child process plays the
+*   UI and kicks at random intervals of 5-25ms.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "emc.hh"
+#include "emc_nml.hh"
+#include "timer.hh"
+#include "emcstatnotify.hh"
+
+static void usage(void)
+{
+    fprintf(stderr,
+	    "Usage: task-event-bench [-e] [-c cycle] [-w timeout] [-t seconds] [-n commands] nmlfile\n"
+	    "  -e  event driven, default polled\n"
+	    "  -c  CYCLE_TIME, default 0.001\n"
+	    "  -w  EVENT_TIMEOUT, default 0.05\n"
+	    "  -t  run time, default 10\n"
+	    "  -n  commands sent by the UI, default 0\n");
+    exit(1);
+}
+
+static double cpu_time(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void ui(const char *nmlfile, int commands)
+{
+    EmcStatNotify n;
+
+    if (n.attach(nmlfile, "emcStatus", false))
+	_exit(1);
+    srand(1);
+    for (int i = 0; i < commands; i++) {
+	usleep(5000 + rand() % 20000);
+	n.kick();
+    }
+    _exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    int event = 0, commands = 0, c;
+    double cycle = 0.001, timeout = 0.05, run = 10.0;
+
+    while ((c = getopt(argc, argv, "ec:w:t:n:")) != -1) {
+	switch (c) {
+	case 'e': event = 1; break;
+	case 'c': cycle = atof(optarg); break;
+	case 'w': timeout = atof(optarg); break;
+	case 't': run = atof(optarg); break;
+	case 'n': commands = atoi(optarg); break;
+	default: usage();
+	}
+    }
+    if (optind != argc - 1 || cycle <= 0.0 || timeout <= 0.0)
+	usage();
+
+    static EMC_STAT stat, buffer;
+    EmcStatNotify n;
+    if (n.attach(argv[optind], "emcStatus", true)) {
+	fprintf(stderr, "can't create the notification segment for %s\n",
+		argv[optind]);
+	return 1;
+    }
+    pid_t pid = fork();
+    if (pid == 0)
+	ui(argv[optind], commands);
+
+    std::vector<double> latency;
+    double seen = n.kickTime(), start = etime(), next = start;
+    double lastWrite = 0.0, diffTime = 0.0, cpu = cpu_time();
+    long cycles = 0, writes = 0;
+
+    while (etime() - start < run) {
+	if (event) {
+	    n.waitCommand(timeout);
+	} else {
+	    next += cycle;
+	    if (next > etime())
+		esleep(next - etime());
+	}
+	cycles++;
+	if (n.kickTime() > seen) {
+	    seen = n.kickTime();
+	    latency.push_back(etime() - seen);
+	    stat.echo_serial_number++;
+	}
+	stat.task.heartbeat++;
+	if (event) {
+	    double t = etime();
+	    int changed = n.diff(&stat);
+	    diffTime += etime() - t;
+	    if (changed || etime() - lastWrite >= 1.0) {
+		buffer = stat;
+		writes++;
+		lastWrite = etime();
+	    }
+	    n.commit();
+	} else {
+	    buffer = stat;
+	    writes++;
+	    n.publish(&stat);
+	}
+    }
+    cpu = cpu_time() - cpu;
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    n.detach();
+
+    double elapsed = etime() - start;
+    printf("%s, cycle %.3fs: %.0f wakeups/s, %.0f writes/s, cpu %.2f%%\n",
+	   event ? "event driven" : "polled", cycle, cycles / elapsed,
+	   writes / elapsed, 100.0 * cpu / elapsed);
+    if (event)
+	printf("diff(): %.2fus avg\n", 1e6 * diffTime / cycles);
+    if (!latency.empty()) {
+	std::sort(latency.begin(), latency.end());
+	printf("%zu commands picked up: median %.3fms, p99 %.3fms, max %.3fms\n",
+	       latency.size(), 1e3 * latency[latency.size() / 2],
+	       1e3 * latency[latency.size() * 99 / 100], 1e3 * latency.back());
+    }
+    return 0;
+}
@@ -24,6 +24,12 @@ extern int emcPluginCall(EMC_EXEC_PLUGIN_CALL *call_msg);
 extern int emcIoPluginCall(EMC_IO_PLUGIN_CALL *call_msg);
 extern int emcTaskOnce(const char *inifile);
 extern int emcRunHalFiles(const char *filename);
+// GIL handover to the interpreter readahead thread, see taskclass.cc
+extern void emcTaskPythonThreads(void);
+extern void emcTaskPythonRelease(void);
+extern void emcTaskPythonAcquire(void);
+extern int emcTaskPythonEnter(void);
+extern void emcTaskPythonLeave(int state);
 
 int emcTaskInit();
 int emcTaskHalt();
@@ -40,6 +46,7 @@ int emcTaskPlanSetOptionalStop(bool state);
 int emcTaskPlanSetBlockDelete(bool state);
 void emcTaskPlanExit();
 int emcTaskPlanOpen(const char *file);
+int emcTaskPlanBeginRun(int line);
 int emcTaskPlanRead();
 int emcTaskPlanExecute(const char *command);
 int emcTaskPlanExecute(const char *command, int line_number); //used in case of MDI to pass the pseudo line number to interp
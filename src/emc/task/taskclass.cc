@@ -379,6 +379,43 @@ int emcRunHalFiles(const char *filename)
     return 0;
 }
 
+// the [TASK] READAHEAD_THREAD interpreter thread runs Python remaps and
+// O-word subs while the task cycle sleeps. The task cycle releases the
+// GIL whenever it hands the interpreter to that thread, which takes it
+// around each stretch of reading.
+static PyThreadState *task_tstate;
+
+void emcTaskPythonThreads(void)
+{
+    if (Py_IsInitialized())
+	PyEval_InitThreads();
+}
+
+void emcTaskPythonRelease(void)
+{
+    if (Py_IsInitialized() && !task_tstate)
+	task_tstate = PyEval_SaveThread();
+}
+
+void emcTaskPythonAcquire(void)
+{
+    if (task_tstate) {
+	PyEval_RestoreThread(task_tstate);
+	task_tstate = NULL;
+    }
+}
+
+int emcTaskPythonEnter(void)
+{
+    return Py_IsInitialized() ? (int) PyGILState_Ensure() : -1;
+}
+
+void emcTaskPythonLeave(int state)
+{
+    if (state >= 0)
+	PyGILState_Release((PyGILState_STATE) state);
+}
+
 // task callables are expected to return an int.
 // extract it, and return that
 // else complain.
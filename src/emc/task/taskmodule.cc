@@ -437,6 +437,10 @@ BOOST_PYTHON_MODULE(emctask) {
 	.def_readwrite("interpreter_errcode", &EMC_TASK_STAT::interpreter_errcode)
 	.def_readwrite("task_paused", &EMC_TASK_STAT::task_paused)
 	.def_readwrite("delayLeft", &EMC_TASK_STAT::delayLeft)
+	.def_readwrite("readaheadDepth", &EMC_TASK_STAT::readaheadDepth)
+	.def_readwrite("queuedMDIcommands", &EMC_TASK_STAT::queuedMDIcommands)
+	.def_readwrite("mdiSerial", &EMC_TASK_STAT::mdiSerial)
+	.def_readwrite("mdiQueueMax", &EMC_TASK_STAT::mdiQueueMax)
 	;
 
     class_ <EMC_TOOL_STAT, noncopyable>("EMC_TOOL_STAT",no_init)
@@ -0,0 +1,384 @@
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#ifdef HAVE_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include "emcpos.h"
+#include "tool_parse.h"
+#include "toolstore.hh"
+
+ToolStore::ToolStore(const char *filename, int random_toolchanger,
+		     CANON_TOOL_TABLE toolTable[], int fms[], char *ttcomments[]) :
+    fname(strdup(filename)),
+    random_toolchanger(random_toolchanger),
+    toolTable(toolTable),
+    fms(fms),
+    ttcomments(ttcomments),
+    pending_all(false)
+{
+}
+
+ToolStore::~ToolStore()
+{
+    free(fname);
+}
+
+int ToolStore::load(const char *filename)
+{
+    if ((filename == NULL) || !strcmp(filename, fname)) {
+	pending.clear();
+	pending_all = false;
+	return read();
+    }
+    ToolStore *other = create(filename, random_toolchanger,
+			      toolTable, fms, ttcomments);
+    if (other == NULL)
+	return -1;
+    int retval = other->read();
+    delete other;
+    if (retval == 0)
+	pending_all = true;
+    return retval;
+}
+
+int ToolStore::flush()
+{
+    if (!pending_all && pending.empty())
+	return 0;
+    int retval = write(pending, pending_all);
+    if (retval == 0) {
+	pending.clear();
+	pending_all = false;
+    }
+    return retval;
+}
+
+void ToolStore::clear()
+{
+    for (int t = random_toolchanger? 0: 1; t < CANON_POCKETS_MAX; t++) {
+	toolTable[t].toolno = -1;
+	ZERO_EMC_POSE(toolTable[t].offset);
+	toolTable[t].diameter = 0.0;
+	toolTable[t].frontangle = 0.0;
+	toolTable[t].backangle = 0.0;
+	toolTable[t].orientation = 0;
+	fms[t] = 0;
+	ttcomments[t][0] = '\0';
+    }
+}
+
+// the traditional text tool table
+class TextToolStore : public ToolStore {
+public:
+    TextToolStore(const char *filename, int random_toolchanger,
+		  CANON_TOOL_TABLE toolTable[], int fms[], char *ttcomments[]) :
+	ToolStore(filename, random_toolchanger, toolTable, fms, ttcomments) {}
+
+protected:
+    int read();
+    int write(const std::set<int> &pockets, bool all);
+};
+
+int TextToolStore::read()
+{
+    return loadToolTable(fname, toolTable, fms, ttcomments, random_toolchanger);
+}
+
+int TextToolStore::write(const std::set<int> &pockets, bool all)
+{
+    char path[PATH_MAX], tmp[PATH_MAX + 8];
+    FILE *fp;
+
+    // replace the file the name points to, not a symlink to it
+    if (realpath(fname, path) == NULL)
+	snprintf(path, sizeof(path), "%s", fname);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    if (NULL == (fp = fopen(tmp, "w"))) {
+	fprintf(stderr, "toolstore: can't write '%s': %s\n", tmp, strerror(errno));
+	return -1;
+    }
+    for (int pocket = random_toolchanger? 0: 1; pocket < CANON_POCKETS_MAX; pocket++) {
+	CANON_TOOL_TABLE &t = toolTable[pocket];
+	if (t.toolno == -1)
+	    continue;
+	fprintf(fp, "T%d P%d", t.toolno, random_toolchanger? pocket: fms[pocket]);
+	if (t.diameter) fprintf(fp, " D%f", t.diameter);
+	if (t.offset.tran.x) fprintf(fp, " X%+f", t.offset.tran.x);
+	if (t.offset.tran.y) fprintf(fp, " Y%+f", t.offset.tran.y);
+	if (t.offset.tran.z) fprintf(fp, " Z%+f", t.offset.tran.z);
+	if (t.offset.a) fprintf(fp, " A%+f", t.offset.a);
+	if (t.offset.b) fprintf(fp, " B%+f", t.offset.b);
+	if (t.offset.c) fprintf(fp, " C%+f", t.offset.c);
+	if (t.offset.u) fprintf(fp, " U%+f", t.offset.u);
+	if (t.offset.v) fprintf(fp, " V%+f", t.offset.v);
+	if (t.offset.w) fprintf(fp, " W%+f", t.offset.w);
+	if (t.frontangle) fprintf(fp, " I%+f", t.frontangle);
+	if (t.backangle) fprintf(fp, " J%+f", t.backangle);
+	if (t.orientation) fprintf(fp, " Q%d", t.orientation);
+	fprintf(fp, " ;%s\n", ttcomments[pocket]);
+    }
+    if (fclose(fp) || rename(tmp, path)) {
+	fprintf(stderr, "toolstore: can't write '%s': %s\n", path, strerror(errno));
+	unlink(tmp);
+	return -1;
+    }
+    return 0;
+}
+
+#ifdef HAVE_SQLITE3
+
+// the tool table in the "tools" table of an sqlite3 database. The
+// pocket column holds what the P word holds in a text table: the pocket
+// on a random toolchanger, the FMS pocket number otherwise.
+class SqliteToolStore : public ToolStore {
+public:
+    SqliteToolStore(const char *filename, int random_toolchanger,
+		    CANON_TOOL_TABLE toolTable[], int fms[], char *ttcomments[]) :
+	ToolStore(filename, random_toolchanger, toolTable, fms, ttcomments),
+	db(NULL), insert_stmt(NULL), delete_stmt(NULL) {}
+    ~SqliteToolStore();
+
+    int open();
+
+protected:
+    int read();
+    int write(const std::set<int> &pockets, bool all);
+
+private:
+    int fail(const char *what);
+    int write_pocket(int pocket);
+
+    sqlite3 *db;
+    sqlite3_stmt *insert_stmt, *delete_stmt;
+};
+
+#define TOOLS_COLUMNS \
+    "toolno, pocket, diameter, backangle, frontangle, orientation, comment, " \
+    "x_offset, y_offset, z_offset, a_offset, b_offset, c_offset, " \
+    "u_offset, v_offset, w_offset"
+
+// as in toolstore/sql/schema-simple.sql
+static const char *create_tools =
+    "CREATE TABLE IF NOT EXISTS tools ("
+    " toolno INTEGER PRIMARY KEY, pocket INTEGER,"
+    " diameter REAL DEFAULT (0.0), backangle REAL DEFAULT (0.0),"
+    " frontangle REAL DEFAULT (0.0), orientation INTEGER DEFAULT (0.0),"
+    " comment TEXT DEFAULT (NULL),"
+    " x_offset REAL DEFAULT (0.0), y_offset REAL DEFAULT (0.0),"
+    " z_offset REAL DEFAULT (0.0), a_offset REAL DEFAULT (0.0),"
+    " b_offset REAL DEFAULT (0.0), c_offset REAL DEFAULT (0.0),"
+    " u_offset REAL DEFAULT (0.0), v_offset REAL DEFAULT (0.0),"
+    " w_offset REAL DEFAULT (0.0))";
+
+SqliteToolStore::~SqliteToolStore()
+{
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(delete_stmt);
+    sqlite3_close(db);
+}
+
+int SqliteToolStore::fail(const char *what)
+{
+    fprintf(stderr, "toolstore: %s '%s': %s\n", what, fname,
+	    db ? sqlite3_errmsg(db) : "out of memory");
+    return -1;
+}
+
+int SqliteToolStore::open()
+{
+    if (sqlite3_open_v2(fname, &db,
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+	return fail("can't open");
+    if (sqlite3_exec(db, create_tools, NULL, NULL, NULL) != SQLITE_OK)
+	return fail("can't create tools table in");
+    if (sqlite3_prepare_v2(db,
+			   "INSERT OR REPLACE INTO tools (" TOOLS_COLUMNS ") "
+			   "VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)",
+			   -1, &insert_stmt, NULL) != SQLITE_OK ||
+	sqlite3_prepare_v2(db, "DELETE FROM tools WHERE pocket = ?",
+			   -1, &delete_stmt, NULL) != SQLITE_OK)
+	return fail("can't prepare statements for");
+    return 0;
+}
+
+int SqliteToolStore::read()
+{
+    sqlite3_stmt *select;
+    int fakepocket = 0, rc;
+
+    // rows in the order of the table, which is by tool number since
+    // toolno is the rowid; ordering by pocket would make a nonrandom
+    // table's pockets follow the FMS numbers
+    if (sqlite3_prepare_v2(db, "SELECT " TOOLS_COLUMNS " FROM tools ORDER BY rowid",
+			   -1, &select, NULL) != SQLITE_OK)
+	return fail("can't read");
+    clear();
+    while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+	int toolno = sqlite3_column_int(select, 0);
+	int pocket = sqlite3_column_int(select, 1);
+
+	if (!random_toolchanger) {
+	    // like a text table: tools go into pockets 1..n in order
+	    if (++fakepocket >= CANON_POCKETS_MAX) {
+		printf("too many tools. skipping tool %d\n", toolno);
+		continue;
+	    }
+	    fms[fakepocket] = pocket;
+	    pocket = fakepocket;
+	}
+	if (pocket < 0 || pocket >= CANON_POCKETS_MAX) {
+	    printf("max pocket number is %d. skipping tool %d\n", CANON_POCKETS_MAX - 1, toolno);
+	    continue;
+	}
+	CANON_TOOL_TABLE &t = toolTable[pocket];
+	t.toolno = toolno;
+	t.diameter = sqlite3_column_double(select, 2);
+	t.backangle = sqlite3_column_double(select, 3);
+	t.frontangle = sqlite3_column_double(select, 4);
+	t.orientation = sqlite3_column_int(select, 5);
+	const unsigned char *comment = sqlite3_column_text(select, 6);
+	snprintf(ttcomments[pocket], CANON_TOOL_COMMENT_LEN, "%s",
+		 comment ? (const char *) comment : "");
+	t.offset.tran.x = sqlite3_column_double(select, 7);
+	t.offset.tran.y = sqlite3_column_double(select, 8);
+	t.offset.tran.z = sqlite3_column_double(select, 9);
+	t.offset.a = sqlite3_column_double(select, 10);
+	t.offset.b = sqlite3_column_double(select, 11);
+	t.offset.c = sqlite3_column_double(select, 12);
+	t.offset.u = sqlite3_column_double(select, 13);
+	t.offset.v = sqlite3_column_double(select, 14);
+	t.offset.w = sqlite3_column_double(select, 15);
+
+	if (!random_toolchanger && toolTable[0].toolno == toolno)
+	    toolTable[0] = t;
+    }
+    sqlite3_finalize(select);
+    if (rc != SQLITE_DONE)
+	return fail("can't read");
+    return 0;
+}
+
+int SqliteToolStore::write_pocket(int pocket)
+{
+    CANON_TOOL_TABLE &t = toolTable[pocket];
+    int p = random_toolchanger? pocket: fms[pocket];
+
+    // on a nonrandom toolchanger pocket 0 is a copy of the loaded
+    // tool's entry, not a place a tool is stored
+    if (!random_toolchanger && pocket == 0)
+	return 0;
+
+    // on a random toolchanger, whatever was stored in this pocket left
+    // it. Tools are rows by tool number, so the tool which moved in
+    // just has its pocket column replaced.
+    if (random_toolchanger) {
+	sqlite3_bind_int(delete_stmt, 1, p);
+	int rc = sqlite3_step(delete_stmt);
+	sqlite3_reset(delete_stmt);
+	if (rc != SQLITE_DONE)
+	    return -1;
+    }
+    if (t.toolno == -1)
+	return 0;
+
+    sqlite3_bind_int(insert_stmt, 1, t.toolno);
+    sqlite3_bind_int(insert_stmt, 2, p);
+    sqlite3_bind_double(insert_stmt, 3, t.diameter);
+    sqlite3_bind_double(insert_stmt, 4, t.backangle);
+    sqlite3_bind_double(insert_stmt, 5, t.frontangle);
+    sqlite3_bind_int(insert_stmt, 6, t.orientation);
+    sqlite3_bind_text(insert_stmt, 7, ttcomments[pocket], -1, SQLITE_STATIC);
+    sqlite3_bind_double(insert_stmt, 8, t.offset.tran.x);
+    sqlite3_bind_double(insert_stmt, 9, t.offset.tran.y);
+    sqlite3_bind_double(insert_stmt, 10, t.offset.tran.z);
+    sqlite3_bind_double(insert_stmt, 11, t.offset.a);
+    sqlite3_bind_double(insert_stmt, 12, t.offset.b);
+    sqlite3_bind_double(insert_stmt, 13, t.offset.c);
+    sqlite3_bind_double(insert_stmt, 14, t.offset.u);
+    sqlite3_bind_double(insert_stmt, 15, t.offset.v);
+    sqlite3_bind_double(insert_stmt, 16, t.offset.w);
+    int rc = sqlite3_step(insert_stmt);
+    sqlite3_reset(insert_stmt);
+    return (rc == SQLITE_DONE) ? 0 : -1;
+}
+
+int SqliteToolStore::write(const std::set<int> &pockets, bool all)
+{
+    int retval = 0;
+
+    if (sqlite3_exec(db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+	return fail("can't write");
+    if (all) {
+	if (sqlite3_exec(db, "DELETE FROM tools", NULL, NULL, NULL) != SQLITE_OK)
+	    retval = -1;
+	for (int pocket = 0; !retval && pocket < CANON_POCKETS_MAX; pocket++)
+	    retval = write_pocket(pocket);
+    } else {
+	for (std::set<int>::const_iterator it = pockets.begin();
+	     !retval && it != pockets.end(); ++it)
+	    retval = write_pocket(*it);
+    }
+    if (retval) {
+	fail("can't write");
+	sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+	return -1;
+    }
+    if (sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+	return fail("can't write");
+    return 0;
+}
+
+#endif
+
+static bool is_database(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+    return ext && (!strcmp(ext, ".db") ||
+		   !strcmp(ext, ".sqlite") ||
+		   !strcmp(ext, ".sqlite3"));
+}
+
+ToolStore *ToolStore::create(const char *filename, int random_toolchanger,
+			     CANON_TOOL_TABLE toolTable[], int fms[],
+			     char *ttcomments[])
+{
+    if (filename == NULL || *filename == '\0')
+	return NULL;
+
+    if (!is_database(filename))
+	return new TextToolStore(filename, random_toolchanger,
+				 toolTable, fms, ttcomments);
+#ifdef HAVE_SQLITE3
+    SqliteToolStore *s = new SqliteToolStore(filename, random_toolchanger,
+					     toolTable, fms, ttcomments);
+    if (s->open()) {
+	delete s;
+	return NULL;
+    }
+    return s;
+#else
+    fprintf(stderr, "toolstore: '%s': built without sqlite3 support\n", filename);
+    return NULL;
+#endif
+}
@@ -0,0 +1,78 @@
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+#ifndef TOOLSTORE_HH
+#define TOOLSTORE_HH
+
+#include <set>
+#include "emctool.h"
+
+// Persistent storage of the tool table.
+//
+// In memory the tool table stays what it always was: the pocket indexed
+// toolTable[] of EMC_TOOL_STAT plus the fms[] and ttcomments[] arrays
+// of iocontrol. A ToolStore reads these from the [EMCIO]TOOL_TABLE file
+// and writes back changes: update(pocket) records a changed pocket,
+// flush() writes what changed since the last flush.
+//
+// The backend is picked by the file name:
+//
+//   *.db, *.sqlite, *.sqlite3  an sqlite3 database with the "tools"
+//                              table of toolstore/sql/schema-simple.sql.
+//                              A flush writes one row per changed pocket
+//                              in a single transaction.
+//   anything else              the traditional text format. It can't be
+//                              updated in place, so a flush rewrites the
+//                              file - to a temporary first, then renamed
+//                              over the old one.
+class ToolStore {
+public:
+    // NULL if the backend isn't available for filename
+    static ToolStore *create(const char *filename, int random_toolchanger,
+			     CANON_TOOL_TABLE toolTable[], int fms[],
+			     char *ttcomments[]);
+    virtual ~ToolStore();
+
+    // read the whole table from the store's file, or from another tool
+    // table file in any of the formats above; the latter is written to
+    // the store's file with the next flush()
+    int load(const char *filename = 0);
+
+    void update(int pocket) { pending.insert(pocket); }
+    int flush();
+
+    const char *filename() const { return fname; }
+
+protected:
+    ToolStore(const char *filename, int random_toolchanger,
+	      CANON_TOOL_TABLE toolTable[], int fms[], char *ttcomments[]);
+
+    virtual int read() = 0;
+    // write pending pockets, or the whole table if all is set
+    virtual int write(const std::set<int> &pockets, bool all) = 0;
+
+    // clear the arrays as loadToolTable() does before reading
+    void clear();
+
+    char *fname;
+    int random_toolchanger;
+    CANON_TOOL_TABLE *toolTable;
+    int *fms;
+    char **ttcomments;
+
+private:
+    std::set<int> pending;
+    bool pending_all;
+};
+
+#endif
@@ -30,8 +30,16 @@
 #include "timer.hh"
 #include "nml_oi.hh"
 #include "rcs_print.hh"
+#include "emcstatnotify.hh"
+#include "hal.h"
+#include "hal_ring.h"
+#include "postrace.h"
+#include "jointhist.h"
 
 #include <cmath>
+#include <map>
+#include <string>
+#include <vector>
 
 #ifndef T_BOOL
 // The C++ standard probably doesn't specify the amount of storage for a 'bool',
@@ -83,6 +91,7 @@ struct pyIniFile {
 struct pyStatChannel {
     PyObject_HEAD
     RCS_STAT_CHANNEL *c;
+    EmcStatNotify *notify;
     EMC_STAT status;
 };
 
@@ -90,6 +99,7 @@ struct pyCommandChannel {
     PyObject_HEAD
     RCS_CMD_CHANNEL *c;
     RCS_STAT_CHANNEL *s;
+    EmcStatNotify *notify;
     int serial;
 };
 
@@ -207,14 +217,32 @@ static PyTypeObject Ini_Type = {
 };
 
 #define EMC_COMMAND_TIMEOUT 5.0  // how long to wait until timeout
-#define EMC_COMMAND_DELAY   0.01 // how long to sleep between checks
+#define EMC_COMMAND_DELAY   0.01 // longest sleep between checks
 
-static int emcWaitCommandComplete(int serial_number, RCS_STAT_CHANNEL *s, double timeout) {
+static EmcStatNotify *attach_notify(const char *file) {
+    EmcStatNotify *n = new EmcStatNotify;
+    if(n->attach(file, "emcStatus", false) < 0) {
+        delete n;
+        return NULL;
+    }
+    return n;
+}
+
+// peek only if the task published a change since the last peek;
+// otherwise the copy held by the channel is still current
+static bool peek_stat(RCS_STAT_CHANNEL *s, EmcStatNotify *n) {
+    if(!n || n->changed())
+        s->peek();
+    return s->get_address()->type == EMC_STAT_TYPE;
+}
+
+static int emcWaitCommandComplete(int serial_number, RCS_STAT_CHANNEL *s,
+        EmcStatNotify *n, double timeout) {
     double start = etime();
 
     do {
         double now = etime();
-        if(s->peek() == EMC_STAT_TYPE) {
+        if(peek_stat(s, n)) {
            EMC_STAT *stat = (EMC_STAT*)s->get_address();
 //           printf("WaitComplete: %d %d %d\n", serial_number, stat->echo_serial_number, stat->status);
            if (stat->echo_serial_number == serial_number &&
@@ -222,21 +250,27 @@ static int emcWaitCommandComplete(int serial_number, RCS_STAT_CHANNEL *s, double
                 return s->get_address()->status;
            }
         }
-        esleep(rtapi_fmin(timeout - (now - start), EMC_COMMAND_DELAY));
+        emcStatWaitChange(n, rtapi_fmin(timeout - (now - start), EMC_COMMAND_DELAY));
     } while (etime() - start < timeout);
     return -1;
 }
 
-static void emcWaitCommandReceived(int serial_number, RCS_STAT_CHANNEL *s) {
+// 0 once task echoed serial_number, -1 if it didn't in time
+static int emcWaitCommandReceived(int serial_number, RCS_STAT_CHANNEL *s,
+        EmcStatNotify *n) {
     double start = etime();
 
+    // wake task if it is waiting for commands
+    if(n) n->kick();
+
     while (etime() - start < EMC_COMMAND_TIMEOUT) {
-        if(s->peek() == EMC_STAT_TYPE &&
+        if(peek_stat(s, n) &&
            s->get_address()->echo_serial_number == serial_number) {
-                return;
+                return 0;
            }
-        esleep(EMC_COMMAND_DELAY);
+        emcStatWaitChange(n, EMC_COMMAND_DELAY);
     }
+    return -1;
 }
 
 static int next_serial(pyCommandChannel *c) {
@@ -261,11 +295,13 @@ static int Stat_init(pyStatChannel *self, PyObject *a, PyObject *k) {
     }
 
     self->c = c;
+    self->notify = attach_notify(file);
     return 0;
 }
 
 static void Stat_dealloc(PyObject *self) {
     delete ((pyStatChannel*)self)->c;
+    delete ((pyStatChannel*)self)->notify;
     PyObject_Del(self);
 }
 
@@ -279,6 +315,10 @@ static bool check_stat(RCS_STAT_CHANNEL *emcStatusBuffer) {
 
 static PyObject *poll(pyStatChannel *s, PyObject *o) {
     if(!check_stat(s->c)) return NULL;
+    if(s->notify && !s->notify->changed()) {
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
     if(s->c->peek() == EMC_STAT_TYPE) {
         EMC_STAT *emcStatus = static_cast<EMC_STAT*>(s->c->get_address());
         memcpy(&s->status, emcStatus, sizeof(EMC_STAT));
@@ -287,8 +327,28 @@ static PyObject *poll(pyStatChannel *s, PyObject *o) {
     return Py_None;
 }
 
+static PyObject *wait_change(pyStatChannel *s, PyObject *o) {
+    double timeout;
+    int mask = EMC_STAT_SECT_ALL, result;
+    if(!PyArg_ParseTuple(o, "d|i:wait_change", &timeout, &mask)) return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    if(s->notify) {
+        result = s->notify->wait(mask, timeout);
+    } else {
+        esleep(timeout);
+        result = mask;
+    }
+    Py_END_ALLOW_THREADS
+    return PyInt_FromLong(result);
+}
+
 static PyMethodDef Stat_methods[] = {
     {"poll", (PyCFunction)poll, METH_NOARGS, "Update current machine state"},
+    {"wait_change", (PyCFunction)wait_change, METH_VARARGS,
+        "wait_change(timeout[, mask]): Block until one of the STAT_SECT_* "
+        "sections in mask changed since the last poll, or timeout seconds "
+        "pass. Returns the changed sections, 0 on timeout. Without a local "
+        "task this just sleeps and returns mask."},
     {NULL}
 };
 
@@ -317,6 +377,9 @@ static PyMemberDef Stat_members[] = {
     {(char*)"rotation_xy", T_DOUBLE, O(task.rotation_xy), READONLY},
     {(char*)"delay_left", T_DOUBLE, O(task.delayLeft), READONLY},
     {(char*)"queued_mdi_commands", T_INT, O(task.queuedMDIcommands), READONLY},
+    {(char*)"readahead_depth", T_INT, O(task.readaheadDepth), READONLY},
+    {(char*)"mdi_serial", T_INT, O(task.mdiSerial), READONLY},
+    {(char*)"mdi_queue_max", T_INT, O(task.mdiQueueMax), READONLY},
 
 // motion
 //   EMC_TRAJ_STAT traj
@@ -707,11 +770,13 @@ static int Command_init(pyCommandChannel *self, PyObject *a, PyObject *k) {
 
     self->s = s;
     self->c = c;
+    self->notify = attach_notify(file);
     return 0;
 }
 
 static void Command_dealloc(PyObject *self) {
     delete ((pyCommandChannel*)self)->c;
+    delete ((pyCommandChannel*)self)->notify;
     PyObject_Del(self);
 }
 
@@ -724,7 +789,7 @@ static PyObject *block_delete(pyCommandChannel *s, PyObject *o) {
             
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -739,7 +804,7 @@ static PyObject *optional_stop(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -759,7 +824,7 @@ static PyObject *mode(pyCommandChannel *s, PyObject *o) {
     }
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -769,7 +834,7 @@ static PyObject *maxvel(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "d", &m.velocity)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }    
@@ -779,7 +844,7 @@ static PyObject *feedrate(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "d", &m.scale)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -789,7 +854,7 @@ static PyObject *rapidrate(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "d", &m.scale)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -799,7 +864,7 @@ static PyObject *spindleoverride(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "d", &m.scale)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -819,7 +884,7 @@ static PyObject *spindle(pyCommandChannel *s, PyObject *o) {
             m.speed = dir * vel;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_SPINDLE_INCREASE:
@@ -827,7 +892,7 @@ static PyObject *spindle(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_INCREASE m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_SPINDLE_DECREASE:
@@ -835,7 +900,7 @@ static PyObject *spindle(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_DECREASE m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_SPINDLE_CONSTANT:
@@ -843,7 +908,7 @@ static PyObject *spindle(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_CONSTANT m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_SPINDLE_OFF:
@@ -851,7 +916,7 @@ static PyObject *spindle(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_OFF m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         default:
@@ -874,11 +939,61 @@ static PyObject *mdi(pyCommandChannel *s, PyObject *o) {
     m.serial_number = next_serial(s);
     strcpy(m.command, cmd);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+// queue as many of the MDI lines as the MDI queue of task has room
+// for, in as few commands as EMC_TASK_BATCH_LEN allows, and return how
+// many task took. A batch counts once task echoed it without an error;
+// on a timeout or a refused batch the count so far is returned. If all
+// were taken, the last has serial number .serial, compare with
+// stat.mdi_serial to follow the execution.
+static PyObject *mdi_batch(pyCommandChannel *s, PyObject *o) {
+    PyObject *lines, *seq;
+    Py_ssize_t n, i, sent = 0;
+    if(!PyArg_ParseTuple(o, "O", &lines)) return NULL;
+    seq = PySequence_Fast(lines, "MDI lines must be a sequence");
+    if(!seq) return NULL;
+    n = PySequence_Fast_GET_SIZE(seq);
+    for(i = 0; i < n; i++) {
+        PyObject *l = PySequence_Fast_GET_ITEM(seq, i);
+        if(!PyString_Check(l) || PyString_GET_SIZE(l) >= LINELEN ||
+           strlen(PyString_AS_STRING(l)) != (size_t)PyString_GET_SIZE(l)) {
+            PyErr_Format(PyExc_ValueError,"MDI line %d: MDI commands are strings limited to %d characters", (int)i, LINELEN);
+            Py_DECREF(seq);
+            return NULL;
+        }
+    }
+    while(sent < n && peek_stat(s->s, s->notify)) {
+        EMC_STAT *stat = (EMC_STAT*)s->s->get_address();
+        int room = stat->task.mdiQueueMax - stat->task.queuedMDIcommands;
+        EMC_TASK_PLAN_EXECUTE_BATCH m;
+        char *p = m.text;
+        m.count = 0;
+        while(sent + m.count < n && m.count < room) {
+            PyObject *l = PySequence_Fast_GET_ITEM(seq, sent + m.count);
+            Py_ssize_t len = PyString_GET_SIZE(l) + 1;
+            if(p + len > m.text + sizeof(m.text)) break;
+            memcpy(p, PyString_AS_STRING(l), len);
+            p += len;
+            m.count++;
+        }
+        if(m.count == 0) break;
+        s->serial += m.count;
+        m.serial_number = s->serial;
+        s->c->write(m);
+        // task takes all lines of a batch or, with RCS_ERROR, none
+        if(emcWaitCommandReceived(s->serial, s->s, s->notify) < 0 ||
+           s->s->get_address()->status == RCS_ERROR)
+            break;
+        sent += m.count;
+    }
+    Py_DECREF(seq);
+    return PyInt_FromLong(sent);
+}
+
 static PyObject *state(pyCommandChannel *s, PyObject *o) {
     EMC_TASK_SET_STATE m;
     if(!PyArg_ParseTuple(o, "i", &m.state)) return NULL;
@@ -894,7 +1009,7 @@ static PyObject *state(pyCommandChannel *s, PyObject *o) {
     }
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -906,7 +1021,7 @@ static PyObject *tool_offset(pyCommandChannel *s, PyObject *o) {
         return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -921,7 +1036,7 @@ static PyObject *mist(pyCommandChannel *s, PyObject *o) {
             EMC_COOLANT_MIST_ON m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_MIST_OFF:
@@ -929,7 +1044,7 @@ static PyObject *mist(pyCommandChannel *s, PyObject *o) {
             EMC_COOLANT_MIST_OFF m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         default:
@@ -949,7 +1064,7 @@ static PyObject *flood(pyCommandChannel *s, PyObject *o) {
             EMC_COOLANT_FLOOD_ON m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_FLOOD_OFF:
@@ -957,7 +1072,7 @@ static PyObject *flood(pyCommandChannel *s, PyObject *o) {
             EMC_COOLANT_FLOOD_OFF m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         default:
@@ -977,7 +1092,7 @@ static PyObject *brake(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_BRAKE_ENGAGE m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         case LOCAL_BRAKE_RELEASE:
@@ -985,7 +1100,7 @@ static PyObject *brake(pyCommandChannel *s, PyObject *o) {
             EMC_SPINDLE_BRAKE_RELEASE m;
             m.serial_number = next_serial(s);
             s->c->write(m);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
         }
             break;
         default:
@@ -1001,7 +1116,7 @@ static PyObject *load_tool_table(pyCommandChannel *s, PyObject *o) {
     m.file[0] = '\0'; // don't override the ini file
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1010,7 +1125,7 @@ static PyObject *emcabort(pyCommandChannel *s, PyObject *o) {
     EMC_TASK_ABORT m;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1020,7 +1135,7 @@ static PyObject *override_limits(pyCommandChannel *s, PyObject *o) {
     m.axis = 0; // same number for all
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1030,7 +1145,7 @@ static PyObject *home(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "i", &m.axis)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1040,7 +1155,7 @@ static PyObject *unhome(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "i", &m.axis)) return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1052,7 +1167,7 @@ static PyObject *set_home_parameters(pyCommandChannel *s, PyObject *o) {
         return NULL;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None; 
@@ -1081,7 +1196,7 @@ static PyObject *jog(pyCommandChannel *s, PyObject *o) {
         abort.axis = axis;
         abort.serial_number = next_serial(s);
         s->c->write(abort);
-        emcWaitCommandReceived(s->serial, s->s);
+        emcWaitCommandReceived(s->serial, s->s, s->notify);
     } else if(fn == LOCAL_JOG_CONTINUOUS) {
         if(PyTuple_Size(o) != 3) {
             PyErr_Format( PyExc_TypeError,
@@ -1094,7 +1209,7 @@ static PyObject *jog(pyCommandChannel *s, PyObject *o) {
         cont.vel = vel;
         cont.serial_number = next_serial(s);
         s->c->write(cont);
-        emcWaitCommandReceived(s->serial, s->s);
+        emcWaitCommandReceived(s->serial, s->s, s->notify);
     } else if(fn == LOCAL_JOG_INCREMENT) {
         if(PyTuple_Size(o) != 4) {
             PyErr_Format( PyExc_TypeError,
@@ -1109,7 +1224,7 @@ static PyObject *jog(pyCommandChannel *s, PyObject *o) {
         incr.incr = inc;
         incr.serial_number = next_serial(s);
         s->c->write(incr);
-        emcWaitCommandReceived(s->serial, s->s);
+        emcWaitCommandReceived(s->serial, s->s, s->notify);
     } else {
         PyErr_Format( PyExc_TypeError, "jog() first argument must be JOG_xxx");
         return NULL;
@@ -1123,7 +1238,7 @@ static PyObject *reset_interpreter(pyCommandChannel *s, PyObject *o) {
     EMC_TASK_PLAN_INIT m;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1137,7 +1252,7 @@ static PyObject *program_open(pyCommandChannel *s, PyObject *o) {
     m.serial_number = next_serial(s);
     strcpy(m.file, file);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     Py_INCREF(Py_None);
     return Py_None;
 }
@@ -1152,7 +1267,7 @@ static PyObject *emcauto(pyCommandChannel *s, PyObject *o) {
     if(PyArg_ParseTuple(o, "ii", &fn, &run.line) && fn == LOCAL_AUTO_RUN) {
         run.serial_number = next_serial(s);
         s->c->write(run);
-        emcWaitCommandReceived(s->serial, s->s);
+        emcWaitCommandReceived(s->serial, s->s, s->notify);
     } else {
         PyErr_Clear();
         if(!PyArg_ParseTuple(o, "i", &fn)) return NULL;
@@ -1160,17 +1275,17 @@ static PyObject *emcauto(pyCommandChannel *s, PyObject *o) {
         case LOCAL_AUTO_PAUSE:
             pause.serial_number = next_serial(s);
             s->c->write(pause);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
             break;
         case LOCAL_AUTO_RESUME:
             resume.serial_number = next_serial(s);
             s->c->write(resume);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
             break;
         case LOCAL_AUTO_STEP:
             step.serial_number = next_serial(s);
             s->c->write(step);
-            emcWaitCommandReceived(s->serial, s->s);
+            emcWaitCommandReceived(s->serial, s->s, s->notify);
             break;
         default:
             PyErr_Format(error, "Unexpected argument '%d' to command.auto", fn);
@@ -1187,7 +1302,7 @@ static PyObject *debug(pyCommandChannel *s, PyObject *o) {
     if(!PyArg_ParseTuple(o, "i", &d.debug)) return NULL;
     d.serial_number = next_serial(s);
     s->c->write(d);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     
     Py_INCREF(Py_None);
     return Py_None;
@@ -1200,7 +1315,7 @@ static PyObject *teleop(pyCommandChannel *s, PyObject *o) {
 
     en.serial_number = next_serial(s);
     s->c->write(en);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     
     Py_INCREF(Py_None);
     return Py_None;
@@ -1213,7 +1328,7 @@ static PyObject *set_traj_mode(pyCommandChannel *s, PyObject *o) {
 
     mo.serial_number = next_serial(s);
     s->c->write(mo);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
     
     Py_INCREF(Py_None);
     return Py_None;
@@ -1229,7 +1344,7 @@ static PyObject *set_teleop_vector(pyCommandChannel *s, PyObject *o) {
 
     mo.serial_number = next_serial(s);
     s->c->write(mo);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1242,7 +1357,7 @@ static PyObject *set_min_limit(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1255,7 +1370,7 @@ static PyObject *set_max_limit(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1269,7 +1384,7 @@ static PyObject *set_feed_override(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1282,7 +1397,7 @@ static PyObject *set_spindle_override(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1295,7 +1410,7 @@ static PyObject *set_feed_hold(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1308,7 +1423,7 @@ static PyObject *set_adaptive_feed(pyCommandChannel *s, PyObject *o) {
 
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1322,7 +1437,7 @@ static PyObject *set_digital_output(pyCommandChannel *s, PyObject *o) {
     m.now = 1;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1336,7 +1451,7 @@ static PyObject *set_analog_output(pyCommandChannel *s, PyObject *o) {
     m.now = 1;
     m.serial_number = next_serial(s);
     s->c->write(m);
-    emcWaitCommandReceived(s->serial, s->s);
+    emcWaitCommandReceived(s->serial, s->s, s->notify);
 
     Py_INCREF(Py_None);
     return Py_None;
@@ -1346,7 +1461,7 @@ static PyObject *wait_complete(pyCommandChannel *s, PyObject *o) {
     double timeout = EMC_COMMAND_TIMEOUT;
     if (!PyArg_ParseTuple(o, "|d:emc.command.wait_complete", &timeout))
         return NULL;
-    return PyInt_FromLong(emcWaitCommandComplete(s->serial, s->s, timeout));
+    return PyInt_FromLong(emcWaitCommandComplete(s->serial, s->s, s->notify, timeout));
 }
 
 static PyMemberDef Command_members[] = {
@@ -1362,6 +1477,7 @@ static PyMethodDef Command_methods[] = {
     {"wait_complete", (PyCFunction)wait_complete, METH_VARARGS},
     {"state", (PyCFunction)state, METH_VARARGS},
     {"mdi", (PyCFunction)mdi, METH_VARARGS},
+    {"mdi_batch", (PyCFunction)mdi_batch, METH_VARARGS},
     {"mode", (PyCFunction)mode, METH_VARARGS},
     {"feedrate", (PyCFunction)feedrate, METH_VARARGS},
     {"rapidrate", (PyCFunction)rapidrate, METH_VARARGS},
@@ -1619,7 +1735,10 @@ static void glvertex9(const double pt[9], const char *geometry) {
 #define max(a,b) ((a) < (b) ? (b) : (a))
 #define max3(a,b,c) (max((a),max((b),(c))))
 
-static void line9(const double p1[9], const double p2[9], const char *geometry) {
+// call point() for the points after p1 on the 9d line p1-p2; a move
+// with a rotary component is subdivided so it shows as an arc
+static void line9_points(const double p1[9], const double p2[9],
+        void (*point)(const double pt[9], void *arg), void *arg) {
     if(p1[3] != p2[3] || p1[4] != p2[4] || p1[5] != p2[5]) {
         double dc = max3(
             rtapi_fabs(p2[3] - p1[3]),
@@ -1633,13 +1752,21 @@ static void line9(const double p1[9], const double p2[9], const char *geometry)
             double v = 1.0 - t;
             double pt[9];
             for(int j=0; j<9; j++) { pt[j] = t * p2[j] + v * p1[j]; }
-            glvertex9(pt, geometry);
+            point(pt, arg);
         }
     } else {
-        glvertex9(p2, geometry);
+        point(p2, arg);
     }
 }
 
+static void glvertex9_point(const double pt[9], void *geometry) {
+    glvertex9(pt, (const char *)geometry);
+}
+
+static void line9(const double p1[9], const double p2[9], const char *geometry) {
+    line9_points(p1, p2, glvertex9_point, (void *)geometry);
+}
+
 static void line9b(const double p1[9], const double p2[9], const char *geometry) {
     glvertex9(p1, geometry);
     if(p1[3] != p2[3] || p1[4] != p2[4] || p1[5] != p2[5]) {
@@ -1816,6 +1943,280 @@ static PyObject *pydraw_dwells(PyObject *s, PyObject *o) {
     return Py_None;
 }
 
+// Preview geometry as vertex arrays.
+//
+// draw_lines() parses the segment tuples of rs274.glcanon and transforms
+// their points each time a display list is rebuilt.  A linuxcnc.segments
+// object does that once: extend() converts the tuples into a packed float
+// array of transformed vertices (rotary moves already subdivided), which
+// draw() hands to glDrawArrays.  The array is split into
+//   strips  connected segments, drawn as one GL_LINE_STRIP each
+//   runs    consecutive segments of one line number within a strip; these
+//           carry the selection names and are looked up by highlight()
+struct segment_range {
+    unsigned first, count;      // vertices
+};
+
+struct segment_run {
+    int lineno;
+    unsigned first, count;      // vertices
+    double sum[3];              // of the untransformed end points
+    int npts;
+};
+
+struct segment_store {
+    std::string geometry;
+    std::vector<float> v;       // x, y, z per vertex
+    std::vector<segment_range> strips;
+    std::vector<segment_run> runs;
+    std::multimap<int, unsigned> by_line; // line number -> index into runs
+    double last[9];
+    int nsegs;
+};
+
+typedef struct {
+    PyObject_HEAD
+    segment_store *s;
+} pySegments;
+
+static void segments_vertex(const double pt[9], void *arg) {
+    segment_store *s = (segment_store *)arg;
+    double p[3];
+    vertex9(pt, p, s->geometry.c_str());
+    s->v.push_back(p[0]);
+    s->v.push_back(p[1]);
+    s->v.push_back(p[2]);
+}
+
+static int Segments_init(pySegments *self, PyObject *a, PyObject *k) {
+    char *geometry;
+    if(!PyArg_ParseTuple(a, "s:segments", &geometry))
+        return -1;
+    delete self->s;
+    self->s = new segment_store;
+    self->s->geometry = geometry;
+    self->s->nsegs = 0;
+    return 0;
+}
+
+static void Segments_dealloc(pySegments *self) {
+    delete self->s;
+    PyObject_Del(self);
+}
+
+static Py_ssize_t Segments_len(pySegments *self) {
+    return self->s ? self->s->nsegs : 0;
+}
+
+static PyObject *Segments_extend(pySegments *self, PyObject *o) {
+    PyListObject *li;
+    int start = 0;
+    segment_store *s = self->s;
+
+    if(!PyArg_ParseTuple(o, "O!|i:segments.extend", &PyList_Type, &li, &start))
+        return NULL;
+    if(!s) {
+        PyErr_SetString(PyExc_RuntimeError, "segments not initialized");
+        return NULL;
+    }
+
+    for(int i=start; i<PyList_GET_SIZE(li); i++) {
+        PyObject *it = PyList_GET_ITEM(li, i);
+        PyObject *dummy1, *dummy2, *dummy3;
+        double p1[9], p2[9];
+        int n;
+        if(!PyArg_ParseTuple(it, "i(ddddddddd)(ddddddddd)|OOO", &n,
+                    p1+0, p1+1, p1+2,
+                    p1+3, p1+4, p1+5,
+                    p1+6, p1+7, p1+8,
+                    p2+0, p2+1, p2+2,
+                    p2+3, p2+4, p2+5,
+                    p2+6, p2+7, p2+8,
+                    &dummy1, &dummy2, &dummy3))
+            return NULL;
+
+        bool newstrip = !s->nsegs || memcmp(p1, s->last, sizeof(p1));
+        if(newstrip) {
+            segment_range r = { (unsigned)(s->v.size() / 3), 1 };
+            s->strips.push_back(r);
+            segments_vertex(p1, s);
+        }
+        // a run starts at the first vertex of its first segment, which
+        // it shares with the previous run of the same strip
+        if(newstrip || s->runs.back().lineno != n) {
+            segment_run r = { n, (unsigned)(s->v.size() / 3 - 1), 1,
+                              {0, 0, 0}, 0 };
+            s->by_line.insert(std::make_pair(n, (unsigned)s->runs.size()));
+            s->runs.push_back(r);
+        }
+
+        unsigned nv = s->v.size() / 3;
+        line9_points(p1, p2, segments_vertex, s);
+        nv = s->v.size() / 3 - nv;
+
+        segment_run &r = s->runs.back();
+        s->strips.back().count += nv;
+        r.count += nv;
+        for(int j=0; j<3; j++) r.sum[j] += p1[j] + p2[j];
+        r.npts += 2;
+
+        memcpy(s->last, p2, sizeof(p2));
+        s->nsegs++;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Segments_draw(pySegments *self, PyObject *o) {
+    int for_selection = 0;
+    segment_store *s = self->s;
+
+    if(!PyArg_ParseTuple(o, "|i:segments.draw", &for_selection))
+        return NULL;
+    if(!s || s->v.empty())
+        Py_RETURN_NONE;
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &s->v[0]);
+    if(for_selection) {
+        int nl = -1;
+        for(size_t i=0; i<s->runs.size(); i++) {
+            const segment_run &r = s->runs[i];
+            if(r.lineno != nl) {
+                glLoadName(r.lineno);
+                nl = r.lineno;
+            }
+            glDrawArrays(GL_LINE_STRIP, r.first, r.count);
+        }
+    } else {
+        for(size_t i=0; i<s->strips.size(); i++)
+            glDrawArrays(GL_LINE_STRIP, s->strips[i].first, s->strips[i].count);
+    }
+    glPopClientAttrib();
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Segments_highlight(pySegments *self, PyObject *o) {
+    int lineno, draw = 1;
+    double sum[3] = {0, 0, 0};
+    int npts = 0;
+    segment_store *s = self->s;
+
+    if(!PyArg_ParseTuple(o, "i|i:segments.highlight", &lineno, &draw))
+        return NULL;
+
+    if(s && !s->v.empty()) {
+        typedef std::multimap<int, unsigned>::const_iterator iter;
+        std::pair<iter, iter> range = s->by_line.equal_range(lineno);
+        if(draw && range.first != range.second) {
+            glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, 0, &s->v[0]);
+        }
+        for(iter i = range.first; i != range.second; ++i) {
+            const segment_run &r = s->runs[i->second];
+            if(draw) glDrawArrays(GL_LINE_STRIP, r.first, r.count);
+            for(int j=0; j<3; j++) sum[j] += r.sum[j];
+            npts += r.npts;
+        }
+        if(draw && range.first != range.second)
+            glPopClientAttrib();
+    }
+
+    return Py_BuildValue("dddi", sum[0], sum[1], sum[2], npts);
+}
+
+static PyObject *Segments_extents(pySegments *self, PyObject *o) {
+    segment_store *s = self->s;
+    if(!s || s->v.empty())
+        Py_RETURN_NONE;
+
+    float lo[3], hi[3];
+    for(int j=0; j<3; j++) lo[j] = hi[j] = s->v[j];
+    for(size_t i=3; i<s->v.size(); i+=3) {
+        for(int j=0; j<3; j++) {
+            float f = s->v[i+j];
+            if(f < lo[j]) lo[j] = f;
+            if(f > hi[j]) hi[j] = f;
+        }
+    }
+    return Py_BuildValue("(ddd)(ddd)", lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+}
+
+static PyObject *Segments_stats(pySegments *self, PyObject *o) {
+    segment_store *s = self->s;
+    if(!s)
+        return Py_BuildValue("iiii", 0, 0, 0, 0);
+    return Py_BuildValue("iiii", s->nsegs, (int)(s->v.size() / 3),
+            (int)s->strips.size(), (int)s->runs.size());
+}
+
+static PySequenceMethods Segments_as_sequence = {
+    (lenfunc)Segments_len,  /*sq_length*/
+};
+
+static PyMethodDef Segments_methods[] = {
+    {"extend", (PyCFunction)Segments_extend, METH_VARARGS,
+        "Add the segments of a list in the 'rs274.glcanon' format, from index ARG on"},
+    {"draw", (PyCFunction)Segments_draw, METH_VARARGS,
+        "Draw the segments; with ARG set, name each line number for selection"},
+    {"highlight", (PyCFunction)Segments_highlight, METH_VARARGS,
+        "Draw the segments of line number ARG.  Returns the sums of their "
+        "x, y and z end points and the count of end points"},
+    {"extents", (PyCFunction)Segments_extents, METH_NOARGS,
+        "Return the minimum and maximum vertex or None"},
+    {"stats", (PyCFunction)Segments_stats, METH_NOARGS,
+        "Return the number of segments, vertices, strips and line number runs"},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyTypeObject SegmentsType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "linuxcnc.segments",    /*tp_name*/
+    sizeof(pySegments),     /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)Segments_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    &Segments_as_sequence,  /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    0,                      /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    0,                      /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    Segments_methods,       /*tp_methods*/
+    0,                      /*tp_members*/
+    0,                      /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    (initproc)Segments_init, /*tp_init*/
+    0,                      /*tp_alloc*/
+    PyType_GenericNew,      /*tp_new*/
+    0,                      /*tp_free*/
+    0,                      /*tp_is_gc*/
+};
+
 struct color {
     unsigned char r, g, b, a;
     bool operator==(const color &o) const {
@@ -1845,6 +2246,8 @@ typedef struct {
     int is_xyuv;
     double foam_z, foam_w;
     pyStatChannel *st;
+    int trace;          // read the motion position trace if there is one
+    bool traced;        // reading the motion position trace
 } pyPositionLogger;
 
 static const double epsilon = 1e-4; // 1-cos(1 deg) ~= 1e-4
@@ -1878,7 +2281,9 @@ static int Logger_init(pyPositionLogger *self, PyObject *a, PyObject *k) {
     self->is_xyuv = 0;
     self->foam_z = 0;
     self->foam_w = 1.5;  // temporarily hard-code
-    if(!PyArg_ParseTuple(a, "O!(BBBB)(BBBB)(BBBB)(BBBB)(BBBB)(BBBB)s|i",
+    self->trace = 0;
+    self->traced = 0;
+    if(!PyArg_ParseTuple(a, "O!(BBBB)(BBBB)(BBBB)(BBBB)(BBBB)(BBBB)s|ii",
             &Stat_Type, &self->st,
             &c[0].r,&c[0].g, &c[0].b, &c[0].a,
             &c[1].r,&c[1].g, &c[1].b, &c[1].a,
@@ -1886,7 +2291,7 @@ static int Logger_init(pyPositionLogger *self, PyObject *a, PyObject *k) {
             &c[3].r,&c[3].g, &c[3].b, &c[3].a,
             &c[4].r,&c[4].g, &c[4].b, &c[4].a,
             &c[5].r,&c[5].g, &c[5].b, &c[5].a,
-            &geometry, &self->is_xyuv
+            &geometry, &self->is_xyuv, &self->trace
             ))
         return -1;
     Py_INCREF(self->st);
@@ -1916,9 +2321,150 @@ static double dist2(double x1, double y1, double x2, double y2) {
     return dx*dx + dy*dy;
 }
 
+// add a tool position, with tool offsets removed, to the plot
+static void Logger_add(pyPositionLogger *s, const double pt[9], int colornum) {
+    if(colornum < 0 || colornum > NUMCOLORS) colornum = 0;
+    struct color c = s->colors[colornum];
+    struct logger_point *op = &s->p[s->npts-1];
+    struct logger_point *oop = &s->p[s->npts-2];
+    bool add_point = s->npts < 2 || c != op->c;
+    double x, y, z, rx, ry, rz;
+    if(s->is_xyuv) {
+        x = pt[0];
+        y = pt[1];
+        z = s->foam_z;
+        rx = pt[6];
+        ry = pt[7];
+        rz = s->foam_w;
+        /* TODO .01, the distance at which a preview line is dropped,
+         * should either be dependent on units or configurable, because
+         * 0.1 is inappropriate for mm systems
+         */
+        add_point = add_point || (dist2(x, y, oop->x, oop->y) > .01)
+            || (dist2(rx, ry, oop->rx, oop->ry) > .01);
+        add_point = add_point || !colinear( x, y, z,
+                        op->x, op->y, op->z,
+                        oop->x, oop->y, oop->z);
+        add_point = add_point || !colinear( rx, ry, rz,
+                        op->rx, op->ry, op->rz,
+                        oop->rx, oop->ry, oop->rz);
+    } else {
+        double p[3];
+        vertex9(pt, p, s->geometry);
+        x = p[0]; y = p[1]; z = p[2];
+        rx = pt[3]; ry = -pt[4]; rz = pt[5];
+
+        add_point = add_point || !colinear( x, y, z,
+                        op->x, op->y, op->z,
+                        oop->x, oop->y, oop->z);
+    }
+    if(add_point) {
+        // 1 or 2 points may be added, make room whenever
+        // fewer than 2 are left
+        bool changed_color = s->npts && c != op->c;
+        if(s->npts+2 > s->mpts) {
+            LOCK();
+            if(s->mpts >= MAX_POINTS) {
+                int adjust = MAX_POINTS / 10;
+                if(adjust < 2) adjust = 2;
+                s->npts -= adjust;
+                memmove(s->p, s->p + adjust, 
+                        sizeof(struct logger_point) * s->npts);
+            } else {
+                s->mpts = 2 * s->mpts + 2;
+                s->changed = 1;
+                s->p = (struct logger_point*) realloc(s->p,
+                            sizeof(struct logger_point) * s->mpts);
+            }
+            UNLOCK();
+            op = &s->p[s->npts-1];
+            oop = &s->p[s->npts-2];
+        }
+        if(changed_color) {
+            {
+            struct logger_point &np = s->p[s->npts];
+            np.x = op->x; np.y = op->y; np.z = op->z;
+            np.rx = rx; np.ry = ry; np.rz = rz;
+            np.c = np.c2 = c;
+            }
+            {
+            struct logger_point &np = s->p[s->npts+1];
+            np.x = x; np.y = y; np.z = z;
+            np.rx = rx; np.ry = ry; np.rz = rz;
+            np.c = np.c2 = c;
+            }
+            s->npts += 2;
+        } else {
+            struct logger_point &np = s->p[s->npts];
+            np.x = x; np.y = y; np.z = z;
+            np.rx = rx; np.ry = ry; np.rz = rz;
+            np.c = np.c2 = c;
+            s->npts++;
+        }
+    } else {
+        struct logger_point &np = s->p[s->npts-1];
+        np.x = x; np.y = y; np.z = z;
+        np.rx = rx; np.ry = ry; np.rz = rz;
+    }
+}
+
+// the position trace of motion, see postrace.h. Asked to, the logger
+// reads ring 0 if motion has it (motmod trace_rings=1 or more), every
+// traced position then goes into the plot rather than those seen by
+// polling the status at the logger interval.
+static int trace_comp_id = -1;
+static int trace_comp_users;
+
+static void ring_comp_exit(void) {
+    if(trace_comp_id >= 0) {
+        hal_exit(trace_comp_id);
+        trace_comp_id = -1;
+    }
+}
+
+// a HAL component to attach rings with, one per process while any ring
+// is attached; ring_comp_put() after each hal_ring_detach(). Called
+// with the interpreter lock held.
+static int ring_comp_get(void) {
+    static bool registered;
+    if(trace_comp_id < 0) {
+        char name[HAL_NAME_LEN + 1];
+        snprintf(name, sizeof(name), "positionlogger%d", getpid());
+        int saved_level = rtapi_get_msg_level();
+        rtapi_set_msg_level(RTAPI_MSG_NONE);
+        trace_comp_id = hal_init(name);
+        rtapi_set_msg_level(saved_level);
+        if(trace_comp_id < 0) return -1;
+        hal_ready(trace_comp_id);
+        // objects still alive at interpreter exit aren't deallocated
+        if(!registered) registered = atexit(ring_comp_exit) == 0;
+    }
+    trace_comp_users++;
+    return 0;
+}
+
+static void ring_comp_put(void) {
+    if(--trace_comp_users == 0)
+        ring_comp_exit();
+}
+
+static int trace_attach(ringbuffer_t *rb) {
+    if(ring_comp_get() < 0) return -1;
+    if(hal_ring_attachf(rb, NULL, POSTRACE_RING, 0) < 0) {
+        ring_comp_put();
+        return -1;
+    }
+    // start from the present: drop what piled up, and ask for a key
+    record_flush(rb);
+    ((postrace_shared_t *)rb->scratchpad)->want_key = 1;
+    return 0;
+}
+
 static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
     double interval;
     struct timespec ts;
+    ringbuffer_t rb;
+    postrace_reader_t trace;
 
     if(!PyArg_ParseTuple(o, "d:logger.start", &interval)) return NULL;
     ts.tv_sec = (int)interval;
@@ -1930,6 +2476,8 @@ static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
     s->clear = 0;
     s->npts = 0;
 
+    memset(&trace, 0, sizeof(trace));
+    s->traced = s->trace && trace_attach(&rb) == 0;
     Py_BEGIN_ALLOW_THREADS
     while(!s->exit) {
         if(s->clear) {
@@ -1937,108 +2485,40 @@ static PyObject *Logger_start(pyPositionLogger *s, PyObject *o) {
             s->lpts = 0;
             s->clear = 0;
         }
-        if(s->st->c->valid() && s->st->c->peek() == EMC_STAT_TYPE) {
-            EMC_STAT *status = static_cast<EMC_STAT*>(s->st->c->get_address());
-            int colornum = 2;
-            colornum = status->motion.traj.motion_type;
-            if(colornum < 0 || colornum > NUMCOLORS) colornum = 0;
-            struct color c = s->colors[colornum];
-            struct logger_point *op = &s->p[s->npts-1];
-            struct logger_point *oop = &s->p[s->npts-2];
-            bool add_point = s->npts < 2 || c != op->c;
-            double x, y, z, rx, ry, rz;
-            if(s->is_xyuv) {
-                x = status->motion.traj.position.tran.x - status->task.toolOffset.tran.x,
-                y = status->motion.traj.position.tran.y - status->task.toolOffset.tran.y,
-                z = s->foam_z;
-                rx = status->motion.traj.position.u - status->task.toolOffset.u,
-                ry = status->motion.traj.position.v - status->task.toolOffset.v,
-                rz = s->foam_w;
-                /* TODO .01, the distance at which a preview line is dropped,
-                 * should either be dependent on units or configurable, because
-                 * 0.1 is inappropriate for mm systems
-                 */
-                add_point = add_point || (dist2(x, y, oop->x, oop->y) > .01)
-                    || (dist2(rx, ry, oop->rx, oop->ry) > .01);
-                add_point = add_point || !colinear( x, y, z,
-                                op->x, op->y, op->z,
-                                oop->x, oop->y, oop->z);
-                add_point = add_point || !colinear( rx, ry, rz,
-                                op->rx, op->ry, op->rz,
-                                oop->rx, oop->ry, oop->rz);
-            } else {
-                double pt[9] = {
-                    status->motion.traj.position.tran.x - status->task.toolOffset.tran.x,
-                    status->motion.traj.position.tran.y - status->task.toolOffset.tran.y,
-                    status->motion.traj.position.tran.z - status->task.toolOffset.tran.z,
-                    status->motion.traj.position.a - status->task.toolOffset.a,
-                    status->motion.traj.position.b - status->task.toolOffset.b,
-                    status->motion.traj.position.c - status->task.toolOffset.c,
-                    status->motion.traj.position.u - status->task.toolOffset.u,
-                    status->motion.traj.position.v - status->task.toolOffset.v,
-                    status->motion.traj.position.w - status->task.toolOffset.w};
-
-                double p[3];
-                vertex9(pt, p, s->geometry);
-                x = p[0]; y = p[1]; z = p[2];
-                rx = pt[3]; ry = -pt[4]; rz = pt[5];
-
-                add_point = add_point || !colinear( x, y, z,
-                                op->x, op->y, op->z,
-                                oop->x, oop->y, oop->z);
-            }
-            if(add_point) {
-                // 1 or 2 points may be added, make room whenever
-                // fewer than 2 are left
-                bool changed_color = s->npts && c != op->c;
-                if(s->npts+2 > s->mpts) {
-                    LOCK();
-                    if(s->mpts >= MAX_POINTS) {
-                        int adjust = MAX_POINTS / 10;
-                        if(adjust < 2) adjust = 2;
-                        s->npts -= adjust;
-                        memmove(s->p, s->p + adjust, 
-                                sizeof(struct logger_point) * s->npts);
-                    } else {
-                        s->mpts = 2 * s->mpts + 2;
-                        s->changed = 1;
-                        s->p = (struct logger_point*) realloc(s->p,
-                                    sizeof(struct logger_point) * s->mpts);
-                    }
-                    UNLOCK();
-                    op = &s->p[s->npts-1];
-                    oop = &s->p[s->npts-2];
+        if(s->traced) {
+            const void *data;
+            ringsize_t size;
+            while(record_read(&rb, &data, &size) == 0) {
+                if(postrace_decode(&trace, data, size) == 1) {
+                    double pt[9];
+                    for(int i=0; i<9; i++)
+                        pt[i] = trace.cmd[i] - trace.tool_offset[i];
+                    Logger_add(s, pt, trace.motion_type);
                 }
-                if(changed_color) {
-                    {
-                    struct logger_point &np = s->p[s->npts];
-                    np.x = op->x; np.y = op->y; np.z = op->z;
-                    np.rx = rx; np.ry = ry; np.rz = rz;
-                    np.c = np.c2 = c;
-                    }
-                    {
-                    struct logger_point &np = s->p[s->npts+1];
-                    np.x = x; np.y = y; np.z = z;
-                    np.rx = rx; np.ry = ry; np.rz = rz;
-                    np.c = np.c2 = c;
-                    }
-                    s->npts += 2;
-                } else {
-                    struct logger_point &np = s->p[s->npts];
-                    np.x = x; np.y = y; np.z = z;
-                    np.rx = rx; np.ry = ry; np.rz = rz;
-                    np.c = np.c2 = c;
-                    s->npts++;
-                }
-            } else {
-                struct logger_point &np = s->p[s->npts-1];
-                np.x = x; np.y = y; np.z = z;
-                np.rx = rx; np.ry = ry; np.rz = rz;
+                record_shift(&rb);
             }
+        } else if(s->st->c->valid() && s->st->c->peek() == EMC_STAT_TYPE) {
+            EMC_STAT *status = static_cast<EMC_STAT*>(s->st->c->get_address());
+            double pt[9] = {
+                status->motion.traj.position.tran.x - status->task.toolOffset.tran.x,
+                status->motion.traj.position.tran.y - status->task.toolOffset.tran.y,
+                status->motion.traj.position.tran.z - status->task.toolOffset.tran.z,
+                status->motion.traj.position.a - status->task.toolOffset.a,
+                status->motion.traj.position.b - status->task.toolOffset.b,
+                status->motion.traj.position.c - status->task.toolOffset.c,
+                status->motion.traj.position.u - status->task.toolOffset.u,
+                status->motion.traj.position.v - status->task.toolOffset.v,
+                status->motion.traj.position.w - status->task.toolOffset.w};
+            Logger_add(s, pt, status->motion.traj.motion_type);
         }
         nanosleep(&ts, NULL);
     }
     Py_END_ALLOW_THREADS
+    if(s->traced) {
+        hal_ring_detach(&rb);
+        ring_comp_put();
+        s->traced = 0;
+    }
     Py_DECREF(s->st);
     Py_INCREF(Py_None);
     return Py_None;
@@ -2115,6 +2595,7 @@ static PyObject *Logger_last(pyPositionLogger *s, PyObject *o) {
 
 static PyMemberDef Logger_members[] = {
     {(char*)"npts", T_INT, offsetof(pyPositionLogger, npts), READONLY},
+    {(char*)"traced", T_BOOL, offsetof(pyPositionLogger, traced), READONLY},
     {0, 0, 0, 0},
 };
 
@@ -2179,6 +2660,152 @@ static PyTypeObject PositionLoggerType = {
     0,                      /*tp_is_gc*/
 };
 
+// the joint history of motion, see jointhist.h. poll() reads what
+// motion wrote since the last call and returns the statistics of the
+// moves that finished in it.
+struct pyJointHistory {
+    PyObject_HEAD
+    ringbuffer_t rb;
+    bool attached;
+    jointhist_stats_t stats;
+};
+
+static int JointHistory_init(pyJointHistory *self, PyObject *a, PyObject *k) {
+    static char *kw[] = {(char*)"settle_band", (char*)"settle_timeout", NULL};
+    double band = 0.001, timeout = 1.0;
+    if(!PyArg_ParseTupleAndKeywords(a, k, "|dd:jointhistory", kw,
+            &band, &timeout))
+        return -1;
+    if(self->attached) {
+        hal_ring_detach(&self->rb);
+        ring_comp_put();
+        self->attached = false;
+    }
+    if(ring_comp_get() < 0) {
+        PyErr_Format(error, "can't create a HAL component to attach '%s'",
+                JOINTHIST_RING);
+        return -1;
+    }
+    if(hal_ring_attachf(&self->rb, NULL, JOINTHIST_RING) < 0) {
+        ring_comp_put();
+        PyErr_Format(error, "can't attach ring '%s', motmod needs history_size",
+                JOINTHIST_RING);
+        return -1;
+    }
+    self->attached = true;
+    record_flush(&self->rb);
+    jointhist_stats_init(&self->stats,
+            ((jointhist_shared_t *)self->rb.scratchpad)->period,
+            band, timeout);
+    return 0;
+}
+
+static void JointHistory_dealloc(pyJointHistory *self) {
+    if(self->attached) {
+        hal_ring_detach(&self->rb);
+        ring_comp_put();
+    }
+    PyObject_Del(self);
+}
+
+static PyObject *move_dict(const jointhist_move_t *mv, double period,
+        int decimate) {
+    PyObject *joints = PyTuple_New(mv->joints);
+    for(int j = 0; j < mv->joints; j++)
+        PyTuple_SET_ITEM(joints, j, Py_BuildValue("{s:d,s:d,s:d,s:d}",
+            "rms_ferror", mv->rms_ferror[j],
+            "peak_ferror", mv->peak_ferror[j],
+            "peak_time", (mv->peak_cycle[j] - mv->start_cycle) * period,
+            "settle_time", mv->settle_time[j]));
+    return Py_BuildValue("{s:i,s:d,s:N}",
+        "line", mv->line,
+        "duration", mv->samples * decimate * period,
+        "joints", joints);
+}
+
+static PyObject *JointHistory_poll(pyJointHistory *self, PyObject *o) {
+    jointhist_shared_t *sp = (jointhist_shared_t *)self->rb.scratchpad;
+    PyObject *moves = PyList_New(0);
+    jointhist_move_t mv;
+    const void *data;
+    ringsize_t size;
+
+    if(!self->attached) return moves;
+    // motion writes the period of its thread with the first record
+    self->stats.period = sp->period;
+    while(record_read(&self->rb, &data, &size) == 0) {
+        if(jointhist_stats_update(&self->stats, data, size, &mv) == 1) {
+            PyObject *d = move_dict(&mv, sp->period, sp->decimate);
+            PyList_Append(moves, d);
+            Py_DECREF(d);
+        }
+        record_shift(&self->rb);
+    }
+    return moves;
+}
+
+static PyObject *JointHistory_dropped(pyJointHistory *self, void *closure) {
+    if(!self->attached) return PyInt_FromLong(0);
+    return PyInt_FromLong(((jointhist_shared_t *)self->rb.scratchpad)->dropped);
+}
+
+static PyMethodDef JointHistory_methods[] = {
+    {"poll", (PyCFunction)JointHistory_poll, METH_NOARGS,
+        "Return the statistics of the moves finished since the last poll"},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef JointHistory_getset[] = {
+    {(char*)"dropped", (getter)JointHistory_dropped, NULL,
+        (char*)"Samples motion could not write to the full ring"},
+    {NULL}
+};
+
+static PyTypeObject JointHistoryType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "linuxcnc.jointhistory",     /*tp_name*/
+    sizeof(pyJointHistory), /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)JointHistory_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    0,                      /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    0,                      /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    0,                      /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    JointHistory_methods,   /*tp_methods*/
+    0,                      /*tp_members*/
+    JointHistory_getset,    /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    (initproc)JointHistory_init, /*tp_init*/
+    0,                      /*tp_alloc*/
+    PyType_GenericNew,      /*tp_new*/
+    0,                      /*tp_free*/
+    0,                      /*tp_is_gc*/
+};
+
 static PyMethodDef emc_methods[] = {
 #define METH(name, doc) { #name, (PyCFunction) py##name, METH_VARARGS, doc }
 METH(draw_lines, "Draw a bunch of lines in the 'rs274.glcanon' format"),
@@ -2219,6 +2846,10 @@ initlinuxcnc(void) {
 
     PyType_Ready(&PositionLoggerType);
     PyModule_AddObject(m, "positionlogger", (PyObject*)&PositionLoggerType);
+    PyType_Ready(&JointHistoryType);
+    PyModule_AddObject(m, "jointhistory", (PyObject*)&JointHistoryType);
+    PyType_Ready(&SegmentsType);
+    PyModule_AddObject(m, "segments", (PyObject*)&SegmentsType);
     pthread_mutex_init(&mutex, NULL);
 
     PyModule_AddStringConstant(m, "PREFIX", EMC2_HOME);
@@ -2239,6 +2870,16 @@ initlinuxcnc(void) {
     ENUMX(4, EMC_AXIS_LINEAR);
     ENUMX(4, EMC_AXIS_ANGULAR);
 
+    ENUMX(4, EMC_STAT_SECT_HEADER);
+    ENUMX(4, EMC_STAT_SECT_TASK);
+    ENUMX(4, EMC_STAT_SECT_TRAJ);
+    ENUMX(4, EMC_STAT_SECT_AXIS);
+    ENUMX(4, EMC_STAT_SECT_SPINDLE);
+    ENUMX(4, EMC_STAT_SECT_MOTION);
+    ENUMX(4, EMC_STAT_SECT_IO);
+    ENUMX(4, EMC_STAT_SECT_HEARTBEAT);
+    ENUMX(4, EMC_STAT_SECT_ALL);
+
     ENUMX(9, EMC_TASK_INTERP_IDLE);
     ENUMX(9, EMC_TASK_INTERP_READING);
     ENUMX(9, EMC_TASK_INTERP_PAUSED);
@@ -705,7 +705,7 @@ class LivePlotter:
             C('backplotarc'),
             C('backplottoolchange'),
             C('backplotprobing'),
-            geometry, foam
+            geometry, foam, position_trace
         )
         o.after_idle(lambda: thread.start_new_thread(self.logger.start, (.01,)))
 
@@ -3050,6 +3050,7 @@ vars.display_type.set(inifile.find("DISPLAY", "POSITION_FEEDBACK") == "COMMANDED
 coordinate_display = inifile.find("DISPLAY", "POSITION_UNITS")
 lathe = bool(inifile.find("DISPLAY", "LATHE"))
 foam = bool(inifile.find("DISPLAY", "FOAM"))
+position_trace = int(inifile.find("DISPLAY", "POSITION_TRACE") or 0)
 editor = inifile.find("DISPLAY", "EDITOR")
 vars.has_editor.set(editor is not None)
 tooleditor = inifile.find("DISPLAY", "TOOL_EDITOR") or "tooledit"
@@ -34,6 +34,7 @@
 #include "rcs_print.hh"
 #include "nml_oi.hh"
 #include "timer.hh"
+#include "emcstatnotify.hh"
 
 /*
   Using halui:
@@ -402,6 +403,7 @@ static int halui_sent_mdi = 0;
 // the NML channels to the EMC task
 static RCS_CMD_CHANNEL *emcCommandBuffer = 0;
 static RCS_STAT_CHANNEL *emcStatusBuffer = 0;
+static EmcStatNotify emcStatNotify;
 EMC_STAT *emcStatus = 0;
 
 // the NML channel for errors
@@ -448,6 +450,7 @@ static int emcTaskNmlGet()
 	    retval = -1;
 	} else {
 	    emcStatus = (EMC_STAT *) emcStatusBuffer->get_address();
+	    emcStatNotify.attach(emc_nmlfile, "emcStatus", false);
 	}
     }
 
@@ -537,6 +540,11 @@ static int updateStatus()
 	return -1;
     }
 
+    // nothing changed since the last peek, emcStatus is current
+    if (emcStatNotify.valid() && !emcStatNotify.changed()) {
+	return 0;
+    }
+
     switch (type = emcStatusBuffer->peek()) {
     case -1:
 	// error on CMS channel
@@ -556,7 +564,7 @@ static int updateStatus()
 }
 
 
-#define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
+#define EMC_COMMAND_DELAY   0.1	// longest sleep between checks
 
 /*
   emcCommandWaitReceived() waits until the EMC reports that it got
@@ -567,17 +575,19 @@ static int updateStatus()
 
 static int emcCommandWaitReceived(int serial_number)
 {
-    double end = 0.0;
+    double start = etime();
 
-    while (end < receiveTimeout) {
+    // wake task if it is waiting for commands
+    emcStatNotify.kick();
+
+    while (etime() - start < receiveTimeout) {
 	updateStatus();
 
 	if (emcStatus->echo_serial_number == serial_number) {
 	    return 0;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	emcStatWaitChange(&emcStatNotify, EMC_COMMAND_DELAY);
     }
 
     return -1;
@@ -585,14 +595,15 @@ static int emcCommandWaitReceived(int serial_number)
 
 static int emcCommandWaitDone(int serial_number)
 {
-    double end = 0.0;
+    double start;
 
     // first get it there
     if (0 != emcCommandWaitReceived(serial_number)) {
 	return -1;
     }
     // now wait until it, or subsequent command (e.g., abort) is done
-    while (end < doneTimeout) {
+    start = etime();
+    while (etime() - start < doneTimeout) {
 	updateStatus();
 
 	if (emcStatus->status == RCS_DONE) {
@@ -603,8 +614,7 @@ static int emcCommandWaitDone(int serial_number)
 	    return -1;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	emcStatWaitChange(&emcStatNotify, EMC_COMMAND_DELAY);
     }
     return -1;
 }
@@ -2251,7 +2261,7 @@ int main(int argc, char *argv[])
 	
 	esleep(0.02); //sleep for a while
 	
-	updateStatus();
+	updateStatus(); //only peeks if the task published a change
     }
     thisQuit();
     return 0;
@@ -35,6 +35,7 @@
 #include "rcs_print.hh"
 #include "timer.hh"             // esleep
 #include "shcom.hh"             // Common NML communications functions
+#include "emcstatnotify.hh"     // EmcStatNotify
 
 LINEAR_UNIT_CONVERSION linearUnitConversion;
 ANGULAR_UNIT_CONVERSION angularUnitConversion;
@@ -46,6 +47,8 @@ int saveEmcCommandSerialNumber;
 RCS_CMD_CHANNEL *emcCommandBuffer;
 RCS_STAT_CHANNEL *emcStatusBuffer;
 EMC_STAT *emcStatus;
+// status change notification, valid if the task runs on this host
+EmcStatNotify emcStatNotify;
 
 // the NML channel for errors
 NML *emcErrorBuffer;
@@ -97,6 +100,7 @@ int emcTaskNmlGet()
 	    retval = -1;
 	} else {
 	    emcStatus = (EMC_STAT *) emcStatusBuffer->get_address();
+	    emcStatNotify.attach(emc_nmlfile, "emcStatus", false);
 	}
     }
 
@@ -181,6 +185,11 @@ int updateStatus()
 	return -1;
     }
 
+    // nothing changed since the last peek, emcStatus is current
+    if (emcStatNotify.valid() && !emcStatNotify.changed()) {
+	return 0;
+    }
+
     switch (type = emcStatusBuffer->peek()) {
     case -1:
 	// error on CMS channel
@@ -275,7 +284,7 @@ int updateError()
     return 0;
 }
 
-#define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
+#define EMC_COMMAND_DELAY   0.1	// longest sleep between checks
 
 /*
   emcCommandWaitReceived() waits until the EMC reports that it got
@@ -286,17 +295,19 @@ int updateError()
 
 int emcCommandWaitReceived(int serial_number)
 {
-    double end = 0.0;
+    double start = etime();
+
+    // wake task if it is waiting for commands
+    emcStatNotify.kick();
 
-    while (emcTimeout <= 0.0 || end < emcTimeout) {
+    while (emcTimeout <= 0.0 || etime() - start < emcTimeout) {
 	updateStatus();
 
 	if (emcStatus->echo_serial_number == serial_number) {
 	    return 0;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	emcStatWaitChange(&emcStatNotify, EMC_COMMAND_DELAY);
     }
 
     return -1;
@@ -304,14 +315,15 @@ int emcCommandWaitReceived(int serial_number)
 
 int emcCommandWaitDone(int serial_number)
 {
-    double end = 0.0;
+    double start;
 
     // first get it there
     if (0 != emcCommandWaitReceived(serial_number)) {
 	return -1;
     }
     // now wait until it, or subsequent command (e.g., abort) is done
-    while (emcTimeout <= 0.0 || end < emcTimeout) {
+    start = etime();
+    while (emcTimeout <= 0.0 || etime() - start < emcTimeout) {
 	updateStatus();
 
 	if (emcStatus->status == RCS_DONE) {
@@ -322,8 +334,7 @@ int emcCommandWaitDone(int serial_number)
 	    return -1;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
+	emcStatWaitChange(&emcStatNotify, EMC_COMMAND_DELAY);
     }
 
     return -1;
@@ -54,6 +54,7 @@ extern int saveEmcCommandSerialNumber;
 // the NML channels to the EMC task
 extern RCS_CMD_CHANNEL *emcCommandBuffer;
 extern RCS_STAT_CHANNEL *emcStatusBuffer;
+extern class EmcStatNotify emcStatNotify;
 // EMC_STAT *emcStatus;
 
 // the NML channel for errors
@@ -40,12 +40,16 @@
 #include "vars_names.h"
 #endif
 #include "arithm_eval.h"
+#include "rtapi_mbarrier.h"
 
 
 char * Expr;
 char * ErrorDesc;
 char * VerifyErrorDesc;
 int UnderVerify;
+/* when not NULL, the parser adds ops to it instead of evaluating */
+StrArithmCode * CodeUnderCompile = NULL;
+int CompileError;
 
 /* for RTLinux module */
 #if defined( MODULE )
@@ -68,12 +72,114 @@ int pow_int(int a,int b)
 
 void SyntaxError(void)
 {
+	if (CodeUnderCompile)
+		CompileError = TRUE;
 	if (UnderVerify)
 		VerifyErrorDesc = ErrorDesc;
 	else
 		debug_printf("Syntax error : '%s' , at %s !!!!!\n",ErrorDesc,Expr);
 }
 
+/* add an op at the end of the code under compile */
+StrArithmOp * EmitOp(int OpCode)
+{
+	StrArithmOp * pOp;
+	if ( CodeUnderCompile->NbrOps>=ARITHM_CODE_SIZE )
+	{
+		/* will stay evaluated from the text */
+		ErrorDesc = "Expression too long to be compiled";
+		SyntaxError();
+		return NULL;
+	}
+	pOp = &CodeUnderCompile->Op[ CodeUnderCompile->NbrOps++ ];
+	pOp->OpCode = OpCode;
+	pOp->Param = 0;
+	pOp->VarType = -1;
+	pOp->Value = 0;
+	pOp->IndexVarType = -1;
+	pOp->IndexVarOffset = -1;
+	return pOp;
+}
+
+/* add a var access op, variables not indexed directly stored in the */
+/* bits/words/floats arrays are resolved here to their final position */
+void EmitVar(int OpCode,int VarType,int VarOffset,int IndexVarType,int IndexVarOffset)
+{
+	StrArithmOp * pOp;
+	int Value = VarOffset;
+	if ( OpCode==ARITHM_OP_VAR && (IndexVarType==-1 || IndexVarOffset==-1) )
+	{
+		switch( VarType )
+		{
+			case VAR_MEM_BIT:
+				OpCode = ARITHM_OP_BIT;
+				break;
+			case VAR_PHYS_INPUT:
+				OpCode = ARITHM_OP_BIT;
+				Value = NBR_BITS+VarOffset;
+				break;
+			case VAR_PHYS_OUTPUT:
+				OpCode = ARITHM_OP_BIT;
+				Value = NBR_BITS+NBR_PHYS_INPUTS+VarOffset;
+				break;
+			case VAR_MEM_WORD:
+				OpCode = ARITHM_OP_WORD;
+				break;
+			case VAR_PHYS_WORD_INPUT:
+				OpCode = ARITHM_OP_WORD;
+				Value = NBR_WORDS+VarOffset;
+				break;
+			case VAR_PHYS_WORD_OUTPUT:
+				OpCode = ARITHM_OP_WORD;
+				Value = NBR_WORDS+NBR_PHYS_WORDS_INPUTS+VarOffset;
+				break;
+			case VAR_PHYS_FLOAT_INPUT:
+				OpCode = ARITHM_OP_FLOAT;
+				break;
+			case VAR_PHYS_FLOAT_OUTPUT:
+				OpCode = ARITHM_OP_FLOAT;
+				Value = NBR_PHYS_FLOAT_INPUTS+VarOffset;
+				break;
+		}
+	}
+	pOp = EmitOp( OpCode );
+	if ( pOp )
+	{
+		pOp->VarType = VarType;
+		pOp->Value = Value;
+		pOp->IndexVarType = IndexVarType;
+		pOp->IndexVarOffset = IndexVarOffset;
+	}
+}
+
+arithmtype ApplyOp(int OpCode,arithmtype Res,arithmtype Val)
+{
+	switch( OpCode )
+	{
+		case ARITHM_OP_POW: return pow_int(Res,Val);
+		case ARITHM_OP_MUL: return Res * Val;
+		case ARITHM_OP_DIV: return Res / Val;
+		case ARITHM_OP_MOD: return Res % Val;
+		case ARITHM_OP_ADD: return Res + Val;
+		case ARITHM_OP_SUB: return Res - Val;
+		case ARITHM_OP_AND: return Res & Val;
+		case ARITHM_OP_XOR: return Res ^ Val;
+		case ARITHM_OP_OR: return Res | Val;
+	}
+	return 0;
+}
+
+/* evaluate a binary operator, or compile it */
+arithmtype BinaryOp(int OpCode,arithmtype Res,arithmtype Val)
+{
+	if ( CodeUnderCompile )
+	{
+		EmitOp( OpCode );
+		return 0;
+	}
+	return ApplyOp( OpCode, Res, Val );
+}
+
 arithmtype Constant(void)
 {
 	arithmtype Res = 0;
@@ -113,6 +219,12 @@ arithmtype Constant(void)
 	}
 	if ( cIsNeg )
 		Res = Res * -1;
+	if ( CodeUnderCompile )
+	{
+		StrArithmOp * pOp = EmitOp( ARITHM_OP_CONST );
+		if ( pOp )
+			pOp->Value = Res;
+	}
 	return Res;
 }
 
@@ -231,7 +343,14 @@ int IdentifyFinalVar( char *StartExpr, int * ResType,int * ResOffset )
 arithmtype Variable(void)
 {
 	int VarType,VarOffset;
-	if (IdentifyFinalVar(Expr, &VarType,&VarOffset))
+	int IndexVarType,IndexVarOffset;
+	int SyntaxOk;
+	/* when compiling, the index value is only known at run time */
+	if ( CodeUnderCompile )
+		SyntaxOk = IdentifyVarIndexedOrNot( Expr, &VarType, &VarOffset, &IndexVarType, &IndexVarOffset );
+	else
+		SyntaxOk = IdentifyFinalVar( Expr, &VarType, &VarOffset );
+	if (SyntaxOk)
 	{
 //printf("Variable:%d/%d\n", VarType, VarOffset);
 		/* flush var found */
@@ -241,6 +360,18 @@ arithmtype Variable(void)
 			Expr++;
 		}
 		while( (*Expr!='@') && (*Expr!='\0') );
+		if ( CodeUnderCompile )
+		{
+			if ( *Expr=='\0' )
+			{
+				ErrorDesc = "Bad var coding (err=3), should end with @";
+				SyntaxError();
+				return 0;
+			}
+			EmitVar( ARITHM_OP_VAR, VarType, VarOffset, IndexVarType, IndexVarOffset );
+			Expr++;
+			return 0;
+		}
 		Expr++;
 		/* return var value */
 		return (arithmtype)ReadVar(VarType,VarOffset);
@@ -251,6 +382,16 @@ arithmtype Variable(void)
 	}
 }
 
+void EmitFunction(int OpCode,int NbrVars)
+{
+	if ( CodeUnderCompile )
+	{
+		StrArithmOp * pOp = EmitOp( OpCode );
+		if ( pOp )
+			pOp->Param = NbrVars;
+	}
+}
+
 arithmtype Function(void)
 {
 	char tcFonc[ 20 ], *pFonc;
@@ -270,6 +411,8 @@ arithmtype Function(void)
 	{
 		Expr++; /* ( */
 		Res = Variable( );
+		if ( CodeUnderCompile )
+			EmitOp( ARITHM_OP_ABS );
 		if ( Res<0 )
 			Res = Res * -1;
 		Expr++; /* ) */
@@ -279,32 +422,38 @@ arithmtype Function(void)
 	/* functions with many parameters = many variables separated per ',' */
 	if ( !strcmp(tcFonc, "MINI") )
 	{
+		int NbrVars = 0;
 		Res = 0x7FFFFFFF;
 		do
 		{
 			int iValVar;
 			Expr++; /* ( -ou- , */
 			iValVar = Variable( );
+			NbrVars++;
 			if ( iValVar<Res )
 				Res = iValVar;
 		}
-		while( *Expr!=')' );
+		while( *Expr!=')' && ErrorDesc==NULL );
 		Expr++; /* ) */
+		EmitFunction( ARITHM_OP_MINI, NbrVars );
 		return Res;
 	}
 	if ( !strcmp(tcFonc, "MAXI") )
 	{
+		int NbrVars = 0;
 		Res = 0x80000000;
 		do
 		{
 			int iValVar;
 			Expr++; /* ( -or- , */
 			iValVar = Variable( );
+			NbrVars++;
 			if ( iValVar>Res )
 				Res = iValVar;
 		}
-		while( *Expr!=')' );
+		while( *Expr!=')' && ErrorDesc==NULL );
 		Expr++; /* ) */
+		EmitFunction( ARITHM_OP_MAXI, NbrVars );
 		return Res;
 	}
 	if ( !strcmp(tcFonc, "MOY") /*original french term!*/ || !strcmp(tcFonc, "AVG") /*added latter!!!*/ )
@@ -318,8 +467,9 @@ arithmtype Function(void)
 			NbrVars++;
 			Res = Res + ValVar;
 		}
-		while( *Expr!=')' );
+		while( *Expr!=')' && ErrorDesc==NULL );
 		Expr++; /* ) */
+		EmitFunction( ARITHM_OP_AVG, NbrVars );
 		Res = Res/NbrVars;
 		return Res;
 	}
@@ -365,8 +515,12 @@ arithmtype Term(void)
 	}
 	else if (*Expr=='!')
 	{
+		arithmtype Res;
 		Expr++;
-		return Term()?0:1;
+		Res = Term();
+		if ( CodeUnderCompile )
+			EmitOp( ARITHM_OP_NOT );
+		return Res?0:1;
 	}
 	else
 	{
@@ -388,7 +542,7 @@ arithmtype Pow(void)
 			break;
 		Expr++;
 		Q = Pow();
-		Res = pow_int(Res,Q);
+		Res = BinaryOp(ARITHM_OP_POW,Res,Q);
 	}
 	return Res;
 }
@@ -406,7 +560,7 @@ arithmtype MulDivMod(void)
 		if (*Expr=='*')
 		{
 			Expr++;
-			Res = Res * Pow();
+			Res = BinaryOp(ARITHM_OP_MUL,Res,Pow());
 		}
 		else
 		if (*Expr=='/')
@@ -414,7 +568,7 @@ arithmtype MulDivMod(void)
 			Expr++;
 			Val = Pow();
 			if ( ErrorDesc==NULL )
-				Res = Res / Val;
+				Res = BinaryOp(ARITHM_OP_DIV,Res,Val);
 		}
 		else
 		if (*Expr=='%')
@@ -422,7 +576,7 @@ arithmtype MulDivMod(void)
 			Expr++;
 			Val = Pow();
 			if ( ErrorDesc==NULL )
-				Res = Res % Val;
+				Res = BinaryOp(ARITHM_OP_MOD,Res,Val);
 		}
 		else
 		{
@@ -444,13 +598,13 @@ arithmtype AddSub(void)
 		if (*Expr=='+')
 		{
 			Expr++;
-			Res = Res + MulDivMod();
+			Res = BinaryOp(ARITHM_OP_ADD,Res,MulDivMod());
 		}
 		else
 		if (*Expr=='-')
 		{
 			Expr++;
-			Res = Res - MulDivMod();
+			Res = BinaryOp(ARITHM_OP_SUB,Res,MulDivMod());
 		}
 		else
 		{
@@ -470,7 +624,7 @@ arithmtype And(void)
 		if (*Expr=='&')
 		{
 			Expr++;
-			Res = Res & AddSub();
+			Res = BinaryOp(ARITHM_OP_AND,Res,AddSub());
 		}
 		else
 		{
@@ -489,7 +643,7 @@ arithmtype Xor(void)
 		if (*Expr=='^')
 		{
 			Expr++;
-			Res = Res ^ And();
+			Res = BinaryOp(ARITHM_OP_XOR,Res,And());
 		}
 		else
 		{
@@ -508,7 +662,7 @@ arithmtype Or(void)
 		if (*Expr=='|')
 		{
 			Expr++;
-			Res = Res | Xor();
+			Res = BinaryOp(ARITHM_OP_OR,Res,Xor());
 		}
 		else
 		{
@@ -580,6 +734,22 @@ int EvalCompare(char * CompareString)
 		EvalFirst = EvalExpression(FirstExpr);
 		EvalSecond = EvalExpression(SecondExpr);
 //printf("EvalCompare ResultFirst=%d , ResultSecond=%d\n",EvalFirst,EvalSecond);
+		if ( CodeUnderCompile )
+		{
+			StrArithmOp * pOp = EmitOp( ARITHM_OP_COMPARE );
+			if ( pOp )
+			{
+				if ( *SearchSep=='>' )
+					pOp->Param |= ARITHM_CMP_GT;
+				if ( *SearchSep=='<' && *(SearchSep+1)!='>' )
+					pOp->Param |= ARITHM_CMP_LT;
+				if ( *SearchSep=='<' && *(SearchSep+1)=='>' )
+					pOp->Param |= ARITHM_CMP_NE;
+				if ( *SearchSep=='=' || *(SearchSep+1)=='=' )
+					pOp->Param |= ARITHM_CMP_EQ;
+			}
+			return 0;
+		}
 		/* verify if compare is true */
 		if ( *SearchSep=='>' && EvalFirst>EvalSecond )
 			BoolRes = 1;
@@ -605,6 +775,8 @@ void MakeCalc(char * CalcString,int VerifyMode)
 {
 	char StrCopy[ARITHM_EXPR_SIZE+1]; /* used for putting null char after first expr */
 	int TargetVarType,TargetVarOffset;
+	int TargetIndexVarType = -1,TargetIndexVarOffset = -1;
+	int SyntaxOk;
 	int  Found = FALSE;
 
 	/* null expression ? */
@@ -614,7 +786,12 @@ void MakeCalc(char * CalcString,int VerifyMode)
 	strcpy(StrCopy,CalcString);
 
 	Expr = StrCopy;
-	if (IdentifyFinalVar(Expr,&TargetVarType,&TargetVarOffset))
+	/* when compiling, the index value is only known at run time */
+	if ( CodeUnderCompile )
+		SyntaxOk = IdentifyVarIndexedOrNot( Expr, &TargetVarType, &TargetVarOffset, &TargetIndexVarType, &TargetIndexVarOffset );
+	else
+		SyntaxOk = IdentifyFinalVar( Expr, &TargetVarType, &TargetVarOffset );
+	if (SyntaxOk)
 	{
 		/* flush var found */
 		Expr++;
@@ -646,7 +823,11 @@ void MakeCalc(char * CalcString,int VerifyMode)
 //printf("Calc - Eval String=%s\n",Expr);
 			EvalExpr = EvalExpression(Expr);
 //printf("Calc - Result=%d\n",EvalExpr);
-			if (!VerifyMode)
+			if ( CodeUnderCompile )
+			{
+				EmitVar( ARITHM_OP_STORE, TargetVarType, TargetVarOffset, TargetIndexVarType, TargetIndexVarOffset );
+			}
+			else if (!VerifyMode)
 			{
 				WriteVar(TargetVarType,TargetVarOffset,(int)EvalExpr);
 			}
@@ -690,3 +871,197 @@ char * VerifySyntaxForMakeCalc(char * StringToVerify)
 	return VerifyErrorDesc;
 }
 
+
+/* final offset of a var op, adding the index content if indexed */
+static inline int OpVarOffset(StrArithmOp * pOp)
+{
+	if ( pOp->IndexVarType!=-1 && pOp->IndexVarOffset!=-1 )
+		return pOp->Value + ReadVar( pOp->IndexVarType, pOp->IndexVarOffset );
+	return pOp->Value;
+}
+
+/* Run a compiled expression, return the value on top of the stack at end */
+/* (result of the compare) */
+arithmtype ExecArithmCode(StrArithmCode * pCode)
+{
+	arithmtype Stack[ ARITHM_CODE_SIZE ];
+	int Sp = 0;
+	int NumOp;
+	for( NumOp=0; NumOp<pCode->NbrOps; NumOp++ )
+	{
+		StrArithmOp * pOp = &pCode->Op[ NumOp ];
+		switch( pOp->OpCode )
+		{
+			case ARITHM_OP_CONST:
+				Stack[ Sp++ ] = pOp->Value;
+				break;
+			case ARITHM_OP_BIT:
+				Stack[ Sp++ ] = VarArray[ pOp->Value ];
+				break;
+			case ARITHM_OP_WORD:
+				Stack[ Sp++ ] = VarWordArray[ pOp->Value ];
+				break;
+			case ARITHM_OP_FLOAT:
+				Stack[ Sp++ ] = (arithmtype)VarFloatArray[ pOp->Value ];
+				break;
+			case ARITHM_OP_VAR:
+				Stack[ Sp++ ] = (arithmtype)ReadVar( pOp->VarType, OpVarOffset( pOp ) );
+				break;
+			case ARITHM_OP_NOT:
+				Stack[ Sp-1 ] = Stack[ Sp-1 ]?0:1;
+				break;
+			case ARITHM_OP_ABS:
+				if ( Stack[ Sp-1 ]<0 )
+					Stack[ Sp-1 ] = Stack[ Sp-1 ] * -1;
+				break;
+			case ARITHM_OP_MINI:
+			case ARITHM_OP_MAXI:
+			case ARITHM_OP_AVG:
+			{
+				int NbrVars = pOp->Param;
+				arithmtype Res;
+				int ScanVar;
+				Sp = Sp-NbrVars;
+				Res = ( pOp->OpCode==ARITHM_OP_MINI )?0x7FFFFFFF:( pOp->OpCode==ARITHM_OP_MAXI )?0x80000000:0;
+				for( ScanVar=Sp; ScanVar<Sp+NbrVars; ScanVar++ )
+				{
+					if ( pOp->OpCode==ARITHM_OP_MINI && Stack[ ScanVar ]<Res )
+						Res = Stack[ ScanVar ];
+					else if ( pOp->OpCode==ARITHM_OP_MAXI && Stack[ ScanVar ]>Res )
+						Res = Stack[ ScanVar ];
+					else if ( pOp->OpCode==ARITHM_OP_AVG )
+						Res = Res + Stack[ ScanVar ];
+				}
+				if ( pOp->OpCode==ARITHM_OP_AVG )
+					Res = Res/NbrVars;
+				Stack[ Sp++ ] = Res;
+				break;
+			}
+			case ARITHM_OP_COMPARE:
+			{
+				arithmtype EvalFirst = Stack[ Sp-2 ];
+				arithmtype EvalSecond = Stack[ Sp-1 ];
+				Sp--;
+				Stack[ Sp-1 ] = ( (pOp->Param & ARITHM_CMP_GT) && EvalFirst>EvalSecond )
+						|| ( (pOp->Param & ARITHM_CMP_LT) && EvalFirst<EvalSecond )
+						|| ( (pOp->Param & ARITHM_CMP_NE) && EvalFirst!=EvalSecond )
+						|| ( (pOp->Param & ARITHM_CMP_EQ) && EvalFirst==EvalSecond );
+				break;
+			}
+			case ARITHM_OP_STORE:
+				Sp--;
+				WriteVar( pOp->VarType, OpVarOffset( pOp ), (int)Stack[ Sp ] );
+				break;
+			default:
+				Sp--;
+				Stack[ Sp-1 ] = ApplyOp( pOp->OpCode, Stack[ Sp-1 ], Stack[ Sp ] );
+				break;
+		}
+	}
+	return ( Sp>0 )?Stack[ Sp-1 ]:0;
+}
+
+/* The buffer not last published can still be run by a scan which */
+/* read CodeInUse before the switch: wait until that scan is over. */
+/* In the realtime module the code is compiled before any scan. */
+static void WaitArithmCodeFree(StrArithmExpr * pArithmExpr)
+{
+#ifndef RTAPI
+	unsigned int CodeScan = pArithmExpr->CodeScan;
+	int Wait = 0;
+	while ( (CodeScan & 1) && InfosGene->ScanSequence==CodeScan && Wait++<1000 )
+		DoPauseMilliSecs( 1 );
+	rtapi_smp_mb();
+#endif
+}
+
+/* Compile an expression, used as a compare or an operate one */
+/* The new code is written in the buffer not last published, */
+/* and then switched to. If not compilable, the text will be evaluated. */
+void CompileArithmExpr(int NumExpr,int ForOperate)
+{
+	StrArithmExpr * pArithmExpr = &ArithmExpr[ NumExpr ];
+	int CodeLast = pArithmExpr->CodeLast;
+	int NewCode = ( CodeLast==0 )?1:0;
+	StrArithmCode * pCode = &pArithmExpr->Code[ NewCode ];
+
+	WaitArithmCodeFree( pArithmExpr );
+	pCode->NbrOps = 0;
+	CodeUnderCompile = pCode;
+	CompileError = FALSE;
+	/* syntax errors are reported when edited, not here */
+	UnderVerify = TRUE;
+	if ( ForOperate )
+		MakeCalc( pArithmExpr->Expr, FALSE /* verify mode */ );
+	else
+		EvalCompare( pArithmExpr->Expr );
+	UnderVerify = FALSE;
+	CodeUnderCompile = NULL;
+
+	if ( CompileError )
+	{
+		pArithmExpr->CodeInUse = -1;
+		return;
+	}
+	/* unchanged: do not touch the one perhaps currently evaluated */
+	if ( pArithmExpr->CodeInUse==CodeLast )
+	{
+		StrArithmCode * pOldCode = &pArithmExpr->Code[ CodeLast ];
+		if ( pOldCode->NbrOps==pCode->NbrOps
+			&& memcmp( pOldCode->Op, pCode->Op, pCode->NbrOps*sizeof(StrArithmOp) )==0 )
+			return;
+	}
+	/* code completely written before seen by the refresh */
+	rtapi_smp_wmb();
+	pArithmExpr->CodeLast = NewCode;
+	pArithmExpr->CodeInUse = NewCode;
+	rtapi_smp_mb();
+	pArithmExpr->CodeScan = InfosGene->ScanSequence;
+}
+
+/* Compile all the expressions used by the compare/operate elements of the rungs */
+void CompileAllArithmExpr(void)
+{
+	int NumRung,x,y;
+	for( NumRung=0; NumRung<NBR_RUNGS; NumRung++ )
+	{
+		StrRung * pRung = &RungArray[ NumRung ];
+		if ( !pRung->Used )
+			continue;
+		for( y=0; y<RUNG_HEIGHT; y++ )
+		{
+			for( x=0; x<RUNG_WIDTH; x++ )
+			{
+				if ( pRung->Element[x][y].Type==ELE_COMPAR )
+					CompileArithmExpr( pRung->Element[x][y].VarNum, FALSE );
+				else if ( pRung->Element[x][y].Type==ELE_OUTPUT_OPERATE )
+					CompileArithmExpr( pRung->Element[x][y].VarNum, TRUE );
+			}
+		}
+	}
+}
+
+/* Used by the refresh : compiled code if available, else the text */
+int EvalCompareExpr(int NumExpr)
+{
+	StrArithmExpr * pArithmExpr = &ArithmExpr[ NumExpr ];
+	int CodeInUse = pArithmExpr->CodeInUse;
+	if ( CodeInUse==0 || CodeInUse==1 )
+	{
+		rtapi_smp_rmb();
+		return ExecArithmCode( &pArithmExpr->Code[ CodeInUse ] );
+	}
+	return EvalCompare( pArithmExpr->Expr );
+}
+void MakeCalcExpr(int NumExpr)
+{
+	StrArithmExpr * pArithmExpr = &ArithmExpr[ NumExpr ];
+	int CodeInUse = pArithmExpr->CodeInUse;
+	if ( CodeInUse==0 || CodeInUse==1 )
+	{
+		rtapi_smp_rmb();
+		ExecArithmCode( &pArithmExpr->Code[ CodeInUse ] );
+		return;
+	}
+	MakeCalc( pArithmExpr->Expr, FALSE /* verify mode */ );
+}
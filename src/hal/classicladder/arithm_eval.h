@@ -24,5 +24,9 @@ arithmtype AddSub(void);
 arithmtype Or(void);
 char * VerifySyntaxForEvalCompare(char * StringToVerify);
 char * VerifySyntaxForMakeCalc(char * StringToVerify);
+void CompileArithmExpr(int NumExpr,int ForOperate);
+void CompileAllArithmExpr(void);
+int EvalCompareExpr(int NumExpr);
+void MakeCalcExpr(int NumExpr);
 
 
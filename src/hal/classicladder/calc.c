@@ -35,6 +35,7 @@
 #include "global.h"
 #include "vars_access.h"
 #include "arithm_eval.h"
+#include "rtapi_mbarrier.h"
 #include "manager.h"
 #ifdef SEQUENTIAL_SUPPORT
 #include "calc_sequential.h"
@@ -204,13 +205,19 @@ void PrepareAllDatasBeforeRun( )
 #ifdef SEQUENTIAL_SUPPORT
 	PrepareSequential( );
 #endif
+	CompileAllArithmExpr( );
 }
 
 void InitArithmExpr()
 {
     int NumExpr;
     for (NumExpr=0; NumExpr<NBR_ARITHM_EXPR; NumExpr++)
+    {
+        ArithmExpr[NumExpr].CodeInUse = -1;
+        ArithmExpr[NumExpr].CodeLast = 0;
+        ArithmExpr[NumExpr].CodeScan = 0;
         strcpy(ArithmExpr[NumExpr].Expr,"");
+    }
 }
 void InitIOConf( )
 {
@@ -625,7 +632,7 @@ char CalcTypeCompar(int x,int y,StrRung * UpdateRung)
     char State;
     char StateElement;
 
-    StateElement = EvalCompare(ArithmExpr[UpdateRung->Element[x][y].VarNum].Expr);
+    StateElement = EvalCompareExpr(UpdateRung->Element[x][y].VarNum);
     UpdateRung->Element[x][y].DynamicState = StateElement;
     if (x==2)
     {
@@ -646,7 +653,7 @@ char CalcTypeOutputOperate(int x,int y,StrRung * UpdateRung)
     char State;
     State = StateOnLeft(x-2,y,UpdateRung);
     if (State)
-        MakeCalc(ArithmExpr[UpdateRung->Element[x][y].VarNum].Expr,FALSE /* verify mode */);
+        MakeCalcExpr(UpdateRung->Element[x][y].VarNum);
     UpdateRung->Element[x][y].DynamicInput = State;
     UpdateRung->Element[x][y].DynamicState = State;
     return State;
@@ -797,6 +804,9 @@ void ClassicLadder_RefreshAllSections()
 	StrSection * pScanSection;
 
 	CycleStart();
+	/* lets CompileArithmExpr() know when a code buffer is no more run */
+	InfosGene->ScanSequence++;
+	rtapi_smp_mb();
 
 	for ( ScanMainSection=0; ScanMainSection<NBR_SECTIONS; ScanMainSection++ )
 	{
@@ -820,6 +830,8 @@ void ClassicLadder_RefreshAllSections()
 
 	}// for( )
 
+	rtapi_smp_mb();
+	InfosGene->ScanSequence++;
 	CycleEnd();
 //TODO: times measures should be moved directly in the module task
 // time measurement has been moved to module_hal.c for EMC
@@ -279,9 +279,65 @@ typedef struct StrTimerIEC
 	int ValueToReachOneBaseUnit;
 }StrTimerIEC;
 
+/* arithmetic expressions are compiled (see arithm_eval.c) to a small */
+/* stack code, evaluated by the refresh instead of parsing the text */
+#define ARITHM_CODE_SIZE 32
+
+#define ARITHM_OP_CONST 0	/* push Value */
+#define ARITHM_OP_BIT 1		/* push VarArray[Value] */
+#define ARITHM_OP_WORD 2	/* push VarWordArray[Value] */
+#define ARITHM_OP_FLOAT 3	/* push VarFloatArray[Value] */
+#define ARITHM_OP_VAR 4		/* push ReadVar(VarType,Value [+index]) */
+#define ARITHM_OP_NOT 10
+#define ARITHM_OP_POW 11
+#define ARITHM_OP_MUL 12
+#define ARITHM_OP_DIV 13
+#define ARITHM_OP_MOD 14
+#define ARITHM_OP_ADD 15
+#define ARITHM_OP_SUB 16
+#define ARITHM_OP_AND 17
+#define ARITHM_OP_XOR 18
+#define ARITHM_OP_OR 19
+#define ARITHM_OP_ABS 20
+#define ARITHM_OP_MINI 21	/* Param values on the stack */
+#define ARITHM_OP_MAXI 22
+#define ARITHM_OP_AVG 23
+#define ARITHM_OP_COMPARE 30	/* Param : mask of ARITHM_CMP_xxx */
+#define ARITHM_OP_STORE 31	/* WriteVar(VarType,Value [+index]) */
+
+#define ARITHM_CMP_GT 1
+#define ARITHM_CMP_LT 2
+#define ARITHM_CMP_NE 4
+#define ARITHM_CMP_EQ 8
+
+typedef struct StrArithmOp
+{
+	unsigned char OpCode;
+	unsigned char Param;
+	short VarType;
+	int Value;
+	int IndexVarType;	/* -1 if not indexed */
+	int IndexVarOffset;
+}StrArithmOp;
+
+typedef struct StrArithmCode
+{
+	int NbrOps;
+	StrArithmOp Op[ARITHM_CODE_SIZE];
+}StrArithmCode;
+
 typedef struct StrArithmExpr
 {
 	char Expr[ARITHM_EXPR_SIZE];
+	/* Code[] buffer used by the refresh, -1 if the text must be evaluated */
+	int CodeInUse;
+	/* Code[] buffer last published (0 or 1, never -1): the refresh may */
+	/* still be running it, so a new version is compiled in the other one */
+	int CodeLast;
+	/* InfosGene->ScanSequence when CodeLast was published: if odd, a */
+	/* scan begun before may still run the other buffer until it ends */
+	unsigned int CodeScan;
+	StrArithmCode Code[2];
 }StrArithmExpr;
 
 #define DEVICE_TYPE_DIRECT_ACCESS 0	/* used inb( ) and outb( ) calls */
@@ -326,6 +382,8 @@ typedef struct StrInfosGene
 	
 	/* how time for the last scan of the rungs in ns (if calc on RTLinux side) */
 	int DurationOfLastScan;
+	/* incremented when a scan of the rungs begins and ends (odd while scanning) */
+	unsigned int ScanSequence;
 	
 	int CurrentSection;
 
@@ -552,7 +552,13 @@ void ApplyNewArithmExpr()
 {
 	int NumExpr;
 	for (NumExpr=0; NumExpr<NBR_ARITHM_EXPR; NumExpr++)
-		strcpy(ArithmExpr[NumExpr].Expr,EditArithmExpr[NumExpr].Expr);
+	{
+		/* the refresh keeps running the previous code until the new */
+		/* one is compiled and switched to */
+		if ( strcmp(ArithmExpr[NumExpr].Expr,EditArithmExpr[NumExpr].Expr)!=0 )
+			strcpy(ArithmExpr[NumExpr].Expr,EditArithmExpr[NumExpr].Expr);
+	}
+	CompileAllArithmExpr( );
 }
 void CheckForFreeingArithmExpr(int PosiX,int PosiY)
 {
@@ -823,6 +829,7 @@ void DeleteCurrentRung()
 				if ( (RungArray[OldCurrent].Element[x][y].Type == ELE_COMPAR)
 				|| (RungArray[OldCurrent].Element[x][y].Type == ELE_OUTPUT_OPERATE) )
 				{
+					ArithmExpr[ RungArray[OldCurrent].Element[x][y].VarNum ].CodeInUse = -1;
 					strcpy(ArithmExpr[ RungArray[OldCurrent].Element[x][y].VarNum ].Expr,"");
 				}
 			}
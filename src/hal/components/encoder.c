@@ -28,6 +28,11 @@
     called in a high speed thread, at least twice the maximum desired
     count rate.  "encoder.capture-position" can be called at a much
     slower rate, and updates the output variables.
+
+    On userland flavors running on a CPU with AVX2, the counters are
+    updated by a vectorized version of "encoder.update-counters" which
+    decodes all channels at once.  The module parameter 'simd=0'
+    forces the plain version.  Both count exactly the same.
 */
 
 /** Copyright (C) 2003 John Kasunich
@@ -63,6 +68,7 @@
 #include "rtapi_app.h"		/* RTAPI realtime module decls */
 #include "rtapi_string.h"
 #include "hal.h"		/* HAL public API decls */
+#include "rtapi_simd.h"		/* RTAPI_SIMD_TARGET, rtapi_simd_supported() */
 
 /* module information */
 MODULE_AUTHOR("John Kasunich");
@@ -77,6 +83,8 @@ RTAPI_MP_INT(num_chan, "number of encoder channels");
 #define MAX_CHAN 8
 char *names[MAX_CHAN] = {0,};
 RTAPI_MP_ARRAY_STRING(names, MAX_CHAN, "names of encoder");
+static int simd = 1;
+RTAPI_MP_INT(simd, "use the vector update funct if the CPU supports it");
 
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
@@ -101,9 +109,6 @@ typedef struct {
 */
 
 typedef struct {
-    unsigned char state;	/* u:rw quad decode state machine state */
-    unsigned char oldZ;		/* u:rw previous value of phase Z */
-    unsigned char Zmask;	/* u:rc c:s mask for oldZ, from index-ena */
     hal_bit_t *x4_mode;		/* u:r enables x4 counting (default) */
     hal_bit_t *counter_mode;	/* u:r enables counter mode */
     atomic buf[2];		/* u:w c:r double buffer for atomic data */
@@ -129,7 +134,6 @@ typedef struct {
     hal_float_t *pos_latch;     /* c:w scaled latched position (floating point) */
     hal_float_t *vel;		/* c:w scaled velocity (floating point) */
     hal_float_t *pos_scale;	/* c:r pin: scaling factor for pos */
-    hal_bit_t old_latch;        /* value of latch on previous cycle */
     double old_scale;		/* c:rw stored scale value */
     double scale;		/* c:rw reciprocal value used for scaling */
     int counts_since_timeout;	/* c:rw used for velocity calcs */
@@ -140,6 +144,15 @@ static __u32 timebase;		/* master timestamp for all counters */
 /* pointer to array of counter_t structs in shmem, 1 per counter */
 static counter_t *counter_array;
 
+/* the decoder state of all counters, one array per field so the
+   vector update funct can work on all channels at once */
+static struct {
+    int state[MAX_CHAN];	/* u:rw quad decode state machine state */
+    int oldZ[MAX_CHAN];		/* u:rw previous value of phase Z */
+    int Zmask[MAX_CHAN];	/* u:rc c:s mask for oldZ, from index-ena */
+    int old_latch[MAX_CHAN];	/* u:rw value of latch on previous cycle */
+} dec;
+
 /* bitmasks for quadrature decode state machine */
 #define SM_PHASE_A_MASK 0x01
 #define SM_PHASE_B_MASK 0x02
@@ -174,6 +187,19 @@ static const unsigned char lut_ctr[16] = {
    0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
 
+#if RTAPI_SIMD
+/* the three tables above for the vector update funct, x4 first, then
+   x1, then the counter table expanded so phase B is don't care */
+static const int lut_all[48] = {
+    0x00, 0x44, 0x88, 0x0C, 0x80, 0x04, 0x08, 0x4C,
+    0x40, 0x04, 0x08, 0x8C, 0x00, 0x84, 0x48, 0x0C,
+    0x00, 0x44, 0x08, 0x0C, 0x80, 0x04, 0x08, 0x0C,
+    0x00, 0x04, 0x08, 0x0C, 0x00, 0x04, 0x08, 0x0C,
+    0x00, 0x48, 0x00, 0x48, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00
+};
+#endif
+
 /* other globals */
 static int comp_id;		/* component ID */
 
@@ -183,6 +209,9 @@ static int comp_id;		/* component ID */
 
 static int export_encoder(counter_t * addr,char * prefix);
 static void update(void *arg, long period);
+#if RTAPI_SIMD
+static RTAPI_SIMD_TARGET void update_simd(void *arg, long period);
+#endif
 static void capture(void *arg, long period);
 
 /***********************************************************************
@@ -194,6 +223,7 @@ int rtapi_app_main(void)
 {
     int n, retval, i;
     counter_t *cntr;
+    void (*update_fn)(void *, long) = update;
 
     if(num_chan && names[0]) {
         rtapi_print_msg(RTAPI_MSG_ERR,"num_chan= and names= are mutually exclusive\n");
@@ -255,9 +285,10 @@ int rtapi_app_main(void)
 	    return -1;
 	}
 	/* init counter */
-	cntr->state = 0;
-	cntr->oldZ = 0;
-	cntr->Zmask = 0;
+	dec.state[n] = 0;
+	dec.oldZ[n] = 0;
+	dec.Zmask[n] = 0;
+	dec.old_latch[n] = 0;
 	*(cntr->x4_mode) = 1;
 	*(cntr->counter_mode) = 0;
 	*(cntr->latch_rising) = 1;
@@ -282,8 +313,14 @@ int rtapi_app_main(void)
 	cntr->scale = 1.0;
 	cntr->counts_since_timeout = 0;
     }
+#if RTAPI_SIMD
+    if (simd && rtapi_simd_supported()) {
+	update_fn = update_simd;
+	rtapi_print_msg(RTAPI_MSG_INFO, "ENCODER: using the vector update funct\n");
+    }
+#endif
     /* export functions */
-    retval = hal_export_funct("encoder.update-counters", update,
+    retval = hal_export_funct("encoder.update-counters", update_fn,
 	counter_array, 0, 0, comp_id);
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
@@ -326,7 +363,7 @@ static void update(void *arg, long period)
     for (n = 0; n < howmany; n++) {
 	buf = (atomic *) cntr->bp;
 	/* get state machine current state */
-	state = cntr->state;
+	state = dec.state[n];
 	/* add input bits to state code */
 	if (*(cntr->phaseA)) {
 	    state |= SM_PHASE_A_MASK;
@@ -355,23 +392,23 @@ static void update(void *arg, long period)
 	    buf->count_detected = 1;
 	}
 	/* save state machine state */
-	cntr->state = state;
+	dec.state[n] = state;
 	/* get old phase Z state, make room for new bit value */
-	state = cntr->oldZ << 1;
+	state = dec.oldZ[n] << 1;
 	/* add new value of phase Z */
 	if (*(cntr->phaseZ)) {
 	    state |= 1;
 	}
-	cntr->oldZ = state & 3;
+	dec.oldZ[n] = state & 3;
 	/* test for index enabled and rising edge on phase Z */
-	if ((state & cntr->Zmask) == 1) {
+	if ((state & dec.Zmask[n]) == 1) {
 	    /* capture counts, reset Zmask */
 	    buf->index_count = *(cntr->raw_counts);
 	    buf->index_detected = 1;
-	    cntr->Zmask = 0;
+	    dec.Zmask[n] = 0;
 	}
         /* test for latch enabled and desired edge on latch-in */
-        latch = *(cntr->latch_in), old_latch = cntr->old_latch;
+        latch = *(cntr->latch_in), old_latch = dec.old_latch[n];
         rising = latch && !old_latch;
         falling = !latch && old_latch;
 
@@ -380,7 +417,7 @@ static void update(void *arg, long period)
             buf->latch_detected = 1;
             buf->latch_count = *(cntr->raw_counts);
         }
-        cntr->old_latch = latch;
+        dec.old_latch[n] = latch;
 
 	/* move on to next channel */
 	cntr++;
@@ -391,6 +428,77 @@ static void update(void *arg, long period)
 }
 
 
+#if RTAPI_SIMD
+/* The same as update(), but split in three passes over all channels:
+   fetch the inputs, decode with selects instead of branches so the
+   compiler can vectorize it, and store the few events. */
+static RTAPI_SIMD_TARGET void update_simd(void *arg, long period)
+{
+    counter_t *cntr;
+    atomic *buf;
+    int n;
+    int in[MAX_CHAN], table[MAX_CHAN], latch_edge[MAX_CHAN];
+    int raw[MAX_CHAN], event[MAX_CHAN];
+
+    cntr = arg;
+    for (n = 0; n < howmany; n++) {
+	in[n] = (*(cntr[n].phaseA) != 0) * SM_PHASE_A_MASK
+	    | (*(cntr[n].phaseB) != 0) * SM_PHASE_B_MASK
+	    | (*(cntr[n].phaseZ) != 0) << 2
+	    | (*(cntr[n].latch_in) != 0) << 3;
+	table[n] = *(cntr[n].counter_mode) ? 32 : *(cntr[n].x4_mode) ? 0 : 16;
+	latch_edge[n] = (*(cntr[n].latch_rising) != 0)
+	    | (*(cntr[n].latch_falling) != 0) << 1;
+	raw[n] = *(cntr[n].raw_counts);
+    }
+    for (n = 0; n < howmany; n++) {
+	int state, up, down, z, hit_index, latch, old_latch, hit_latch;
+
+	/* quadrature decode state machine */
+	state = lut_all[table[n]
+	    + ((dec.state[n] | (in[n] & 3)) & SM_LOOKUP_MASK)];
+	up = (state & SM_CNT_UP_MASK) != 0;
+	down = (state & SM_CNT_DN_MASK) != 0;
+	raw[n] += up - down;
+	dec.state[n] = state;
+	/* rising edge on phase Z while index is enabled */
+	z = (dec.oldZ[n] << 1 | (in[n] >> 2 & 1)) & 3;
+	dec.oldZ[n] = z;
+	hit_index = (z & dec.Zmask[n]) == 1;
+	/* desired edge on latch-in */
+	latch = in[n] >> 3 & 1;
+	old_latch = dec.old_latch[n];
+	hit_latch = ((latch & ~old_latch) & latch_edge[n])
+	    | ((~latch & old_latch) & (latch_edge[n] >> 1));
+	dec.old_latch[n] = latch;
+	event[n] = (up | down) | hit_index << 1 | hit_latch << 2;
+    }
+    for (n = 0; n < howmany; n++, cntr++) {
+	*(cntr->raw_counts) = raw[n];
+	if (!event[n]) {
+	    continue;
+	}
+	buf = (atomic *) cntr->bp;
+	if (event[n] & 1) {
+	    buf->raw_count = raw[n];
+	    buf->timestamp = timebase;
+	    buf->count_detected = 1;
+	}
+	if (event[n] & 2) {
+	    buf->index_count = raw[n];
+	    buf->index_detected = 1;
+	    dec.Zmask[n] = 0;
+	}
+	if (event[n] & 4) {
+	    buf->latch_detected = 1;
+	    buf->latch_count = raw[n];
+	}
+    }
+    /* increment main timestamp counter */
+    timebase += period;
+}
+#endif
+
 static void capture(void *arg, long period)
 {
     counter_t *cntr;
@@ -424,9 +532,9 @@ static void capture(void *arg, long period)
 
 	/* update Zmask based on index_ena */
 	if (*(cntr->index_ena)) {
-	    cntr->Zmask = 3;
+	    dec.Zmask[n] = 3;
 	} else {
-	    cntr->Zmask = 0;
+	    dec.Zmask[n] = 0;
 	}
 	/* done interacting with update() */
 	/* check for change in scale value */
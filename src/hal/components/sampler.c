@@ -13,10 +13,11 @@
 /** This file, 'sampler.c', is the realtime part of a HAL component
     that allows data from HAL pins to be sampled at a uniform realtime
     sample rate and then be transferred to a file.  When this realtime
-    module is loaded, it creates a fifo in shared memory and begins 
-    capturing data from HAL pins to the fifo.  Then, the user space 
-    program 'halsampler' is invoked, which reads the fifo and writes
-    the data to stdout.
+    module is loaded, it creates a HAL stream ring and begins
+    capturing data from HAL pins to the ring.  Then, the user space
+    program 'halsampler' is invoked, which reads the ring and writes
+    the data to stdout.  When the ring is full new samples are
+    dropped and counted as overruns.
 
     Loading:
 
@@ -56,6 +57,7 @@
 #include "rtapi.h"              /* RTAPI realtime OS API */
 #include "rtapi_app.h"          /* RTAPI realtime module decls */
 #include "hal.h"                /* HAL public API decls */
+#include "hal_ring.h"		/* HAL ring API */
 #include "streamer.h"		/* decls and such for fifos */
 #include "rtapi_errno.h"
 #include "rtapi_string.h"
@@ -76,7 +78,7 @@ RTAPI_MP_ARRAY_INT(depth,MAX_SAMPLERS,"fifo depth");
 /* this structure contains the HAL shared memory data for one sampler */
 
 typedef struct {
-    fifo_t *fifo;		/* pointer to user/RT fifo */
+    ringbuffer_t rb;		/* user/RT fifo, fifo_t in the scratchpad */
     hal_s32_t *curr_depth;	/* pin: current fifo depth */
     hal_bit_t *full;		/* pin: overrun flag */
     hal_bit_t *enable;		/* pin: enable sampling */
@@ -86,7 +88,7 @@ typedef struct {
 
 /* other globals */
 static int comp_id;		/* component ID */
-static int shmem_id[MAX_SAMPLERS];
+static sampler_t *samplers[MAX_SAMPLERS];
 
 /***********************************************************************
 *                  LOCAL FUNCTION DECLARATIONS                         *
@@ -94,6 +96,7 @@ static int shmem_id[MAX_SAMPLERS];
 
 static int parse_types(fifo_t *f, char *cfg);
 static int init_sampler(int num, fifo_t *tmp_fifo);
+static void delete_rings(void);
 static void sample(void *arg, long period);
 
 /***********************************************************************
@@ -131,10 +134,6 @@ int rtapi_app_main(void)
 	return -EINVAL;
     }
     numchan = n;
-    /* clear shmem IDs */
-    for ( n = 0 ; n < MAX_SAMPLERS ; n++ ) {
-	shmem_id[n] = -1;
-    }
 
     /* have good config info, connect to the HAL */
     comp_id = hal_init("sampler");
@@ -149,6 +148,7 @@ int rtapi_app_main(void)
 	if (retval != 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"SAMPLER: ERROR: sampler %d init failed\n", n);
+	    delete_rings();
 	    hal_exit(comp_id);
 	    return retval;
 	}
@@ -161,14 +161,7 @@ int rtapi_app_main(void)
 
 void rtapi_app_exit(void)
 {
-    int n;
-
-    /* free any shmem blocks */
-    for ( n = 0 ; n < MAX_SAMPLERS ; n++ ) {
-	if ( shmem_id[n] > 0 ) {
-	    rtapi_shmem_delete(shmem_id[n], comp_id);
-	}
-    }
+    delete_rings();
     hal_exit(comp_id);
 }
 
@@ -181,8 +174,9 @@ static void sample(void *arg, long period)
     sampler_t *samp;
     fifo_t *fifo;
     pin_data_t *pptr;
-    shmem_data_t *dptr;
-    int tmpin, newin, tmpout, n;
+    shmem_data_t *dptr, rec[MAX_PINS+1];
+    ringsize_t space;
+    int n;
 
     /* point at sampler struct in HAL shmem */
     samp = arg;
@@ -193,33 +187,26 @@ static void sample(void *arg, long period)
     }
     /* HAL pins are right after the sampler_t struct in HAL shmem */
     pptr = (pin_data_t *)(samp+1);
-    /* point at user/RT fifo in other shmem */
-    fifo = samp->fifo;
-    /* fifo data area is right after the fifo_t struct in shmem */
-    dptr = (shmem_data_t *)(fifo+1);
-    /* calculate _next_ value for in */
-    tmpin = fifo->in;
-    newin = tmpin + 1;
-    if ( newin >= fifo->depth ) {
-	newin = 0;
-    }
-    tmpout = fifo->out;
-    if ( newin == tmpout ) {
-	/* fifo is full, need to overwrite the oldest data */
-	tmpout++;
-	if ( tmpout >= fifo->depth ) {
-	    tmpout = 0;
-	}
-	fifo->out = tmpout;
-        /* log the overrun */
+    /* fifo info is in the ring scratchpad */
+    fifo = samp->rb.scratchpad;
+    /* let the user side pace its reads */
+    fifo->period = period;
+    space = stream_write_space(samp->rb.header);
+    if ( space < fifo->record_size ) {
+	/* fifo is full, drop this sample; the reader sees the gap
+	   in the sample numbers */
+	(*samp->sample_num)++;
 	(*samp->overruns)++;
 	*(samp->full) = 1;
-    } else {
-	*(samp->full) = 0;
+	*(samp->curr_depth) = stream_read_space(samp->rb.header) / fifo->record_size;
+	return;
     }
-    /* make pointer to fifo entry */
-    dptr += tmpin * (fifo->num_pins+1);
-    /* copy data from HAL pins to fifo */
+    *(samp->full) = 0;
+    /* build the record, clearing the unused bytes of each item so
+       binary output is reproducible */
+    memset(rec, 0, fifo->record_size);
+    dptr = rec;
+    /* copy data from HAL pins to the record */
     for ( n = 0 ; n < fifo->num_pins ; n++ ) {
 	switch ( fifo->type[n] ) {
 	case HAL_FLOAT:
@@ -246,13 +233,9 @@ static void sample(void *arg, long period)
     }
     /* store sample number at the end of the fifo record */
     dptr->u = (*samp->sample_num)++;
-    /* update fifo pointer */
-    fifo->in = newin;
+    stream_write(&samp->rb, (char *)rec, fifo->record_size);
     /* calculate current depth */
-    if ( newin < tmpout ) {
-	newin += fifo->depth;
-    }
-    *(samp->curr_depth) = newin - tmpout;
+    *(samp->curr_depth) = stream_read_space(samp->rb.header) / fifo->record_size;
 }
 
 /***********************************************************************
@@ -306,7 +289,6 @@ static int parse_types(fifo_t *f, char *cfg)
 static int init_sampler(int num, fifo_t *tmp_fifo)
 {
     int size, retval, n, usefp;
-    void *shmem_ptr;
     sampler_t *str;
     pin_data_t *pptr;
     fifo_t *fifo;
@@ -404,27 +386,32 @@ static int init_sampler(int num, fifo_t *tmp_fifo)
 	return retval;
     }
 
-    /* alloc shmem for user/RT comms (fifo) */
-    size = sizeof(fifo_t) + (tmp_fifo->num_pins + 1) * tmp_fifo->depth * sizeof(shmem_data_t);
-    shmem_id[num] = rtapi_shmem_new(SAMPLER_SHMEM_KEY+num, comp_id, size);
-    if ( shmem_id[num] < 0 ) {
+    /* create the ring for user/RT comms (fifo), big enough for
+       'depth' records with the sample number at the end of each */
+    size = (tmp_fifo->num_pins + 1) * sizeof(shmem_data_t);
+    retval = hal_ring_newf(size * tmp_fifo->depth + 1, sizeof(fifo_t),
+	RINGTYPE_STREAM, "sampler.%d.samples", num);
+    if ( retval < 0 ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "SAMPLEr: ERROR: couldn't allocate user/RT shared memory\n");
-	return -ENOMEM;
+	    "SAMPLER: ERROR: couldn't create ring 'sampler.%d.samples': %d\n",
+	    num, retval);
+	return retval;
     }
-    retval = rtapi_shmem_getptr(shmem_id[num], &shmem_ptr, 0);
+    retval = hal_ring_attachf(&(str->rb), NULL, "sampler.%d.samples", num);
     if ( retval < 0 ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "SAMPLER: ERROR: couldn't map user/RT shared memory\n");
-	return -ENOMEM;
+	    "SAMPLER: ERROR: couldn't attach ring 'sampler.%d.samples': %d\n",
+	    num, retval);
+	hal_ring_deletef("sampler.%d.samples", num);
+	return retval;
     }
-    fifo = shmem_ptr;
-    str->fifo = fifo;
+    samplers[num] = str;
+    fifo = str->rb.scratchpad;
     /* copy data from temp_fifo */
     *fifo = *tmp_fifo;
     /* init fields */
-    fifo->in = 0;
-    fifo->out = 0;
+    fifo->record_size = size;
+    fifo->period = 0;
     fifo->last_sample = 0;
     fifo->last_sample--;
 
@@ -433,3 +420,17 @@ static int init_sampler(int num, fifo_t *tmp_fifo)
     return 0;
 }
 
+static void delete_rings(void)
+{
+    int n;
+
+    /* detach and delete the rings; deleting fails while halsampler
+       is still attached, the ring then goes away with hal_lib */
+    for ( n = 0 ; n < MAX_SAMPLERS ; n++ ) {
+	if ( samplers[n] && ringbuffer_attached(&samplers[n]->rb) ) {
+	    hal_ring_detach(&samplers[n]->rb);
+	    hal_ring_deletef("sampler.%d.samples", n);
+	}
+	samplers[n] = NULL;
+    }
+}
@@ -20,6 +20,7 @@
 
 #include "rtapi.h"      /* RTAPI realtime OS API */
 #include "hal.h"                /* HAL public API decls */
+#include "hal_ring.h"           /* HAL ring API */
 #include "streamer.h"
 
 /***********************************************************************
@@ -31,7 +32,7 @@
 ************************************************************************/
 
 int comp_id = -1;   /* -1 means hal_init() not called yet */
-int shmem_id = -1;
+ringbuffer_t rb;    /* the user/RT fifo, attached if rb.magic is set */
 int exitval = 1;    /* program return code - 1 means error */
 int ignore_sig = 0; /* used to flag critical regions */
 char comp_name[HAL_NAME_LEN+1]; /* name for this instance of sampler */
@@ -48,8 +49,8 @@ static void quit(int sig)
     if ( ignore_sig ) {
     return;
     }
-    if ( shmem_id >= 0 ) {
-    rtapi_shmem_delete(shmem_id, comp_id);
+    if ( ringbuffer_attached(&rb) ) {
+    hal_ring_detach(&rb);
     }
     if ( comp_id >= 0 ) {
     hal_exit(comp_id);
@@ -61,15 +62,13 @@ static void quit(int sig)
 
 int main(int argc, char **argv)
 {
-    int n, channel, retval, size, tag;
+    int n, channel, retval, tag;
     long int samples;
     unsigned long this_sample;
     char  *cp2;
     char *name = NULL;
-    void *shmem_ptr;
     fifo_t *fifo;
-    shmem_data_t *data, *dptr, buf[MAX_PINS];
-    int tmpout, newout;
+    shmem_data_t buf[MAX_PINS+1];
     struct timespec delay;
 
     /* set return code to "fail", clear it later if all goes well */
@@ -157,80 +156,34 @@ int main(int argc, char **argv)
         }
     hal_ready(comp_id);
 
-    /* open shmem for user/RT comms (fifo) */
-    /* initial size is unknown, assume only the fifo structure */
-    shmem_id = rtapi_shmem_new(SAMPLER_SHMEM_KEY+channel, comp_id, sizeof(fifo_t));
-    if ( shmem_id < 0 )
-        {
-        fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
-        goto out;
-        }
-
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
+    /* attach to the ring for user/RT comms (fifo) */
+    retval = hal_ring_attachf(&rb, NULL, "sampler.%d.samples", channel);
     if ( retval < 0 )
-        {
-        fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
-        goto out;
-        }
-
-    fifo = shmem_ptr;
-    if ( fifo->magic != FIFO_MAGIC_NUM )
         {
         //fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
         goto out;
         }
 
-    /* now use data in fifo structure to calculate proper shmem size */
-    size = sizeof(fifo_t) + (1+fifo->num_pins) * fifo->depth * sizeof(shmem_data_t);
-    /* close shmem, re-open with proper size */
-    rtapi_shmem_delete(shmem_id, comp_id);
-    shmem_id = rtapi_shmem_new(SAMPLER_SHMEM_KEY+channel, comp_id, size);
-    if ( shmem_id < 0 )
+    fifo = rb.scratchpad;
+    if ( fifo == NULL || fifo->magic != FIFO_MAGIC_NUM )
         {
-        fprintf(stderr, "ERROR: couldn't re-allocate user/RT shared memory\n");
-        goto out;
-        }
-
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
-    if ( retval < 0 )
-        {
-        fprintf(stderr, "ERROR: couldn't re-map user/RT shared memory\n");
+        //fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
         goto out;
         }
 
-    fifo = shmem_ptr;
-    data = fifo->data;
-
     // This is the main printing loop
     while ( samples != 0 )
         {
-        while ( fifo->in == fifo->out )
+        while ( stream_read_space(rb.header) < (ringsize_t)fifo->record_size )
             {
             /* fifo empty, sleep for 10mS */
             delay.tv_sec = 0;
             delay.tv_nsec = 10000000;
             nanosleep(&delay,NULL);
             }
-        /* make pointer to fifo entry */
-        tmpout = fifo->out;
-        newout = tmpout + 1;
-        if ( newout >= fifo->depth )
-            newout = 0;
-
-        dptr = &data[tmpout * (fifo->num_pins+1)];
-        /* read data from shmem into buffer */
-        for ( n = 0 ; n < fifo->num_pins ; n++ )
-            buf[n] = *(dptr++);
-
-        /* and read sample number */
-        this_sample = dptr->u;
-        if ( fifo->out != tmpout )
-        /* the sample was overwritten while we were reading it */
-        /* so ignore it */
-            continue;
-        else
-            /* update 'out' for next sample */
-            fifo->out = newout;
+        /* read the record, sample number at the end */
+        stream_read(&rb, (char *)buf, fifo->record_size);
+        this_sample = buf[fifo->num_pins].u;
 
         if ( this_sample != ++(fifo->last_sample) )
             {
@@ -264,8 +217,8 @@ int main(int argc, char **argv)
 
 out:
     ignore_sig = 1;
-    if ( shmem_id >= 0 )
-        rtapi_shmem_delete(shmem_id, comp_id);
+    if ( ringbuffer_attached(&rb) )
+        hal_ring_detach(&rb);
 
     if ( comp_id >= 0 )
         hal_exit(comp_id);
@@ -14,13 +14,13 @@
     that allows values to be sampled from HAL pins at a uniform 
     realtime sample rate, and writes them to a stdout (from which
     they can be redirected to a file).  When the realtime module
-    is loaded, it creates a fifo in shared memory and begins capturing
-    samples to the fifo.  Then, the user space program 'hal_ssampler'
-    is invoked to read from the fifo and print to stdout.
+    is loaded, it creates a HAL stream ring and begins capturing
+    samples to the ring.  Then, the user space program 'halsampler'
+    is invoked to read from the ring and print to stdout.
 
     Invoking:
 
-    halsampler [-c chan_num] [-n num_samples] [-t]
+    halsampler [-c chan_num] [-n num_samples] [-t] [-b] [filename]
 
     'chan_num', if present, specifies the sampler channel to use.
     The default is channel zero.
@@ -32,6 +32,12 @@
     '-t' tells sampler to print the sample number at the start
     of each line.
 
+    '-b' writes binary records instead of text: a header describing
+    the pins (streamer_bin_header_t, see streamer.h), followed by the
+    records exactly as they are in the ring, sample number included.
+    Lost samples are reported on stderr.  'halstreamer -b' reads
+    this format back.
+
 */
 
 /** This program is free software; you can redistribute it and/or
@@ -69,21 +75,26 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "hal.h"                /* HAL public API decls */
+#include "hal_ring.h"		/* HAL ring API */
 #include "streamer.h"
 
 /***********************************************************************
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
+static void wait_ring(fifo_t *fifo, ringsize_t capacity);
+static int write_all(int fd, const char *buf, size_t len);
+
 /***********************************************************************
 *                         GLOBAL VARIABLES                             *
 ************************************************************************/
 
 int comp_id = -1;	/* -1 means hal_init() not called yet */
-int shmem_id = -1;
+ringbuffer_t rb;	/* the user/RT fifo, attached if rb.magic is set */
 int exitval = 1;	/* program return code - 1 means error */
 int ignore_sig = 0;	/* used to flag critical regions */
 char comp_name[HAL_NAME_LEN+1];	/* name for this instance of sampler */
@@ -98,8 +109,8 @@ static void quit(int sig)
     if ( ignore_sig ) {
 	return;
     }
-    if ( shmem_id >= 0 ) {
-	rtapi_shmem_delete(shmem_id, comp_id);
+    if ( ringbuffer_attached(&rb) ) {
+	hal_ring_detach(&rb);
     }
     if ( comp_id >= 0 ) {
 	hal_exit(comp_id);
@@ -107,29 +118,31 @@ static void quit(int sig)
     exit(exitval);
 }
 
-#define BUF_SIZE 4000
+/* binary mode output buffer */
+#define BIN_BUF_SIZE (256*1024)
 
 int main(int argc, char **argv)
 {
-    int n, channel, retval, size, tag;
-    long int samples;
+    int n, channel, retval, tag, binary;
+    long int samples, nrec;
     unsigned long this_sample;
     char  *cp2;
     char *name = NULL;
-    void *shmem_ptr;
     fifo_t *fifo;
-    shmem_data_t *data, *dptr, buf[MAX_PINS];
-    int tmpout, newout;
-    struct timespec delay;
+    shmem_data_t buf[MAX_PINS+1];
+    ringsize_t rec, capacity, avail;
+    streamer_bin_header_t hdr;
+    char *binbuf = NULL;
 
     /* set return code to "fail", clear it later if all goes well */
     exitval = 1;
     channel = 0;
     tag = 0;
+    binary = 0;
     samples = -1;  /* -1 means run forever */
     int  opt;
 
-    while ((opt = getopt(argc, argv, "tn:c:N:")) != -1) {
+    while ((opt = getopt(argc, argv, "tbn:c:N:")) != -1) {
 	switch (opt) {
 	case 'c':
 	    channel = strtol(optarg, &cp2, 10);
@@ -151,10 +164,14 @@ int main(int argc, char **argv)
 	case 't':
 	    tag = 1;
 	    break;
+	case 'b':
+	    binary = 1;
+	    break;
 	default: /* '?' */
 	    fprintf(stderr,"ERROR: unknown option '%c'\n", opt);
 	    fprintf(stderr,"valid options are:\n" );
 	    fprintf(stderr,"\t-t\t\ttag values with sample number\n" );
+	    fprintf(stderr,"\t-b\t\twrite binary records\n" );
 	    fprintf(stderr,"\t-c <int>\t channel number\n" );
 	    fprintf(stderr,"\t-n <int>\t sample count\n" );
 	    fprintf(stderr,"\t-N <name>\t set HAL component name\n" );
@@ -169,7 +186,7 @@ int main(int argc, char **argv)
 	    exit(1);
 	}
 	// make stdout be the named file
-	fd = open(argv[optind], O_WRONLY | O_CREAT, 0666);
+	fd = open(argv[optind], O_WRONLY | O_CREAT | (binary ? O_TRUNC : 0), 0666);
 	close(1);
 	dup2(fd, 1);
     }
@@ -195,67 +212,79 @@ int main(int argc, char **argv)
 	goto out;
     }
     hal_ready(comp_id);
-    /* open shmem for user/RT comms (fifo) */
-    /* initial size is unknown, assume only the fifo structure */
-    shmem_id = rtapi_shmem_new(SAMPLER_SHMEM_KEY+channel, comp_id, sizeof(fifo_t));
-    if ( shmem_id < 0 ) {
-	fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
-	goto out;
-    }
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
+    /* attach to the ring for user/RT comms (fifo) */
+    retval = hal_ring_attachf(&rb, NULL, "sampler.%d.samples", channel);
     if ( retval < 0 ) {
-	fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
-	goto out;
-    }
-    fifo = shmem_ptr;
-    if ( fifo->magic != FIFO_MAGIC_NUM ) {
 	fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
 	goto out;
     }
-    /* now use data in fifo structure to calculate proper shmem size */
-    size = sizeof(fifo_t) + (1+fifo->num_pins) * fifo->depth * sizeof(shmem_data_t);
-    /* close shmem, re-open with proper size */
-    rtapi_shmem_delete(shmem_id, comp_id);
-    shmem_id = rtapi_shmem_new(SAMPLER_SHMEM_KEY+channel, comp_id, size);
-    if ( shmem_id < 0 ) {
-	fprintf(stderr, "ERROR: couldn't re-allocate user/RT shared memory\n");
-	goto out;
-    }
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
-    if ( retval < 0 ) {
-	fprintf(stderr, "ERROR: couldn't re-map user/RT shared memory\n");
+    fifo = rb.scratchpad;
+    if ( fifo == NULL || fifo->magic != FIFO_MAGIC_NUM ) {
+	fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
 	goto out;
     }
-    fifo = shmem_ptr;
-    data = fifo->data;
-    while ( samples != 0 ) {
-	while ( fifo->in == fifo->out ) {
-            /* fifo empty, sleep for 10mS */
-	    delay.tv_sec = 0;
-	    delay.tv_nsec = 10000000;
-	    nanosleep(&delay,NULL);
+    rec = fifo->record_size;
+    capacity = (rb.header->size - 1) / rec;
+    if ( binary ) {
+	/* describe the records, then copy them out in large blocks */
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, STREAMER_BIN_MAGIC, sizeof(hdr.magic));
+	hdr.byte_order = STREAMER_BIN_ORDER;
+	hdr.version = STREAMER_BIN_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.num_pins = fifo->num_pins;
+	hdr.record_size = rec;
+	hdr.flags = STREAMER_BIN_TAGGED;
+	for ( n = 0 ; n < fifo->num_pins ; n++ ) {
+	    hdr.type[n] = fifo->type[n];
 	}
-	/* make pointer to fifo entry */
-	tmpout = fifo->out;
-	newout = tmpout + 1;
-	if ( newout >= fifo->depth ) {
-	    newout = 0;
+	binbuf = malloc(BIN_BUF_SIZE);
+	if ( binbuf == NULL || write_all(1, (char *)&hdr, sizeof(hdr)) < 0 ) {
+	    fprintf(stderr, "ERROR: can't write binary header: %s\n", strerror(errno));
+	    goto out;
 	}
-	dptr = &data[tmpout * (fifo->num_pins+1)];
-	/* read data from shmem into buffer */
-	for ( n = 0 ; n < fifo->num_pins ; n++ ) {
-	    buf[n] = *(dptr++);
+	while ( samples != 0 ) {
+	    avail = stream_read_space(rb.header) / rec;
+	    if ( avail == 0 ) {
+		wait_ring(fifo, capacity);
+		continue;
+	    }
+	    nrec = BIN_BUF_SIZE / rec;
+	    if ( nrec > avail ) {
+		nrec = avail;
+	    }
+	    if (( samples > 0 ) && ( nrec > samples )) {
+		nrec = samples;
+	    }
+	    stream_read(&rb, binbuf, nrec * rec);
+	    /* check the sample numbers for gaps */
+	    for ( n = 0 ; n < nrec ; n++ ) {
+		this_sample = ((shmem_data_t *)(binbuf + n * rec))[fifo->num_pins].u;
+		if ( this_sample != ++(fifo->last_sample) ) {
+		    fprintf(stderr, "overrun: %lu samples lost\n",
+			this_sample - fifo->last_sample);
+		    fifo->last_sample = this_sample;
+		}
+	    }
+	    if ( write_all(1, binbuf, nrec * rec) < 0 ) {
+		fprintf(stderr, "ERROR: write failed: %s\n", strerror(errno));
+		goto out;
+	    }
+	    if ( samples > 0 ) {
+		samples -= nrec;
+	    }
 	}
-	/* and read sample number */
-	this_sample = dptr->u;
-	if ( fifo->out != tmpout ) {
-	    /* the sample was overwritten while we were reading it */
-	    /* so ignore it */
+    }
+    while ( samples != 0 ) {
+	if ( stream_read_space(rb.header) < rec ) {
+	    /* fifo empty, flush what we have and wait for more */
+	    fflush(stdout);
+	    wait_ring(fifo, capacity);
 	    continue;
-	} else {
-	    /* update 'out' for next sample */
-	    fifo->out = newout;
 	}
+	/* read the record, sample number at the end */
+	stream_read(&rb, (char *)buf, rec);
+	this_sample = buf[fifo->num_pins].u;
 	if ( this_sample != ++(fifo->last_sample) ) {
 	    printf ( "overrun\n" );
 	    fifo->last_sample = this_sample;
@@ -296,11 +325,54 @@ int main(int argc, char **argv)
 
 out:
     ignore_sig = 1;
-    if ( shmem_id >= 0 ) {
-	rtapi_shmem_delete(shmem_id, comp_id);
+    fflush(stdout);
+    free(binbuf);
+    if ( ringbuffer_attached(&rb) ) {
+	hal_ring_detach(&rb);
     }
     if ( comp_id >= 0 ) {
 	hal_exit(comp_id);
     }
     return exitval;
 }
+
+/***********************************************************************
+*                   LOCAL FUNCTION DEFINITIONS                         *
+************************************************************************/
+
+/* Sleep while the RT side moves about a quarter of the ring, judging
+   by the period it last ran with.  Bounded to 0.1..10 ms, 10 ms until
+   the sampler funct has run. */
+static void wait_ring(fifo_t *fifo, ringsize_t capacity)
+{
+    struct timespec delay;
+    long long ns;
+
+    ns = (long long)fifo->period * (capacity / 4);
+    if (( fifo->period <= 0 ) || ( ns > 10000000 )) {
+	ns = 10000000;
+    } else if ( ns < 100000 ) {
+	ns = 100000;
+    }
+    delay.tv_sec = 0;
+    delay.tv_nsec = ns;
+    nanosleep(&delay, NULL);
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while ( len > 0 ) {
+	n = write(fd, buf, len);
+	if ( n < 0 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    return -1;
+	}
+	buf += n;
+	len -= n;
+    }
+    return 0;
+}
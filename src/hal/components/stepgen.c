@@ -51,6 +51,30 @@
     values of the position feedback counters.  Both 'update-freq' and
     'capture-position' use floating point, 'make-pulses' does not.
 
+    Buffered mode:
+
+    With 'buffered=1' on the command line, 'stepgen.update-freq' runs
+    the pulse generators ahead of time, and renders the outputs of all
+    channels for the next servo period or so into a buffer, one byte
+    per channel and base period.  'stepgen.make-pulses' then only
+    copies the next byte of each channel to its output pins, which
+    makes the base thread much cheaper and its timing independent of
+    the stepping math.  The price is latency: the outputs, and the
+    feedback from 'capture-position', lag the commands by one to one
+    and a half servo periods, which shows up as following error.  If
+    'update-freq' is late and the buffer runs dry, the outputs hold
+    their state and 'stepgen.underruns' is incremented.  The HAL
+    connections and threads are the same in both modes.
+
+    Vector kernel:
+
+    'make-pulses' keeps the state it shares with the other functs in
+    one array per field, and steps all channels in a single pass,
+    grouped by output type, without per-channel branches.  On userland
+    flavors running on a CPU with AVX2 a vectorized copy of that pass
+    is used; 'simd=0' on the command line forces the plain one.  The
+    outputs are the same either way.
+
     Polarity:
 
     All signals from this module have fixed polarity (active high
@@ -304,9 +328,13 @@
 #include <float.h>
 #include "rtapi_math.h"
 
+#include "rtapi_mbarrier.h"	/* rtapi_smp_wmb(), rtapi_smp_rmb() */
+#include "rtapi_simd.h"		/* RTAPI_SIMD_TARGET, rtapi_simd_supported() */
+
 #define MAX_CHAN 16
 #define MAX_CYCLE 18
 #define USER_STEP_TYPE 13
+#define WAVE_FRAMES 512		/* buffered base periods, power of 2 */
 
 /* module information */
 MODULE_AUTHOR("John Kasunich");
@@ -319,6 +347,10 @@ RTAPI_MP_ARRAY_STRING(ctrl_type,MAX_CHAN,"control type (pos or vel) for up to 16
 int user_step_type[] = { [0 ... MAX_CYCLE-1] = -1 };
 RTAPI_MP_ARRAY_INT(user_step_type, MAX_CYCLE,
 	"lookup table for user-defined step type");
+int buffered = 0;
+RTAPI_MP_INT(buffered, "precompute the step waveforms in update-freq");
+static int simd = 1;
+RTAPI_MP_INT(simd, "use the vector kernel if the CPU supports it");
 
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
@@ -326,24 +358,13 @@ RTAPI_MP_ARRAY_INT(user_step_type, MAX_CYCLE,
 
 /** This structure contains the runtime data for a single generator. */
 
-/* structure members are ordered to optimize caching for makepulses,
-   which runs in the fastest thread */
+/* the state stepped by makepulses lives in 'sg' below, this holds
+   the pins, parameters and what the slower functs need */
 
 typedef struct {
-    /* stuff that is both read and written by makepulses */
-    unsigned int timer1;	/* times out when step pulse should end */
-    unsigned int timer2;	/* times out when safe to change dir */
-    unsigned int timer3;	/* times out when safe to step in new dir */
-    int hold_dds;		/* prevents accumulator from updating */
-    long addval;		/* actual frequency generator add value */
-    volatile long long accum;	/* frequency generator accumulator */
+    /* stuff that is read by makepulses */
     hal_s32_t rawcount;		/* param: position feedback in counts */
-    int curr_dir;		/* current direction */
-    int state;			/* current position in state table */
-    /* stuff that is read but not written by makepulses */
     hal_bit_t *enable;		/* pin for enable stepgen */
-    long target_addval;		/* desired freq generator add value */
-    long deltalim;		/* max allowed change per period */
     hal_u32_t step_len;		/* parameter: step pulse length */
     hal_u32_t dir_hold_dly;	/* param: direction hold time or delay */
     hal_u32_t dir_setup;	/* param: direction setup time */
@@ -376,6 +397,41 @@ typedef struct {
 /* ptr to array of stepgen_t structs in shared memory, 1 per channel */
 static stepgen_t *stepgen_array;
 
+/* the per channel state read and written by makepulses, one array per
+   field so a pass over all channels can be vectorized */
+static struct {
+    long long accum[MAX_CHAN];	/* frequency generator accumulator */
+    long addval[MAX_CHAN];	/* actual frequency generator add value */
+    long target_addval[MAX_CHAN];	/* desired freq generator add value */
+    long deltalim[MAX_CHAN];	/* max allowed change per period */
+    unsigned int timer1[MAX_CHAN];	/* times out when step pulse should end */
+    unsigned int timer2[MAX_CHAN];	/* times out when safe to change dir */
+    unsigned int timer3[MAX_CHAN];	/* times out when safe to step in new dir */
+    unsigned int step_len[MAX_CHAN];	/* copies of the timing parameters, */
+    unsigned int dir_hold_dly[MAX_CHAN];	/* as rounded by update_freq */
+    unsigned int dir_setup[MAX_CHAN];
+    int hold_dds[MAX_CHAN];	/* prevents accumulator from updating */
+    int enable[MAX_CHAN];	/* enable pin, sampled once per period */
+    int step[MAX_CHAN];		/* a step was taken this period */
+    int curr_dir[MAX_CHAN];	/* current direction */
+    int state[MAX_CHAN];	/* current position in state table */
+} sg;
+
+/* channels by output type, so the output stage has no type branches */
+static int stepdir_chan[MAX_CHAN], updown_chan[MAX_CHAN], table_chan[MAX_CHAN];
+static int num_stepdir, num_updown, num_table;
+
+/* buffered mode: outputs and accumulators rendered by update_freq for
+   each base period, a ring with one writer (update_freq) and one
+   reader (make_pulses) */
+static unsigned char wave_bits[WAVE_FRAMES][MAX_CHAN];
+static long long wave_accum[WAVE_FRAMES][MAX_CHAN];
+static unsigned int wave_write;	/* next frame to render */
+static unsigned int wave_read;	/* next frame to output */
+static int wave_running;		/* make_pulses ran, periodns is valid */
+static int wave_started;		/* a frame has been output */
+static hal_u32_t *wave_underruns;	/* param: frames missed */
+
 /* lookup tables for stepping types 2 and higher - phase A is the LSB */
 
 static unsigned char master_lut[][MAX_CYCLE] = {
@@ -431,12 +487,24 @@ typedef enum CONTROL { POSITION, VELOCITY, INVALID } CONTROL;
 ************************************************************************/
 
 static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode);
+static void step_frame_scalar(stepgen_t *stepgen, long period,
+    unsigned char *bits);
+#if RTAPI_SIMD
+static RTAPI_SIMD_TARGET void step_frame_simd(stepgen_t *stepgen,
+    long period, unsigned char *bits);
+#endif
 static void make_pulses(void *arg, long period);
+static void replay_pulses(void *arg, long period);
 static void update_freq(void *arg, long period);
+static void render_pulses(stepgen_t *stepgen, long period);
 static void update_pos(void *arg, long period);
 static int setup_user_step_type(void);
 static CONTROL parse_ctrl_type(const char *ctrl);
 
+/* the step_frame variant used, picked in rtapi_app_main() */
+static void (*step_frame)(stepgen_t *stepgen, long period,
+    unsigned char *bits) = step_frame_scalar;
+
 
 /***********************************************************************
 *                       INIT AND EXIT CODE                             *
@@ -510,9 +578,33 @@ int rtapi_app_main(void)
 	    return -1;
 	}
     }
+    if (buffered) {
+	wave_underruns = hal_malloc(sizeof(hal_u32_t));
+	if (wave_underruns == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+			    "STEPGEN: ERROR: hal_malloc() failed\n");
+	    hal_exit(comp_id);
+	    return -1;
+	}
+	*wave_underruns = 0;
+	retval = hal_param_u32_newf(HAL_RO, wave_underruns, comp_id,
+	    "stepgen.underruns");
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"STEPGEN: ERROR: underruns param export failed\n");
+	    hal_exit(comp_id);
+	    return -1;
+	}
+    }
+#if RTAPI_SIMD
+    if (simd && rtapi_simd_supported()) {
+	step_frame = step_frame_simd;
+	rtapi_print_msg(RTAPI_MSG_INFO, "STEPGEN: using the vector kernel\n");
+    }
+#endif
     /* export functions */
-    retval = hal_export_funct("stepgen.make-pulses", make_pulses,
-	stepgen_array, 0, 0, comp_id);
+    retval = hal_export_funct("stepgen.make-pulses",
+	buffered ? replay_pulses : make_pulses, stepgen_array, 0, 0, comp_id);
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "STEPGEN: ERROR: makepulses funct export failed\n");
@@ -555,162 +647,334 @@ void rtapi_app_exit(void)
     toggles, a step is generated.
 */
 
-static void make_pulses(void *arg, long period)
+/* Advance generator n by one base period, and return its outputs,
+   phase A (or STEP, or UP) in bit 0 */
+static inline unsigned char step_tick(stepgen_t *stepgen, int n, long period)
 {
-    stepgen_t *stepgen;
     long old_addval, target_addval, new_addval, step_now;
-    int n, p;
-    unsigned char outbits;
 
-    /* store period so scaling constants can be (re)calculated */
-    periodns = period;
-    /* point to stepgen data structures */
-    stepgen = arg;
-
-    for (n = 0; n < num_chan; n++) {
-	/* decrement "timing constraint" timers */
-	if ( stepgen->timer1 > 0 ) {
-	    if ( stepgen->timer1 > periodns ) {
-		stepgen->timer1 -= periodns;
-	    } else {
-		stepgen->timer1 = 0;
-	    }
+    /* decrement "timing constraint" timers */
+    if ( sg.timer1[n] > 0 ) {
+	if ( sg.timer1[n] > period ) {
+	    sg.timer1[n] -= period;
+	} else {
+	    sg.timer1[n] = 0;
 	}
-	if ( stepgen->timer2 > 0 ) {
-	    if ( stepgen->timer2 > periodns ) {
-		stepgen->timer2 -= periodns;
-	    } else {
-		stepgen->timer2 = 0;
-	    }
+    }
+    if ( sg.timer2[n] > 0 ) {
+	if ( sg.timer2[n] > period ) {
+	    sg.timer2[n] -= period;
+	} else {
+	    sg.timer2[n] = 0;
 	}
-	if ( stepgen->timer3 > 0 ) {
-	    if ( stepgen->timer3 > periodns ) {
-		stepgen->timer3 -= periodns;
-	    } else {
-		stepgen->timer3 = 0;
-		/* last timer timed out, cancel hold */
-		stepgen->hold_dds = 0;
-	    }
+    }
+    if ( sg.timer3[n] > 0 ) {
+	if ( sg.timer3[n] > period ) {
+	    sg.timer3[n] -= period;
+	} else {
+	    sg.timer3[n] = 0;
+	    /* last timer timed out, cancel hold */
+	    sg.hold_dds[n] = 0;
 	}
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
-	    /* update addval (ramping) */
-	    old_addval = stepgen->addval;
-	    target_addval = stepgen->target_addval;
-	    if (stepgen->deltalim != 0) {
-		/* implement accel/decel limit */
-		if (target_addval > (old_addval + stepgen->deltalim)) {
-		    /* new value is too high, increase addval as far as possible */
-		    new_addval = old_addval + stepgen->deltalim;
-		} else if (target_addval < (old_addval - stepgen->deltalim)) {
-		    /* new value is too low, decrease addval as far as possible */
-		    new_addval = old_addval - stepgen->deltalim;
-		} else {
-		    /* new value can be reached in one step - do it */
-		    new_addval = target_addval;
-		}
+    }
+    if ( !sg.hold_dds[n] && *(stepgen->enable) ) {
+	/* update addval (ramping) */
+	old_addval = sg.addval[n];
+	target_addval = sg.target_addval[n];
+	if (sg.deltalim[n] != 0) {
+	    /* implement accel/decel limit */
+	    if (target_addval > (old_addval + sg.deltalim[n])) {
+		/* new value is too high, increase addval as far as possible */
+		new_addval = old_addval + sg.deltalim[n];
+	    } else if (target_addval < (old_addval - sg.deltalim[n])) {
+		/* new value is too low, decrease addval as far as possible */
+		new_addval = old_addval - sg.deltalim[n];
 	    } else {
-		/* go to new freq without any ramping */
+		/* new value can be reached in one step - do it */
 		new_addval = target_addval;
 	    }
-	    /* save result */
-	    stepgen->addval = new_addval;
-	    /* check for direction reversal */
-	    if (((new_addval >= 0) && (old_addval < 0)) ||
-		((new_addval < 0) && (old_addval >= 0))) {
-		/* reversal required, can we do so now? */
-		if ( stepgen->timer3 != 0 ) {
-		    /* no - hold everything until delays time out */
-		    stepgen->hold_dds = 1;
-		}
-	    }
-	}
-	/* update DDS */
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
-	    /* save current value of low half of accum */
-	    step_now = stepgen->accum;
-	    /* update the accumulator */
-	    stepgen->accum += stepgen->addval;
-	    /* test for changes in low half of accum */
-	    step_now ^= stepgen->accum;
-	    /* we only care about the pickoff bit */
-	    step_now &= (1L << PICKOFF);
-	    /* update rawcounts parameter */
-	    stepgen->rawcount = stepgen->accum >> PICKOFF;
 	} else {
-	    /* DDS is in hold, no steps */
-	    step_now = 0;
+	    /* go to new freq without any ramping */
+	    new_addval = target_addval;
 	}
-	if ( stepgen->timer2 == 0 ) {
-	    /* update direction - do not change if addval = 0 */
-	    if ( stepgen->addval > 0 ) {
-		stepgen->curr_dir = 1;
-	    } else if ( stepgen->addval < 0 ) {
-		stepgen->curr_dir = -1;
+	/* save result */
+	sg.addval[n] = new_addval;
+	/* check for direction reversal */
+	if (((new_addval >= 0) && (old_addval < 0)) ||
+	    ((new_addval < 0) && (old_addval >= 0))) {
+	    /* reversal required, can we do so now? */
+	    if ( sg.timer3[n] != 0 ) {
+		/* no - hold everything until delays time out */
+		sg.hold_dds[n] = 1;
 	    }
 	}
-	if ( step_now ) {
-	    /* (re)start various timers */
-	    /* timer 1 = time till end of step pulse */
-	    stepgen->timer1 = stepgen->step_len;
-	    /* timer 2 = time till allowed to change dir pin */
-	    stepgen->timer2 = stepgen->timer1 + stepgen->dir_hold_dly;
-	    /* timer 3 = time till allowed to step the other way */
-	    stepgen->timer3 = stepgen->timer2 + stepgen->dir_setup;
-	    if ( stepgen->step_type >= 2 ) {
-		/* update state */
-		stepgen->state += stepgen->curr_dir;
-		if ( stepgen->state < 0 ) {
-		    stepgen->state = stepgen->cycle_max;
-		} else if ( stepgen->state > stepgen->cycle_max ) {
-		    stepgen->state = 0;
-		}
-	    }
+    }
+    /* update DDS */
+    if ( !sg.hold_dds[n] && *(stepgen->enable) ) {
+	/* save current value of low half of accum */
+	step_now = sg.accum[n];
+	/* update the accumulator */
+	sg.accum[n] += sg.addval[n];
+	/* test for changes in low half of accum */
+	step_now ^= sg.accum[n];
+	/* we only care about the pickoff bit */
+	step_now &= (1L << PICKOFF);
+    } else {
+	/* DDS is in hold, no steps */
+	step_now = 0;
+    }
+    if ( sg.timer2[n] == 0 ) {
+	/* update direction - do not change if addval = 0 */
+	if ( sg.addval[n] > 0 ) {
+	    sg.curr_dir[n] = 1;
+	} else if ( sg.addval[n] < 0 ) {
+	    sg.curr_dir[n] = -1;
 	}
-	/* generate output, based on stepping type */
-	if (stepgen->step_type == 0) {
-	    /* step/dir output */
-	    if ( stepgen->timer1 != 0 ) {
-		 *(stepgen->phase[STEP_PIN]) = 1;
-	    } else {
-		 *(stepgen->phase[STEP_PIN]) = 0;
-	    }
-	    if ( stepgen->curr_dir < 0 ) {
-		 *(stepgen->phase[DIR_PIN]) = 1;
-	    } else {
-		 *(stepgen->phase[DIR_PIN]) = 0;
-	    }
-	} else if (stepgen->step_type == 1) {
-	    /* up/down */
-	    if ( stepgen->timer1 != 0 ) {
-		if ( stepgen->curr_dir < 0 ) {
-		    *(stepgen->phase[UP_PIN]) = 0;
-		    *(stepgen->phase[DOWN_PIN]) = 1;
-		} else {
-		    *(stepgen->phase[UP_PIN]) = 1;
-		    *(stepgen->phase[DOWN_PIN]) = 0;
-		}
-	    } else {
-		*(stepgen->phase[UP_PIN]) = 0;
-		*(stepgen->phase[DOWN_PIN]) = 0;
-	    }
-	} else {
-	    /* step type 2 or greater */
-	    /* look up correct output pattern */
-	    outbits = (stepgen->lut)[stepgen->state];
-	    /* now output the phase bits */
-	    for (p = 0; p < stepgen->num_phases; p++) {
-		/* output one phase */
-		*(stepgen->phase[p]) = outbits & 1;
-		/* move to the next phase */
-		outbits >>= 1;
+    }
+    if ( step_now ) {
+	/* (re)start various timers */
+	/* timer 1 = time till end of step pulse */
+	sg.timer1[n] = sg.step_len[n];
+	/* timer 2 = time till allowed to change dir pin */
+	sg.timer2[n] = sg.timer1[n] + sg.dir_hold_dly[n];
+	/* timer 3 = time till allowed to step the other way */
+	sg.timer3[n] = sg.timer2[n] + sg.dir_setup[n];
+	if ( stepgen->step_type >= 2 ) {
+	    /* update state */
+	    sg.state[n] += sg.curr_dir[n];
+	    if ( sg.state[n] < 0 ) {
+		sg.state[n] = stepgen->cycle_max;
+	    } else if ( sg.state[n] > stepgen->cycle_max ) {
+		sg.state[n] = 0;
 	    }
 	}
+    }
+    /* generate output, based on stepping type */
+    if (stepgen->step_type == 0) {
+	/* step/dir output */
+	return (sg.timer1[n] != 0) << STEP_PIN
+	    | (sg.curr_dir[n] < 0) << DIR_PIN;
+    } else if (stepgen->step_type == 1) {
+	/* up/down */
+	if ( sg.timer1[n] == 0 ) {
+	    return 0;
+	}
+	return sg.curr_dir[n] < 0 ? 1 << DOWN_PIN : 1 << UP_PIN;
+    }
+    /* step type 2 or greater, look up correct output pattern */
+    return (stepgen->lut)[sg.state[n]];
+}
+
+/* Advance all generators by one base period, and store their outputs
+   in bits[] */
+static void step_frame_scalar(stepgen_t *stepgen, long period,
+    unsigned char *bits)
+{
+    int n;
+
+    for (n = 0; n < num_chan; n++) {
+	bits[n] = step_tick(&stepgen[n], n, period);
+    }
+}
+
+#if RTAPI_SIMD
+/* The same as step_frame_scalar(), but the part which is the same for
+   all step types is written with selects rather than branches, so the
+   compiler can vectorize it across channels, and the output stage is
+   run per group of channels with the same output type. */
+static RTAPI_SIMD_TARGET void step_frame_simd(stepgen_t *stepgen,
+    long period, unsigned char *bits)
+{
+    int n, i;
+
+    for (n = 0; n < num_chan; n++) {
+	sg.enable[n] = *(stepgen[n].enable);
+    }
+    for (n = 0; n < num_chan; n++) {
+	unsigned int timer1 = sg.timer1[n];
+	unsigned int timer2 = sg.timer2[n];
+	unsigned int timer3 = sg.timer3[n];
+	long old_addval = sg.addval[n];
+	long target_addval = sg.target_addval[n];
+	long deltalim = sg.deltalim[n];
+	long long accum = sg.accum[n], new_accum;
+	long new_addval;
+	int hold_dds = sg.hold_dds[n], run, step_now, dir, new_dir;
+
+	/* decrement "timing constraint" timers, the last one to time
+	   out cancels the hold */
+	hold_dds = (timer3 != 0 && timer3 <= period) ? 0 : hold_dds;
+	timer1 = timer1 > period ? timer1 - period : 0;
+	timer2 = timer2 > period ? timer2 - period : 0;
+	timer3 = timer3 > period ? timer3 - period : 0;
+	run = (hold_dds == 0) & sg.enable[n];
+	/* update addval (ramping), implementing the accel/decel limit
+	   if there is one */
+	new_addval = target_addval > old_addval + deltalim ?
+	    old_addval + deltalim : target_addval;
+	new_addval = target_addval < old_addval - deltalim ?
+	    old_addval - deltalim : new_addval;
+	new_addval = deltalim != 0 ? new_addval : target_addval;
+	new_addval = run ? new_addval : old_addval;
+	/* on a direction reversal, hold everything until the delays
+	   time out */
+	hold_dds |= run & ((new_addval < 0) != (old_addval < 0))
+	    & (timer3 != 0);
+	run = (hold_dds == 0) & sg.enable[n];
+	/* update DDS, a step is a toggle of the pickoff bit */
+	new_accum = accum + new_addval;
+	step_now = run & (int) ((accum ^ new_accum) >> PICKOFF) & 1;
+	accum = run ? new_accum : accum;
+	/* update direction - do not change if addval = 0 */
+	dir = sg.curr_dir[n];
+	new_dir = new_addval > 0 ? 1 : dir;
+	new_dir = new_addval < 0 ? -1 : new_dir;
+	dir = timer2 == 0 ? new_dir : dir;
+	/* on a step, (re)start the timers for the end of the pulse,
+	   the dir pin change and the step the other way */
+	timer1 = step_now ? sg.step_len[n] : timer1;
+	timer2 = step_now ? timer1 + sg.dir_hold_dly[n] : timer2;
+	timer3 = step_now ? timer2 + sg.dir_setup[n] : timer3;
+
+	sg.timer1[n] = timer1;
+	sg.timer2[n] = timer2;
+	sg.timer3[n] = timer3;
+	sg.hold_dds[n] = hold_dds;
+	sg.addval[n] = new_addval;
+	sg.accum[n] = accum;
+	sg.curr_dir[n] = dir;
+	sg.step[n] = step_now;
+    }
+    /* generate output, based on stepping type */
+    for (i = 0; i < num_stepdir; i++) {
+	n = stepdir_chan[i];
+	bits[n] = (sg.timer1[n] != 0) << STEP_PIN
+	    | (sg.curr_dir[n] < 0) << DIR_PIN;
+    }
+    for (i = 0; i < num_updown; i++) {
+	n = updown_chan[i];
+	bits[n] = (sg.timer1[n] != 0) <<
+	    (sg.curr_dir[n] < 0 ? DOWN_PIN : UP_PIN);
+    }
+    for (i = 0; i < num_table; i++) {
+	int state;
+
+	n = table_chan[i];
+	/* update state, and look up the output pattern */
+	state = sg.state[n] + (sg.step[n] ? sg.curr_dir[n] : 0);
+	state = state < 0 ? stepgen[n].cycle_max : state;
+	state = state > stepgen[n].cycle_max ? 0 : state;
+	sg.state[n] = state;
+	bits[n] = (stepgen[n].lut)[state];
+    }
+}
+#endif
+
+static inline void set_outputs(stepgen_t *stepgen, unsigned char outbits)
+{
+    int p;
+
+    if (stepgen->step_type < 2) {
+	*(stepgen->phase[0]) = outbits & 1;
+	*(stepgen->phase[1]) = (outbits >> 1) & 1;
+	return;
+    }
+    /* now output the phase bits */
+    for (p = 0; p < stepgen->num_phases; p++) {
+	/* output one phase */
+	*(stepgen->phase[p]) = outbits & 1;
+	/* move to the next phase */
+	outbits >>= 1;
+    }
+}
+
+static void make_pulses(void *arg, long period)
+{
+    stepgen_t *stepgen;
+    unsigned char bits[MAX_CHAN];
+    int n;
+
+    /* store period so scaling constants can be (re)calculated */
+    periodns = period;
+    /* point to stepgen data structures */
+    stepgen = arg;
+
+    step_frame(stepgen, period, bits);
+    for (n = 0; n < num_chan; n++) {
+	set_outputs(stepgen, bits[n]);
+	/* update rawcounts parameter */
+	stepgen->rawcount = sg.accum[n] >> PICKOFF;
 	/* move on to next step generator */
 	stepgen++;
     }
     /* done */
 }
 
+/** Buffered mode replacement for make_pulses: output the next frame
+    rendered by update_freq.
+*/
+static void replay_pulses(void *arg, long period)
+{
+    stepgen_t *stepgen;
+    unsigned char *frame;
+    unsigned int r;
+    int n;
+
+    /* store period so update_freq renders at the right rate */
+    periodns = period;
+    stepgen = arg;
+
+    wave_running = 1;
+    r = wave_read;
+    if (r == *(volatile unsigned int *) &wave_write) {
+	/* update_freq is late, hold the outputs */
+	if (wave_started) {
+	    (*wave_underruns)++;
+	}
+	return;
+    }
+    rtapi_smp_rmb();
+    frame = wave_bits[r % WAVE_FRAMES];
+    for (n = 0; n < num_chan; n++) {
+	set_outputs(stepgen, frame[n]);
+	stepgen++;
+    }
+    rtapi_smp_mb();
+    wave_read = r + 1;
+    wave_started = 1;
+}
+
+/** Buffered mode: run the generators ahead until the buffer holds about
+    one and a half servo periods, so a late update_freq doesn't starve
+    make_pulses.  Called at the end of update_freq, after the new
+    target frequencies are set.
+*/
+static void render_pulses(stepgen_t *stepgen, long period)
+{
+    unsigned int w, fill, target;
+    int n;
+
+    if (!wave_running) {
+	/* the base period isn't known yet */
+	return;
+    }
+    target = (3 * ((period + periodns / 2) / periodns)) / 2 + 1;
+    if (target > WAVE_FRAMES / 2) {
+	target = WAVE_FRAMES / 2;
+    }
+    w = wave_write;
+    fill = w - *(volatile unsigned int *) &wave_read;
+    for (; fill < target; fill++, w++) {
+	long long *accum = wave_accum[w % WAVE_FRAMES];
+	step_frame(stepgen, periodns, wave_bits[w % WAVE_FRAMES]);
+	for (n = 0; n < num_chan; n++) {
+	    accum[n] = sg.accum[n];
+	}
+    }
+    rtapi_smp_wmb();
+    wave_write = w;
+}
+
 static void update_pos(void *arg, long period)
 {
     long long int accum_a, accum_b;
@@ -720,13 +984,23 @@ static void update_pos(void *arg, long period)
     stepgen = arg;
 
     for (n = 0; n < num_chan; n++) {
-	/* 'accum' is a long long, and its remotely possible that
-	   make_pulses could change it half-way through a read.
-	   So we have a crude atomic read routine */
-	do {
-	    accum_a = stepgen->accum;
-	    accum_b = stepgen->accum;
-	} while ( accum_a != accum_b );
+	if (buffered && wave_started) {
+	    /* report where the outputs are, not how far update_freq
+	       has run the generator ahead */
+	    accum_a = wave_accum[(wave_read - 1) % WAVE_FRAMES][n];
+	} else {
+	    /* 'accum' is a long long, and its remotely possible that
+	       make_pulses could change it half-way through a read.
+	       So we have a crude atomic read routine */
+	    do {
+		accum_a = *(volatile long long *) &sg.accum[n];
+		accum_b = *(volatile long long *) &sg.accum[n];
+	    } while ( accum_a != accum_b );
+	}
+	if (buffered) {
+	    /* make_pulses doesn't run the generators in buffered mode */
+	    stepgen->rawcount = accum_a >> PICKOFF;
+	}
 	/* compute integer counts */
 	*(stepgen->count) = accum_a >> PICKOFF;
 	/* check for change in scale value */
@@ -859,6 +1133,10 @@ static void update_freq(void *arg, long period)
 	    stepgen->old_dir_hold_dly = ulceil(stepgen->dir_hold_dly, periodns);
 	    stepgen->dir_hold_dly = stepgen->old_dir_hold_dly;
 	}
+	/* hand the rounded values to make_pulses */
+	sg.step_len[n] = stepgen->step_len;
+	sg.dir_hold_dly[n] = stepgen->dir_hold_dly;
+	sg.dir_setup[n] = stepgen->dir_setup;
 	/* test for disabled stepgen */
 	if (*stepgen->enable == 0) {
 	    /* disabled: keep updating old_pos_cmd (if in pos ctrl mode) */
@@ -867,8 +1145,8 @@ static void update_freq(void *arg, long period)
 	    }
 	    /* set velocity to zero */
 	    stepgen->freq = 0;
-	    stepgen->addval = 0;
-	    stepgen->target_addval = 0;
+	    sg.addval[n] = 0;
+	    sg.target_addval[n] = 0;
 	    /* and skip to next one */
 	    stepgen++;
 	    continue;
@@ -930,8 +1208,8 @@ static void update_freq(void *arg, long period)
 	       make_pulses could change it half-way through a read.
 	       So we have a crude atomic read routine */
 	    do {
-		accum_a = stepgen->accum;
-		accum_b = stepgen->accum;
+		accum_a = *(volatile long long *) &sg.accum[n];
+		accum_b = *(volatile long long *) &sg.accum[n];
 	    } while ( accum_a != accum_b );
 	    /* convert from fixed point to double, after subtracting
 	       the one-half step offset */
@@ -1016,12 +1294,15 @@ static void update_freq(void *arg, long period)
 	}
 	stepgen->freq = new_vel;
 	/* calculate new addval */
-	stepgen->target_addval = stepgen->freq * freqscale;
+	sg.target_addval[n] = stepgen->freq * freqscale;
 	/* calculate new deltalim */
-	stepgen->deltalim = max_ac * accelscale;
+	sg.deltalim[n] = max_ac * accelscale;
 	/* move on to next channel */
 	stepgen++;
     }
+    if (buffered) {
+	render_pulses(arg, period);
+    }
     /* done */
 }
 
@@ -1169,21 +1450,32 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
 	addr->cycle_max = cycle_len_lut[step_type - 2] - 1;
 	addr->lut = &(master_lut[step_type - 2][0]);
     }
+    /* file the channel under its output stage */
+    if ( step_type == 0 ) {
+	stepdir_chan[num_stepdir++] = num;
+    } else if ( step_type == 1 ) {
+	updown_chan[num_updown++] = num;
+    } else {
+	table_chan[num_table++] = num;
+    }
     /* init the step generator core to zero output */
-    addr->timer1 = 0;
-    addr->timer2 = 0;
-    addr->timer3 = 0;
-    addr->hold_dds = 0;
-    addr->addval = 0;
+    sg.timer1[num] = 0;
+    sg.timer2[num] = 0;
+    sg.timer3[num] = 0;
+    sg.step_len[num] = addr->step_len;
+    sg.dir_hold_dly[num] = addr->dir_hold_dly;
+    sg.dir_setup[num] = addr->dir_setup;
+    sg.hold_dds[num] = 0;
+    sg.addval[num] = 0;
     /* accumulator gets a half step offset, so it will step half
        way between integer positions, not at the integer positions */
-    addr->accum = 1 << (PICKOFF-1);
+    sg.accum[num] = 1 << (PICKOFF-1);
     addr->rawcount = 0;
-    addr->curr_dir = 0;
-    addr->state = 0;
+    sg.curr_dir[num] = 0;
+    sg.state[num] = 0;
     *(addr->enable) = 0;
-    addr->target_addval = 0;
-    addr->deltalim = 0;
+    sg.target_addval[num] = 0;
+    sg.deltalim[num] = 0;
     /* other init */
     addr->printed_error = 0;
     addr->old_pos_cmd = 0.0;
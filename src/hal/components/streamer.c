@@ -13,10 +13,10 @@
 /** This file, 'streamer.c', is the realtime part of a HAL component
     that allows numbers stored in a file to be "streamed" onto HAL
     pins at a uniform realtime sample rate.  When the realtime module
-    is loaded, it creates a fifo in shared memory.  Then, the user
-    space program 'hal_streamer' is invoked.  'hal_streamer' takes 
-    input from stdin and writes it to the fifo, and this component 
-    transfers the data from the fifo to HAL pins.
+    is loaded, it creates a HAL stream ring.  Then, the user
+    space program 'halstreamer' is invoked.  'hal_streamer' takes 
+    input from stdin and writes it to the ring, and this component
+    transfers the data from the ring to HAL pins.
 
     Loading:
 
@@ -56,6 +56,7 @@
 #include "rtapi.h"              /* RTAPI realtime OS API */
 #include "rtapi_app.h"          /* RTAPI realtime module decls */
 #include "hal.h"                /* HAL public API decls */
+#include "hal_ring.h"		/* HAL ring API */
 #include "streamer.h"		/* decls and such for fifos */
 #include "rtapi_errno.h"
 #include "rtapi_string.h"
@@ -76,7 +77,7 @@ RTAPI_MP_ARRAY_INT(depth,MAX_STREAMERS,"fifo depth");
 /* this structure contains the HAL shared memory data for one streamer */
 
 typedef struct {
-    fifo_t *fifo;		/* pointer to user/RT fifo */
+    ringbuffer_t rb;		/* user/RT fifo, fifo_t in the scratchpad */
     hal_s32_t *curr_depth;	/* pin: current fifo depth */
     hal_bit_t *empty;		/* pin: underrun flag */
     hal_bit_t *enable;		/* pin: enable streaming */
@@ -85,7 +86,7 @@ typedef struct {
 
 /* other globals */
 static int comp_id;		/* component ID */
-static int shmem_id[MAX_STREAMERS];
+static streamer_t *streamers[MAX_STREAMERS];
 
 /***********************************************************************
 *                  LOCAL FUNCTION DECLARATIONS                         *
@@ -93,6 +94,7 @@ static int shmem_id[MAX_STREAMERS];
 
 static int parse_types(fifo_t *f, char *cfg);
 static int init_streamer(int num, fifo_t *tmp_fifo);
+static void delete_rings(void);
 static void update(void *arg, long period);
 
 /***********************************************************************
@@ -129,10 +131,6 @@ int rtapi_app_main(void)
 	return -EINVAL;
     }
     numchan = n;
-    /* clear shmem IDs */
-    for ( n = 0 ; n < MAX_STREAMERS ; n++ ) {
-	shmem_id[n] = -1;
-    }
 
     /* have good config info, connect to the HAL */
     comp_id = hal_init("streamer");
@@ -147,6 +145,7 @@ int rtapi_app_main(void)
 	if (retval != 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
 		"STREAMER: ERROR: streamer %d init failed\n", n);
+	    delete_rings();
 	    hal_exit(comp_id);
 	    return retval;
 	}
@@ -159,14 +158,7 @@ int rtapi_app_main(void)
 
 void rtapi_app_exit(void)
 {
-    int n;
-
-    /* free any shmem blocks */
-    for ( n = 0 ; n < MAX_STREAMERS ; n++ ) {
-	if ( shmem_id[n] > 0 ) {
-	    rtapi_shmem_delete(shmem_id[n], comp_id);
-	}
-    }
+    delete_rings();
     hal_exit(comp_id);
 }
 
@@ -179,8 +171,9 @@ static void update(void *arg, long period)
     streamer_t *str;
     fifo_t *fifo;
     pin_data_t *pptr;
-    shmem_data_t *dptr;
-    int tmpin, tmpout, n;
+    shmem_data_t *dptr, rec[MAX_PINS];
+    ringsize_t avail;
+    int n;
 
     /* point at streamer struct in HAL shmem */
     str = arg;
@@ -191,14 +184,13 @@ static void update(void *arg, long period)
     }
     /* HAL pins are right after the streamer_t struct in HAL shmem */
     pptr = (pin_data_t *)(str+1);
-    /* point at user/RT fifo in other shmem */
-    fifo = str->fifo;
-    /* fifo data area is right after the fifo_t struct in shmem */
-    dptr = (shmem_data_t *)(fifo+1);
-    /* find the next block of data in the fifo */
-    tmpin = fifo->in;
-    tmpout = fifo->out;
-    if ( tmpout == tmpin ) {
+    /* fifo info is in the ring scratchpad */
+    fifo = str->rb.scratchpad;
+    /* let the user side pace its writes */
+    fifo->period = period;
+    /* find the next record in the fifo */
+    avail = stream_read_space(str->rb.header);
+    if ( avail < fifo->record_size ) {
         /* fifo empty - log it */
 	(*str->underruns)++;
 	*(str->empty) = 1;
@@ -209,13 +201,11 @@ static void update(void *arg, long period)
     /* clear the "empty" pin */
     *(str->empty) = 0;
     /* calculate current depth */
-    if ( tmpin < tmpout ) {
-	tmpin += fifo->depth;
-    }
-    *(str->curr_depth) = tmpin - tmpout;
-    /* make ptr to first data item of the current fifo record */
-    dptr += tmpout * fifo->num_pins;
-    /* copy data from fifo to HAL pins */
+    *(str->curr_depth) = avail / fifo->record_size;
+    /* take the record out of the fifo */
+    stream_read(&str->rb, (char *)rec, fifo->record_size);
+    dptr = rec;
+    /* copy data from the record to HAL pins */
     for ( n = 0 ; n < fifo->num_pins ; n++ ) {
 	switch ( fifo->type[n] ) {
 	case HAL_FLOAT:
@@ -240,12 +230,6 @@ static void update(void *arg, long period)
 	dptr++;
 	pptr++;
     }
-    tmpout++;
-    if ( tmpout >= fifo->depth ) {
-        tmpout = 0;
-    }
-    /* store new value of out */
-    fifo->out = tmpout;
 }
 
 /***********************************************************************
@@ -299,7 +283,6 @@ static int parse_types(fifo_t *f, char *cfg)
 static int init_streamer(int num, fifo_t *tmp_fifo)
 {
     int size, retval, n, usefp;
-    void *shmem_ptr;
     streamer_t *str;
     pin_data_t *pptr;
     fifo_t *fifo;
@@ -389,27 +372,32 @@ static int init_streamer(int num, fifo_t *tmp_fifo)
 	return retval;
     }
 
-    /* alloc shmem for user/RT comms (fifo) */
-    size = sizeof(fifo_t) + tmp_fifo->num_pins * tmp_fifo->depth * sizeof(shmem_data_t);
-    shmem_id[num] = rtapi_shmem_new(STREAMER_SHMEM_KEY+num, comp_id, size);
-    if ( shmem_id[num] < 0 ) {
+    /* create the ring for user/RT comms (fifo), big enough for
+       'depth' records */
+    size = tmp_fifo->num_pins * sizeof(shmem_data_t);
+    retval = hal_ring_newf(size * tmp_fifo->depth + 1, sizeof(fifo_t),
+	RINGTYPE_STREAM, "streamer.%d.samples", num);
+    if ( retval < 0 ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "STREAMER: ERROR: couldn't allocate user/RT shared memory\n");
-	return -ENOMEM;
+	    "STREAMER: ERROR: couldn't create ring 'streamer.%d.samples': %d\n",
+	    num, retval);
+	return retval;
     }
-    retval = rtapi_shmem_getptr(shmem_id[num], &shmem_ptr, 0);
+    retval = hal_ring_attachf(&(str->rb), NULL, "streamer.%d.samples", num);
     if ( retval < 0 ) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "STREAMER: ERROR: couldn't map user/RT shared memory\n");
-	return -ENOMEM;
+	    "STREAMER: ERROR: couldn't attach ring 'streamer.%d.samples': %d\n",
+	    num, retval);
+	hal_ring_deletef("streamer.%d.samples", num);
+	return retval;
     }
-    fifo = shmem_ptr;
-    str->fifo = fifo;
+    streamers[num] = str;
+    fifo = str->rb.scratchpad;
     /* copy data from temp_fifo */
     *fifo = *tmp_fifo;
     /* init fields */
-    fifo->in = 0;
-    fifo->out = 0;
+    fifo->record_size = size;
+    fifo->period = 0;
     fifo->last_sample = 0;
 
     /* mark it inited for user program */
@@ -417,3 +405,17 @@ static int init_streamer(int num, fifo_t *tmp_fifo)
     return 0;
 }
 
+static void delete_rings(void)
+{
+    int n;
+
+    /* detach and delete the rings; deleting fails while halstreamer
+       is still attached, the ring then goes away with hal_lib */
+    for ( n = 0 ; n < MAX_STREAMERS ; n++ ) {
+	if ( streamers[n] && ringbuffer_attached(&streamers[n]->rb) ) {
+	    hal_ring_detach(&streamers[n]->rb);
+	    hal_ring_deletef("streamer.%d.samples", n);
+	}
+	streamers[n] = NULL;
+    }
+}
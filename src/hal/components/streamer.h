@@ -9,7 +9,7 @@
 * Copyright (c) 2006 All rights reserved.
 *
 ********************************************************************/
-#include "rtapi_shmkeys.h"
+#include "ring.h"
 
 #define MAX_STREAMERS		8
 #define MAX_SAMPLERS		8
@@ -18,8 +18,11 @@
 
 #define FIFO_MAGIC_NUM		0x4649464F
 
-/* These structs live in the shared memory that connects the user
-   space and RT parts.  They are _not_ in HAL shared memory.
+/* The user space and RT parts talk through a HAL stream ring named
+   "sampler.N.samples" or "streamer.N.samples".  The ring holds fixed
+   size records of num_pins shmem_data_t items; sampler records carry
+   the sample number in one more item at the end.  The ring is created
+   by the RT part, the fifo_t below lives in its scratchpad.
 */
 
 typedef union {
@@ -31,13 +34,12 @@ typedef union {
 
 typedef struct {
     unsigned int magic;
-    volatile unsigned int in;
-    volatile unsigned int out;
-    int depth;
+    int depth;			/* fifo depth in records, as configured */
     int num_pins;
-    unsigned long last_sample;
+    int record_size;		/* bytes per record in the ring */
+    long period;		/* period of the thread running the funct, ns */
+    unsigned long last_sample;	/* sampler: last sample number read */
     hal_type_t type[MAX_PINS];
-    shmem_data_t data[];
 } fifo_t;
 
 /* this struct lives in HAL shared memory */
@@ -49,3 +51,26 @@ typedef union {
     hal_s32_t *hs32;
 } pin_data_t;
 
+/* Binary file format used by 'halsampler -b' and 'halstreamer -b'.
+   A header describing the pins is followed by fixed size records in
+   the ring layout above, in the byte order of the machine that wrote
+   them.  If STREAMER_BIN_TAGGED is set, each record ends with the
+   sample number, as written by halsampler; halstreamer skips it.
+*/
+
+#define STREAMER_BIN_MAGIC	"HALSTRM"	/* 8 bytes including the nul */
+#define STREAMER_BIN_ORDER	0x01020304
+#define STREAMER_BIN_VERSION	1
+#define STREAMER_BIN_TAGGED	0x1
+
+typedef struct {
+    char magic[8];
+    __u32 byte_order;		/* STREAMER_BIN_ORDER as written */
+    __u32 version;
+    __u32 header_size;		/* records start at this file offset */
+    __u32 num_pins;
+    __u32 record_size;		/* bytes per record */
+    __u32 flags;
+    __u8 type[MAX_PINS];	/* hal_type_t of each pin */
+    __u8 pad[4];
+} streamer_bin_header_t;
@@ -13,20 +13,25 @@
 /** This file, 'streamer_usr.c', is the user part of a HAL component
     that allows numbers stored in a file to be "streamed" onto HAL
     pins at a uniform realtime sample rate.  When the realtime module
-    is loaded, it creates a fifo in shared memory.  Then, the user
-    space program 'hal_streamer' is invoked.  'hal_streamer' takes 
-    input from stdin and writes it to the fifo, and the realtime
-    part transfers the data from the fifo to HAL pins.
+    is loaded, it creates a HAL stream ring.  Then, the user
+    space program 'halstreamer' is invoked.  'halstreamer' takes
+    input from stdin and writes it to the ring, and the realtime
+    part transfers the data from the ring to HAL pins.
 
     Invoking:
 
-    halstreamer [chan_num]
+    halstreamer [-c chan_num] [-b] [filename]
 
     'chan_num', if present, specifies the streamer channel to use.
-    The default is channel zero.  Since hal_streamer takes its data
-    from stdin, it will almost always either need to have stdin 
+    The default is channel zero.  Since halstreamer takes its data
+    from stdin, it will almost always either need to have stdin
     redirected from a file, or have data piped into it from some
     other program.
+
+    '-b' reads binary records as written by 'halsampler -b' instead
+    of text, see streamer.h.  The pin types in the file header must
+    match the streamer configuration.  Regular files are mapped and
+    copied to the ring in blocks, pipes are read in large chunks.
 */
 
 /** This program is free software; you can redistribute it and/or
@@ -63,23 +68,31 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <errno.h>
 
 
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "hal.h"                /* HAL public API decls */
+#include "hal_ring.h"		/* HAL ring API */
 #include "streamer.h"
 
 /***********************************************************************
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
+static void wait_ring(fifo_t *fifo, ringsize_t capacity);
+static void feed_records(fifo_t *fifo, ringsize_t capacity, const char *p,
+			 long nrec, ringsize_t inrec);
+static int stream_binary(fifo_t *fifo, ringsize_t capacity);
+
 /***********************************************************************
 *                         GLOBAL VARIABLES                             *
 ************************************************************************/
 
 int comp_id = -1;	/* -1 means hal_init() not called yet */
-int shmem_id = -1;
+ringbuffer_t rb;	/* the user/RT fifo, attached if rb.magic is set */
 int exitval = 1;	/* program return code - 1 means error */
 int ignore_sig = 0;	/* used to flag critical regions */
 int linenumber=0;	/* used to print linenumber on errors */
@@ -95,8 +108,8 @@ static void quit(int sig)
     if ( ignore_sig ) {
 	return;
     }
-    if ( shmem_id >= 0 ) {
-	rtapi_shmem_delete(shmem_id, comp_id);
+    if ( ringbuffer_attached(&rb) ) {
+	hal_ring_detach(&rb);
     }
     if ( comp_id >= 0 ) {
 	hal_exit(comp_id);
@@ -105,25 +118,26 @@ static void quit(int sig)
 }
 
 #define BUF_SIZE 4000
+/* binary mode input buffer, when the input can't be mapped */
+#define BIN_BUF_SIZE (256*1024)
 
 int main(int argc, char **argv)
 {
-    int n, channel, retval, size, line;
+    int n, channel, retval, line, binary;
     char *cp,*cp2;
     char *name = NULL;
-    void *shmem_ptr;
     fifo_t *fifo;
-    shmem_data_t *data, *dptr;
+    shmem_data_t *dptr, rec[MAX_PINS];
+    ringsize_t capacity;
     char buf[BUF_SIZE];
 	const char *errmsg;
-    int tmpin, newin;
-    struct timespec delay;
 
     /* set return code to "fail", clear it later if all goes well */
     exitval = 1;
     channel = 0;
+    binary = 0;
     int  opt;
-    while ((opt = getopt(argc, argv, "c:N:")) != -1) {
+    while ((opt = getopt(argc, argv, "bc:N:")) != -1) {
 	switch (opt) {
         case 'c':
 	    channel = strtol(optarg, &cp2, 10);
@@ -135,10 +149,14 @@ int main(int argc, char **argv)
 	case 'N':
 	    name = optarg;
 	    break;
+	case 'b':
+	    binary = 1;
+	    break;
 	default: /* '?' */
 	    fprintf(stderr,"ERROR: unknown option '%c'\n", opt);
 	    fprintf(stderr,"valid options are:\n" );
 	    fprintf(stderr,"\t-c <int>\t channel number\n" );
+	    fprintf(stderr,"\t-b\t\tread binary records\n" );
 	    fprintf(stderr,"\t-N <name>\t set HAL component name\n" );
 	    exit(EXIT_FAILURE);
         }
@@ -183,57 +201,29 @@ int main(int argc, char **argv)
 	goto out;
     }
     hal_ready(comp_id);
-    /* open shmem for user/RT comms (fifo) */
-    /* initial size is unknown, assume only the fifo structure */
-    shmem_id = rtapi_shmem_new(STREAMER_SHMEM_KEY+channel, comp_id, sizeof(fifo_t));
-    if ( shmem_id < 0 ) {
-	fprintf(stderr, "ERROR: couldn't allocate user/RT shared memory\n");
-	goto out;
-    }
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
+    /* attach to the ring for user/RT comms (fifo) */
+    retval = hal_ring_attachf(&rb, NULL, "streamer.%d.samples", channel);
     if ( retval < 0 ) {
-	fprintf(stderr, "ERROR: couldn't map user/RT shared memory\n");
-	goto out;
-    }
-    fifo = shmem_ptr;
-    if ( fifo->magic != FIFO_MAGIC_NUM ) {
 	fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
 	goto out;
     }
-    /* now use data in fifo structure to calculate proper shmem size */
-    size = sizeof(fifo_t) + fifo->num_pins * fifo->depth * sizeof(shmem_data_t);
-    /* close shmem, re-open with proper size */
-    rtapi_shmem_delete(shmem_id, comp_id);
-    shmem_id = rtapi_shmem_new(STREAMER_SHMEM_KEY+channel, comp_id, size);
-    if ( shmem_id < 0 ) {
-	fprintf(stderr, "ERROR: couldn't re-allocate user/RT shared memory\n");
+    fifo = rb.scratchpad;
+    if ( fifo == NULL || fifo->magic != FIFO_MAGIC_NUM ) {
+	fprintf(stderr, "ERROR: channel %d realtime part is not loaded\n", channel );
 	goto out;
     }
-    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr, 0);
-    if ( retval < 0 ) {
-	fprintf(stderr, "ERROR: couldn't re-map user/RT shared memory\n");
+    capacity = (rb.header->size - 1) / fifo->record_size;
+    if ( binary ) {
+	if ( stream_binary(fifo, capacity) < 0 ) {
+	    goto out;
+	}
+	exitval = 0;
 	goto out;
     }
     line = 1;
-    fifo = shmem_ptr;
-    data = fifo->data;
     while ( fgets(buf, BUF_SIZE, stdin) ) {
-	/* calculate _next_ value for in */
-	tmpin = fifo->in;
-	newin = tmpin + 1;
-	if ( newin >= fifo->depth ) {
-	    newin = 0;
-	}
-	/* wait until there is space in the buffer */
-	while ( newin == fifo->out ) {
-            /* fifo full, sleep for 10mS */
-	    delay.tv_sec = 0;
-	    delay.tv_nsec = 10000000;
-	    nanosleep(&delay,NULL);
-	}
-	/* make pointer fifo entry */
-	dptr = &data[tmpin*fifo->num_pins];
-	/* parse input line, write results to fifo */
+	/* parse input line into a record */
+	dptr = rec;
 	cp = buf;
 	errmsg = NULL;
 	for ( n = 0 ; n < fifo->num_pins ; n++ ) {
@@ -293,8 +283,11 @@ int main(int argc, char **argv)
 	    /** TODO - decide whether to skip this line and continue, or 
 		abort the program.  Right now it skips the line. */
 	} else {
-	    /* good data, keep it */
-	    fifo->in = newin;
+	    /* good data, wait until there is space in the fifo */
+	    while ( stream_write_space(rb.header) < (ringsize_t)fifo->record_size ) {
+		wait_ring(fifo, capacity);
+	    }
+	    stream_write(&rb, (char *)rec, fifo->record_size);
 	}
 	line++;
     }
@@ -303,11 +296,171 @@ int main(int argc, char **argv)
 
 out:
     ignore_sig = 1;
-    if ( shmem_id >= 0 ) {
-	rtapi_shmem_delete(shmem_id, comp_id);
+    if ( ringbuffer_attached(&rb) ) {
+	hal_ring_detach(&rb);
     }
     if ( comp_id >= 0 ) {
 	hal_exit(comp_id);
     }
     return exitval;
 }
+
+/***********************************************************************
+*                   LOCAL FUNCTION DEFINITIONS                         *
+************************************************************************/
+
+/* Sleep while the RT side moves about a quarter of the ring, judging
+   by the period it last ran with.  Bounded to 0.1..10 ms, 10 ms until
+   the streamer funct has run. */
+static void wait_ring(fifo_t *fifo, ringsize_t capacity)
+{
+    struct timespec delay;
+    long long ns;
+
+    ns = (long long)fifo->period * (capacity / 4);
+    if (( fifo->period <= 0 ) || ( ns > 10000000 )) {
+	ns = 10000000;
+    } else if ( ns < 100000 ) {
+	ns = 100000;
+    }
+    delay.tv_sec = 0;
+    delay.tv_nsec = ns;
+    nanosleep(&delay, NULL);
+}
+
+/* Copy nrec records of inrec bytes each into the ring, as many at a
+   time as fit, keeping the first record_size bytes of each (a trailing
+   sample number is dropped).  Blocks while the ring is full. */
+static void feed_records(fifo_t *fifo, ringsize_t capacity, const char *p,
+			 long nrec, ringsize_t inrec)
+{
+    ringsize_t rec = fifo->record_size;
+    long k, i;
+
+    while ( nrec > 0 ) {
+	k = stream_write_space(rb.header) / rec;
+	if ( k == 0 ) {
+	    wait_ring(fifo, capacity);
+	    continue;
+	}
+	if ( k > nrec ) {
+	    k = nrec;
+	}
+	if ( inrec == rec ) {
+	    stream_write(&rb, p, k * rec);
+	} else {
+	    for ( i = 0 ; i < k ; i++ ) {
+		stream_write(&rb, p + i * inrec, rec);
+	    }
+	}
+	p += k * inrec;
+	nrec -= k;
+    }
+}
+
+static int stream_binary(fifo_t *fifo, ringsize_t capacity)
+{
+    streamer_bin_header_t hdr;
+    struct stat st;
+    off_t start;
+    ringsize_t inrec;
+    char *map, *bbuf;
+    size_t got, fill, bsize;
+    ssize_t n;
+    long nrec;
+    int i;
+
+    /* read and check the header */
+    start = lseek(0, 0, SEEK_CUR);
+    got = 0;
+    while ( got < sizeof(hdr) ) {
+	n = read(0, (char *)&hdr + got, sizeof(hdr) - got);
+	if ( n < 0 && errno == EINTR ) {
+	    continue;
+	}
+	if ( n <= 0 ) {
+	    fprintf(stderr, "ERROR: short binary header\n");
+	    return -1;
+	}
+	got += n;
+    }
+    if ( memcmp(hdr.magic, STREAMER_BIN_MAGIC, sizeof(hdr.magic)) != 0 ) {
+	fprintf(stderr, "ERROR: input is not a binary sample file\n");
+	return -1;
+    }
+    if ( hdr.byte_order != STREAMER_BIN_ORDER ) {
+	fprintf(stderr, "ERROR: binary input has the wrong byte order\n");
+	return -1;
+    }
+    if (( hdr.version != STREAMER_BIN_VERSION ) ||
+	( hdr.header_size != sizeof(hdr) )) {
+	fprintf(stderr, "ERROR: unsupported binary format version %u\n",
+	    hdr.version);
+	return -1;
+    }
+    if ( (int)hdr.num_pins != fifo->num_pins ) {
+	fprintf(stderr, "ERROR: binary input has %u pins, streamer has %d\n",
+	    hdr.num_pins, fifo->num_pins);
+	return -1;
+    }
+    for ( i = 0 ; i < fifo->num_pins ; i++ ) {
+	if ( hdr.type[i] != fifo->type[i] ) {
+	    fprintf(stderr, "ERROR: binary input pin %d has the wrong type\n", i);
+	    return -1;
+	}
+    }
+    inrec = hdr.record_size;
+    if (( inrec != (ringsize_t)fifo->record_size ) &&
+	!(( hdr.flags & STREAMER_BIN_TAGGED ) &&
+	  ( inrec == fifo->record_size + sizeof(shmem_data_t) ))) {
+	fprintf(stderr, "ERROR: bad binary record size %u\n", inrec);
+	return -1;
+    }
+
+    /* regular file: map it and hand the records over in place */
+    if (( start >= 0 ) && ( fstat(0, &st) == 0 ) && S_ISREG(st.st_mode) &&
+	( st.st_size > start + (off_t)sizeof(hdr) )) {
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0);
+	if ( map != MAP_FAILED ) {
+	    madvise(map, st.st_size, MADV_SEQUENTIAL);
+	    got = st.st_size - start - sizeof(hdr);
+	    feed_records(fifo, capacity, map + start + sizeof(hdr),
+		got / inrec, inrec);
+	    munmap(map, st.st_size);
+	    if ( got % inrec ) {
+		fprintf(stderr, "WARNING: truncated record at end of input ignored\n");
+	    }
+	    return 0;
+	}
+    }
+
+    /* pipe, or mapping failed: read large blocks, carrying partial
+       records over to the next block */
+    bsize = (BIN_BUF_SIZE / inrec) * inrec;
+    bbuf = malloc(bsize);
+    if ( bbuf == NULL ) {
+	fprintf(stderr, "ERROR: out of memory\n");
+	return -1;
+    }
+    fill = 0;
+    while (( n = read(0, bbuf + fill, bsize - fill) ) != 0 ) {
+	if ( n < 0 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    fprintf(stderr, "ERROR: read failed: %s\n", strerror(errno));
+	    free(bbuf);
+	    return -1;
+	}
+	fill += n;
+	nrec = fill / inrec;
+	feed_records(fifo, capacity, bbuf, nrec, inrec);
+	fill -= nrec * inrec;
+	memmove(bbuf, bbuf + nrec * inrec, fill);
+    }
+    if ( fill ) {
+	fprintf(stderr, "WARNING: truncated record at end of input ignored\n");
+    }
+    free(bbuf);
+    return 0;
+}
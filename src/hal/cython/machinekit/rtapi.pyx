@@ -191,9 +191,13 @@ class RTAPIcommand:
         if r:
             raise RuntimeError("cant connect to rtapi: %s" % strerror(-r))
 
-    def newthread(self,char *name, int period, instance=0,fp=0,cpu=-1, flags=0):
+    def newthread(self,char *name, int period, instance=0,fp=0,cpu=-1, flags=0,
+                  timing=0, timing_interval=0):
+        # timing: 0 full, 1 sampled, 2 thread, 3 tsc, see halcmd help newthread
+        # timing_interval: 0 for the default of 100 cycles
         cdef char *c_name = name
-        r = rtapi_newthread(instance, c_name, period, cpu, fp, flags)
+        r = rtapi_newthread(instance, c_name, period, cpu, fp, flags,
+                            timing, timing_interval)
         if r:
             raise RuntimeError("rtapi_newthread failed:  %s" % strerror(-r))
 
@@ -386,6 +386,8 @@ static hal_funct_entry_t *alloc_funct_entry_struct(void)
 	p->funct_ptr = 0;
 	p->arg = 0;
 	p->funct.l = 0;
+	p->clocks = 0;
+	p->max_clocks = 0;
     }
     return p;
 }
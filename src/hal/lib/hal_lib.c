@@ -467,6 +467,7 @@ EXPORT_SYMBOL(halg_foreach);
 EXPORT_SYMBOL(halg_yield);
 EXPORT_SYMBOL(halg_object_setbarriers);
 EXPORT_SYMBOL(hal_sweep);
+EXPORT_SYMBOL(halg_foreach_event);
 
 // hal_iring.c
 EXPORT_SYMBOL(hal_iring_alloc);
@@ -199,6 +199,8 @@ void halg_add_object(const bool use_hal_mutex,
     // insert new object after the new insertion point.
     // if nothing found, insert after head.
     dlist_add_before(&o.hdr->list, args.user_ptr2);
+    halpr_log_event(HAL_EV_CREATE, hh_get_object_type(o.hdr),
+		    hh_get_id(o.hdr), hh_get_owner_id(o.hdr));
 
     // make sure all values visible everywhere
     rtapi_smp_mb();
@@ -216,6 +218,9 @@ int halg_free_object(const bool use_hal_mutex,
 		   hh_get_refcnt(o.hdr));
     }
 
+    halpr_log_event(HAL_EV_DELETE, hh_get_object_type(o.hdr),
+		    hh_get_id(o.hdr), hh_get_owner_id(o.hdr));
+
     // zap the header, including valid bit
     // marks object for garbage collection by halg_sweep()
     hh_clear_hdr(o.hdr);
@@ -224,6 +229,42 @@ int halg_free_object(const bool use_hal_mutex,
     return 0;
 }
 
+void halpr_log_event(const int op, const int type,
+		     const int id, const int owner_id)
+{
+    hal_event_t *ev = &hal_data->event_log[hal_data->event_seq %
+					   HAL_EVENT_LOG_SIZE];
+    ev->op = op;
+    ev->type = type;
+    ev->id = id;
+    ev->owner_id = owner_id;
+    hal_data->event_seq++;
+}
+
+int halg_foreach_event(const bool use_hal_mutex,
+		       unsigned long *seq,
+		       const hal_event_callback_t callback,
+		       void *arg)
+{
+    WITH_HAL_MUTEX_IF(use_hal_mutex);
+    unsigned long end = hal_data->event_seq;
+    int nvisited = 0;
+
+    // also catches a *seq from before a HAL restart
+    if (end - *seq > HAL_EVENT_LOG_SIZE) {
+	*seq = end;
+	return -EOVERFLOW;
+    }
+    while (*seq != end) {
+	const hal_event_t *ev = &hal_data->event_log[*seq % HAL_EVENT_LOG_SIZE];
+	(*seq)++;
+	nvisited++;
+	if (callback && callback(ev, arg))
+	    break;
+    }
+    return nvisited;
+}
+
 // garbage collector - not nestable under other
 // halg_* methods - must be the only HAL code to hold the HAL mutex
 int hal_sweep(void)
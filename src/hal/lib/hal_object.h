@@ -304,6 +304,46 @@ int halg_yield(bool use_hal_mutex,
 	       foreach_args_t *args,
 	       hal_object_callback_t callback);
 
+// object event log
+//
+// object creation and deletion, and pin links, are recorded in a
+// fixed size log in hal_data. A user which tracks HAL objects, like
+// haltalk, remembers the sequence number it has seen events up to;
+// to catch up, it looks at the events since rather than walking the
+// whole object list. When the log wrapped in between, events were lost
+// and the user must walk the object list again.
+#define HAL_EVENT_LOG_SIZE 1024
+
+typedef enum {
+    HAL_EV_CREATE = 1,
+    HAL_EV_DELETE,
+    HAL_EV_LINK,      // id is the pin, owner_id the signal
+    HAL_EV_UNLINK,    // same
+} hal_event_op_t;
+
+typedef struct {
+    int op;           // hal_event_op_t
+    int type;         // hal_object_type
+    int id;
+    int owner_id;
+} hal_event_t;
+
+// return nonzero to stop iterating
+typedef int (*hal_event_callback_t)(const hal_event_t *ev, void *arg);
+
+// record an event - HAL mutex must be held
+void halpr_log_event(const int op, const int type,
+		     const int id, const int owner_id);
+
+// visit the events after *seq, and advance *seq past the last one
+// visited. Starting with *seq = 0 visits all events still in the log.
+// returns the number of events visited, or -EOVERFLOW if events after
+// *seq were lost; *seq is then set to the current end of the log.
+int halg_foreach_event(const bool use_hal_mutex,
+		       unsigned long *seq,
+		       const hal_event_callback_t callback,
+		       void *arg);
+
 #include "hal_object_selectors.h"
 
 #endif // HAL_OBJECT_H
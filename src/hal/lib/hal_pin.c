@@ -332,6 +332,7 @@ void unlink_pin(hal_pin_t * pin)
 	}
 	/* mark pin as unlinked */
 	pin_set_unlinked(pin);
+	halpr_log_event(HAL_EV_UNLINK, HAL_PIN, ho_id(pin), ho_id(sig));
 
 	// propagate the news
 	rtapi_smp_mb();
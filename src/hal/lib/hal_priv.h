@@ -236,6 +236,10 @@ typedef struct {
     size_t rt_alignment_loss;
     size_t hal_malloced; // mostly by comps doing hal_malloc()
 
+    // object event log, see halg_foreach_event()
+    unsigned long event_seq;    // events recorded so far
+    hal_event_t event_log[HAL_EVENT_LOG_SIZE];
+
 
     // HAL heap for shmalloc_desc()
     struct rtapi_heap heap;
@@ -590,8 +594,25 @@ typedef struct hal_funct_entry {
     void *arg;			/* argument for function */
     hal_funct_u funct;          // ptr to function code
     int funct_ptr;		/* pointer to function */
+    long long int clocks;       // TP_TSC: raw duration of last run
+    long long int max_clocks;   // TP_TSC: longest run since last conversion
 } hal_funct_entry_t;
 
+// per-thread funct timing policy, evaluated by thread_task() every cycle
+// and changeable at runtime through the <thread>.timing pin.
+//
+// in any policy except TP_FULL fa_start_time() reported to xthread functs
+// is the thread release time rather than the individual funct start time.
+typedef enum {
+    TP_FULL    = 0, // rtapi_get_time() after every funct, every cycle
+    TP_SAMPLED = 1, // time functs every <thread>.timing-interval cycles only
+    TP_THREAD  = 2, // thread time/tmax only, funct pins not updated
+    TP_TSC     = 3, // raw rtapi_get_clocks() per funct, converted to nsec
+                    // every <thread>.timing-interval cycles
+} hal_thread_timing_t;
+
+#define TP_DEFAULT_INTERVAL 100
+
 // argument struct for hal_create_xthread()
 typedef struct {
     const char *name;
@@ -599,6 +620,8 @@ typedef struct {
     int uses_fp;
     int cpu_id;
     rtapi_thread_flags_t flags;
+    hal_thread_timing_t timing;  // initial value of <thread>.timing
+    int timing_interval;         // <= 0: TP_DEFAULT_INTERVAL
 } hal_threadargs_t;
 
 // extended arguments version of hal_create_thread().
@@ -613,6 +636,8 @@ typedef struct hal_thread {
     s32_pin_ptr runtime;         // owned by hal_lib during thread lifetime
     s32_pin_ptr maxtime;
     s32_pin_ptr curr_period;    // actual period measured at cycle start
+    s32_pin_ptr timing;         // hal_thread_timing_t policy
+    s32_pin_ptr timing_interval; // cycles between samples/conversions
     hal_float_t mean;           // online jitter (really variance) calculation
     hal_float_t m2;
     hal_u32_t  cycles;
@@ -699,7 +724,7 @@ typedef struct hal_vtable {
    meaningfull error messages in case of a mismatch.
 */
 #include "rtapi_shmkeys.h"
-#define HAL_VER   13	/* version code */
+#define HAL_VER   14	/* version code */
 
 
 /***********************************************************************
@@ -49,7 +49,8 @@ static struct proc_dir_entry *hal_rtapicmd = 0;
 // simple interface to hal_create_thread()/hal_thread_delete()
 // through /proc/rtapi/hal/rtapicmd (kernel threadstyles only)
 //
-// to start a thread, write 'newthread' <threadname> <period> <fp> <cpu>'
+// to start a thread, write 'newthread' <threadname> <period> <fp> <cpu>
+// [<flags> [<timing> [<timing-interval>]]]'
 // example:
 //    echo newthread servo-thread 1000000 1 -1 >/proc/rtapi/hal/rtapicmd
 //
@@ -65,25 +66,37 @@ static ssize_t proc_write_rtapicmd(struct file *file,
     char cmd[20], name[HAL_NAME_LEN + 1];
     unsigned long period;
     int fp, cpu, retval;
+    int flags = 0, timing = TP_FULL, interval = 0;
 
     if (!strncmp(buffer,"newthread", 9)) {
-	if ((retval = sscanf(buffer, "%s %s %lu %d %d",
-			     cmd, name, &period, &fp, &cpu)) != 5) {
+	if ((retval = sscanf(buffer, "%s %s %lu %d %d %d %d %d",
+			     cmd, name, &period, &fp, &cpu,
+			     &flags, &timing, &interval)) < 5) {
 	    HALFAIL_RC(EINVAL,
-		       "newthread: expecting 5 items"
-		       " (s:cmd s:name d:period d:fp d:cpu), got %d",
+		       "newthread: expecting at least 5 items"
+		       " (s:cmd s:name d:period d:fp d:cpu"
+		       " [d:flags d:timing d:interval]), got %d",
 		       retval);
 	}
 	if ((period > 0) &&
 	    (strlen(name) > 0)) {
-	    retval = hal_create_thread(name, period, fp, cpu);
+	    hal_threadargs_t args = {
+		.name = name,
+		.period_nsec = period,
+		.uses_fp = fp,
+		.cpu_id = cpu,
+		.flags = flags,
+		.timing = timing,
+		.timing_interval = interval,
+	    };
+	    retval = hal_create_xthread(&args);
 	    if (retval < 0) {
 		HALFAIL_RC(EINVAL, "newthread: could not create thread '%s' - error %d",
 		       name, retval);
 		return retval;
 	    } else {
-		HALINFO("newthread: created %ld uS thread '%s' fp=%d cpu=%d",
-			period / 1000, name, fp, cpu);
+		HALINFO("newthread: created %ld uS thread '%s' fp=%d cpu=%d timing=%d",
+			period / 1000, name, fp, cpu, timing);
 	    }
 	}
     } else if (!strncmp(buffer, "delthread", 9)) {
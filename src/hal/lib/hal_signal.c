@@ -324,6 +324,7 @@ int halg_link(const int use_hal_mutex,
 	}
 	/* and update the pin */
 	set_signal(pin, sig);
+	halpr_log_event(HAL_EV_LINK, HAL_PIN, ho_id(pin), ho_id(sig));
 
 	// propagate the pin->signal assignment because
 	// halg_signal_propagate_barriers() triggers on
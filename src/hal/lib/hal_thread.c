@@ -12,13 +12,56 @@
 /** 'thread_task()' is a function that is invoked as a realtime task.
     It implements a thread, by running down the thread's function list
     and calling each function in turn.
+
+    Per-funct execution time measurement is governed by the thread's
+    timing policy (see hal_thread_timing_t) which is re-read from the
+    <thread>.timing and <thread>.timing-interval pins each cycle.
 */
+
+// record a funct execution time in nsec
+static inline void update_funct_time(hal_funct_t *funct, hal_s32_t delta)
+{
+    set_s32_pin(funct->f_runtime, delta);
+    if ( delta > get_s32_pin(funct->f_maxtime)) {
+	set_s32_pin(funct->f_maxtime, delta);
+#ifdef ENABLE_TMAX_INC
+	set_bit_pin(funct->f_maxtime_increased, 1);
+    } else {
+	set_bit_pin(funct->f_maxtime_increased, 0);
+#endif
+    }
+}
+
+// TP_TSC: convert the raw clock counts collected in the funct entries
+// to nsec and expose them on the funct pins
+static void convert_funct_clocks(hal_thread_t *thread, double ns_per_clock)
+{
+    hal_list_t *list_root = &(thread->funct_list);
+    hal_list_t *list_entry = dlist_next(list_root);
+
+    while (list_entry != list_root) {
+	hal_funct_entry_t *fentry = (hal_funct_entry_t *) list_entry;
+	hal_funct_t *funct = SHMPTR(fentry->funct_ptr);
+	hal_s32_t maxtime = fentry->max_clocks * ns_per_clock;
+
+	set_s32_pin(funct->f_runtime, fentry->clocks * ns_per_clock);
+	if (maxtime > get_s32_pin(funct->f_maxtime))
+	    set_s32_pin(funct->f_maxtime, maxtime);
+	fentry->max_clocks = 0;
+	list_entry = dlist_next(list_entry);
+    }
+}
+
 static void thread_task(void *arg)
 {
     hal_thread_t *thread = arg;
     hal_funct_entry_t *funct_root, *funct_entry;
     long long int end_time;
-    hal_s32_t delta, act_period;
+    long long int clk_start = 0, clk_end, clk_ref = 0, time_ref = 0;
+    double ns_per_clock = 0.0;
+    hal_s32_t act_period;
+    hal_s32_t requested, policy, last_policy = TP_FULL, interval;
+    int sample;
 
     thread->cycles = 0;
     thread->mean = 0.0;
@@ -48,6 +91,37 @@ static void thread_task(void *arg)
 
 	    fa.last_start_time = fa.thread_start_time = fa.start_time;
 
+	    // pick up timing policy changes
+	    policy = requested = get_s32_pin(thread->timing);
+	    interval = get_s32_pin(thread->timing_interval);
+	    if (interval < 1)
+		interval = 1;
+	    sample = (thread->cycles % interval) == 0;
+
+	    switch (policy) {
+	    case TP_SAMPLED:
+		if (!sample)
+		    policy = TP_THREAD;
+		break;
+	    case TP_THREAD:
+		break;
+	    case TP_TSC:
+		clk_start = rtapi_get_clocks();
+		if (last_policy != TP_TSC) {
+		    // (re)start calibration against rtapi_get_time()
+		    clk_ref = clk_start;
+		    time_ref = fa.start_time;
+		} else if (sample && (clk_start > clk_ref)) {
+		    // refine over the whole interval since switching to TSC
+		    ns_per_clock = (double)(fa.start_time - time_ref) /
+			(double)(clk_start - clk_ref);
+		}
+		break;
+	    default:
+		policy = TP_FULL;
+	    }
+	    last_policy = requested;
+
 	    /* run thru function list */
 	    while (funct_entry != funct_root) {
 		/* point to function structure */
@@ -71,19 +145,26 @@ static void thread_task(void *arg)
 		    // bad - a mistyped funct
 		    ;
 		}
-		// capture execution time of this funct
-		end_time = rtapi_get_time();
 
-		/* update execution time data */
-		delta = end_time - fa.start_time;
-		set_s32_pin(fa.funct->f_runtime, delta);
-		if ( delta > get_s32_pin(fa.funct->f_maxtime)) {
-		    set_s32_pin(fa.funct->f_maxtime, delta);
-#ifdef ENABLE_TMAX_INC
-		    set_bit_pin(fa.funct->f_maxtime_increased, 1);
-		} else {
-		    set_bit_pin(fa.funct->f_maxtime_increased, 0);
-#endif
+		switch (policy) {
+		case TP_FULL:
+		case TP_SAMPLED:
+		    // capture execution time of this funct
+		    end_time = rtapi_get_time();
+		    update_funct_time(fa.funct, end_time - fa.start_time);
+		    /* prepare to measure time for next funct */
+		    fa.start_time = end_time;
+		    break;
+		case TP_TSC:
+		    // raw clocks only, conversion deferred
+		    clk_end = rtapi_get_clocks();
+		    funct_entry->clocks = clk_end - clk_start;
+		    if (funct_entry->clocks > funct_entry->max_clocks)
+			funct_entry->max_clocks = funct_entry->clocks;
+		    clk_start = clk_end;
+		    break;
+		default:
+		    ;
 		}
 
 		// issue a write barrier if set in funct_entry or
@@ -94,15 +175,24 @@ static void thread_task(void *arg)
 
 		/* point to next next entry in list */
 		funct_entry = SHMPTR(funct_entry->links.next);
-		/* prepare to measure time for next funct */
-		fa.start_time = end_time;
 	    }
+	    // in the per-funct nsec policies the last funct's end time
+	    // doubles as thread end time
+	    if ((policy == TP_FULL) || (policy == TP_SAMPLED))
+		end_time = fa.start_time;
+	    else
+		end_time = rtapi_get_time();
+
 	    // update thread execution time in this period
 	    hal_s32_t rt = (end_time - fa.thread_start_time);
 	    set_s32_pin(thread->runtime, rt);
 	    if (rt > get_s32_pin(thread->maxtime)) {
 		set_s32_pin(thread->maxtime, rt);
 	    }
+
+	    // deferred clocks->nsec conversion, outside the measured runtime
+	    if ((policy == TP_TSC) && sample && (ns_per_clock > 0.0))
+		convert_funct_clocks(thread, ns_per_clock);
 	} else {
 	    // threads_running flag false:
 
@@ -150,10 +240,11 @@ int hal_create_xthread(const hal_threadargs_t *args)
     CHECK_STRLEN(args->name, HAL_NAME_LEN);
     CHECK_HALDATA();
     CHECK_LOCK(HAL_LOCK_CONFIG);
-    HALDBG("creating thread %s, %ld nsec fp=%d\n",
+    HALDBG("creating thread %s, %ld nsec fp=%d timing=%d\n",
 	   args->name,
 	   args->period_nsec,
-	   args->uses_fp);
+	   args->uses_fp,
+	   args->timing);
 
     if (args->period_nsec == 0) {
 	HALFAIL_RC(EINVAL,"create_thread called "
@@ -256,8 +347,19 @@ int hal_create_xthread(const hal_threadargs_t *args)
 							 lib_module_id,
 							 "%s.curr-period", args->name));
 
+	new->timing._sp = hal_off_safe(halg_pin_newf(0, HAL_S32, HAL_IO, NULL,
+						     lib_module_id,
+						     "%s.timing", args->name));
+	new->timing_interval._sp = hal_off_safe(halg_pin_newf(0, HAL_S32, HAL_IO, NULL,
+							      lib_module_id,
+							      "%s.timing-interval",
+							      args->name));
+
 	// expose nominal period for a start
 	set_s32_pin(new->curr_period, new->period);
+	set_s32_pin(new->timing, args->timing);
+	set_s32_pin(new->timing_interval, (args->timing_interval > 0) ?
+		    args->timing_interval : TP_DEFAULT_INTERVAL);
 
 	/* start task */
 	retval = rtapi_task_start(new->task_id, new->period);
@@ -287,6 +389,8 @@ int hal_create_thread(const char *name, unsigned long period_nsec,
 	.uses_fp = uses_fp,
 	.cpu_id = cpu_id,
 	.flags = 0,
+	.timing = TP_FULL,
+	.timing_interval = 0,
     };
     return hal_create_xthread(&args);
 }
@@ -296,6 +400,8 @@ static int delete_thread_cb(hal_object_ptr o, foreach_args_t *args)
     free_pin_struct(hal_ptr(o.thread->runtime._sp));
     free_pin_struct(hal_ptr(o.thread->maxtime._sp));
     free_pin_struct(hal_ptr(o.thread->curr_period._sp));
+    free_pin_struct(hal_ptr(o.thread->timing._sp));
+    free_pin_struct(hal_ptr(o.thread->timing_interval._sp));
     free_thread_struct(o.thread);
     return 0;
 }
@@ -50,6 +50,7 @@
 #include "halcmd_commands.h"
 #include "halcmd_rtapiapp.h"
 #include "rtapi_hexdump.h"
+#include "rtapi_startup.h"	/* startup span trace */
 
 #include <../include/machinetalk/protobuf/types.npb.h>
 
@@ -118,6 +119,7 @@ static int print_name(hal_object_ptr o, foreach_args_t *args);
 static int print_objects(char **patterns);
 static int print_mutexes(char **patterns);
 static int print_heap(char **patterns);
+static int print_startup(char **patterns);
 
 static int inst_count(const int use_halmutex, hal_comp_t *comp);
 
@@ -1080,6 +1082,8 @@ int do_show_cmd(char *type, char **patterns)
 	print_mutexes(patterns);
     } else if (strcmp(type, "heap") == 0) {
 	print_heap(patterns);
+    } else if (strcmp(type, "startup") == 0) {
+	print_startup(patterns);
     } else {
 	halcmd_error("Unknown 'show' type '%s'\n", type);
 	return -1;
@@ -2456,6 +2460,108 @@ static int print_mutexes(char **patterns)
     }
     return 0;
 }
+
+static int span_cmp(const void *a, const void *b)
+{
+    const rtapi_span_rec_t *sa = a, *sb = b;
+    if (sa->start != sb->start)
+	return sa->start < sb->start ? -1 : 1;
+    return sa->end < sb->end ? 1 : (sa->end > sb->end ? -1 : 0);
+}
+
+#define SPAN_BAR 40
+#define MSEC(ns) ((ns) / 1e6)
+
+// timeline of the spans recorded in global_data->startup_spans, times
+// in msec relative to rtapi_msgd start. The critical path is walked
+// back from the span ending last: its predecessor is the span which
+// ended last before it started, and started strictly earlier - so the
+// walk terminates even across zero-length spans. Gaps on the path are time no traced
+// activity accounts for - process startup, sleeps, polling.
+static int print_startup(char **patterns)
+{
+    extern global_data_t *global_data;
+    static rtapi_span_rec_t spans[RTAPI_STARTUP_SPANS];
+    int n = 0, i, j;
+
+    if (!MMAP_OK(global_data))
+	return -1;
+
+    for (i = 0; i < RTAPI_STARTUP_SPANS; i++) {
+	rtapi_span_rec_t *r = &global_data->startup_spans[i];
+	unsigned long seq = r->seq;
+	if (seq == 0)
+	    continue;
+	__sync_synchronize();
+	spans[n] = *r;
+	__sync_synchronize();
+	if (r->seq != seq)
+	    continue; // being overwritten
+	n++;
+    }
+    if (n == 0) {
+	halcmd_output("no startup trace recorded\n");
+	return 0;
+    }
+    qsort(spans, n, sizeof(spans[0]), span_cmp);
+
+    long long origin = global_data->boot_start ?
+	global_data->boot_start : spans[0].start;
+    long long last = 0;
+    int lastidx = 0;
+    for (i = 0; i < n; i++)
+	if (spans[i].end > last) {
+	    last = spans[i].end;
+	    lastidx = i;
+	}
+    double total = MSEC(last - origin);
+
+    if (scriptmode == 0) {
+	halcmd_output("Startup trace, boot id ");
+	for (i = 0; i < 16; i++)
+	    halcmd_output("%02x%s", global_data->boot_id[i],
+			  (i == 3 || i == 5 || i == 7 || i == 9) ? "-" : "");
+	halcmd_output(", %.1fms, %d spans%s:\n", total, n,
+		      global_data->next_span > RTAPI_STARTUP_SPANS ?
+		      " (oldest lost)" : "");
+	halcmd_output("%9s %9s %-16s %-32s\n",
+		      "start", "msec", "process", "span");
+    }
+    for (i = 0; i < n; i++) {
+	rtapi_span_rec_t *r = &spans[i];
+	char bar[SPAN_BAR + 1];
+	if (!match(patterns, r->name))
+	    continue;
+	int b = total > 0 ? MSEC(r->start - origin) / total * SPAN_BAR : 0;
+	int e = total > 0 ? MSEC(r->end - origin) / total * SPAN_BAR : 0;
+	for (j = 0; j < SPAN_BAR; j++)
+	    bar[j] = (j >= b && j <= e) ? '#' : ' ';
+	bar[SPAN_BAR] = '\0';
+	halcmd_output("%9.1f %9.1f %-16.16s %-32.32s |%s|\n",
+		      MSEC(r->start - origin), MSEC(r->end - r->start),
+		      r->proc, r->name, bar);
+    }
+
+    if (scriptmode == 0)
+	halcmd_output("\nCritical path, latest first:\n");
+    i = lastidx;
+    while (i >= 0) {
+	rtapi_span_rec_t *r = &spans[i];
+	int pred = -1;
+	for (j = 0; j < n; j++)
+	    if ((spans[j].end <= r->start) &&
+		(spans[j].start < r->start) &&
+		((pred < 0) || (spans[j].end > spans[pred].end)))
+		pred = j;
+	long long from = pred < 0 ? origin : spans[pred].end;
+	halcmd_output("%9.1f %9.1f %-16.16s %-32.32s gap %.1fms\n",
+		      MSEC(r->start - origin), MSEC(r->end - r->start),
+		      r->proc, r->name, MSEC(r->start - from));
+	i = pred;
+    }
+    return 0;
+}
+
 static int print_heap(char **patterns)
 {
     extern hal_data_t *hal_data;
@@ -2546,10 +2652,20 @@ static int print_thread_entry(hal_object_ptr o, foreach_args_t *args)
     if (match(patterns, ho_name(tptr))) {
 	// note that the scriptmode format string has no \n
 	// TODO FIXME add thread runtime and max runtime to this print
+	    static const char *timing_names[] = {
+		[TP_FULL] = "",
+		[TP_SAMPLED] = "sampled",
+		[TP_THREAD] = "thread",
+		[TP_TSC] = "tsc",
+	    };
+	    hal_s32_t timing = get_s32_pin(tptr->timing);
 	    char flags[100];
-	    snprintf(flags, sizeof(flags),"%s%s",
+	    snprintf(flags, sizeof(flags),"%s%s%s%s",
 		     tptr->flags & TF_NONRT ? "posix ":"",
-		     tptr->flags & TF_NOWAIT ? "nowait":"");
+		     tptr->flags & TF_NOWAIT ? "nowait ":"",
+		     (timing > TP_FULL) && (timing <= TP_TSC) ? "timing=" : "",
+		     (timing > TP_FULL) && (timing <= TP_TSC) ?
+		     timing_names[timing] : "");
 	halcmd_output(((scriptmode == 0) ?
 		       "%11ld  %-3s %-2d   %-40s  %8u, %8u %3ld%% %3ld%%  +/-%5.2f%% %s\n" :
 		       "%ld %s %d %s %u %u %3ld%% %3ld%% %.2f"),
@@ -4390,10 +4506,30 @@ int do_newthread_cmd(char *name, char *args[])
     char *s;
     int per = 1000000;
     int flags = 0;
+    int timing = TP_FULL;
+    int interval = 0;
+    char policy[20];
 
     for (i = 0; ((s = args[i]) != NULL) && strlen(s); i++) {
 	if (sscanf(s, "cpu=%d", &cpu) == 1)
 	    continue;
+	// timing=<full|sampled|thread|tsc>[:<interval>]
+	if (sscanf(s, "timing=%19[a-z]:%d", policy, &interval) >= 1) {
+	    if (strcmp(policy, "full") == 0)
+		timing = TP_FULL;
+	    else if (strcmp(policy, "sampled") == 0)
+		timing = TP_SAMPLED;
+	    else if (strcmp(policy, "thread") == 0)
+		timing = TP_THREAD;
+	    else if (strcmp(policy, "tsc") == 0)
+		timing = TP_TSC;
+	    else {
+		halcmd_error("timing policy '%s' invalid, expecting one of"
+			     " full, sampled, thread, tsc\n", policy);
+		return -EINVAL;
+	    }
+	    continue;
+	}
 	if (strcmp(s, "fp") == 0) {
 	    use_fp = true;
 	    continue;
@@ -4424,7 +4560,8 @@ int do_newthread_cmd(char *name, char *args[])
 	halcmd_info("specifying 'nowait' without 'posix' makes it easy to lock up RT\n");
     }
 
-    retval = rtapi_newthread(rtapi_instance, name, per, cpu, (int)use_fp, flags);
+    retval = rtapi_newthread(rtapi_instance, name, per, cpu, (int)use_fp, flags,
+			     timing, interval);
     if (retval)
 	halcmd_error("rc=%d: %s\n",retval,rtapi_rpcerror());
 
@@ -4569,6 +4706,8 @@ int do_help_cmd(char *command)
 	printf("  'all' with no pattern.  If 'pattern' is specified\n");
 	printf("  it prints only those items whose names match the\n");
 	printf("  pattern, which may be a 'shell glob'.\n");
+	printf("  'show startup' prints the startup trace of this instance\n");
+	printf("  as a timeline, followed by its critical path.\n");
     } else if (strcmp(command, "list") == 0) {
 	printf("list type [pattern]\n");
 	printf("  Prints the names of HAL items of the specified type.\n");
@@ -4596,6 +4735,22 @@ int do_help_cmd(char *command)
 	printf("  or 'thread'.  ('linka' and 'neta' show arrows for pin\n");
 	printf("  direction.)  If 'type' is omitted or 'all', does the\n");
 	printf("  equivalent of 'comp', 'netl', 'param', and 'thread'.\n");
+    } else if (strcmp(command, "newthread") == 0) {
+	printf("newthread name [period] [fp|nofp] [cpu=n] [posix] [nowait]\n");
+	printf("          [timing=policy[:interval]]\n");
+	printf("  Creates a realtime thread 'name' running every 'period'\n");
+	printf("  nanoseconds (default 1000000). 'timing' selects how the\n");
+	printf("  functs of the thread are timed:\n");
+	printf("    full     time every funct every cycle (default)\n");
+	printf("    sampled  time the functs every 'interval' cycles only\n");
+	printf("    thread   time the thread as a whole, funct pins not updated\n");
+	printf("    tsc      count raw clocks per funct, converted to ns\n");
+	printf("             every 'interval' cycles\n");
+	printf("  'interval' defaults to 100. Both can be changed later through\n");
+	printf("  the <name>.timing and <name>.timing-interval pins.\n");
+    } else if (strcmp(command, "delthread") == 0) {
+	printf("delthread name|all\n");
+	printf("  Deletes realtime thread 'name', or all threads.\n");
     } else if (strcmp(command, "start") == 0) {
 	printf("start\n");
 	printf("  Starts all realtime threads.\n");
@@ -4661,6 +4816,7 @@ static void print_help_commands(void)
     printf("  source              Execute commands from another .hal file\n");
     printf("  status              Display status information\n");
     printf("  save                Print config as commands\n");
+    printf("  newthread, delthread Create/delete a realtime thread\n");
     printf("  start, stop         Start/stop realtime threads\n");
     printf("  alias, unalias      Add or remove pin or parameter name aliases\n");
     printf("  echo, unecho        Echo commands from stdin to stderr\n");
@@ -70,7 +70,7 @@ static const char *nonRT_command_table[] = {
 
 static const char *show_table[] = {
     "all", "comp", "pin", "sig", "param", "funct", "thread", "group", "member",
-    "ring", "eps","vtable","inst",
+    "ring", "eps","vtable","inst", "startup",
     NULL,
 };
 
@@ -45,6 +45,7 @@
 #include "halcmd_commands.h"
 #include "halcmd_completion.h"
 #include "halcmd_rtapiapp.h"
+#include "rtapi_startup.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -64,6 +65,7 @@
 #define CMD_BUF_LEN 200
 
 static int get_input(FILE *srcfile, char *buf, size_t bufsize);
+static void preload_modules(FILE *srcfile);
 static void print_help_general(int showR);
 static int release_HAL_mutex(void);
 static int propose_completion(char *all, char *fragment, int start);
@@ -94,6 +96,9 @@ int main(int argc, char **argv)
     char *uri = NULL; // NULL - use service discovery
     char *service_uuid = NULL; // must have a global uuid
     int strdupped_uuid = 0;
+    int timing = 0;
+    struct timespec t0, t1;
+    rtapi_span_t span;
 
     inifile = getenv("MACHINEKIT_INI");
     /* use default if not specified by user */
@@ -112,7 +117,7 @@ int main(int argc, char **argv)
     keep_going = 0;
     /* start parsing the command line, options first */
     while(1) {
-        c = getopt(argc, argv, "+RCfi:kqQsvVhu:U:P");
+        c = getopt(argc, argv, "+RCfi:kqQstvVhu:U:P");
         if(c == -1) break;
         switch(c) {
             case 'R':
@@ -148,6 +153,9 @@ int main(int argc, char **argv)
 		/* script friendly mode */
 		scriptmode = 1;
 		break;
+	    case 't':
+		timing = 1;
+		break;
 	    case 'v':
 		/* -v = verbose */
 		rtapi_set_msg_level(RTAPI_MSG_INFO);
@@ -275,6 +283,10 @@ int main(int argc, char **argv)
         }
     }
 
+    if (filename) {
+	const char *base = strrchr(filename, '/');
+	rtapi_span_begin(&span, "halcmd %s", base ? base + 1 : filename);
+    }
     if ( halcmd_startup(0, uri, service_uuid) != 0 ){
         if(strdupped_uuid)
             cleanup(service_uuid);
@@ -316,10 +328,14 @@ int main(int argc, char **argv)
             }
         }
     } else {
+	if (srcfile != stdin)
+	    preload_modules(srcfile);
 	/* read command line(s) from 'srcfile' */
 	while (get_input(srcfile, raw_buf, CMD_BUF_LEN)) {
 	    char *tokens[MAX_TOK+1];
 	    halcmd_set_linenumber(linenumber++);
+	    if (timing)
+		clock_gettime(CLOCK_MONOTONIC, &t0);
 	    /* remove comments, do var substitution, and tokenise */
 	    retval = halcmd_preprocess_line(raw_buf, tokens);
         if(echo_mode) { 
@@ -333,6 +349,14 @@ int main(int argc, char **argv)
 		}
 		/* process command */
 		retval = halcmd_parse_cmd(tokens);
+		if (timing) {
+		    clock_gettime(CLOCK_MONOTONIC, &t1);
+		    fprintf(stderr, "%s:%d: %.1fms %s\n",
+			    filename ? filename : "<stdin>", linenumber - 1,
+			    (t1.tv_sec - t0.tv_sec) * 1e3 +
+			    (t1.tv_nsec - t0.tv_nsec) / 1e6,
+			    tokens[0]);
+		}
 	    }
 	    /* did a signal happen while we were busy? */
 	    if ( halcmd_done ) {
@@ -350,6 +374,8 @@ int main(int argc, char **argv)
 	    }
 	}
     }
+    if (filename)
+	rtapi_span_end(&span);
     /* all done */
     if (!scriptmode && srcfile == stdin && isatty(0)) {
 	halcmd_save_history();
@@ -449,6 +475,7 @@ static void print_help_general(int showR)
     printf("  -R             Release mutex (for crash recovery only).\n");
     }
     printf("  -s             Script friendly - don't print headers on output.\n");
+    printf("  -t             Print the time each command took to stderr.\n");
     printf("  -v             Verbose - print result of every command.\n");
     printf("  -V             Very verbose - print lots of junk.\n");
     printf("  -h             Help - print this help screen and exit.\n\n");
@@ -460,6 +487,49 @@ static void print_help_general(int showR)
     printf("  help command   Prints detailed help for 'command'\n\n");
 }
 
+/* tell rtapi_app which modules the file is going to loadrt, so it can
+   read them ahead while the commands before each loadrt execute. Only
+   literal module names are collected; names built from variables or
+   ini values are left to loadrt proper. The file is rewound.
+*/
+#define MAX_PRELOAD 256
+
+static void preload_modules(FILE *srcfile)
+{
+    char buf[CMD_BUF_LEN+1];
+    char *names[MAX_PRELOAD+1];
+    int n = 0, i;
+    long pos = ftell(srcfile);
+
+    if (pos < 0)
+	return; /* not seekable */
+
+    while ((n < MAX_PRELOAD) && fgets(buf, sizeof(buf), srcfile)) {
+	char *cp = buf, *name;
+	while (isspace(*cp))
+	    cp++;
+	if ((strncmp(cp, "loadrt", 6) != 0) || !isspace(cp[6]))
+	    continue;
+	cp += 6;
+	while (isspace(*cp))
+	    cp++;
+	name = cp;
+	while (*cp && !isspace(*cp) && (*cp != '#'))
+	    cp++;
+	*cp = '\0';
+	if ((*name == '\0') || strpbrk(name, "$[]"))
+	    continue;
+	names[n++] = strdup(name);
+    }
+    names[n] = NULL;
+    fseek(srcfile, pos, SEEK_SET);
+
+    if (n > 0)
+	rtapi_preload(rtapi_instance, (const char **)names);
+    for (i = 0; i < n; i++)
+	free(names[i]);
+}
+
 #ifdef HAVE_READLINE
 #include "halcmd_completion.h"
 
@@ -158,6 +158,26 @@ int rtapi_unloadrt(int instance, const char *modname)
     return rtapi_loadop(machinetalk::MT_RTAPI_APP_UNLOADRT, instance, modname, NULL);
 }
 
+int rtapi_preload(int instance, const char **modnames)
+{
+    machinetalk::RTAPICommand *cmd;
+    command.Clear();
+    command.set_type(machinetalk::MT_RTAPI_APP_PRELOAD);
+    cmd = command.mutable_rtapicmd();
+    cmd->set_instance(instance);
+
+    int argc = 0;
+    if (modnames)
+	while(modnames[argc] && *modnames[argc]) {
+	    cmd->add_argv(modnames[argc]);
+	    argc++;
+	}
+    int retval = rtapi_rpc(z_command, command, reply);
+    if (retval)
+	return retval;
+    return reply.retcode();
+}
+
 int rtapi_shutdown(int instance)
 {
     machinetalk::RTAPICommand *cmd;
@@ -188,7 +208,8 @@ int rtapi_ping(int instance)
     return reply.retcode();
 }
 
-int rtapi_newthread(int instance, const char *name, int period, int cpu, int use_fp, int flags)
+int rtapi_newthread(int instance, const char *name, int period, int cpu, int use_fp, int flags,
+		    int timing, int timing_interval)
 {
     machinetalk::RTAPICommand *cmd;
     command.Clear();
@@ -200,6 +221,8 @@ int rtapi_newthread(int instance, const char *name, int period, int cpu, int use
     cmd->set_cpu(cpu);
     cmd->set_use_fp(use_fp);
     cmd->set_flags(flags);
+    cmd->set_timing_policy(timing);
+    cmd->set_timing_interval(timing_interval);
 
     int retval = rtapi_rpc(z_command, command, reply);
     if (retval)
@@ -8,10 +8,14 @@ extern "C" {
     int rtapi_connect(int instance, char *uri, const char *svc_uuid);
     int rtapi_loadrt(int instance, const char *modname, const char **args);
     int rtapi_unloadrt(int instance, const char *modname);
+    // hint which modules a file is going to load, so rtapi_app can
+    // read them ahead. NULL-terminated list.
+    int rtapi_preload(int instance, const char **modnames);
     int rtapi_shutdown(int instance);
     int rtapi_ping(int instance);
     int rtapi_newthread(int instance, const char *name, int period,
-			int cpu, int use_fp, int flags);
+			int cpu, int use_fp, int flags,
+			int timing, int timing_interval);
     int rtapi_delthread(int instance, const char *name);
     int rtapi_callfunc(int instance,
 		       const char *func,
@@ -91,7 +91,9 @@ static int heartbeat(gpointer data);
 static void rm_normal_button_clicked(GtkWidget * widget, gpointer * gdata);
 static void rm_single_button_clicked(GtkWidget * widget, gpointer * gdata);
 static void rm_roll_button_clicked(GtkWidget * widget, gpointer * gdata);
+static void rm_stream_button_clicked(GtkWidget * widget, gpointer * gdata);
 static void rm_stop_button_clicked(GtkWidget * widget, gpointer * gdata);
+static void run_mode_changed(void);
 
 /***********************************************************************
 *                        MAIN() FUNCTION                               *
@@ -197,6 +199,7 @@ int main(int argc, gchar * argv[])
     init_vert();
     init_trig();
     init_display();
+    init_stream();
     init_run_mode_window();
     /* register signal handlers for ctrl-C and SIGTERM */
     signal(SIGINT, quit);
@@ -251,6 +254,11 @@ static int heartbeat(gpointer data)
             gtk_window_set_urgency_hint(GTK_WINDOW(ctrl_usr->main_win), TRUE);
 	capture_complete();
     } else if (ctrl_usr->run_mode == ROLL) capture_cont();
+    else if (ctrl_shm->state == STREAMING) {
+	/* move the new samples into the envelopes and show them */
+	stream_poll();
+	refresh_display();
+    }
     return 1;
 }
 
@@ -261,6 +269,7 @@ scope_chan_t *chan;
 hal_pin_t *pin;
 hal_sig_t *sig;
 hal_param_t *param;
+int stream_view;
 
     if (ctrl_shm->state != IDLE) {
 	/* already running! */
@@ -330,6 +339,17 @@ hal_param_t *param;
 	}
     }
     ctrl_shm->pre_trig = (ctrl_shm->rec_len-2) * ctrl_usr->trig.position;
+    stream_view = ctrl_usr->stream_view;
+    ctrl_shm->stream = (ctrl_usr->run_mode == STREAM);
+    if (ctrl_shm->stream) {
+	stream_start();
+    } else {
+	ctrl_usr->stream_view = 0;
+    }
+    if (ctrl_usr->stream_view != stream_view) {
+	/* the horizontal scale differs between the two kinds of display */
+	set_horiz_zoom(ctrl_usr->horiz.zoom_setting);
+    }
     ctrl_shm->state = INIT;
 }
 
@@ -523,11 +543,41 @@ static void save_configuration(int junk) {
 }
 
 
+static void do_record_stream(GtkWidget *w, GtkFileSelection *fs) {
+    stream_export_start((char *) gtk_file_selection_get_filename(fs));
+}
+
+static void record_stream(int junk) {
+    GtkWidget *filew;
+    if (stream_exporting()) {
+        /* second activation ends the recording */
+        stream_export_stop();
+        return;
+    }
+    filew = gtk_file_selection_new(_("Record Stream to File:"));
+    gtk_signal_connect (GTK_OBJECT (filew), "destroy",
+        (GtkSignalFunc) gtk_widget_destroy, &filew);
+    gtk_signal_connect (GTK_OBJECT (GTK_FILE_SELECTION (filew)->ok_button),
+                        "clicked", (GtkSignalFunc) do_record_stream, filew );
+    //link ok to destroy, otherwise the window stays open
+    gtk_signal_connect_object (GTK_OBJECT (GTK_FILE_SELECTION
+                                            (filew)->ok_button),
+                               "clicked", (GtkSignalFunc) gtk_widget_destroy,
+                               GTK_OBJECT (filew));
+    gtk_signal_connect_object (GTK_OBJECT (GTK_FILE_SELECTION
+                                            (filew)->cancel_button),
+                               "clicked", (GtkSignalFunc) gtk_widget_destroy,
+                               GTK_OBJECT (filew));
+    gtk_file_selection_set_select_multiple(GTK_FILE_SELECTION(filew), FALSE);
+    gtk_file_selection_hide_fileop_buttons (GTK_FILE_SELECTION(filew) );
+    gtk_dialog_run(GTK_DIALOG(filew));
+}
+
 static void define_menubar(GtkWidget *vboxtop) {
     GtkWidget *file_rootmenu, *help_rootmenu;
     GtkWidget *menubar, *filemenu, 
               *fileopenconfiguration, *filesaveconfiguration, 
-              *fileopendatafile, *filesavedatafile,
+              *fileopendatafile, *filesavedatafile, *filerecordstream,
               *filequit, *sep1, *sep2;
     GtkWidget *helpmenu, *helpabout;
     GtkWidget *vbox;
@@ -564,6 +614,12 @@ static void define_menubar(GtkWidget *vboxtop) {
     gtk_signal_connect_object(GTK_OBJECT(filesavedatafile), "activate", 
             GTK_SIGNAL_FUNC(log_popup), 0);
     gtk_widget_show(filesavedatafile);
+
+    filerecordstream = gtk_menu_item_new_with_mnemonic(_("_Record Stream..."));
+    gtk_menu_append(GTK_MENU(filemenu), filerecordstream);
+    gtk_signal_connect_object(GTK_OBJECT(filerecordstream), "activate", 
+            GTK_SIGNAL_FUNC(record_stream), 0);
+    gtk_widget_show(filerecordstream);
     
     gtk_menu_append(GTK_MENU(filemenu), sep2);
     gtk_widget_show(sep2);
@@ -712,6 +768,9 @@ static void init_run_mode_window(void)
     ctrl_usr->rm_roll_button =
 	gtk_radio_button_new_with_label(gtk_radio_button_group
 	(GTK_RADIO_BUTTON(ctrl_usr->rm_stop_button)), _("Roll"));
+    ctrl_usr->rm_stream_button =
+	gtk_radio_button_new_with_label(gtk_radio_button_group
+	(GTK_RADIO_BUTTON(ctrl_usr->rm_stop_button)), _("Stream"));
     /* now put them into the box */
     gtk_box_pack_start(GTK_BOX(ctrl_usr->run_mode_win),
 	ctrl_usr->rm_normal_button, FALSE, FALSE, 0);
@@ -719,6 +778,8 @@ static void init_run_mode_window(void)
 	ctrl_usr->rm_single_button, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(ctrl_usr->run_mode_win),
 	ctrl_usr->rm_roll_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(ctrl_usr->run_mode_win),
+	ctrl_usr->rm_stream_button, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(ctrl_usr->run_mode_win),
 	ctrl_usr->rm_stop_button, FALSE, FALSE, 0);
     /* hook callbacks to buttons */
@@ -728,12 +789,17 @@ static void init_run_mode_window(void)
 	GTK_SIGNAL_FUNC(rm_single_button_clicked), NULL);
     gtk_signal_connect(GTK_OBJECT(ctrl_usr->rm_roll_button), "clicked",
 	GTK_SIGNAL_FUNC(rm_roll_button_clicked), NULL);
+    gtk_signal_connect(GTK_OBJECT(ctrl_usr->rm_stream_button), "clicked",
+	GTK_SIGNAL_FUNC(rm_stream_button_clicked), NULL);
     gtk_signal_connect(GTK_OBJECT(ctrl_usr->rm_stop_button), "clicked",
 	GTK_SIGNAL_FUNC(rm_stop_button_clicked), NULL);
     /* and make them visible */
     gtk_widget_show(ctrl_usr->rm_normal_button);
     gtk_widget_show(ctrl_usr->rm_single_button);
     gtk_widget_show(ctrl_usr->rm_roll_button);
+    /* stream mode needs the ring from scope_rt */
+    gtk_widget_set_sensitive(ctrl_usr->rm_stream_button, stream_available());
+    gtk_widget_show(ctrl_usr->rm_stream_button);
     gtk_widget_show(ctrl_usr->rm_stop_button);
 }
 
@@ -759,6 +825,7 @@ static void init_run_mode_window(void)
 
 static void exit_from_hal(void)
 {
+    close_stream();
     rtapi_shmem_delete(shm_id, comp_id);
     hal_exit(comp_id);
 }
@@ -795,6 +862,9 @@ int set_run_mode(int mode)
 	/* roll mode */
 	button = ctrl_usr->rm_roll_button;
 #endif
+    } else if ( mode == 4 && stream_available() ) {
+	/* continuous mode */
+	button = ctrl_usr->rm_stream_button;
     } else {
 	/* illegal mode */
 	return -1;
@@ -810,9 +880,7 @@ static void rm_normal_button_clicked(GtkWidget * widget, gpointer * gdata)
 	return;
     }
     ctrl_usr->run_mode = NORMAL;
-    if (ctrl_shm->state == IDLE) {
-	start_capture();
-    }
+    run_mode_changed();
 }
 
 static void rm_single_button_clicked(GtkWidget * widget, gpointer * gdata)
@@ -822,9 +890,7 @@ static void rm_single_button_clicked(GtkWidget * widget, gpointer * gdata)
 	return;
     }
     ctrl_usr->run_mode = SINGLE;
-    if (ctrl_shm->state == IDLE) {
-	start_capture();
-    }
+    run_mode_changed();
 }
 
 static void rm_roll_button_clicked(GtkWidget * widget, gpointer * gdata)
@@ -834,9 +900,17 @@ static void rm_roll_button_clicked(GtkWidget * widget, gpointer * gdata)
 	return;
     }
     ctrl_usr->run_mode = ROLL;
-    if (ctrl_shm->state == IDLE) {
-	start_capture();
+    run_mode_changed();
+}
+
+static void rm_stream_button_clicked(GtkWidget * widget, gpointer * gdata)
+{
+    if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) != TRUE) {
+	/* not pressed, ignore it */
+	return;
     }
+    ctrl_usr->run_mode = STREAM;
+    run_mode_changed();
 }
 
 static void rm_stop_button_clicked(GtkWidget * widget, gpointer * gdata)
@@ -850,6 +924,19 @@ static void rm_stop_button_clicked(GtkWidget * widget, gpointer * gdata)
 	ctrl_shm->state = RESET;
     }
     ctrl_usr->run_mode = STOP;
+    /* a recording ends with the stream */
+    stream_export_stop();
+}
+
+/* start sampling in the newly selected run mode; a capture of the
+   other kind (triggered record vs. stream) is stopped and restarted */
+static void run_mode_changed(void)
+{
+    if (ctrl_shm->state == IDLE) {
+	start_capture();
+    } else if ((ctrl_shm->state == STREAMING) != (ctrl_usr->run_mode == STREAM)) {
+	prepare_scope_restart();
+    }
 }
 
 void prepare_scope_restart(void) {
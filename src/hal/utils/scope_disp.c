@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <math.h>
 
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "hal.h"		/* HAL public API decls */
@@ -63,6 +64,8 @@ static void update_readout(void);
 static void draw_grid(void);
 static void draw_baseline(int chan_num, int highlight);
 static void draw_waveform(int chan_num, int highlight);
+static void draw_envelope(int chan_num, int highlight);
+static void draw_label(int chan_num, int y);
 static void draw_triggerline(int chan_num, int highlight);
 static void handle_window_expose(GtkWidget * widget, gpointer data);
 static int handle_click(GtkWidget *widget, GdkEventButton *event, gpointer data);
@@ -82,6 +85,8 @@ static int cursor_valid = 0;
 static double cursor_time = 0;
 static double cursor_prev_value = 0.;
 static double cursor_value = 0;
+static double stream_first;	/* first sample on screen, stream view */
+static double stream_width;	/* samples on screen, stream view */
 
 void init_display(void)
 {
@@ -223,6 +228,20 @@ void refresh_display(void)
     if (disp->end_sample > ctrl_shm->rec_len - 1) {
 	disp->end_sample = ctrl_shm->rec_len - 1;
     }
+    if (ctrl_usr->stream_view && horiz->sample_period > 0.0) {
+	long long first, end;
+	double hidden;
+
+	/* the position slider scrolls back through the stream history,
+	   all the way right shows the newest samples */
+	stream_span(&first, &end);
+	stream_width = 10.0 * horiz->disp_scale / horiz->sample_period;
+	hidden = end - first - stream_width;
+	if (hidden < 0.0) {
+	    hidden = 0.0;
+	}
+	stream_first = end - stream_width - (1.0 - horiz->pos_setting) * hidden;
+    }
 
     {
         GdkRectangle rect = {0, 0, disp->width, disp->height};
@@ -237,7 +256,7 @@ void refresh_display(void)
 
     /* calculate offsets for AC-offset channels */
     for (n = 0; n < 16; n++) {
-        if (vert->chan_enabled[n]) calculate_offset(n);
+        if (vert->chan_enabled[n] && !ctrl_usr->stream_view) calculate_offset(n);
     }
 
     /* draw baselines first */
@@ -258,6 +277,21 @@ void refresh_display(void)
 
     conflict_reset(disp->height);
 
+    if (ctrl_usr->stream_view) {
+	/* envelopes instead of samples, same drawing order */
+	for (n = 0; n < 16; n++) {
+	    if ((vert->chan_enabled[n]) && (n + 1 != vert->selected)) {
+		draw_envelope(n + 1, FALSE);
+	    }
+	}
+	if (vert->chan_enabled[vert->selected - 1]) {
+	    draw_envelope(vert->selected, TRUE);
+	}
+	update_readout();
+	gdk_window_end_paint(disp->drawing->window);
+	return;
+    }
+
     /* draw non-highlighted waveforms next */
     for (n = 0; n < 16; n++) {
 	if ((vert->chan_enabled[n]) && (vert->data_offset[n] >= 0)
@@ -910,32 +944,96 @@ void draw_waveform(int chan_num, int highlight)
     }
     if(pn) {
         lines(chan_num, points, pn);
-        if(DRAWING) {
-            PangoLayout *p;
-            int y = points[0].y;
-            char scale[HAL_NAME_LEN];
-            char buffer[2 * HAL_NAME_LEN];
-            int h;
-            PangoRectangle r;
-
-            format_scale_value(scale, sizeof(scale), chan->scale);
-            snprintf(buffer, sizeof(buffer), "%s\n%s", chan->name, scale);
-            p=gtk_widget_create_pango_layout(disp->drawing, buffer);
-            pango_layout_get_extents(p, NULL, &r);
-            h = PANGO_PIXELS(r.height);
-
-            if(y < 0 || y+h > disp->height)
-                // if the first sample isn't visible, try the zero value
-                y = (0-yfoffset) * yscale + ypoffset;
-            if(y < 0 || y+h > disp->height)
-                // if that's not visible either, try the offset value
-                y = ypoffset;
-
-            conflict_avoid(&y, h);
-            gdk_draw_layout(disp->win, disp->context, 5, y, p);
-            g_object_unref(p);
+        if(DRAWING) draw_label(chan_num, points[0].y);
+    }
+}
+
+/* stream view: a vertical min-max stroke per pixel column, joined
+   into one polyline so a steady signal is still a thin line */
+void draw_envelope(int chan_num, int highlight)
+{
+    scope_disp_t *disp = &(ctrl_usr->disp);
+    scope_chan_t *chan = &(ctrl_usr->chan[chan_num - 1]);
+    double yscale = disp->height / (-10.0 * chan->scale);
+    double yfoffset = chan->vert_offset;
+    double ypoffset = chan->position * disp->height;
+    int x, ymin, ymax, pn, label_y = 0, labeled = 0;
+    float *mins, *maxs;
+    GdkPoint *points;
+
+    cursor_valid = 0;
+    if (disp->width <= 0) return;
+    mins = alloca(disp->width * sizeof(float));
+    maxs = alloca(disp->width * sizeof(float));
+    points = alloca(2 * disp->width * sizeof(GdkPoint));
+    if (stream_envelope(chan_num - 1, stream_first, stream_width,
+            disp->width, mins, maxs) < 0) {
+        return;
+    }
+
+    if (highlight) {
+	gdk_gc_set_foreground(disp->context, &(disp->color_selected[chan_num-1]));
+    } else {
+	gdk_gc_set_foreground(disp->context, &(disp->color_normal[chan_num-1]));
+    }
+
+    pn = 0;
+    for (x = 0; x <= disp->width; x++) {
+        if (x == disp->width || isnan(mins[x])) {
+            /* end of data or a gap, flush what we have */
+            if (pn > 1) {
+                lines(chan_num, points, pn);
+            } else if (pn == 1) {
+                line(chan_num, points[0].x, points[0].y,
+                    points[0].x, points[0].y);
+            }
+            pn = 0;
+            continue;
+        }
+        ymax = COORDINATE_CLIP(((maxs[x] - yfoffset) * yscale) + ypoffset);
+        ymin = COORDINATE_CLIP(((mins[x] - yfoffset) * yscale) + ypoffset);
+        points[pn].x = x; points[pn].y = ymax; pn++;
+        if (ymin != ymax) {
+            points[pn].x = x; points[pn].y = ymin; pn++;
+        }
+        if (!labeled) {
+            label_y = ymax;
+            labeled = 1;
         }
     }
+    if (labeled && DRAWING) draw_label(chan_num, label_y);
+}
+
+/* channel name and scale, near y if that is on screen */
+static void draw_label(int chan_num, int y)
+{
+    scope_disp_t *disp = &(ctrl_usr->disp);
+    scope_chan_t *chan = &(ctrl_usr->chan[chan_num - 1]);
+    double yscale = disp->height / (-10.0 * chan->scale);
+    double yfoffset = chan->vert_offset;
+    double ypoffset = chan->position * disp->height;
+    PangoLayout *p;
+    char scale[HAL_NAME_LEN];
+    char buffer[2 * HAL_NAME_LEN];
+    int h;
+    PangoRectangle r;
+
+    format_scale_value(scale, sizeof(scale), chan->scale);
+    snprintf(buffer, sizeof(buffer), "%s\n%s", chan->name, scale);
+    p=gtk_widget_create_pango_layout(disp->drawing, buffer);
+    pango_layout_get_extents(p, NULL, &r);
+    h = PANGO_PIXELS(r.height);
+
+    if(y < 0 || y+h > disp->height)
+        // if the first sample isn't visible, try the zero value
+        y = (0-yfoffset) * yscale + ypoffset;
+    if(y < 0 || y+h > disp->height)
+        // if that's not visible either, try the offset value
+        y = ypoffset;
+
+    conflict_avoid(&y, h);
+    gdk_draw_layout(disp->win, disp->context, 5, y, p);
+    g_object_unref(p);
 }
 
 static int ch=0;
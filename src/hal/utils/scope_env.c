@@ -0,0 +1,121 @@
+/** This file, 'scope_env.c', implements the min/max envelopes of the
+    stream mode of halscope, see 'scope_env.h'.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include <math.h>
+
+#include "scope_env.h"
+
+/***********************************************************************
+*                       PUBLIC FUNCTIONS                               *
+************************************************************************/
+
+void env_push(scope_env_t * e, long long count, float v)
+{
+    env_bucket_t b;
+    long long j;
+    int k;
+
+    b.min = b.max = v;
+    j = count;
+    e->level[0][j & ENV_MASK] = b;
+    /* b is now a complete bucket 'j' of level k-1, merge it into
+       level k, and carry on up while that completes a bucket */
+    for (k = 1; k < ENV_LEVELS; k++) {
+	if ((j & 3) == 0) {
+	    e->acc[k] = b;
+	} else {
+	    e->acc[k].min = fminf(e->acc[k].min, b.min);
+	    e->acc[k].max = fmaxf(e->acc[k].max, b.max);
+	}
+	if ((j & 3) != 3) {
+	    break;
+	}
+	j >>= 2;
+	b = e->acc[k];
+	e->level[k][j & ENV_MASK] = b;
+    }
+}
+
+void env_span(long long count, long long *first, long long *end)
+{
+    long long top;
+
+    top = ENV_SAMPLE((long long) ENV_LEN, ENV_LEVELS - 1);
+    *end = count;
+    *first = count > top ? count - top : 0;
+}
+
+void env_query(scope_env_t * e, long long count, double first,
+    double span, int cols, float *min, float *max)
+{
+    double per, s0;
+    long long b, b0, b1, n, lo;
+    int c, k, kmin;
+
+    per = span / cols;
+    /* the coarsest level whose buckets still fit in one column */
+    kmin = 0;
+    while (kmin < ENV_LEVELS - 1 && ENV_SAMPLE(4LL, kmin) <= per) {
+	kmin++;
+    }
+    k = ENV_LEVELS - 1;
+    for (c = 0; c < cols; c++) {
+	min[c] = max[c] = NAN;
+	s0 = first + c * per;
+	if (s0 + per <= 0 || s0 >= count) {
+	    continue;
+	}
+	/* columns go from old to new, so the level only gets finer */
+	while (k > kmin) {
+	    n = count >> (2 * (k - 1));
+	    lo = n > ENV_LEN ? n - ENV_LEN : 0;
+	    if (s0 < ENV_SAMPLE(lo, k - 1)) {
+		break;
+	    }
+	    k--;
+	}
+	n = count >> (2 * k);
+	lo = n > ENV_LEN ? n - ENV_LEN : 0;
+	b0 = floor(s0 / ENV_SAMPLE(1LL, k));
+	b1 = ceil((s0 + per) / ENV_SAMPLE(1LL, k));
+	if (b1 <= b0) {
+	    b1 = b0 + 1;
+	}
+	if (b0 < lo) {
+	    b0 = lo;
+	}
+	if (b1 > n) {
+	    b1 = n;
+	}
+	for (b = b0; b < b1; b++) {
+	    min[c] = fminf(min[c], e->level[k][b & ENV_MASK].min);
+	    max[c] = fmaxf(max[c], e->level[k][b & ENV_MASK].max);
+	}
+    }
+}
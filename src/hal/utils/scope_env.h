@@ -0,0 +1,81 @@
+#ifndef SCOPE_ENV_H
+#define SCOPE_ENV_H
+/** This file, 'scope_env.h', declares the min/max envelopes that
+    the stream mode of halscope (scope_stream.c) keeps of each
+    channel.  They don't depend on GTK or HAL, so they can be tested
+    on their own.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+/***********************************************************************
+*                         TYPEDEFS AND DEFINES                         *
+************************************************************************/
+
+/* An envelope is a pyramid of ENV_LEVELS circular arrays of min/max
+   buckets.  A bucket of level 'k' covers 4^k samples, and is built by
+   merging four buckets of level k-1 as soon as the last of them is
+   complete, so the cost per sample is constant.  Each level keeps the
+   ENV_LEN newest buckets; the fine levels therefore only cover the
+   recent past, while the top level spans ENV_LEN * 4^(ENV_LEVELS-1)
+   samples (hours even at high sample rates).  A query picks, per
+   pixel column, the finest level that still holds the data and whose
+   buckets are no wider than the column, so drawing costs O(width),
+   whatever the zoom.  NaN samples (a gap) are ignored by the min/max,
+   a bucket of only NaNs is NaN. */
+
+#define ENV_LEVELS 12
+#define ENV_LEN 8192		/* buckets per level, must be 2^n */
+#define ENV_MASK (ENV_LEN - 1)
+
+/* first sample covered by bucket 'b' of level 'k' */
+#define ENV_SAMPLE(b, k) ((b) << (2 * (k)))
+
+typedef struct {
+    float min, max;
+} env_bucket_t;
+
+typedef struct {
+    env_bucket_t *level[ENV_LEVELS];	/* ENV_LEN buckets each */
+    env_bucket_t acc[ENV_LEVELS];	/* bucket being built per level */
+} scope_env_t;
+
+/***********************************************************************
+*                    PUBLIC FUNCTION DECLARATIONS                      *
+************************************************************************/
+
+/* add sample number 'count' (the number pushed before) */
+void env_push(scope_env_t * e, long long count, float v);
+
+/* range of samples held once 'count' were pushed, [*first, *end) */
+void env_span(long long count, long long *first, long long *end);
+
+/* min/max over 'cols' equal slices of the samples [first, first + span)
+   once 'count' were pushed; slices without data are NaN */
+void env_query(scope_env_t * e, long long count, double first,
+    double span, int cols, float *min, float *max);
+
+#endif /* SCOPE_ENV_H */
@@ -78,7 +78,7 @@
    TPOS <float>		0.0-1.0, trigger position setting
    TPOLAR <enum>	triger polarity, RISE or FALL
    TMODE <int>		0 = normal trigger, 1 = auto trigger
-   RMODE <int>		0 = stop, 1 = norm, 2 = single, 3 = roll
+   RMODE <int>		0 = stop, 1 = norm, 2 = single, 3 = roll, 4 = stream
   
 */
 
@@ -227,6 +227,8 @@ void write_config_file (char *filename)
     } else if ( ctrl_usr->run_mode == ROLL ) {
 	fprintf(fp, "RMODE 3\n" );
 #endif
+    } else if ( ctrl_usr->run_mode == STREAM ) {
+	fprintf(fp, "RMODE 4\n" );
     } else {
 	/* stop mode */
 	fprintf(fp, "RMODE 0\n" );
@@ -290,11 +290,12 @@ void refresh_state_info(void)
 	"TRIGGER?",
 	"TRIGGERED",
 	"DONE",
-	"RESET"
+	"RESET",
+	"STREAM"
     };
 
     horiz = &(ctrl_usr->horiz);
-    if (ctrl_shm->state > RESET) {
+    if (ctrl_shm->state > STREAMING) {
 	ctrl_shm->state = IDLE;
     }
     gtk_label_set_text_if(horiz->state_label, state_names[ctrl_shm->state]);
@@ -1006,6 +1007,15 @@ static void calc_horiz_scaling(void)
     horiz->sample_period_ns = horiz->thread_period_ns * ctrl_shm->mult;
     horiz->sample_period = horiz->sample_period_ns / 1000000000.0;
     total_rec_time = ctrl_shm->rec_len * horiz->sample_period;
+    if (ctrl_usr->stream_view) {
+	/* stream display: zoom 9 shows one record length, every step
+	   back shows four times as much of the stream history */
+	horiz->disp_scale = total_rec_time / 10.0;
+	for (n = horiz->zoom_setting; n < 9; n++) {
+	    horiz->disp_scale *= 4.0;
+	}
+	return;
+    }
     if (total_rec_time < 0.000010) {
 	/* out of range, set to 1uS per div */
 	horiz->disp_scale = 0.000001;
@@ -47,6 +47,8 @@ MODULE_LICENSE("GPL");
 long num_samples = 16000;
 long shm_size;
 RTAPI_MP_LONG(num_samples, "Number of samples in the shared memory block")
+long stream_size = SCOPE_STREAM_SIZE_DEFAULT;
+RTAPI_MP_LONG(stream_size, "Size of the continuous mode ring in bytes, 0 disables it")
 
 /***********************************************************************
 *                         GLOBAL VARIABLES                             *
@@ -72,6 +74,9 @@ static void init_shm_control_struct(void);
 
 static void sample(void *arg, long period);
 static void capture_sample(void);
+static scope_data_t *capture_channels(scope_data_t *dest);
+static void stream_sample(void);
+static void delete_stream_ring(void);
 static int check_trigger(void);
 
 /***********************************************************************
@@ -112,11 +117,33 @@ int rtapi_app_main(void)
     ctrl_rt = &ctrl_struct;
     init_rt_control_struct(shm_base);
 
+    /* create the ring for continuous mode; scope still works
+       without it, just not in stream mode */
+    if (stream_size > 0) {
+	retval = hal_ring_newf(stream_size, 0, RINGTYPE_STREAM,
+	    SCOPE_STREAM_RING);
+	if (retval == 0) {
+	    retval = hal_ring_attachf(&ctrl_rt->stream_rb, NULL,
+		SCOPE_STREAM_RING);
+	    if (retval < 0) {
+		hal_ring_deletef(SCOPE_STREAM_RING);
+	    }
+	}
+	if (retval < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"SCOPE_RT: ERROR: couldn't create ring '%s': %d\n",
+		SCOPE_STREAM_RING, retval);
+	} else {
+	    ctrl_shm->stream_ok = 1;
+	}
+    }
+
     /* export scope data sampling function */
     retval = hal_export_funct("scope.sample", sample, NULL, 0, 0, comp_id);
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "SCOPE_RT: ERROR: sample funct export failed\n");
+	delete_stream_ring();
 	hal_exit(comp_id);
 	return -1;
     }
@@ -132,10 +159,21 @@ void rtapi_app_exit(void)
 	/* need to unlink it before we release the scope shared memory */
 	hal_del_funct_from_thread("scope.sample", ctrl_shm->thread_name);
     }
+    delete_stream_ring();
     rtapi_shmem_delete(shm_id, comp_id);
     hal_exit(comp_id);
 }
 
+static void delete_stream_ring(void)
+{
+    /* deleting fails while halscope is still attached, the ring
+       then goes away with hal_lib */
+    if (ringbuffer_attached(&ctrl_rt->stream_rb)) {
+	hal_ring_detach(&ctrl_rt->stream_rb);
+	hal_ring_deletef(SCOPE_STREAM_RING);
+    }
+}
+
 /***********************************************************************
 *                          REALTIME FUNCTIONS                          *
 ************************************************************************/
@@ -180,7 +218,13 @@ static void sample(void *arg, long period)
 	    ctrl_rt->data_len[n] = ctrl_shm->data_len[n];
 	}
 	/* set next state */
-	ctrl_shm->state = PRE_TRIG;
+	if (ctrl_shm->stream && ctrl_shm->stream_ok) {
+	    ctrl_rt->stream_seq = 0;
+	    ctrl_shm->stream_overruns = 0;
+	    ctrl_shm->state = STREAMING;
+	} else {
+	    ctrl_shm->state = PRE_TRIG;
+	}
 	break;
     case PRE_TRIG:
 	/* acquire a sample */
@@ -229,6 +273,10 @@ static void sample(void *arg, long period)
     case DONE:
 	/* do nothing while GUI displays waveform */
 	break;
+    case STREAMING:
+	/* acquire a sample into the ring, until the GUI resets us */
+	stream_sample();
+	break;
     default:
 	/* shouldn't get here - if we do, set a legal state */
 	ctrl_shm->state = IDLE;
@@ -239,10 +287,36 @@ static void sample(void *arg, long period)
 
 static void capture_sample(void)
 {
-    scope_data_t *dest;
+    capture_channels(&(ctrl_rt->buffer[ctrl_shm->curr]));
+    /* increment sample pointer */
+    ctrl_shm->curr += ctrl_shm->sample_len;
+    /* is there room in the buffer for another sample? */
+    if ((ctrl_shm->curr + ctrl_shm->sample_len) > ctrl_shm->buf_len) {
+	/* no, wrap back to beginning of buffer */
+	ctrl_shm->curr = 0;
+    }
+}
+
+static void stream_sample(void)
+{
+    scope_data_t rec[17];
+    ringsize_t size;
+
+    /* sequence number first, numbers of dropped samples are used too */
+    rec[0].d_u64 = ctrl_rt->stream_seq++;
+    size = (char *) capture_channels(&rec[1]) - (char *) rec;
+    if (stream_write_space(ctrl_rt->stream_rb.header) < size) {
+	ctrl_shm->stream_overruns++;
+	return;
+    }
+    stream_write(&ctrl_rt->stream_rb, (char *) rec, size);
+}
+
+/* store the enabled channels at dest, returns the end of the data */
+static scope_data_t *capture_channels(scope_data_t *dest)
+{
     int n;
 
-    dest = &(ctrl_rt->buffer[ctrl_shm->curr]);
     /* loop through all channels to acquire data */
     for (n = 0; n < 16; n++) {
 	/* capture 1, 2, or 4 bytes, based on data size */
@@ -270,13 +344,7 @@ static void capture_sample(void)
 	    break;
 	}
     }
-    /* increment sample pointer */
-    ctrl_shm->curr += ctrl_shm->sample_len;
-    /* is there room in the buffer for another sample? */
-    if ((ctrl_shm->curr + ctrl_shm->sample_len) > ctrl_shm->buf_len) {
-	/* no, wrap back to beginning of buffer */
-	ctrl_shm->curr = 0;
-    }
+    return dest;
 }
 
 // TODO: type-independent way to get high bit
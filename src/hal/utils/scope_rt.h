@@ -38,6 +38,7 @@
 
 /* import the shared declarations */
 #include "scope_shm.h"
+#include "hal_ring.h"
 
 /***********************************************************************
 *                         TYPEDEFS AND DEFINES                         *
@@ -52,6 +53,8 @@ typedef struct {
     char data_len[16];		/* data size for each channel */
     void *data_addr[16];	/* pointers to data for each channel */
     hal_type_t data_type[16];	/* data type for each channel */
+    ringbuffer_t stream_rb;	/* continuous mode ring, if attached */
+    __u64 stream_seq;		/* sequence number of next stream record */
 } scope_rt_control_t;
 
 /***********************************************************************
@@ -51,9 +51,19 @@ typedef enum {
     TRIG_WAIT,			/* waiting for trigger */
     POST_TRIG,			/* acquiring post-trigger data */
     DONE,			/* data acquisition complete */
-    RESET			/* data acquisition interrupted */
+    RESET,			/* data acquisition interrupted */
+    STREAMING			/* continuous capture to the stream ring */
 } scope_state_t;
 
+/* Continuous mode: while in the STREAMING state every sample goes to
+   the HAL stream ring SCOPE_STREAM_RING instead of the record buffer.
+   Each ring record is a sequence number (d_u64) followed by one
+   scope_data_t per channel with a non-zero data_len, in channel
+   order.  When the ring is full the sample is dropped, the reader
+   sees the gap in the sequence numbers. */
+#define SCOPE_STREAM_RING "scope.stream"
+#define SCOPE_STREAM_SIZE_DEFAULT (1024 * 1024)
+
 /* this struct holds a single value - one sample of one channel */
 
 typedef union {
@@ -93,6 +103,9 @@ typedef struct {
     int data_offset[16];	/* U data addr in shmem for each channel */
     hal_type_t data_type[16];	/* U data type for each channel */
     char data_len[16];		/* U data size, 0 if not to be acquired */
+    int stream_ok;		/* I stream ring exists */
+    int stream;			/* U INIT goes to STREAMING instead of PRE_TRIG */
+    unsigned long stream_overruns;	/* R samples dropped, ring full */
 } scope_shm_control_t;
 
 #endif /* HALSC_SHM_H */
@@ -0,0 +1,400 @@
+/** This file, 'scope_stream.c', implements the continuous (stream)
+    run mode of halscope.  In this mode the realtime side pushes every
+    sample into a HAL stream ring instead of a triggered record, and
+    the code here drains that ring, keeps min/max envelopes of each
+    channel at several resolutions for display, and optionally copies
+    the samples to a file.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"		/* HAL public API decls */
+#include "hal_ring.h"		/* HAL ring API */
+
+#include <gtk/gtk.h>
+#include "miscgtk.h"		/* generic GTK stuff */
+#include "scope_usr.h"		/* scope related declarations */
+#include "scope_env.h"		/* min/max envelopes */
+
+/***********************************************************************
+*                         DOCUMENTATION                                *
+************************************************************************/
+
+/* The envelopes of the channels are described in scope_env.h.
+   Samples lost to ring overruns are pushed as NaN, a gap.
+
+   Export file: a stream_file_header_t, then one stream_file_chan_t
+   per channel, then the records.  Each record is the low 32 bits of
+   the sample sequence number followed by the channel values packed
+   to their natural size: 1 byte for bit, 4 for s32/u32, 8 for
+   float (IEEE double), s64 and u64.  Everything is in the byte order
+   of the writing machine, see 'byte_order'.  A jump in the sequence
+   numbers marks samples dropped by the realtime side.
+*/
+
+#define STREAM_FILE_MAGIC "HALSCOP"
+#define STREAM_FILE_VERSION 1
+#define STREAM_READ_RECS 256	/* records per ring read */
+
+typedef struct {
+    char magic[8];		/* "HALSCOP" */
+    __u32 byte_order;		/* 0x01020304 */
+    __u32 version;		/* STREAM_FILE_VERSION */
+    __u32 header_size;		/* bytes before the first record */
+    __u32 num_chans;		/* channel entries following the header */
+    __u32 record_size;		/* bytes per record */
+    __u32 pad;
+    __u64 sample_period_ns;	/* time between records */
+    __s64 start_time;		/* time(2) when the file was started */
+} stream_file_header_t;
+
+typedef struct {
+    __u32 chan;			/* scope channel, 1-16 */
+    __u32 type;			/* hal_type_t */
+    char name[HAL_NAME_LEN + 1];	/* pin, signal or parameter */
+} stream_file_chan_t;
+
+/***********************************************************************
+*                         LOCAL VARIABLES                              *
+************************************************************************/
+
+static ringbuffer_t stream_rb;	/* attached if the RT side has it */
+static int rec_size;		/* bytes per ring record */
+static int chan_index[16];	/* value index in a record, -1 if absent */
+static int num_chans;		/* values per record */
+static __u64 next_seq;		/* expected sequence number */
+static long long env_count;	/* samples in the envelopes */
+static scope_env_t env[16];
+static FILE *export_fp;
+static int export_size;		/* bytes per export record */
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static float sample_value(scope_data_t * d, hal_type_t type);
+static void push_sample(const float *v);
+static void export_record(__u64 seq, scope_data_t * d);
+static int export_value_size(hal_type_t type);
+
+/***********************************************************************
+*                       PUBLIC FUNCTIONS                               *
+************************************************************************/
+
+void init_stream(void)
+{
+    int retval;
+
+    if (!ctrl_shm->stream_ok) {
+	/* scope_rt was loaded with stream_size=0 */
+	return;
+    }
+    retval = hal_ring_attachf(&stream_rb, NULL, SCOPE_STREAM_RING);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "SCOPE: ERROR: couldn't attach ring '%s': %d\n",
+	    SCOPE_STREAM_RING, retval);
+    }
+}
+
+void close_stream(void)
+{
+    stream_export_stop();
+    if (ringbuffer_attached(&stream_rb)) {
+	hal_ring_detach(&stream_rb);
+    }
+}
+
+int stream_available(void)
+{
+    return ringbuffer_attached(&stream_rb);
+}
+
+/* called by start_capture() once the channel setup is in ctrl_shm,
+   before the RT side leaves IDLE */
+void stream_start(void)
+{
+    int n, k;
+
+    num_chans = 0;
+    for (n = 0; n < 16; n++) {
+	if (ctrl_shm->data_len[n] > 0) {
+	    chan_index[n] = num_chans++;
+	    if (env[n].level[0] == NULL) {
+		for (k = 0; k < ENV_LEVELS; k++) {
+		    env[n].level[k] = g_malloc(ENV_LEN * sizeof(env_bucket_t));
+		}
+	    }
+	} else {
+	    chan_index[n] = -1;
+	}
+    }
+    rec_size = (num_chans + 1) * sizeof(scope_data_t);
+    next_seq = 0;
+    env_count = 0;
+    /* anything left over is from an earlier run */
+    if (ringbuffer_attached(&stream_rb)) {
+	stream_flush(&stream_rb);
+    }
+    ctrl_usr->stream_view = 1;
+    if (export_fp != NULL) {
+	/* the channel layout may have changed, start a new file */
+	stream_export_stop();
+    }
+}
+
+/* drain the ring, called from the heartbeat while streaming */
+void stream_poll(void)
+{
+    scope_data_t buf[STREAM_READ_RECS * 17];
+    scope_data_t *rec;
+    float v[16];
+    ringsize_t avail;
+    int n, cnt, c;
+
+    if (!ringbuffer_attached(&stream_rb) || rec_size == 0) {
+	return;
+    }
+    while ((avail = stream_read_space(stream_rb.header)) >= rec_size) {
+	cnt = avail / rec_size;
+	if (cnt > STREAM_READ_RECS) {
+	    cnt = STREAM_READ_RECS;
+	}
+	stream_read(&stream_rb, (char *) buf, cnt * rec_size);
+	rec = buf;
+	for (n = 0; n < cnt; n++) {
+	    /* samples the RT side dropped leave a gap */
+	    if (rec->d_u64 > next_seq) {
+		for (c = 0; c < 16; c++) {
+		    v[c] = NAN;
+		}
+		while (next_seq < rec->d_u64) {
+		    push_sample(v);
+		    next_seq++;
+		}
+	    }
+	    for (c = 0; c < 16; c++) {
+		if (chan_index[c] >= 0) {
+		    v[c] = sample_value(rec + 1 + chan_index[c],
+			ctrl_shm->data_type[c]);
+		}
+	    }
+	    push_sample(v);
+	    if (export_fp != NULL) {
+		export_record(rec->d_u64, rec + 1);
+	    }
+	    next_seq = rec->d_u64 + 1;
+	    rec += num_chans + 1;
+	}
+    }
+}
+
+/* range of samples held by the envelopes, [*first, *end) */
+void stream_span(long long *first, long long *end)
+{
+    env_span(env_count, first, end);
+}
+
+/* Min/max of channel 'chan' (0-15) over 'cols' equal slices of the
+   samples [first, first + span).  Slices without data are NaN.
+   Returns -1 if the channel is not part of the stream. */
+int stream_envelope(int chan, double first, double span, int cols,
+    float *min, float *max)
+{
+    if (chan < 0 || chan > 15 || chan_index[chan] < 0 || cols <= 0) {
+	return -1;
+    }
+    env_query(&env[chan], env_count, first, span, cols, min, max);
+    return 0;
+}
+
+int stream_export_start(char *filename)
+{
+    stream_file_header_t hdr;
+    stream_file_chan_t ch;
+    int n;
+
+    stream_export_stop();
+    if (!ctrl_usr->stream_view || rec_size == 0) {
+	fprintf(stderr, "halscope: nothing to record, start stream mode first\n");
+	return -1;
+    }
+    export_fp = fopen(filename, "wb");
+    if (export_fp == NULL) {
+	fprintf(stderr, "halscope: can't open '%s': %s\n", filename,
+	    strerror(errno));
+	return -1;
+    }
+    setvbuf(export_fp, NULL, _IOFBF, 256 * 1024);
+    export_size = sizeof(__u32);
+    for (n = 0; n < 16; n++) {
+	if (chan_index[n] >= 0) {
+	    export_size += export_value_size(ctrl_shm->data_type[n]);
+	}
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.magic, STREAM_FILE_MAGIC);
+    hdr.byte_order = 0x01020304;
+    hdr.version = STREAM_FILE_VERSION;
+    hdr.header_size = sizeof(hdr) + num_chans * sizeof(ch);
+    hdr.num_chans = num_chans;
+    hdr.record_size = export_size;
+    hdr.sample_period_ns = ctrl_usr->horiz.sample_period_ns;
+    hdr.start_time = time(NULL);
+    fwrite(&hdr, sizeof(hdr), 1, export_fp);
+    for (n = 0; n < 16; n++) {
+	if (chan_index[n] < 0) {
+	    continue;
+	}
+	memset(&ch, 0, sizeof(ch));
+	ch.chan = n + 1;
+	ch.type = ctrl_shm->data_type[n];
+	if (ctrl_usr->chan[n].name != NULL) {
+	    strncpy(ch.name, ctrl_usr->chan[n].name, HAL_NAME_LEN);
+	}
+	fwrite(&ch, sizeof(ch), 1, export_fp);
+    }
+    return 0;
+}
+
+void stream_export_stop(void)
+{
+    if (export_fp == NULL) {
+	return;
+    }
+    if (fclose(export_fp) != 0) {
+	fprintf(stderr, "halscope: error writing stream file: %s\n",
+	    strerror(errno));
+    }
+    export_fp = NULL;
+}
+
+int stream_exporting(void)
+{
+    return export_fp != NULL;
+}
+
+/***********************************************************************
+*                       LOCAL FUNCTIONS                                *
+************************************************************************/
+
+static float sample_value(scope_data_t * d, hal_type_t type)
+{
+    switch (type) {
+    case HAL_BIT:
+	return d->d_u8 ? 1.0 : 0.0;
+    case HAL_FLOAT:
+	return d->d_real;
+    case HAL_S32:
+	return d->d_s32;
+    case HAL_U32:
+	return d->d_u32;
+    case HAL_S64:
+	return d->d_s64;
+    case HAL_U64:
+	return d->d_u64;
+    default:
+	return 0.0;
+    }
+}
+
+/* add one sample of every channel to the envelopes */
+static void push_sample(const float *v)
+{
+    int c;
+
+    for (c = 0; c < 16; c++) {
+	if (chan_index[c] >= 0) {
+	    env_push(&env[c], env_count, v[c]);
+	}
+    }
+    env_count++;
+}
+
+static int export_value_size(hal_type_t type)
+{
+    switch (type) {
+    case HAL_BIT:
+	return 1;
+    case HAL_S32:
+    case HAL_U32:
+	return 4;
+    default:
+	return 8;
+    }
+}
+
+static void export_record(__u64 seq, scope_data_t * d)
+{
+    unsigned char buf[sizeof(__u32) + 16 * sizeof(scope_data_t)];
+    unsigned char *p;
+    __u32 seq32;
+    double f;
+    int n;
+
+    seq32 = seq;
+    memcpy(buf, &seq32, sizeof(seq32));
+    p = buf + sizeof(seq32);
+    for (n = 0; n < 16; n++) {
+	if (chan_index[n] < 0) {
+	    continue;
+	}
+	switch (ctrl_shm->data_type[n]) {
+	case HAL_BIT:
+	    *p++ = d->d_u8 ? 1 : 0;
+	    break;
+	case HAL_S32:
+	case HAL_U32:
+	    memcpy(p, &d->d_u32, 4);
+	    p += 4;
+	    break;
+	case HAL_FLOAT:
+	    f = d->d_real;
+	    memcpy(p, &f, 8);
+	    p += 8;
+	    break;
+	default:
+	    memcpy(p, &d->d_u64, 8);
+	    p += 8;
+	    break;
+	}
+	d++;
+    }
+    if (fwrite(buf, export_size, 1, export_fp) != 1) {
+	fprintf(stderr, "halscope: error writing stream file: %s\n",
+	    strerror(errno));
+	stream_export_stop();
+    }
+}
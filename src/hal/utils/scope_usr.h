@@ -196,7 +196,7 @@ typedef struct {
 
 /* this is the master user space control structure */
 
-typedef enum { STOP = 0, NORMAL, SINGLE, ROLL } scope_run_mode_t;
+typedef enum { STOP = 0, NORMAL, SINGLE, ROLL, STREAM } scope_run_mode_t;
 
 typedef struct {
     /* general data */
@@ -207,6 +207,7 @@ typedef struct {
     scope_run_mode_t run_mode;	/* current run mode */
     scope_run_mode_t old_run_mode;	/* run mode to restore*/
     int pending_restart;        /* nonzero if run mode to be restored */
+    int stream_view;		/* display shows the stream envelopes */
     /* top level windows */
     GtkWidget *main_win;
     GtkWidget *horiz_info_win;
@@ -222,6 +223,7 @@ typedef struct {
     GtkWidget *rm_normal_button;
     GtkWidget *rm_single_button;
     GtkWidget *rm_roll_button;
+    GtkWidget *rm_stream_button;
     GtkWidget *rm_stop_button;
     /* subsection control data */
     scope_chan_t chan[16];	/* channel specific data */
@@ -263,6 +265,19 @@ void channel_changed(void);
 
 void format_signal_value(char *buf, int buflen, double value);
 
+/* continuous (stream) mode, see scope_stream.c */
+void init_stream(void);
+void close_stream(void);
+int stream_available(void);
+void stream_start(void);
+void stream_poll(void);
+void stream_span(long long *first, long long *end);
+int stream_envelope(int chan, double first, double span, int cols,
+    float *min, float *max);
+int stream_export_start(char *filename);
+void stream_export_stop(void);
+int stream_exporting(void);
+
 int read_config_file (char *filename);
 void write_config_file (char *filename);
 void write_horiz_config(FILE *fp);
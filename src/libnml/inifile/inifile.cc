@@ -18,29 +18,378 @@
 #include <string.h>             /* strstr() */
 #include <ctype.h>              /* isspace() */
 #include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>           /* fstat() */
 
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "config.h"
 #include "inifile.hh"
 
-/// Return TRUE if the line has a line-ending problem
-static bool check_line_endings(const char *s) {
-    if(!s) return false;
+enum { LE_DOS = 1, LE_AMBIGUOUS = 2 };
+
+/// Return the line-ending problems found on the line, LE_* flags
+static int check_line_endings(const char *s) {
+    int flags = 0;
+    if(!s) return 0;
     for(; *s; s++ ) {
         if(*s == '\r') {
             char c = s[1];
             if(c == '\n' || c == '\0') {
-                static bool warned = 0;
-                if(!warned) 
-                    fprintf(stderr, "inifile: warning: File contains DOS-style line endings.\n");
-                warned = true;
+                flags |= LE_DOS;
                 continue;
             }
-            fprintf(stderr, "inifile: error: File contains ambiguous carriage returns\n");
-            return true;
+            return flags | LE_AMBIGUOUS;
+        }
+    }
+    return flags;
+}
+
+static char *skip_white(const char *string);
+static char *after_equal(const char *string);
+
+
+/* Parsed form of an ini file.
+
+   Find() used to rewind the file and fgets() through it for every
+   lookup, which made reading a configuration quadratic in the size of
+   the file. Now the file is read once, split into lines exactly the
+   way the scan did, and the first header of each section and the
+   lines starting with each tag are put in hash tables. Lookups then
+   reproduce what the scan would have found, including which line a
+   problem would have been reported on.
+
+   The index is shared by every IniFile and iniFind*() call in the
+   process reading the same file, and rebuilt when the file's size or
+   mtime changes. Each IniFile holds the indexes it returned values
+   from, and a replaced index is freed when the last of them is closed,
+   so values returned by Find() stay valid until the IniFile is closed
+   even if the file changes meanwhile. Pipes can't be read twice, they
+   are parsed once per IniFile. */
+
+struct ini_key {
+    std::string                 name;
+    std::vector<int>            lines;          // ascending
+};
+
+class ini_hash {
+public:
+    void init(size_t n) {
+        size_t size = 64;
+        while(size < n)
+            size <<= 1;
+        buckets.assign(size, std::vector<int>());
+        keys.clear();
+    }
+
+    ini_key *find(const char *name, size_t len) {
+        std::vector<int> &b = buckets[hash(name, len) & (buckets.size() - 1)];
+        for(size_t i = 0; i < b.size(); i++) {
+            ini_key &k = keys[b[i]];
+            if(k.name.size() == len && !memcmp(k.name.data(), name, len))
+                return &k;
+        }
+        return NULL;
+    }
+
+    ini_key *insert(const char *name, size_t len) {
+        ini_key *k = find(name, len);
+        if(k)
+            return k;
+        buckets[hash(name, len) & (buckets.size() - 1)].push_back(keys.size());
+        keys.push_back(ini_key());
+        keys.back().name.assign(name, len);
+        return &keys.back();
+    }
+
+private:
+    std::vector<ini_key>        keys;
+    std::vector<std::vector<int> > buckets;
+
+    static unsigned int hash(const char *s, size_t len) {
+        unsigned int h = 2166136261u;           // FNV-1a
+        while(len--)
+            h = (h ^ (unsigned char) *s++) * 16777619u;
+        return h;
+    }
+};
+
+struct ini_index {
+    dev_t                       dev;
+    ino_t                       ino;
+    off_t                       size;
+    struct timespec             mtime;
+
+    std::vector<std::string>    text;           // lines, newline stripped
+    std::vector<std::string>    value;          // value of a tag line
+    std::vector<char>           hasValue;
+    std::vector<int>            nextHeader;     // next '[' line, or size
+    int                         badLine;        // first ambiguous CR or -1
+    ini_hash                    tags;           // tag -> lines
+    ini_hash                    sections;       // name -> first header line
+
+    /* values of tags not in the hash, by line and tag length */
+    std::map<std::pair<int, size_t>, std::string> other;
+
+    int                         users;          // IniFiles holding it
+    bool                        retired;        // not in ini_cache
+};
+
+/* the indexes an IniFile returned values from */
+struct ini_refs {
+    std::vector<ini_index *>    held;
+    ini_index                   *pipe;          // parse of a non-regular file
+};
+
+static pthread_mutex_t ini_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<ini_index *> ini_cache;
+static unsigned long ini_live;                  // allocated indexes
+
+/* The functions below are called with ini_mutex held. */
+
+static void ini_free(ini_index *x)
+{
+    delete x;
+    ini_live--;
+}
+
+/* x is no longer in ini_cache: free it once no IniFile holds it */
+static void ini_retire(ini_index *x)
+{
+    x->retired = true;
+    if(x->users == 0)
+        ini_free(x);
+}
+
+static void ini_hold(ini_refs *r, ini_index *x)
+{
+    if(!r->held.empty() && r->held.back() == x)
+        return;
+    for(size_t i = 0; i < r->held.size(); i++)
+        if(r->held[i] == x)
+            return;
+    r->held.push_back(x);
+    x->users++;
+}
+
+static void ini_release(ini_refs *r)
+{
+    for(size_t i = 0; i < r->held.size(); i++) {
+        ini_index *x = r->held[i];
+        if(--x->users == 0 && x->retired)
+            ini_free(x);
+    }
+    r->held.clear();
+    r->pipe = NULL;
+}
+
+static std::string trim_value(const char *v)
+{
+    size_t len = strlen(v);
+
+    /* Eliminate white space at the end of a line also. */
+    while(len > 0 && (v[len - 1] == ' ' || v[len - 1] == '\t'
+                      || v[len - 1] == '\r'))
+        len--;
+    return std::string(v, len);
+}
+
+static ini_index *ini_parse(FILE *fp)
+{
+    static bool                 warned = false;
+    char                        line[LINELEN + 2];
+    ini_index                   *x = new ini_index;
+
+    x->users = 0;
+    x->retired = false;
+    ini_live++;
+
+    /* lines longer than LINELEN are split, as fgets() did for Find() */
+    rewind(fp);
+    while(fgets(line, LINELEN + 1, fp) != NULL) {
+        size_t len = strlen(line);
+        if(len > 0 && line[len - 1] == '\n')
+            line[--len] = 0;
+        x->text.push_back(std::string(line, len));
+    }
+
+    int n = x->text.size();
+    x->value.resize(n);
+    x->hasValue.assign(n, 0);
+    x->nextHeader.resize(n);
+    x->badLine = -1;
+    x->tags.init(n);
+    x->sections.init(n / 4);
+
+    int next = n;
+    for(int i = n - 1; i >= 0; i--) {
+        x->nextHeader[i] = next;
+        const char *nonWhite = skip_white(x->text[i].c_str());
+        if(nonWhite && nonWhite[0] == '[')
+            next = i;
+    }
+
+    for(int i = 0; i < n; i++) {
+        const char *s = x->text[i].c_str();
+
+        int le = check_line_endings(s);
+        if((le & LE_DOS) && !warned) {
+            fprintf(stderr, "inifile: warning: File contains DOS-style line endings.\n");
+            warned = true;
+        }
+        if((le & LE_AMBIGUOUS) && x->badLine < 0)
+            x->badLine = i;
+
+        const char *nonWhite = skip_white(s);
+        if(nonWhite == NULL)
+            continue;
+
+        if(nonWhite[0] == '[') {
+            const char *close = strchr(nonWhite, ']');
+            if(close && !x->sections.find(nonWhite + 1, close - nonWhite - 1))
+                x->sections.insert(nonWhite + 1, close - nonWhite - 1)
+                    ->lines.push_back(i);
+        }
+
+        /* a tag is followed by whitespace or '=' */
+        size_t len = strcspn(nonWhite, " \t\r\n=");
+        if(nonWhite[len] == 0)
+            continue;
+        x->tags.insert(nonWhite, len)->lines.push_back(i);
+        const char *valueString = after_equal(nonWhite + len);
+        if(valueString) {
+            x->value[i] = trim_value(valueString);
+            x->hasValue[i] = 1;
+        }
+    }
+    return x;
+}
+
+/* Return the index for fp, (re)reading the file if needed, and hold it
+   for r. Called with ini_mutex held. */
+static ini_index *ini_get(FILE *fp, ini_refs *r)
+{
+    struct stat                 st;
+
+    if(fstat(fileno(fp), &st) < 0 || !S_ISREG(st.st_mode)) {
+        /* pipes and the like, never shared */
+        if(r->pipe == NULL) {
+            r->pipe = ini_parse(fp);
+            r->pipe->retired = true;
+            ini_hold(r, r->pipe);
+        }
+        return r->pipe;
+    }
+
+    size_t i;
+    for(i = 0; i < ini_cache.size(); i++) {
+        ini_index *x = ini_cache[i];
+        if(x->dev != st.st_dev || x->ino != st.st_ino)
+            continue;
+        if(x->size == st.st_size
+           && x->mtime.tv_sec == st.st_mtim.tv_sec
+           && x->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            ini_hold(r, x);
+            return x;
+        }
+        ini_retire(x);
+        break;
+    }
+    if(i == ini_cache.size())
+        ini_cache.push_back(NULL);
+
+    ini_index *x = ini_parse(fp);
+    x->dev = st.st_dev;
+    x->ino = st.st_ino;
+    x->size = st.st_size;
+    x->mtime = st.st_mtim;
+    ini_cache[i] = x;
+    ini_hold(r, x);
+    return x;
+}
+
+/* Number of indexes allocated, for the tests. */
+extern "C" unsigned long
+iniIndexCount(void)
+{
+    pthread_mutex_lock(&ini_mutex);
+    unsigned long n = ini_live;
+    pthread_mutex_unlock(&ini_mutex);
+    return n;
+}
+
+/* Line of the first header matching [section], or -1. */
+static int find_section(ini_index *x, const char *section)
+{
+    if(strchr(section, ']') == NULL) {
+        ini_key *k = x->sections.find(section, strlen(section));
+        return k ? k->lines[0] : -1;
+    }
+
+    /* can't be split at the first ']', compare whole lines */
+    std::string bracketSection = std::string("[") + section + "]";
+    for(size_t i = 0; i < x->text.size(); i++) {
+        const char *nonWhite = skip_white(x->text[i].c_str());
+        if(nonWhite && !strncmp(bracketSection.c_str(), nonWhite,
+                                bracketSection.size()))
+            return i;
+    }
+    return -1;
+}
+
+/* Line of the num-th occurrence of tag in lines [start, end), or -1.
+   *value is set to its value, NULL if it has none. */
+static int find_tag(ini_index *x, const char *tag, int start, int end,
+                    int num, const char **value)
+{
+    size_t len = strlen(tag);
+
+    if(num < 1)
+        num = 1;
+
+    if(strcspn(tag, " \t\r\n=") == len) {
+        ini_key *k = x->tags.find(tag, len);
+        if(k == NULL)
+            return -1;
+        std::vector<int>::iterator it =
+            std::lower_bound(k->lines.begin(), k->lines.end(), start);
+        if(k->lines.end() - it < num || it[num - 1] >= end)
+            return -1;
+        int line = it[num - 1];
+        *value = x->hasValue[line] ? x->value[line].c_str() : NULL;
+        return line;
+    }
+
+    /* Tags containing whitespace or '=' aren't in the hash, match them
+       the way the scan did. Where the value starts depends on the tag,
+       so it is kept by line and tag length. */
+    for(int i = start; i < end; i++) {
+        const char *nonWhite = skip_white(x->text[i].c_str());
+        if(nonWhite == NULL || strncmp(tag, nonWhite, len) != 0)
+            continue;
+        char tagEnd = nonWhite[len];
+        if(tagEnd != ' ' && tagEnd != '\r' && tagEnd != '\t'
+           && tagEnd != '\n' && tagEnd != '=')
+            continue;
+        if(--num > 0)
+            continue;
+        const char *valueString = after_equal(nonWhite + len);
+        *value = NULL;
+        if(valueString) {
+            std::pair<int, size_t> key(i, len);
+            std::map<std::pair<int, size_t>, std::string>::iterator it =
+                x->other.find(key);
+            if(it == x->other.end())
+                it = x->other.insert(
+                    std::make_pair(key, trim_value(valueString))).first;
+            *value = it->second.c_str();
         }
+        return i;
     }
-    return false;
+    return -1;
 }
 
 IniFile::IniFile(int _errMask, FILE *_fp)
@@ -48,6 +397,7 @@ IniFile::IniFile(int _errMask, FILE *_fp)
     fp = _fp;
     errMask = _errMask;
     owned = false;
+    refs = NULL;
 
     if(fp != NULL)
         LockFile();
@@ -96,6 +446,13 @@ IniFile::Close()
 
         fp = NULL;
     }
+    if(refs != NULL){
+        pthread_mutex_lock(&ini_mutex);
+        ini_release(refs);
+        pthread_mutex_unlock(&ini_mutex);
+        delete refs;
+        refs = NULL;
+    }
 
     return(rVal == 0);
 }
@@ -271,20 +628,14 @@ IniFile::Find(double *result, StrDoublePair *pPair,
 
    @param num (optionally) the Nth occurrence of the tag.
 
-   @return pointer to the the variable after the '=' delimiter */
+   @return pointer to the the variable after the '=' delimiter, valid
+   until the IniFile is closed */
 const char *
 IniFile::Find(const char *_tag, const char *_section, int _num, int *lineno)
 {
-    // WTF, return a pointer to the middle of a local buffer?
-    // FIX: this is totally non-reentrant.
-    static char                 line[LINELEN + 2] = "";        /* 1 for newline, 1 for NULL */
-    char                        bracketSection[LINELEN + 2] = "";
-    char                        *nonWhite;
-    int                         newLinePos;                /* position of newline to strip */
-    int                         len;
-    char                        tagEnd;
-    char                        *valueString;
-    char                        *endValueString;
+    ErrorCode                   errCode = ERR_NONE;
+    const char                  *valueString = NULL;
+    int                         line;
 
     // For exceptions.
     lineNo = 0;
@@ -296,132 +647,54 @@ IniFile::Find(const char *_tag, const char *_section, int _num, int *lineno)
     if(!CheckIfOpen())
         return(NULL);
 
-    /* start from beginning */
-    rewind(fp);
-
-    /* check for section first-- if it's non-NULL, then position file at
-       line after [section] */
+    if(refs == NULL){
+        refs = new ini_refs;
+        refs->pipe = NULL;
+    }
+    pthread_mutex_lock(&ini_mutex);
+    ini_index *x = ini_get(fp, refs);
+    int n = x->text.size();
+    int start = 0, end = n;
+
+    /* lineNo is set to where the scan through the file would have
+       stopped, and a line with ambiguous carriage returns before that
+       point fails the lookup as it did */
     if(section != NULL){
-        sprintf(bracketSection, "[%s]", section);
-
-        /* find [section], and position fp just after it */
-        while (!feof(fp)) {
-
-            if (NULL == fgets(line, LINELEN + 1, fp)) {
-                /* got to end of file without finding it */
-                ThrowException(ERR_SECTION_NOT_FOUND);
-                return(NULL);
-            }
-
-            if(check_line_endings(line)) {
-                ThrowException(ERR_CONVERSION);
-                return(NULL);
-            }
-
-            /* got a line */
-            lineNo++;
-
-            /* strip off newline */
-            newLinePos = strlen(line) - 1;        /* newline is on back from 0 */
-            if (newLinePos < 0) {
-                newLinePos = 0;
-            }
-            if (line[newLinePos] == '\n') {
-                line[newLinePos] = 0;        /* make the newline 0 */
-            }
-
-            if (NULL == (nonWhite = SkipWhite(line))) {
-                /* blank line-- skip */
-                continue;
-            }
-
-            /* not a blank line, and nonwhite is first char */
-            if (strncmp(bracketSection, nonWhite, strlen(bracketSection)) != 0){
-                /* not on this line */
-                continue;
-            }
-
-            /* it matches-- fp is now set up for search on tag */
-            break;
+        int header = find_section(x, section);
+        if(header < 0){
+            errCode = ERR_SECTION_NOT_FOUND;
+            lineNo = n;
+            goto out;
         }
+        start = header + 1;
+        end = x->nextHeader[header];
     }
 
-    while (!feof(fp)) {
-        /* check for end of file */
-        if (NULL == fgets(line, LINELEN + 1, (FILE *) fp)) {
-            /* got to end of file without finding it */
-            ThrowException(ERR_TAG_NOT_FOUND);
-            return(NULL);
-        }
-
-        if(check_line_endings(line)) {
-            ThrowException(ERR_CONVERSION);
-            return(NULL);
-        }
-
-        /* got a line */
-        lineNo++;
-
-        /* strip off newline */
-        newLinePos = strlen(line) - 1;        /* newline is on back from 0 */
-        if (newLinePos < 0) {
-            newLinePos = 0;
-        }
-        if (line[newLinePos] == '\n') {
-            line[newLinePos] = 0;        /* make the newline 0 */
-        }
-
-        /* skip leading whitespace */
-        if (NULL == (nonWhite = SkipWhite(line))) {
-            /* blank line-- skip */
-            continue;
-        }
-
-        /* check for '[' char-- if so, it's a section tag, and we're out
-           of our section */
-        if (NULL != section && nonWhite[0] == '[') {
-            ThrowException(ERR_TAG_NOT_FOUND);
-            return(NULL);
-        }
-
-        len = strlen(tag);
-        if (strncmp(tag, nonWhite, len) != 0) {
-            /* not on this line */
-            continue;
-        }
+    line = find_tag(x, tag, start, end, num, &valueString);
+    if(line < 0){
+        errCode = ERR_TAG_NOT_FOUND;
+        lineNo = end < n ? end + 1 : n;
+    } else {
+        if(valueString == NULL)
+            errCode = ERR_TAG_NOT_FOUND;
+        lineNo = line + 1;
+    }
 
-        /* it matches the first part of the string-- if whitespace or = is
-           next char then call it a match */
-        tagEnd = nonWhite[len];
-        if (tagEnd == ' ' || tagEnd == '\r' || tagEnd == '\t'
-            || tagEnd == '\n' || tagEnd == '=') {
-            /* it matches-- return string after =, or NULL */
-            if (--_num > 0) {
-                /* Not looking for this one, so skip it... */
-                continue;
-            }
-            nonWhite += len;
-            valueString = AfterEqual(nonWhite);
-            /* Eliminate white space at the end of a line also. */
-            if (NULL == valueString) {
-                ThrowException(ERR_TAG_NOT_FOUND);
-                return(NULL);
-            }
-            endValueString = valueString + strlen(valueString) - 1;
-            while (*endValueString == ' ' || *endValueString == '\t'
-                   || *endValueString == '\r') {
-                *endValueString = 0;
-                endValueString--;
-            }
-	    if (lineno)
-		*lineno = lineNo;
-            return(valueString);
-        }
-        /* else continue */
+out:
+    if(x->badLine >= 0 && (int) lineNo > x->badLine){
+        fprintf(stderr, "inifile: error: File contains ambiguous carriage returns\n");
+        errCode = ERR_CONVERSION;
+        lineNo = x->badLine;
     }
+    pthread_mutex_unlock(&ini_mutex);
 
-    ThrowException(ERR_TAG_NOT_FOUND);
-    return(NULL);
+    if(errCode != ERR_NONE){
+        ThrowException(errCode);
+        return(NULL);
+    }
+    if (lineno)
+	*lineno = lineNo;
+    return(valueString);
 }
 
 const char *
@@ -548,9 +821,9 @@ IniFile::ThrowException(ErrorCode errCode)
 
    @return NULL or pointer to first non-white char after the delimiter
 
-   Called By: find() and section() only. */
-char *
-IniFile::AfterEqual(const char *string)
+   Called By: ini_parse() and lookups. */
+static char *
+after_equal(const char *string)
 {
     const char                  *spot = string;
 
@@ -589,9 +862,9 @@ IniFile::AfterEqual(const char *string)
 
    @return NULL if not found or a valid pointer.
 
-   Called By: find() and section() only. */
-char *
-IniFile::SkipWhite(const char *string)
+   Called By: ini_parse() and lookups. */
+static char *
+skip_white(const char *string)
 {
     while(true){
         if (*string == 0) {
@@ -612,6 +885,20 @@ IniFile::SkipWhite(const char *string)
 }
 
 
+char *
+IniFile::AfterEqual(const char *string)
+{
+    return(after_equal(string));
+}
+
+
+char *
+IniFile::SkipWhite(const char *string)
+{
+    return(skip_white(string));
+}
+
+
 void
 IniFile::Exception::Print(FILE *fp)
 {
@@ -655,8 +942,15 @@ extern "C" const char *
 iniFind(FILE *fp, const char *tag, const char *section)
 {
     IniFile                     f(false, fp);
+    static char                 value[LINELEN + 1];
 
-    return(f.Find(tag, section));
+    /* the index is released with f, the value is good until the next
+       call as when it pointed to the line buffer of the scan */
+    const char *v = f.Find(tag, section);
+    if(v == NULL)
+        return(NULL);
+    snprintf(value, sizeof(value), "%s", v);
+    return(value);
 }
 
 extern "C" const int
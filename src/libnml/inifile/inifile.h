@@ -30,6 +30,7 @@ extern const char *iniFind(FILE *fp, const char *tag, const char *section);
 extern const int iniFindInt(FILE *fp, const char *tag, const char *section, int *result);
 extern const int iniFindDouble(FILE *fp, const char *tag, const char *section, double *result);
 extern int TildeExpansion(const char *file, char *path, size_t size);
+extern unsigned long iniIndexCount(void);
 
 #ifdef __cplusplus
 }
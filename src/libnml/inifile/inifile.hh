@@ -23,6 +23,8 @@
 #endif
 
 #ifdef __cplusplus
+struct ini_refs;
+
 class IniFile {
 public:
     typedef enum {
@@ -102,6 +104,7 @@ private:
     FILE                        *fp;
     struct flock                lock;
     bool                        owned;
+    struct ini_refs             *refs;          // indexes Find() used
 
     Exception                   exception;
     int                         errMask;
@@ -34,6 +34,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #ifndef ULAPI
 #error This is intended as a userspace component only.
@@ -44,6 +45,7 @@
 #include <hal_priv.h>
 #include <hal_group.h>
 #include <hal_rcomp.h>
+#include <hal_ring.h>
 #include <inifile.h>
 #include <syslog_async.h>
 
@@ -74,6 +76,31 @@ typedef struct {
     int msec;
 } group_t;
 
+// a subscriber-negotiated view of a group, see haltalk_groupview.cc
+typedef struct {
+    group_t *group;
+    std::string topic;   // as subscribed, and published to
+    int serial;
+    int timer_id;
+    int msec;
+    bool delta;          // MT_HALGROUP_DELTA_UPDATE instead of incremental
+    std::vector<double> eps;      // per member deadband, float signals
+    std::vector<hal_data_u> sent; // per member value last sent
+    htself_t *self;
+} groupview_t;
+
+// a HAL record ring published to subscribers, see haltalk_ringview.cc
+typedef struct {
+    std::string topic;   // as subscribed, and published to
+    std::string ring;
+    ringbuffer_t rb;
+    int serial;
+    int timer_id;
+    int msec;
+    bool postrace;       // a motion position trace ring
+    htself_t *self;
+} ringview_t;
+
 typedef struct {
     hal_compiled_comp_t *cc;
     int serial; // must be unique per active comp
@@ -94,6 +121,14 @@ typedef struct htbridge {
 typedef std::unordered_map<std::string, group_t *> groupmap_t;
 typedef groupmap_t::iterator groupmap_iterator;
 
+// group views indexed by subscribed topic
+typedef std::unordered_map<std::string, groupview_t *> viewmap_t;
+typedef viewmap_t::iterator viewmap_iterator;
+
+// ring views indexed by subscribed topic
+typedef std::unordered_map<std::string, ringview_t *> ringviewmap_t;
+typedef ringviewmap_t::iterator ringviewmap_iterator;
+
 // remote components indexed by component name
 typedef std::unordered_map<std::string, rcomp_t *> compmap_t;
 typedef compmap_t::iterator compmap_iterator;
@@ -145,9 +180,18 @@ typedef struct htself {
 
 
     groupmap_t groups;
+    viewmap_t  views;
+    ringviewmap_t ringviews;
     compmap_t  rcomps;
     itemmap_t  items;
 
+    // position in the HAL event log, and whether all groups resp. comps
+    // as of there are adopted; see scan_groups(), scan_comps()
+    unsigned long group_seq;
+    bool groups_current;
+    unsigned long comp_seq;
+    bool comps_current;
+
     htbridge_t *bridge;
 } htself_t;
 
@@ -159,6 +203,22 @@ int handle_group_timer(zloop_t *loop, int timer_id, void *arg);
 int handle_group_input(zloop_t *loop, zsock_t *socket, void *arg);
 int ping_groups(htself_t *self);
 
+// haltalk_groupview.cc:
+// topics starting with GROUPVIEW_PREFIX select a group view
+#define GROUPVIEW_PREFIX '@'
+int subscribe_groupview(htself_t *self, zloop_t *loop, const std::string &topic, void *socket);
+int unsubscribe_groupview(htself_t *self, zloop_t *loop, const std::string &topic);
+int ping_groupviews(htself_t *self);
+void release_groupviews(htself_t *self);
+
+// haltalk_ringview.cc:
+// topics starting with RINGVIEW_PREFIX select a ring view
+#define RINGVIEW_PREFIX '%'
+int subscribe_ringview(htself_t *self, zloop_t *loop, const std::string &topic, void *socket);
+int unsubscribe_ringview(htself_t *self, zloop_t *loop, const std::string &topic);
+int ping_ringviews(htself_t *self);
+void release_ringviews(htself_t *self);
+
 // haltalk_rcomp.cc:
 int scan_comps(htself_t *self);
 int release_comps(htself_t *self);
@@ -47,6 +47,30 @@ handle_group_input(zloop_t *loop, zsock_t *socket, void *arg)
     }
     const char *topic = s+1;
 
+    // a view of a group, see haltalk_groupview.cc
+    if ((zframe_size(f_subscribe) > 1) && (*topic == GROUPVIEW_PREFIX)) {
+	std::string view(topic, zframe_size(f_subscribe) - 1);
+	if (*s == '\001') {
+	    scan_groups(self);
+	    subscribe_groupview(self, loop, view, socket);
+	} else {
+	    unsubscribe_groupview(self, loop, view);
+	}
+	zframe_destroy(&f_subscribe);
+	return 0;
+    }
+
+    // a ring, see haltalk_ringview.cc
+    if ((zframe_size(f_subscribe) > 1) && (*topic == RINGVIEW_PREFIX)) {
+	std::string view(topic, zframe_size(f_subscribe) - 1);
+	if (*s == '\001')
+	    subscribe_ringview(self, loop, view, socket);
+	else
+	    unsubscribe_ringview(self, loop, view);
+	zframe_destroy(&f_subscribe);
+	return 0;
+    }
+
     switch (*s) {
     case '\001':   // non-zero: subscribe event
 
@@ -157,11 +181,29 @@ handle_group_timer(zloop_t *loop, int timer_id, void *arg)
     return 0;
 }
 
+static int group_created(const hal_event_t *ev, void *arg)
+{
+    if ((ev->op == HAL_EV_CREATE) && (ev->type == HAL_GROUP))
+	*((bool *) arg) = true;
+    return 0;
+}
+
 // walk HAL groups, and compile any which are not in self->groups yet
 // idempotent - will add new groups as found
+//
+// this runs on every subscribe. Walking the HAL object list under the
+// HAL mutex is slow with large configs, so it is skipped unless the
+// HAL event log has a group created since the last walk, events were
+// lost, or the last walk failed to adopt a group.
 int
 scan_groups(htself_t *self)
 {
+    bool created = false;
+    int retval = halg_foreach_event(true, &self->group_seq,
+				    group_created, &created);
+    if (self->groups_current && (retval >= 0) && !created)
+	return 0;
+
     foreach_args_t args = {};
     args.type = HAL_GROUP;
     args.user_ptr1 = (void *)self;
@@ -172,6 +214,7 @@ scan_groups(htself_t *self)
     rtapi_print_msg(RTAPI_MSG_DBG,"adopted %d groups(s)\n",
 		    args.user_arg2);
 
+    self->groups_current = (args.user_arg1 == 0);
     if (args.user_arg1 > 0) { // error counter
 	rtapi_print_msg(RTAPI_MSG_DBG,"%d groups(s) failed to adopt\n",
 			args.user_arg1);
@@ -272,6 +315,8 @@ int release_groups(htself_t *self)
 			"%s: unreferencing group '%s'",
 			self->cfg->progname, g->first.c_str());
     }
+    release_groupviews(self);
+    release_ringviews(self);
     return -nfail;
 }
 
@@ -337,5 +382,6 @@ int ping_groups(htself_t *self)
 				      self->mksock[SVC_HALGROUP].socket);
 	assert(retval == 0);
     }
-    return 0;
+    ping_ringviews(self);
+    return ping_groupviews(self);
 }
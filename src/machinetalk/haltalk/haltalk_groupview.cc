@@ -0,0 +1,377 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// group views - update policies negotiated by the subscriber
+//
+// a group is scanned at the interval of its definition, and all its
+// subscribers get the same reports. An HMI on a slow link may rather
+// have fewer and smaller updates, so instead of the group it can
+// subscribe to a view of it:
+//
+//   @<group>[?<option>[&<option>...]]#
+//
+// options:
+//   rate=<hz>                at most <hz> updates per second; a view is
+//                            never scanned faster than its group
+//   eps=<deadband>           report a float member only once it moved by
+//                            more than <deadband> from the value last sent
+//   eps.<signal>=<deadband>  the same, for one member signal
+//   delta                    send MT_HALGROUP_DELTA_UPDATE frames
+//
+// e.g. '@axes?rate=5&eps=0.001&eps.spindle-rpm=5&delta#'
+//
+// without eps options, a float member uses the deadband of its member
+// definition. A view reports the members which changed since last sent
+// on this view, whatever the report flags of the group are.
+//
+// A view starts with a MT_HALGROUP_FULL_UPDATE listing every member
+// signal with name, handle, type and value. The order of this list is
+// fixed for the life of the view. A delta update refers to members by
+// their position in it: delta_mask has a bit per member, delta_values
+// carries the packed values of the members whose bit is set, see
+// message.proto. A changed float costs 8 bytes and a mask bit, rather
+// than a Signal submessage with handle and tags.
+//
+// Updates go out under the view topic. The leading '@' keeps group
+// subscribers from receiving them, the trailing '#' keeps subscribers
+// of a view from receiving updates of views whose topic extends theirs.
+// A wildcard subscriber does receive all views in use. Subscribers of
+// the same topic share a view; it is dropped on the last unsubscribe.
+
+#include "haltalk.hh"
+#include "halpb.hh"
+#include "pbutil.hh"
+
+#include <math.h>
+
+static int handle_groupview_timer(zloop_t *loop, int timer_id, void *arg);
+static int parse_view(htself_t *self, groupview_t *v, std::string &err);
+static int view_full_update(groupview_t *v, void *socket);
+
+
+int
+subscribe_groupview(htself_t *self, zloop_t *loop,
+		    const std::string &topic, void *socket)
+{
+    groupview_t *v;
+    viewmap_iterator vi = self->views.find(topic);
+
+    if (vi != self->views.end()) {
+	// another subscriber to a view in use
+	v = vi->second;
+    } else {
+	std::string err;
+	v = new groupview_t();
+	v->self = self;
+	v->topic = topic;
+	v->serial = 0;
+	v->timer_id = -1;
+	v->delta = false;
+	if (parse_view(self, v, err)) {
+	    delete v;
+	    self->tx.set_type(machinetalk::MT_HALGROUP_ERROR);
+	    note_printf(self->tx, "%s: %s", topic.c_str(), err.c_str());
+	    return send_pbcontainer(topic, self->tx, socket);
+	}
+	self->views[topic] = v;
+    }
+
+    int retval = view_full_update(v, socket);
+
+    if (v->timer_id < 0) {
+	v->timer_id = zloop_timer(loop, v->msec, 0,
+				  handle_groupview_timer, (void *)v);
+	assert(v->timer_id > -1);
+	rtapi_print_msg(RTAPI_MSG_DBG,
+			"%s: start scanning view %s, tid=%d, %d mS, %d members",
+			self->cfg->progname, topic.c_str(), v->timer_id,
+			v->msec, v->group->cg->n_members);
+    }
+    return retval;
+}
+
+int
+unsubscribe_groupview(htself_t *self, zloop_t *loop, const std::string &topic)
+{
+    viewmap_iterator vi = self->views.find(topic);
+    if (vi == self->views.end())
+	return 0;
+
+    groupview_t *v = vi->second;
+    if (v->timer_id > -1) {
+	rtapi_print_msg(RTAPI_MSG_DBG,
+			"%s: view %s stop scanning, tid=%d",
+			self->cfg->progname, topic.c_str(), v->timer_id);
+	int retval = zloop_timer_end(loop, v->timer_id);
+	assert(retval == 0);
+    }
+    self->views.erase(vi);
+    delete v;
+    return 0;
+}
+
+// send a keepalive to all view subscribers
+int ping_groupviews(htself_t *self)
+{
+    for (viewmap_iterator v = self->views.begin(); v != self->views.end(); v++) {
+	self->tx.set_type(machinetalk::MT_PING);
+	int retval = send_pbcontainer(v->first, self->tx,
+				      self->mksock[SVC_HALGROUP].socket);
+	assert(retval == 0);
+    }
+    return 0;
+}
+
+void release_groupviews(htself_t *self)
+{
+    for (viewmap_iterator v = self->views.begin(); v != self->views.end(); v++)
+	delete v->second;
+    self->views.clear();
+}
+
+// ----- end of public functions ----
+
+static bool parse_double(const std::string &s, double &d)
+{
+    char *end;
+    errno = 0;
+    d = strtod(s.c_str(), &end);
+    return !s.empty() && (*end == '\0') && (errno == 0) && isfinite(d);
+}
+
+static int parse_view(htself_t *self, groupview_t *v, std::string &err)
+{
+    const std::string &topic = v->topic;
+    std::vector<std::pair<std::string, double> > member_eps;
+    double hz = 0.0, eps = -1.0; // not given
+
+    if ((topic.size() < 3) || (topic[topic.size()-1] != '#')) {
+	err = "view topic must be '@<group>[?<options>]#'";
+	return -1;
+    }
+    std::string spec = topic.substr(1, topic.size() - 2);
+    std::string::size_type q = spec.find('?');
+    std::string name = spec.substr(0, q);
+
+    groupmap_iterator gi = self->groups.find(name);
+    if (gi == self->groups.end()) {
+	err = "no such group: '" + name + "'";
+	return -1;
+    }
+    v->group = gi->second;
+
+    while (q != std::string::npos) {
+	std::string::size_type next = spec.find('&', q + 1);
+	std::string opt = spec.substr(q + 1, next - q - 1);
+	std::string::size_type eq = opt.find('=');
+	std::string key = opt.substr(0, eq);
+	std::string val = (eq == std::string::npos) ? "" : opt.substr(eq + 1);
+	double d;
+
+	if (opt == "delta") {
+	    v->delta = true;
+	} else if (key == "rate") {
+	    if (!parse_double(val, hz) || (hz <= 0.0)) {
+		err = "invalid rate: '" + val + "'";
+		return -1;
+	    }
+	} else if (key == "eps") {
+	    if (!parse_double(val, eps) || (eps < 0.0)) {
+		err = "invalid deadband: '" + val + "'";
+		return -1;
+	    }
+	} else if ((key.compare(0, 4, "eps.") == 0) && (key.size() > 4)) {
+	    if (!parse_double(val, d) || (d < 0.0)) {
+		err = "invalid deadband for " + key.substr(4) + ": '" + val + "'";
+		return -1;
+	    }
+	    member_eps.push_back(std::make_pair(key.substr(4), d));
+	} else {
+	    err = "invalid option: '" + opt + "'";
+	    return -1;
+	}
+	q = next;
+    }
+
+    v->msec = v->group->msec;
+    if ((hz > 0.0) && (ceil(1000.0 / hz) > v->msec))
+	v->msec = ceil(1000.0 / hz);
+
+    hal_compiled_group_t *cg = v->group->cg;
+    v->eps.resize(cg->n_members);
+    v->sent.resize(cg->n_members);
+    for (int i = 0; i < cg->n_members; i++)
+	v->eps[i] = (eps < 0.0) ? hal_data->epsilon[cg->member[i]->eps_index] : eps;
+
+    for (size_t j = 0; j < member_eps.size(); j++) {
+	int i;
+	for (i = 0; i < cg->n_members; i++) {
+	    hal_sig_t *sig = (hal_sig_t *) SHMPTR(cg->member[i]->sig_ptr);
+	    if (member_eps[j].first == ho_name(sig))
+		break;
+	}
+	if (i == cg->n_members) {
+	    err = "'" + member_eps[j].first + "' is not a member of " + name;
+	    return -1;
+	}
+	v->eps[i] = member_eps[j].second;
+    }
+    return 0;
+}
+
+// list all members in the order the delta updates refer to
+static int view_full_update(groupview_t *v, void *socket)
+{
+    htself_t *self = v->self;
+    hal_compiled_group_t *cg = v->group->cg;
+
+    self->tx.set_type(machinetalk::MT_HALGROUP_FULL_UPDATE);
+    self->tx.set_uuid(self->netopts.proc_uuid, sizeof(self->netopts.proc_uuid));
+    self->tx.set_serial(v->serial++);
+    describe_parameters(self);
+    self->tx.mutable_pparams()->set_group_timer(v->msec);
+    {
+	WITH_HAL_MUTEX();
+	for (int i = 0; i < cg->n_members; i++) {
+	    hal_sig_t *sig = (hal_sig_t *) SHMPTR(cg->member[i]->sig_ptr);
+	    // take the value before describing: should the signal
+	    // change in between, the next scan reports it
+	    v->sent[i] = *sig_value(sig);
+	    halpr_describe_signal(sig, self->tx.add_signal());
+	}
+    }
+    rtapi_print_msg(RTAPI_MSG_DBG,
+		    "%s: subscribe view='%s' serial=%d",
+		    self->cfg->progname, v->topic.c_str(), v->serial);
+    return send_pbcontainer(v->topic, self->tx, socket);
+}
+
+static bool value_changed(hal_type_t type, const hal_data_u *cur,
+			  const hal_data_u *sent, hal_float_t eps)
+{
+    switch (type) {
+    case HAL_BIT:
+	return get_bit_value(cur) != get_bit_value(sent);
+    case HAL_FLOAT:
+	return HAL_FABS(get_float_value(cur) - get_float_value(sent)) > eps;
+    case HAL_S32:
+	return get_s32_value(cur) != get_s32_value(sent);
+    case HAL_U32:
+	return get_u32_value(cur) != get_u32_value(sent);
+    default:
+	return false;
+    }
+}
+
+// append a value to delta_values, little endian
+static void pack_value(std::string *buf, hal_type_t type, const hal_data_u *vp)
+{
+    uint64_t u;
+    int n;
+    hal_float_t f;
+
+    switch (type) {
+    case HAL_BIT:
+	u = get_bit_value(vp);
+	n = 1;
+	break;
+    case HAL_FLOAT:
+	f = get_float_value(vp);
+	memcpy(&u, &f, sizeof(u));
+	n = 8;
+	break;
+    case HAL_S32:
+	u = (uint32_t) get_s32_value(vp);
+	n = 4;
+	break;
+    case HAL_U32:
+	u = get_u32_value(vp);
+	n = 4;
+	break;
+    default:
+	return;
+    }
+    for (int i = 0; i < n; i++, u >>= 8)
+	buf->push_back((char) (u & 0xff));
+}
+
+static void value2pb(hal_type_t type, const hal_data_u *vp, machinetalk::Signal *s)
+{
+    switch (type) {
+    case HAL_BIT:
+	s->set_halbit(get_bit_value(vp));
+	break;
+    case HAL_FLOAT:
+	s->set_halfloat(get_float_value(vp));
+	break;
+    case HAL_S32:
+	s->set_hals32(get_s32_value(vp));
+	break;
+    case HAL_U32:
+	s->set_halu32(get_u32_value(vp));
+	break;
+    default:
+	break;
+    }
+}
+
+// report the members which changed beyond their deadband since last sent
+static int
+handle_groupview_timer(zloop_t *loop, int timer_id, void *arg)
+{
+    groupview_t *v = (groupview_t *) arg;
+    htself_t *self = v->self;
+    hal_compiled_group_t *cg = v->group->cg;
+    std::string *mask = NULL, *values = NULL;
+    int nchanged = 0;
+
+    if (v->delta) {
+	mask = self->tx.mutable_delta_mask();
+	mask->assign((cg->n_members + 7) / 8, '\0');
+	values = self->tx.mutable_delta_values();
+    }
+    for (int i = 0; i < cg->n_members; i++) {
+	hal_sig_t *sig = (hal_sig_t *) SHMPTR(cg->member[i]->sig_ptr);
+	hal_type_t type = sig_type(sig);
+	hal_data_u cur = *sig_value(sig);
+
+	if (!value_changed(type, &cur, &v->sent[i], v->eps[i]))
+	    continue;
+	v->sent[i] = cur;
+	nchanged++;
+	if (v->delta) {
+	    (*mask)[i / 8] |= 1 << (i % 8);
+	    pack_value(values, type, &cur);
+	} else {
+	    machinetalk::Signal *signal = self->tx.add_signal();
+	    signal->set_handle(ho_id(sig));
+	    value2pb(type, &cur, signal);
+	}
+    }
+    if (nchanged == 0) {
+	self->tx.Clear();
+	return 0;
+    }
+    self->tx.set_type(v->delta ? machinetalk::MT_HALGROUP_DELTA_UPDATE :
+		      machinetalk::MT_HALGROUP_INCREMENTAL_UPDATE);
+    // as with groups, a gap in serials means a lost update, and
+    // re-subscribing gets a full update
+    self->tx.set_serial(v->serial++);
+    int retval = send_pbcontainer(v->topic, self->tx,
+				  self->mksock[SVC_HALGROUP].socket);
+    assert(retval == 0);
+    return 0;
+}
@@ -202,13 +202,33 @@ static int scan_component(hal_object_ptr o, foreach_args_t *args)
                         "%s: component '%s' - using %d mS poll interval",
                         self->cfg->progname, name, msec);
         args->user_arg2++;
+    } else if ((comp->type == TYPE_REMOTE) &&
+               (self->rcomps.count(ho_name(comp)) == 0)) {
+        // not ready yet, or acquired by someone else - may change
+        // without a HAL event, so look again next time
+        args->user_arg3++;
     }
     return 0;
 }
 
+static int comp_created(const hal_event_t *ev, void *arg)
+{
+    if ((ev->op == HAL_EV_CREATE) && (ev->type == HAL_COMPONENT))
+        *((bool *) arg) = true;
+    return 0;
+}
+
+// like scan_groups(), walk the HAL objects only if the event log has
+// a comp created since the last walk, or that walk left comps behind
 int
 scan_comps(htself_t *self)
 {
+    bool created = false;
+    int retval = halg_foreach_event(true, &self->comp_seq,
+                                    comp_created, &created);
+    if (self->comps_current && (retval >= 0) && !created)
+        return 0;
+
     foreach_args_t args = {};
     args.type = HAL_COMPONENT;
     args.user_ptr1 = (void *)self;
@@ -219,6 +239,8 @@ scan_comps(htself_t *self)
     rtapi_print_msg(RTAPI_MSG_DBG,"adopted %d comps(s)\n",
             args.user_arg2);
 
+    self->comps_current = (args.user_arg1 == 0) && (args.user_arg3 == 0);
+
     if (args.user_arg1 > 0) { // error counter
         rtapi_print_msg(RTAPI_MSG_DBG,"%d comps(s) failed to adopt\n",
                         args.user_arg1);
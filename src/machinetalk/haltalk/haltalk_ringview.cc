@@ -0,0 +1,219 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// ring views - the records of a HAL record ring, published
+//
+// subscribing on the halgroup socket to
+//
+//   %<ring>[?rate=<hz>]#
+//
+// makes haltalk the reader of the named record ring. Every scan it
+// publishes what was written since as an MT_HALRING_UPDATE, one
+// ring_record per record, oldest first. The scan interval defaults to
+// the group timer, rate=<hz> overrides it. Records are passed on as
+// they are; for the motion position trace rings (motion.trace.<n>),
+// postrace.h describes the format, and every new subscriber makes
+// motion write a key record, so the subscriber can start decoding
+// right away. A ring has one reader: publish a trace ring motion
+// doesn't hand to the AXIS logger, e.g. motmod trace_rings=2 and
+// subscribe to '%motion.trace.1#'.
+//
+// As with group views, the leading '%' and trailing '#' keep the
+// topic apart from groups and from longer ring names. Subscribers of
+// the same topic share the view, the last unsubscribe detaches the
+// ring. A gap in serials means lost updates.
+
+#include "haltalk.hh"
+#include "halpb.hh"
+#include "pbutil.hh"
+#include "postrace.h"
+
+#include <math.h>
+
+// records per MT_HALRING_UPDATE at most; more go out next scan
+#define RINGVIEW_MAX_RECORDS 1000
+
+static int handle_ringview_timer(zloop_t *loop, int timer_id, void *arg);
+static int parse_ringview(htself_t *self, ringview_t *v, std::string &err);
+
+
+int
+subscribe_ringview(htself_t *self, zloop_t *loop,
+		   const std::string &topic, void *socket)
+{
+    ringview_t *v;
+    ringviewmap_iterator vi = self->ringviews.find(topic);
+
+    if (vi != self->ringviews.end()) {
+	// another subscriber to a view in use
+	v = vi->second;
+    } else {
+	std::string err;
+	v = new ringview_t();
+	v->self = self;
+	v->topic = topic;
+	v->serial = 0;
+	v->timer_id = -1;
+	v->postrace = false;
+	if (parse_ringview(self, v, err)) {
+	    delete v;
+	    self->tx.set_type(machinetalk::MT_HALGROUP_ERROR);
+	    note_printf(self->tx, "%s: %s", topic.c_str(), err.c_str());
+	    return send_pbcontainer(topic, self->tx, socket);
+	}
+	// start with what is written from now on
+	record_flush(&v->rb);
+	self->ringviews[topic] = v;
+    }
+    if (v->postrace)
+	((postrace_shared_t *) v->rb.scratchpad)->want_key = 1;
+
+    if (v->timer_id < 0) {
+	v->timer_id = zloop_timer(loop, v->msec, 0,
+				  handle_ringview_timer, (void *)v);
+	assert(v->timer_id > -1);
+	rtapi_print_msg(RTAPI_MSG_DBG,
+			"%s: start reading ring %s, tid=%d, %d mS",
+			self->cfg->progname, v->ring.c_str(), v->timer_id,
+			v->msec);
+    }
+    return 0;
+}
+
+int
+unsubscribe_ringview(htself_t *self, zloop_t *loop, const std::string &topic)
+{
+    ringviewmap_iterator vi = self->ringviews.find(topic);
+    if (vi == self->ringviews.end())
+	return 0;
+
+    ringview_t *v = vi->second;
+    if (v->timer_id > -1) {
+	rtapi_print_msg(RTAPI_MSG_DBG,
+			"%s: ring view %s stop reading, tid=%d",
+			self->cfg->progname, topic.c_str(), v->timer_id);
+	int retval = zloop_timer_end(loop, v->timer_id);
+	assert(retval == 0);
+    }
+    hal_ring_detach(&v->rb);
+    self->ringviews.erase(vi);
+    delete v;
+    return 0;
+}
+
+// send a keepalive to all ring view subscribers
+int ping_ringviews(htself_t *self)
+{
+    for (ringviewmap_iterator v = self->ringviews.begin();
+	 v != self->ringviews.end(); v++) {
+	self->tx.set_type(machinetalk::MT_PING);
+	int retval = send_pbcontainer(v->first, self->tx,
+				      self->mksock[SVC_HALGROUP].socket);
+	assert(retval == 0);
+    }
+    return 0;
+}
+
+void release_ringviews(htself_t *self)
+{
+    for (ringviewmap_iterator v = self->ringviews.begin();
+	 v != self->ringviews.end(); v++) {
+	hal_ring_detach(&v->second->rb);
+	delete v->second;
+    }
+    self->ringviews.clear();
+}
+
+// ----- end of public functions ----
+
+static int parse_ringview(htself_t *self, ringview_t *v, std::string &err)
+{
+    const std::string &topic = v->topic;
+    double hz = 0.0;
+    unsigned flags;
+
+    if ((topic.size() < 3) || (topic[topic.size()-1] != '#')) {
+	err = "ring view topic must be '%<ring>[?rate=<hz>]#'";
+	return -1;
+    }
+    std::string spec = topic.substr(1, topic.size() - 2);
+    std::string::size_type q = spec.find('?');
+    v->ring = spec.substr(0, q);
+
+    if (q != std::string::npos) {
+	std::string opt = spec.substr(q + 1);
+	char *end;
+	if (opt.compare(0, 5, "rate=") == 0) {
+	    hz = strtod(opt.c_str() + 5, &end);
+	    if ((*end != '\0') || !(hz > 0.0) || !isfinite(hz)) {
+		err = "invalid rate: '" + opt.substr(5) + "'";
+		return -1;
+	    }
+	} else {
+	    err = "invalid option: '" + opt + "'";
+	    return -1;
+	}
+    }
+
+    if (hal_ring_attachf(NULL, &flags, "%s", v->ring.c_str()) < 0) {
+	err = "no such ring: '" + v->ring + "'";
+	return -1;
+    }
+    if ((flags & RINGTYPE_MASK) != RINGTYPE_RECORD) {
+	err = "not a record ring: '" + v->ring + "'";
+	return -1;
+    }
+    if (hal_ring_attachf(&v->rb, NULL, "%s", v->ring.c_str()) < 0) {
+	err = "can't attach ring: '" + v->ring + "'";
+	return -1;
+    }
+
+    std::string trace(POSTRACE_RING);
+    trace.erase(trace.find('%'));
+    v->postrace = (v->ring.compare(0, trace.size(), trace) == 0) &&
+	(ring_scratchpad_size(&v->rb) >= sizeof(postrace_shared_t));
+
+    v->msec = self->cfg->default_group_timer;
+    if (hz > 0.0)
+	v->msec = ceil(1000.0 / hz);
+    return 0;
+}
+
+// publish the records written since the last scan
+static int
+handle_ringview_timer(zloop_t *loop, int timer_id, void *arg)
+{
+    ringview_t *v = (ringview_t *) arg;
+    htself_t *self = v->self;
+    const void *data;
+    ringsize_t size;
+    int n = 0;
+
+    while ((n < RINGVIEW_MAX_RECORDS) &&
+	   (record_read(&v->rb, &data, &size) == 0)) {
+	self->tx.add_ring_record(data, size);
+	record_shift(&v->rb);
+	n++;
+    }
+    if (n == 0)
+	return 0;
+    self->tx.set_type(machinetalk::MT_HALRING_UPDATE);
+    self->tx.set_serial(v->serial++);
+    int retval = send_pbcontainer(v->topic, self->tx,
+				  self->mksock[SVC_HALGROUP].socket);
+    assert(retval == 0);
+    return 0;
+}
@@ -10,8 +10,9 @@ Logger.prototype.define_signal = function(s) {
     this.log("define signal: " + s.name + " type: " + s.type + " value: " + halvalue(s));
 }
 
-Logger.prototype.log_message = function(msg) {
-    this.log("logger message: " + JSON.stringify(msg));
+// called once per log record; msg is the container it came in
+Logger.prototype.log_message = function(record, msg) {
+    this.log("logger message: " + JSON.stringify(record));
 }
 
 Logger.prototype.closed = function(evt) {
@@ -60,7 +61,11 @@ Logger.prototype.run = function() {
 	var msg = JSON.parse(evt.data);
 	switch (msg.type) {
 	case  MT_LOG_MESSAGE:
-            this.logger.log_message(msg);
+	    // several records come in log_batch, oldest first,
+	    // a single one in log_message
+	    var records = msg.log_batch || [msg.log_message];
+	    for (var i = 0; i < records.length; i++)
+		this.logger.log_message(records[i], msg);
             break;
 	default:
 	    alert("logger  onmessage: undefined message type: " + msg.type + "," + evt.data);
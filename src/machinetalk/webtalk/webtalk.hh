@@ -42,6 +42,7 @@
 
 #define LWS_INITIAL_TXBUFFER 4096  // transmit buffer grows as needed
 #define LWS_TXBUFFER_EXTRA 256   // add to current required size if growing tx buffer
+#define WSQ_LIMIT 1000  // default max frames queued to a websocket session
 
 #ifdef LWS_MAX_HEADER_LEN
 #define MAX_HEADER_LEN LWS_MAX_HEADER_LEN
@@ -157,6 +158,8 @@ typedef struct zws_session_data {
     zframe_t *current;   // partially sent frame (to ws)
     size_t already_sent; // how much of current was sent already
 
+    int queued;          // frames in wsq_out not yet written to the websocket
+    bool kicked;         // queue limit hit, closing the session
 
 
     // URI/args state
@@ -170,6 +173,7 @@ typedef struct zws_session_data {
     int wsin_bytes, wsin_msgs;
     int wsout_bytes, wsout_msgs;
     int zmq_bytes, zmq_msgs;
+    int dropped;
 
     int partial;
     int partial_retry;
@@ -203,6 +207,7 @@ typedef struct wtconf {
     bool trap_signals;
     int ipv6;
     int rtapi_instance;
+    int wsq_limit; // max frames queued per session, 0: unlimited
 } wtconf_t;
 
 typedef struct wtself {
@@ -229,6 +234,8 @@ typedef struct wtself {
     mk_socket_t mksock;
     zservice_t zswww;
 
+    struct wt_txcache *txcache; // shared conversions, see webtalk_txcache.cc
+
 } wtself_t;
 
 
@@ -256,6 +263,24 @@ int wt_proxy_add_policy(wtself_t *self, const char *name, zwscvt_cb cb);
 int service_timer_callback(zloop_t *loop, int  timer_id, void *context);
 int register_zmq_poller(zws_session_t *wss);
 const char *zwsmimetype(const char *ext);
+// queue a frame to the websocket, subject to cfg->wsq_limit. The frame
+// is consumed; returns -1 on a zmq error. wt_wsq_admit() is the limit
+// check alone, for senders not using zframes.
+int wt_wsq_send(zws_session_t *wss, zframe_t **f);
+bool wt_wsq_admit(zws_session_t *wss);
+
+// webtalk_txcache.cc:
+int wt_txcache_new(wtself_t *self);
+void wt_txcache_destroy(wtself_t *self);
+// if the message m received on a SUB-type session was converted before
+// under 'variant' (a policy name, plus options changing the output),
+// queue the stored conversion to wss and return 1; 0 if not cached.
+int wt_txcache_send(wtself_t *self, zws_session_t *wss,
+		    const char *variant, zmsg_t *m);
+// store data as the conversion of m under variant, and queue it to wss
+int wt_txcache_put(wtself_t *self, zws_session_t *wss,
+		   const char *variant, zmsg_t *m,
+		   const void *data, size_t size);
 
 // webtalk_jsonpolicy.cc:
 int json_policy(wtself_t *self, zws_session_t *wss, zwscb_type type);
@@ -74,7 +74,7 @@ example_policy(wtself_t *self,
 		wss->zmq_bytes += zframe_size(f);
 		wss->zmq_msgs++;
 		lwsl_tows("%s: %d:'%.*s'\n", __func__, zframe_size(f),zframe_size(f),zframe_data(f));
-		zframe_send(&f, wss->wsq_out, 0);
+		wt_wsq_send(wss, &f);
 	    }
 	    zmsg_destroy(&m);
 	}
@@ -113,6 +113,35 @@ json_policy(wtself_t *self,
 	    if ((wss->socket_type == ZMQ_SUB) ||
 		(wss->socket_type == ZMQ_XSUB)) {
 
+		// the same update goes to every session subscribed to the
+		// topic - convert a topic + payload message only once
+		bool cacheable = (zmsg_size(m) == 2);
+		if (cacheable && wt_txcache_send(self, wss, "json", m) > 0) {
+		    zmsg_destroy(&m);
+		    break;
+		}
+		if (cacheable) {
+		    f = zmsg_last(m);
+		    if (!c.ParseFromArray(zframe_data(f), zframe_size(f))) {
+			char *hex = zframe_strhex(f);
+			lwsl_err("cant protobuf parse from %s",
+				 hex);
+			free(hex);
+		    } else {
+			try {
+			    std::string json = pb2json(c);
+			    lwsl_tows("%s: '%s'\n", __func__, json.c_str());
+			    wt_txcache_put(self, wss, "json", m,
+					   json.c_str(), json.size());
+			} catch (std::exception &ex) {
+			    lwsl_err("%s: pb2json exception: %s\n", __func__, ex.what());
+			}
+		    }
+		    zmsg_destroy(&m);
+		    c.Clear();
+		    break;
+		}
+
 		// just drop the topic frame
 		f = zmsg_pop (m);
 		zframe_destroy(&f);
@@ -134,6 +163,7 @@ json_policy(wtself_t *self,
 		    zframe_destroy(&f);
 		    break;
 		}
+		zframe_destroy(&f);
 		// this breaks - probably needs some MergeFrom* pb method
 		// if (!c.has_topic() && (topic != NULL))
 		//     c.set_topic(topic); // tack on
@@ -142,7 +172,7 @@ json_policy(wtself_t *self,
 		    std::string json = pb2json(c);
 		    zframe_t *z_jsonframe = zframe_new( json.c_str(), json.size());
 		    lwsl_tows("%s: '%s'\n", __func__, json.c_str());
-		    assert(zframe_send(&z_jsonframe, wss->wsq_out, 0) == 0);
+		    wt_wsq_send(wss, &z_jsonframe);
 
 		} catch (std::exception &ex) {
 		    lwsl_err("%s: pb2json exception: %s\n", __func__, ex.what());
@@ -216,6 +216,7 @@ read_config(wtconf_t *conf)
     if (flag) conf->info.extensions = libwebsocket_get_internal_extensions();
 #endif
     iniFindInt(inifp, "TIMER", conf->section, &conf->service_timer);
+    iniFindInt(inifp, "WSQ_LIMIT", conf->section, &conf->wsq_limit);
 
     str_inidefault(&conf->index_html, inifp, "INDEX_HTML", conf->section);
     str_inidefault(&conf->www_dir, inifp, "WWW_DIR", conf->section);
@@ -313,6 +314,7 @@ int main (int argc, char *argv[])
     conf.info.uid = -1;
     conf.index_html = NULL;
     conf.info.port = PROXY_PORT;
+    conf.wsq_limit = WSQ_LIMIT;
     // ease debugging with gdb - disable all signal handling
     conf.trap_signals = (getenv("NOSIGHDLR") == NULL);
 
@@ -41,6 +41,7 @@ static inline bool b64wrapped(const struct pbzws_session *self)
 { return !!(self->proto->id & PROTO_WRAP_BASE64); }
 
 static int buf_resize(struct pbzws_session *self, size_t required);
+static unsigned char *frame_encode(struct pbzws_session *self, size_t *size);
 static int payload_fromws(zws::Frame *f, void *socket);
 static int frame_tows(struct pbzws_session *self);
 static int frame_fromws(struct pbzws_session *self);
@@ -179,18 +180,35 @@ pbzws_policy(wtself_t *server,
 	break;
 
     case ZWS_TO_WS:
-	// a message was received from the zeroMQ socket
-	m = zmsg_recv(wss->socket);
-	self->pzf->Clear();
-	self->pzf->set_type(zws::MT_PAYLOAD);
-
-	while ((f = zmsg_pop (m)) != NULL) {
-	    self->pzf->add_payload(zframe_data(f), zframe_size(f));
-	    zframe_destroy(&f);
+	{
+	    // a message was received from the zeroMQ socket
+	    // published ones are encoded once for all sessions
+	    const char *variant = b64wrapped(self) ? "pbzws-b64" : "pbzws";
+	    bool published = ((wss->socket_type == ZMQ_SUB) ||
+			      (wss->socket_type == ZMQ_XSUB));
+
+	    m = zmsg_recv(wss->socket);
+	    if (published && wt_txcache_send(server, wss, variant, m) > 0) {
+		zmsg_destroy(&m);
+		return 0;
+	    }
+	    self->pzf->Clear();
+	    self->pzf->set_type(zws::MT_PAYLOAD);
+
+	    for (f = zmsg_first(m); f != NULL; f = zmsg_next(m))
+		self->pzf->add_payload(zframe_data(f), zframe_size(f));
+
+	    if (published) {
+		size_t size;
+		unsigned char *data = frame_encode(self, &size);
+		rc = (data == NULL) ? 1 :
+		    wt_txcache_put(server, wss, variant, m, data, size);
+	    } else {
+		rc = frame_tows(self);
+	    }
+	    zmsg_destroy(&m);
+	    return rc;
 	}
-	rc = frame_tows(self);
-	zmsg_destroy(&m);
-	return rc;
 	break;
 
     default:
@@ -244,11 +262,10 @@ static int error_tows(struct pbzws_session *self, const char *fmt, ...)
     return frame_tows(self);
 }
 
-// serialize and send to ws client. Optionally base64-encode.
-static int frame_tows(struct pbzws_session *self)
+// serialize into self->buf. Optionally base64-encode.
+// returns the start of the encoded frame, NULL on failure
+static unsigned char *frame_encode(struct pbzws_session *self, size_t *size)
 {
-    zframe_t *f;
-
     size_t pbsize =  self->pzf->ByteSize();
     buf_resize(self,  b64wrapped(self) ? B64SIZE(pbsize) + pbsize : pbsize);
 
@@ -256,7 +273,7 @@ static int frame_tows(struct pbzws_session *self)
 
     if (end == self->buf) {
 	lwsl_err("%s: SerializeWithCachedSizesToArray failed\n",  __func__);
-	return 1;
+	return NULL;
     }
     if (b64wrapped(self)) {
 	size_t cnt;
@@ -264,11 +281,23 @@ static int frame_tows(struct pbzws_session *self)
 	base64_init_encodestate(&state);
 	cnt = base64_encode_block((char *)self->buf, pbsize, (char *)end, &state);
 	cnt += base64_encode_blockend((char *)end + cnt, &state);
-	f = zframe_new (end, cnt);
-    } else {
-	f = zframe_new (self->buf, pbsize);
+	*size = cnt;
+	return end;
     }
-    return zframe_send(&f, self->wss->wsq_out, 0);
+    *size = pbsize;
+    return self->buf;
+}
+
+// serialize and send to ws client
+static int frame_tows(struct pbzws_session *self)
+{
+    size_t size;
+    unsigned char *data = frame_encode(self, &size);
+
+    if (data == NULL)
+	return 1;
+    zframe_t *f = zframe_new (data, size);
+    return wt_wsq_send(self->wss, &f);
 }
 
 static int frame_fromws(struct pbzws_session *self)
@@ -0,0 +1,165 @@
+// conversion cache for messages published to many websocket sessions
+//
+// every SUB-type session has its own zmq socket, so a status update
+// subscribed to by 20 browsers arrives 20 times, and the JSON or
+// pbzws policy would parse and re-encode it 20 times. Instead, the
+// first session to see a message converts it and stores the result
+// here, keyed by conversion variant and topic; the other sessions find
+// the identical message in the cache and queue a zmq_msg_copy() of the
+// converted frame, which shares the buffer by reference count.
+//
+// only the most recent message per (variant, topic) is kept. A session
+// lagging behind the others just misses and converts on its own.
+
+#include <string>
+#include <map>
+
+#include "webtalk.hh"
+
+#define TXCACHE_MAX_ENTRIES 256
+
+struct txentry {
+    zmsg_t *raw;	// the message as received from zmq
+    zmq_msg_t cvt;	// its conversion, shared by all sessions
+    unsigned long used; // for LRU eviction
+};
+
+typedef std::map<std::string, txentry *> txmap_t;
+
+struct wt_txcache {
+    txmap_t entries;
+    unsigned long clock;
+    int hits, misses;
+};
+
+static void entry_free(txentry *e)
+{
+    zmsg_destroy(&e->raw);
+    zmq_msg_close(&e->cvt);
+    delete e;
+}
+
+// key: variant and topic, the latter being the first frame
+static bool make_key(std::string &key, const char *variant, zmsg_t *m)
+{
+    zframe_t *topic = zmsg_first(m);
+    if (topic == NULL)
+	return false;
+    key.assign(variant);
+    key.push_back('\0');
+    key.append((const char *) zframe_data(topic), zframe_size(topic));
+    return true;
+}
+
+static bool same_message(zmsg_t *a, zmsg_t *b)
+{
+    if (zmsg_size(a) != zmsg_size(b) ||
+	zmsg_content_size(a) != zmsg_content_size(b))
+	return false;
+    zframe_t *fa = zmsg_first(a);
+    zframe_t *fb = zmsg_first(b);
+    while (fa && fb) {
+	if (!zframe_eq(fa, fb))
+	    return false;
+	fa = zmsg_next(a);
+	fb = zmsg_next(b);
+    }
+    return true;
+}
+
+static int queue_copy(zws_session_t *wss, zmq_msg_t *cvt)
+{
+    zmq_msg_t copy;
+    zmq_msg_init(&copy);
+    zmq_msg_copy(&copy, cvt);
+    if (!wt_wsq_admit(wss)) {
+	zmq_msg_close(&copy);
+	return 0;
+    }
+    if (zmq_msg_send(&copy, zsock_resolve(wss->wsq_out), ZMQ_DONTWAIT) < 0) {
+	zmq_msg_close(&copy);
+	return -1;
+    }
+    wss->queued++;
+    return 0;
+}
+
+int wt_txcache_new(wtself_t *self)
+{
+    self->txcache = new wt_txcache();
+    self->txcache->clock = 0;
+    self->txcache->hits = self->txcache->misses = 0;
+    return 0;
+}
+
+void wt_txcache_destroy(wtself_t *self)
+{
+    wt_txcache *c = self->txcache;
+    if (c == NULL)
+	return;
+    lwsl_info("txcache: %zu entries, %d hits, %d misses\n",
+	      c->entries.size(), c->hits, c->misses);
+    for (txmap_t::iterator it = c->entries.begin(); it != c->entries.end(); ++it)
+	entry_free(it->second);
+    delete c;
+    self->txcache = NULL;
+}
+
+int wt_txcache_send(wtself_t *self, zws_session_t *wss,
+		    const char *variant, zmsg_t *m)
+{
+    wt_txcache *c = self->txcache;
+    std::string key;
+
+    if (c == NULL || !make_key(key, variant, m))
+	return 0;
+
+    txmap_t::iterator it = c->entries.find(key);
+    if (it == c->entries.end() || !same_message(it->second->raw, m)) {
+	c->misses++;
+	return 0;
+    }
+    c->hits++;
+    it->second->used = ++c->clock;
+    if (queue_copy(wss, &it->second->cvt))
+	return -1;
+    return 1;
+}
+
+int wt_txcache_put(wtself_t *self, zws_session_t *wss,
+		   const char *variant, zmsg_t *m,
+		   const void *data, size_t size)
+{
+    wt_txcache *c = self->txcache;
+    std::string key;
+
+    if (c == NULL || !make_key(key, variant, m)) {
+	zframe_t *f = zframe_new(data, size);
+	return wt_wsq_send(wss, &f);
+    }
+
+    txentry *e;
+    txmap_t::iterator it = c->entries.find(key);
+    if (it != c->entries.end()) {
+	// replace the conversion of an older message on this topic
+	e = it->second;
+	zmsg_destroy(&e->raw);
+	zmq_msg_close(&e->cvt);
+    } else {
+	if (c->entries.size() >= TXCACHE_MAX_ENTRIES) {
+	    txmap_t::iterator lru = c->entries.begin();
+	    for (txmap_t::iterator i = c->entries.begin(); i != c->entries.end(); ++i)
+		if (i->second->used < lru->second->used)
+		    lru = i;
+	    entry_free(lru->second);
+	    c->entries.erase(lru);
+	}
+	e = new txentry;
+	c->entries[key] = e;
+    }
+    e->raw = zmsg_dup(m);
+    zmq_msg_init_size(&e->cvt, size);
+    memcpy(zmq_msg_data(&e->cvt), data, size);
+    e->used = ++c->clock;
+    return queue_copy(wss, &e->cvt);
+}
@@ -39,6 +39,7 @@ static inline int zmq2poll(int mask)
 int wt_proxy_new(wtself_t *self)
 {
     self->policies = zlist_new();
+    wt_txcache_new(self);
     self->cfg->info.user = self; // pass instance pointer
     // protocols is a zero delimited array of struct libwebsocket_protocols
     self->cfg->info.protocols = protocols;
@@ -63,6 +64,58 @@ int wt_proxy_add_policy(wtself_t *self, const char *name, zwscvt_cb cb)
 void wt_proxy_exit(wtself_t *self)
 {
     zlist_destroy (&self->policies);
+    wt_txcache_destroy(self);
+}
+
+// the frames queued to a session are limited to cfg->wsq_limit. A client
+// which doesn't keep up - a stalled browser tab, a dead link - would
+// otherwise have the proxy buffer without bound, and with the default
+// pipe HWM block it altogether. Once the limit is hit, further frames are
+// dropped and the session is closed; the client may reconnect and start
+// over from a full update.
+bool wt_wsq_admit(zws_session_t *wss)
+{
+#ifdef LWS_NEW_API
+    wtself_t *self = (wtself_t *) lws_context_user(wss->ctxref);
+#else
+    wtself_t *self = (wtself_t *) libwebsocket_context_user(wss->ctxref);
+#endif
+    int limit = self->cfg->wsq_limit;
+
+    if (!wss->kicked && ((limit <= 0) || (wss->queued < limit)))
+	return true;
+
+    wss->dropped++;
+    if (!wss->kicked) {
+	wss->kicked = true;
+#ifdef LWS_NEW_API
+	lwsl_notice("Websocket %d: %d frames queued, closing slow client\n",
+		    lws_get_socket_fd(wss->wsiref), wss->queued);
+	// the socket may never become writable again, so time it out
+	lws_set_timeout(wss->wsiref, PENDING_TIMEOUT_AWAITING_PING, 1);
+	lws_callback_on_writable(wss->wsiref);
+#else
+	lwsl_notice("Websocket %d: %d frames queued, closing slow client\n",
+		    libwebsocket_get_socket_fd(wss->wsiref), wss->queued);
+	libwebsocket_set_timeout(wss->wsiref, PENDING_TIMEOUT_AWAITING_PING, 1);
+	libwebsocket_callback_on_writable(wss->ctxref, wss->wsiref);
+#endif
+    }
+    return false;
+}
+
+int wt_wsq_send(zws_session_t *wss, zframe_t **f)
+{
+    if (!wt_wsq_admit(wss)) {
+	zframe_destroy(f);
+	return 0;
+    }
+    if (zframe_send(f, wss->wsq_out, ZFRAME_DONTWAIT)) {
+	zframe_destroy(f);
+	return -1;
+    }
+    wss->queued++;
+    return 0;
 }
 
 int register_zmq_poller(zws_session_t *wss)
@@ -338,10 +391,12 @@ callback_http(struct libwebsocket_context *context,
 	    // the two/from WS pair pipe
 	    wss->wsq_out = zsock_new(ZMQ_PAIR);
 	    assert (wss->wsq_out);
+	    zsock_set_sndhwm (wss->wsq_out, 0); // limited by wt_wsq_admit()
 	    zsock_bind (wss->wsq_out, "inproc://wsq-%p", wss);
 
 	    wss->wsq_in = zsock_new(ZMQ_PAIR);
 	    assert (wss->wsq_in);
+	    zsock_set_rcvhwm (wss->wsq_in, 0);
 	    zsock_connect (wss->wsq_in, "inproc://wsq-%p", wss);
 
 	    // start watching the to-websocket pipe
@@ -368,6 +423,9 @@ callback_http(struct libwebsocket_context *context,
 	    // let library handle partial writes
 	    // deal with ws send flow control only
 
+	    if (wss->kicked)
+		return -1; // close a client which didn't keep up
+
 	    if (!lws_send_pipe_choked(wsi) &&
 		(wss->wsqin_poller_active == false)) {
 
@@ -385,6 +443,7 @@ callback_http(struct libwebsocket_context *context,
 	    do {
 		if ((f = zframe_recv_nowait (wss->wsq_in)) == NULL)
 		    break; // done for now
+		wss->queued--;
 
 		n = zframe_size(f);
 		wss->wsout_msgs++;
@@ -445,7 +504,8 @@ callback_http(struct libwebsocket_context *context,
 		default_policy(self, wss, ZWS_CLOSE);
 
 	    lwsl_info("Websocket %d stats: in %d/%d out"
-		      " %d/%d zmq %d/%d partial=%d retry=%d complete=%d txbuf=%d\n",
+		      " %d/%d zmq %d/%d partial=%d retry=%d complete=%d txbuf=%d"
+		      " dropped=%d\n",
 #ifdef LWS_NEW_API
 		      lws_get_socket_fd(wsi), wss->wsin_msgs, wss->wsin_bytes,
 #else
@@ -454,7 +514,7 @@ callback_http(struct libwebsocket_context *context,
 		      wss->wsout_msgs, wss->wsout_bytes,
 		      wss->zmq_msgs, wss->zmq_bytes,
 		      wss->partial, wss->partial_retry, wss->completed,
-		      wss->txbufsize);
+		      wss->txbufsize, wss->dropped);
 	    // stop watching and destroy the zmq sockets
 
 	    if (wss->pollitem.socket != NULL)
@@ -188,7 +188,7 @@ zws_policy(wtself_t *self,
 		lwsl_tows("%s: %c %d:\"%.*s\"\n", __func__,
 			  (nf > 0) ? '1' : '0',
 			  zframe_size(f), zframe_size(f), zframe_data(f));
-		zframe_send(&nframe, wss->wsq_out, 0);
+		wt_wsq_send(wss, &nframe);
 		zframe_destroy(&f);
 	    }
 	    zmsg_destroy(&m);
@@ -60,6 +60,10 @@
 #include <syslog_async.h>
 #include <limits.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
 #include <inifile.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -83,6 +87,7 @@ using namespace google::protobuf;
 #include "shmdrv.h"
 
 #include "mk-backtrace.h"
+#include "rtapi_startup.h"
 #include "setup_signals.h"
 #include "mk-zeroconf.hh"
 
@@ -174,12 +179,15 @@ static AvahiCzmqPoll *av_loop;
 // except for rtapi_msg* and friends (those do not go through the rtapi_switch).
 rtapi_switch_t *rtapi_switch;
 global_data_t *global_data;
+static long long app_start;
 static const char *rpath;
 static int init_actions(int instance);
 static void exit_actions(int instance);
 static int harden_rt(void);
 static void stderr_rtapi_msg_handler(msg_level_t level, const char *fmt, va_list ap);
-static int record_instparms(char *fname, modinfo_t &mi);
+struct preload;
+static int record_instparms(char *fname, modinfo_t &mi, struct preload *p);
+static int find_module(const char *fname, void **section, std::string *path);
 
 static int do_one_item(char item_type_char,
 		       const string &param_name,
@@ -576,6 +584,108 @@ static int do_callfunc_cmd(int instance,
 
 
 
+// module preloading
+//
+// before executing a file, halcmd tells which modules it is going to
+// loadrt with MT_RTAPI_APP_PRELOAD. A thread per module finds the
+// shared object along rpath, pulls it into the page cache and extracts
+// the .rtapi_export section for record_instparms(), all while halcmd
+// works through the lines before the loadrt. dlopen() is not done
+// ahead: a module resolves symbols against those loaded before it, and
+// rtapi_app_main() must run in loadrt order, in this thread.
+// The lookup is find_module(), as loadrt does it, only earlier: a
+// module which was not found is looked up again by loadrt, but one
+// replaced on disk in between gets the section of the old file.
+typedef struct preload {
+    pthread_t thread;
+    string name;
+    string path;      // empty if not found
+    void *section;    // .rtapi_export, malloc'd
+    int csize;
+    double msec;      // time taken
+} preload_t;
+
+static std::map<string, preload_t *> preloads;
+
+static double msec_since(const struct timespec &t0)
+{
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+static void *preload_thread(void *arg)
+{
+    preload_t *p = (preload_t *) arg;
+    struct timespec t0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    p->csize = find_module((p->name + flavor->mod_ext).c_str(),
+			   &p->section, &p->path);
+    if (p->csize >= 0) {
+	int fd = open(p->path.c_str(), O_RDONLY);
+	if (fd >= 0) {
+	    struct stat sb;
+	    if (fstat(fd, &sb) == 0)
+		readahead(fd, 0, sb.st_size);
+	    close(fd);
+	}
+    }
+    p->msec = msec_since(t0);
+    return NULL;
+}
+
+// wait for the preload of a module if one was started, and hand it over
+static preload_t *preload_collect(const string &name)
+{
+    std::map<string, preload_t *>::iterator it = preloads.find(name);
+    if (it == preloads.end())
+	return NULL;
+    preload_t *p = it->second;
+    preloads.erase(it);
+    pthread_join(p->thread, NULL);
+    return p;
+}
+
+static void preload_free(preload_t *p)
+{
+    if (p->section)
+	free(p->section);
+    delete p;
+}
+
+static int do_preload_cmd(int instance,
+			  pbstringarray_t names,
+			  machinetalk::Container &pbreply)
+{
+    if (kernel_threads(flavor))
+	return 0; // modules are insmod'ed by the helper
+
+    // drop leftovers of an earlier file which never got loaded
+    while (!preloads.empty())
+	preload_free(preload_collect(preloads.begin()->first));
+
+    int started = 0;
+    for (int i = 0; i < names.size(); i++) {
+	const string &name = names.Get(i);
+	if (modules.count(name) || preloads.count(name))
+	    continue;
+	preload_t *p = new preload_t();
+	p->name = name;
+	p->section = NULL;
+	p->csize = -1;
+	if (pthread_create(&p->thread, NULL, preload_thread, p)) {
+	    delete p;
+	    continue; // loadrt will do it the slow way
+	}
+	preloads[name] = p;
+	started++;
+    }
+    rtapi_print_msg(RTAPI_MSG_DBG, "preloading %d of %d modules\n",
+		    started, (int) names.size());
+    return 0;
+}
+
 static int do_load_cmd(int instance,
 		       string name,
 		       pbstringarray_t args,
@@ -585,6 +695,9 @@ static int do_load_cmd(int instance,
     int retval;
 
     if (modules.count(name) == 0) {
+	rtapi_span_t span;
+	rtapi_span_begin(&span, "loadrt %s", name.c_str());
+
 	if (kernel_threads(flavor)) {
 	    string cmdargs = pbconcat(args, " ", "'");
 	    retval = run_module_helper("insert %s %s", name.c_str(), cmdargs.c_str());
@@ -593,24 +706,32 @@ static int do_load_cmd(int instance,
 	    } else {
 		modules[name] = modinfo();
 		loading_order.push_back(name);
+		rtapi_span_end(&span);
 	    }
 	    return retval;
 	} else {
 	    strncpy(module_name, (name + flavor->mod_ext).c_str(),
 		    PATH_MAX);
 	    modinfo_t mi = modinfo_t();
+	    struct timespec t0;
+	    double t_dlopen, t_main;
+	    preload_t *p = preload_collect(name);
 
+	    clock_gettime(CLOCK_MONOTONIC, &t0);
 	    mi.handle = dlopen(module_name, RTLD_GLOBAL |RTLD_NOW);
 	    if (!mi.handle) {
 		string errmsg(dlerror());
 		note_printf(pbreply, "%s: dlopen: %s",
 			    __FUNCTION__, errmsg.c_str());
 		note_printf(pbreply, "rpath=%s", rpath == NULL ? "" : rpath);
+		if (p)
+		    preload_free(p);
 		return -1;
 	    }
 	    // first load of a module. Record default instanceparams
 	    // so they can be replayed before newinst
-	    record_instparms(module_name, mi);
+	    record_instparms(module_name, mi, p);
+	    t_dlopen = msec_since(t0);
 
 	    // retrieve the address of rtapi_switch_struct
 	    // so rtapi functions can be called and members
@@ -644,16 +765,22 @@ static int do_load_cmd(int instance,
 
 	    // need to call rtapi_app_main with as root
 	    // RT thread creation and hardening requires this
+	    clock_gettime(CLOCK_MONOTONIC, &t0);
 	    if ((result = start()) < 0) {
 		note_printf(pbreply, "rtapi_app_main(%s): %d %s\n",
 			    name.c_str(), result, strerror(-result));
 		return result;
 	    }
+	    t_main = msec_since(t0);
 	    modules[name] = mi;
 	    loading_order.push_back(name);
+	    rtapi_span_end(&span);
 
-	    rtapi_print_msg(RTAPI_MSG_DBG, "%s: loaded from %s\n",
-			    name.c_str(), module_name);
+	    rtapi_print_msg(RTAPI_MSG_DBG,
+			    "%s: loaded from %s, dlopen %.1fms%s, "
+			    "rtapi_app_main %.1fms\n",
+			    name.c_str(), module_name, t_dlopen,
+			    p ? " (preloaded)" : "", t_main);
 	    return 0;
 	}
     } else {
@@ -947,6 +1074,14 @@ static int rtapi_request(zloop_t *loop, zsock_t *socket, void *arg)
 					pbreply));
 	break;
 
+    case machinetalk::MT_RTAPI_APP_PRELOAD:
+	assert(pbreq.has_rtapicmd());
+	assert(pbreq.rtapicmd().has_instance());
+	pbreply.set_retcode(do_preload_cmd(pbreq.rtapicmd().instance(),
+					   pbreq.rtapicmd().argv(),
+					   pbreply));
+	break;
+
     case machinetalk::MT_RTAPI_APP_UNLOADRT:
 	assert(pbreq.rtapicmd().has_modname());
 	assert(pbreq.rtapicmd().has_instance());
@@ -977,12 +1112,14 @@ static int rtapi_request(zloop_t *loop, zsock_t *socket, void *arg)
 	assert(pbreq.rtapicmd().has_flags());
 
 	if (kernel_threads(flavor)) {
-	    int retval =  rtapi_fs_write(PROCFS_RTAPICMD,"newthread %s %d %d %d %d",
+	    int retval =  rtapi_fs_write(PROCFS_RTAPICMD,"newthread %s %d %d %d %d %d %d",
 				     pbreq.rtapicmd().threadname().c_str(),
 				     pbreq.rtapicmd().threadperiod(),
 				     pbreq.rtapicmd().use_fp(),
 				     pbreq.rtapicmd().cpu(),
-				     pbreq.rtapicmd().flags());
+				     pbreq.rtapicmd().flags(),
+				     pbreq.rtapicmd().timing_policy(),
+				     pbreq.rtapicmd().timing_interval());
 	    pbreply.set_retcode(retval < 0 ? retval:0);
 
 	} else {
@@ -1006,6 +1143,8 @@ static int rtapi_request(zloop_t *loop, zsock_t *socket, void *arg)
 	    args.uses_fp = pbreq.rtapicmd().use_fp();
 	    args.cpu_id = pbreq.rtapicmd().cpu();
 	    args.flags = (rtapi_thread_flags_t) pbreq.rtapicmd().flags();
+	    args.timing = (hal_thread_timing_t) pbreq.rtapicmd().timing_policy();
+	    args.timing_interval = pbreq.rtapicmd().timing_interval();
 
 	    int retval = create_thread(&args);
 	    if (retval < 0) {
@@ -1401,6 +1540,7 @@ static int mainloop(size_t  argc, char **argv)
 
     // the RT stack is now set up and good for use
     global_data->rtapi_app_pid = getpid();
+    rtapi_span_record("rtapi_app startup", app_start, rtapi_span_now());
 
     // main loop
     do {
@@ -1411,6 +1551,10 @@ static int mainloop(size_t  argc, char **argv)
 		    "exiting mainloop (%s)\n",
 		    interrupted ? "interrupted": "by remote command");
 
+    // reap preloads of modules never loaded
+    while (!preloads.empty())
+	preload_free(preload_collect(preloads.begin()->first));
+
     // stop the service announcement
     zeroconf_service_withdraw(rtapi_publisher);
 
@@ -1619,6 +1763,7 @@ static struct option long_options[] = {
 int main(int argc, char **argv)
 {
     int c;
+    app_start = rtapi_span_now();
     progname = argv[0];
     inifile =  getenv("MACHINEKIT_INI");
 
@@ -1775,6 +1920,34 @@ static void remove_module(std::string name)
     invalid = remove( loading_order.begin(), loading_order.end(), name );
 }
 
+// find the location of a shared library - the dlopen() handle wont
+// tell us the pathname - so walk the rpath and stat, and get the params
+// section. A file without one doesn't end the walk, a later rpath entry
+// may have the module. Returns the section size and sets *path, or -1.
+static int find_module(const char *fname, void **section, string *path)
+{
+    if (rpath == NULL)
+	return -1;
+
+    vector<string> tokens;
+    string rp(rpath);
+    boost::split(tokens, rp, boost::is_any_of(":"),
+			 boost::algorithm::token_compress_on);
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+	string pn = tokens[i]+ "/" + fname;
+	struct stat sb;
+	if (stat(pn.c_str(), &sb))
+	    continue;
+	int csize = get_elf_section(pn.c_str(), ".rtapi_export" , section);
+	if (csize >= 0) {
+	    *path = pn;
+	    return csize;
+	}
+    }
+    return -1;
+}
+
 // instparams are set on each instantiation, but must be set
 // to default values before applying new instance params
 // because the old ones will remain in place, overriding defaults.
@@ -1788,31 +1961,31 @@ static void remove_module(std::string name)
 //
 // in do_newinst_cmd(), apply those defaults before the actual parameters
 // are applied.
-static int record_instparms(char *fname, modinfo_t &mi)
+//
+// p: the module's preload if any, consumed
+static int record_instparms(char *fname, modinfo_t &mi, preload_t *p)
 {
-    if (rpath == NULL)
-	return -1;
-
     void *section = NULL;
     int csize = -1;
     size_t i;
-    vector<string> tokens;
-    string pn;
-    string rp(rpath);
-
-    // find the location of the shared library - the dlopen()
-    // handle wont tell us the pathname
-    // so walk the rpath and stat
-    boost::split(tokens, rp, boost::is_any_of(":"),
-			 boost::algorithm::token_compress_on);
 
-    for(i = 0; i < tokens.size() && csize < 0; i++) {
-	pn = tokens[i]+ "/" + fname;
-	struct stat sb;
-	if (stat(pn.c_str(), &sb))
-	    continue;
-	// found it. get the params section.
-	csize = get_elf_section(pn.c_str(), ".rtapi_export" , &section);
+    if (rpath == NULL) {
+	if (p)
+	    preload_free(p);
+	return -1;
+    }
+    if (p) {
+	section = p->section;
+	csize = p->csize;
+	p->section = NULL;
+	rtapi_print_msg(RTAPI_MSG_DBG, "%s: preloaded in %.1fms\n",
+			fname, p->msec);
+	preload_free(p);
+    }
+    if (csize < 0) {
+	// not preloaded, or not found then: look again
+	string pn;
+	csize = find_module(fname, &section, &pn);
     }
     if (csize < 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR, "cant open %s\n", fname);
@@ -71,6 +71,18 @@
 #define MESSAGE_RING_SIZE (4096 * 128)
 #define GLOBAL_HEAP_SIZE  (4096 * 64)
 
+// startup trace, see rtapi_startup.h
+#define RTAPI_STARTUP_SPANS 512   // ring, oldest spans are overwritten
+#define RTAPI_SPAN_NAME     40
+
+typedef struct {
+    unsigned long seq;          // 0: unused or being written, else 1 + span number
+    int pid;
+    char proc[16];              // process name
+    char name[RTAPI_SPAN_NAME];
+    long long start, end;       // CLOCK_MONOTONIC, nsec
+} rtapi_span_rec_t;
+
 // the universally shared global structure
 typedef struct {
     unsigned magic;
@@ -122,6 +134,13 @@ typedef struct {
     // type = *ringheader_t
     int rtapi_messages_ptr;
 
+    // startup trace, written by userland processes while bringing up
+    // the instance. boot_id and boot_start are set by rtapi_msgd.
+    unsigned char boot_id[16];  // new on every start of an instance
+    long long boot_start;       // CLOCK_MONOTONIC nsec, rtapi_msgd start
+    rtapi_atomic_type next_span;
+    rtapi_span_rec_t startup_spans[RTAPI_STARTUP_SPANS];
+
     // global heap
     struct rtapi_heap heap;
     //size_t heap_size;
@@ -132,7 +151,7 @@ typedef struct {
 
 extern global_data_t *global_data;
 
-#define GLOBAL_LAYOUT_VERSION 44   // bump on layout changes of global_data_t
+#define GLOBAL_LAYOUT_VERSION 45   // bump on layout changes of global_data_t
 
 // use global_data->magic to reflect rtapi_msgd state
 #define GLOBAL_INITIALIZING  0x0eadbeefU
@@ -59,6 +59,7 @@ using namespace std;
 #include <ring.h>
 #include <setup_signals.h>
 #include <mk-backtrace.h>
+#include <rtapi_startup.h>
 
 #include <czmq.h>
 #include <mk-service.hh>
@@ -109,6 +110,7 @@ using namespace google::protobuf;
 
 int rtapi_instance;
 global_data_t *global_data;
+static long long boot_start; // origin of the startup trace
 int shmdrv_loaded;
 long page_size;
 
@@ -152,6 +154,11 @@ static int msg_poll_inc = 5;  // increment interval if no message read up to msg
 static int msg_poll =     10;  // current delay; startup fast
 #endif
 
+// under load, when a poll drained more than 1/msg_poll_load_frac of
+// the ring, poll every msg_poll_load mS until the ring is quiet again
+static int msg_poll_load = 1;
+static int msg_poll_load_frac = 8;
+
 static int polltimer_id;      // as returned by zloop_timer()
 static int shutdowntimer_id;
 
@@ -168,6 +175,34 @@ static char proctitle[20];
 static int exit_code  = 0;
 static const char *origins[] = { "kernel", "rt", "user" };
 
+// log records are published in batches of up to LOG_BATCH_MAX records
+// or LOG_BATCH_BYTES of text per frame; the container and its
+// LogMessage objects are reused from one batch to the next
+#define LOG_BATCH_MAX   256
+#define LOG_BATCH_BYTES 65536
+static machinetalk::Container log_container;
+static size_t log_batch_bytes;
+
+// per-origin rate limiting: each (origin, tag) pair has a token bucket
+// of msg_burst messages refilled at msg_rate messages/s. Messages above
+// the rate are dropped and counted, errors and warnings always pass.
+// msg_rate 0 disables the limit.
+static int msg_rate = 500;
+static int msg_burst = 2000;
+#define RATE_REPORT_INTERVAL 1000 // mS between drop reports
+#define MAX_LOG_ORIGINS 256	// (origin, tag) pairs tracked at once
+
+struct log_origin {
+    int origin;
+    char tag[TAGSIZE];
+    double tokens;
+    int64_t last_refill;	// zclock_mono()
+    unsigned long dropped;	// since last report
+    unsigned long dropped_total;
+};
+static std::vector<log_origin> log_origins;
+static int64_t last_rate_report;
+
 static void usage(int argc, char **argv)
 {
     printf("Usage:  %s [options]\n", argv[0]);
@@ -413,6 +448,10 @@ static int init_global_data(global_data_t * data,
 	retval--;
     }
 
+    // startup trace: a fresh boot id, and msgd start as time origin
+    uuid_generate(data->boot_id);
+    data->boot_start = boot_start;
+
     // init the global heap
     _rtapi_heap_init(&data->heap, "global heap");
 
@@ -625,26 +664,166 @@ s_start_shutdown_cb(zloop_t *loop, int  timer_id, void *args)
     return -1; // exit reactor
 }
 
+static void report_origin(log_origin *o);
+
+// a bucket which refilled since its last message is as good as a new
+// one; report_drops() forgets those, and a new pair beyond
+// MAX_LOG_ORIGINS takes the place of the one idle longest
+static log_origin *find_origin(const rtapi_msgheader_t *msg)
+{
+    log_origin *o, *oldest = NULL;
+
+    for (size_t i = 0; i < log_origins.size(); i++) {
+	o = &log_origins[i];
+	if ((o->origin == msg->origin) &&
+	    !strncmp(o->tag, msg->tag, TAGSIZE))
+	    return o;
+	if (!oldest || (o->last_refill < oldest->last_refill))
+	    oldest = o;
+    }
+    if (log_origins.size() < MAX_LOG_ORIGINS) {
+	log_origins.push_back(log_origin());
+	o = &log_origins.back();
+    } else {
+	report_origin(oldest);
+	o = oldest;
+    }
+    memset(o, 0, sizeof(*o));
+    o->origin = msg->origin;
+    strncpy(o->tag, msg->tag, TAGSIZE);
+    o->tokens = msg_burst;
+    o->last_refill = zclock_mono();
+    return o;
+}
+
+// true if the message is within the rate of its origin
+static bool rate_ok(const rtapi_msgheader_t *msg, int64_t now)
+{
+    if ((msg_rate <= 0) || (msg->level <= RTAPI_MSG_WARN))
+	return true;
+
+    log_origin *o = find_origin(msg);
+    o->tokens += (now - o->last_refill) * msg_rate / 1000.0;
+    o->last_refill = now;
+    if (o->tokens > msg_burst)
+	o->tokens = msg_burst;
+    if (o->tokens < 1.0) {
+	o->dropped++;
+	o->dropped_total++;
+	return false;
+    }
+    o->tokens -= 1.0;
+    return true;
+}
+
+static void publish_batch(void)
+{
+    int n = log_container.log_batch_size();
+    zframe_t *z_pbframe;
+
+    if (n == 0)
+	return;
+    if (n == 1) {
+	// a lone record goes out the way it always did
+	log_container.mutable_log_message()->Swap(log_container.mutable_log_batch(0));
+	log_container.mutable_log_batch()->RemoveLast();
+    }
+    log_container.set_type(machinetalk::MT_LOG_MESSAGE);
+
+    struct timespec timestamp;
+    clock_gettime(CLOCK_REALTIME, &timestamp);
+    log_container.set_tv_sec(timestamp.tv_sec);
+    log_container.set_tv_nsec(timestamp.tv_nsec);
+
+    z_pbframe = zframe_new(NULL, log_container.ByteSize());
+    assert(z_pbframe != NULL);
+
+    if (log_container.SerializeWithCachedSizesToArray(zframe_data(z_pbframe))) {
+	// channel name:
+	if (zstr_sendm(logpub.socket, "log"))
+	    syslog_async(LOG_ERR,"zstr_sendm(): %s", strerror(errno));
+
+	// and the actual pb2-encoded message
+	// zframe_send() deallocates the frame after sending
+	if (zframe_send(&z_pbframe, logpub.socket, 0))
+	    syslog_async(LOG_ERR,"zframe_send(): %s", strerror(errno));
+    } else {
+	zframe_destroy(&z_pbframe);
+	syslog_async(LOG_ERR, "container serialization failed");
+    }
+    // Clear() keeps the LogMessage objects and their string buffers
+    // around for the next batch
+    log_container.Clear();
+    log_batch_bytes = 0;
+}
+
+static void add_to_batch(int origin, int pid, int level,
+			 const char *tag, const char *text, size_t len)
+{
+    machinetalk::LogMessage *logmsg = log_container.add_log_batch();
+
+    logmsg->set_origin((machinetalk::MsgOrigin) origin);
+    logmsg->set_pid(pid);
+    logmsg->set_level((machinetalk::MsgLevel) level);
+    logmsg->set_tag(tag, strnlen(tag, TAGSIZE));
+    logmsg->set_text(text, len);
+    log_batch_bytes += len;
+    if ((log_container.log_batch_size() >= LOG_BATCH_MAX) ||
+	(log_batch_bytes >= LOG_BATCH_BYTES))
+	publish_batch();
+}
+
+static void report_origin(log_origin *o)
+{
+    char text[100];
+
+    if (o->dropped == 0)
+	return;
+    int len = snprintf(text, sizeof(text),
+		       "%s:%.*s: %lu messages dropped by rate limit (%lu total)",
+		       origins[o->origin], TAGSIZE, o->tag,
+		       o->dropped, o->dropped_total);
+    syslog_async(LOG_WARNING, "msgd:%d: %s", rtapi_instance, text);
+    if (logpub.socket)
+	add_to_batch(MSG_ULAPI, getpid(), RTAPI_MSG_WARN, "msgd", text, len);
+    o->dropped = 0;
+}
+
+static void report_drops(int64_t now)
+{
+    if (now - last_rate_report < RATE_REPORT_INTERVAL)
+	return;
+    last_rate_report = now;
+    for (size_t i = 0; i < log_origins.size(); ) {
+	log_origin *o = &log_origins[i];
+	report_origin(o);
+	if (o->tokens + (now - o->last_refill) * msg_rate / 1000.0 >= msg_burst) {
+	    log_origins[i] = log_origins.back();
+	    log_origins.pop_back();
+	} else {
+	    i++;
+	}
+    }
+}
+
 static int
 message_poll_cb(zloop_t *loop, int  timer_id, void *args)
 {
     rtapi_msgheader_t *msg;
     size_t payload_length;
     int retval;
-    char *cp;
-    machinetalk::Container container;
-    machinetalk::LogMessage *logmsg;
-    zframe_t *z_pbframe;
+    const char *cp;
     int current_interval = msg_poll;
+    int64_t now = zclock_mono();
 
     if (global_data->error_ring_full > full) {
 	syslog_async(LOG_ERR, "msgd:%d: message ring overrun (full): %d messages lost",
-		     global_data->error_ring_full - full);
+		     rtapi_instance, global_data->error_ring_full - full);
 	full = global_data->error_ring_full;
     }
     if (global_data->error_ring_locked > locked) {
 	syslog_async(LOG_ERR, "msgd:%d: message ring overrun (locked): %d messages lost",
-		     global_data->error_ring_locked - locked);
+		     rtapi_instance, global_data->error_ring_locked - locked);
 	locked = global_data->error_ring_locked;
     }
 
@@ -657,55 +836,39 @@ message_poll_cb(zloop_t *loop, int  timer_id, void *args)
 	n_msgs++;
 	n_bytes += msg_size;
 
+	if (!rate_ok(msg, now)) {
+	    record_shift(&rtapi_msg_buffer);
+	    continue;
+	}
+
 	// strip trailing newlines
-	while ((cp = strrchr(msg->buf,'\n')))
-	    *cp = '\0';
+	payload_length = strnlen(msg->buf, payload_length);
+	if ((cp = (const char *) memchr(msg->buf, '\n', payload_length)))
+	    payload_length = cp - msg->buf;
 	syslog_async(rtapi2syslog(msg->level), "%s:%d:%s %.*s",
 		     msg->tag, msg->pid, origins[msg->origin],
 		     (int) payload_length, msg->buf);
 
-
-	if (logpub.socket) {
-	    // publish protobuf-encoded log message
-	    container.set_type(machinetalk::MT_LOG_MESSAGE);
-
-	    struct timespec timestamp;
-	    clock_gettime(CLOCK_REALTIME, &timestamp);
-	    container.set_tv_sec(timestamp.tv_sec);
-	    container.set_tv_nsec(timestamp.tv_nsec);
-
-	    logmsg = container.mutable_log_message();
-	    logmsg->set_origin((machinetalk::MsgOrigin)msg->origin);
-	    logmsg->set_pid(msg->pid);
-	    logmsg->set_level((machinetalk::MsgLevel) msg->level);
-	    logmsg->set_tag(msg->tag);
-	    logmsg->set_text(msg->buf, strlen(msg->buf));
-
-	    z_pbframe = zframe_new(NULL, container.ByteSize());
-	    assert(z_pbframe != NULL);
-
-	    if (container.SerializeWithCachedSizesToArray(zframe_data(z_pbframe))) {
-		// channel name:
-		if (zstr_sendm(logpub.socket, "log"))
-		    syslog_async(LOG_ERR,"zstr_sendm(): %s", strerror(errno));
-
-		// and the actual pb2-encoded message
-		// zframe_send() deallocates the frame after sending,
-		// and frees pb_buffer through zfree_cb()
-		if (zframe_send(&z_pbframe, logpub.socket, 0))
-		    syslog_async(LOG_ERR,"zframe_send(): %s", strerror(errno));
-
-	    } else {
-		syslog_async(LOG_ERR, "container serialization failed");
-	    }
-	}
+	if (logpub.socket)
+	    add_to_batch(msg->origin, msg->pid, msg->level,
+			 msg->tag, msg->buf, payload_length);
 	record_shift(&rtapi_msg_buffer);
+    }
+    report_drops(now);
+    if (logpub.socket)
+	publish_batch();
+
+    if (n_bytes > message_ring_size / msg_poll_load_frac) {
+	// falling behind - come back right away
+	msg_poll = msg_poll_load;
+    } else if (n_msgs) {
 	msg_poll = msg_poll_min; // keep going quick
+    } else {
+	// done - decay the timer
+	msg_poll += msg_poll_inc;
+	if (msg_poll > msg_poll_max)
+	    msg_poll = msg_poll_max;
     }
-    // done - decay the timer
-    msg_poll += msg_poll_inc;
-    if (msg_poll > msg_poll_max)
-	msg_poll = msg_poll_max;
 
     // update stats
     if (n_msgs > max_msgs)
@@ -715,7 +878,7 @@ message_poll_cb(zloop_t *loop, int  timer_id, void *args)
 
     if (current_interval != msg_poll) {
 	zloop_timer_end(loop, polltimer_id);
-	polltimer_id = zloop_timer (loop, current_interval, 0, message_poll_cb, NULL);
+	polltimer_id = zloop_timer (loop, msg_poll, 0, message_poll_cb, NULL);
     }
 
     // check for rtapi_app exit only after all pending messages are logged:
@@ -750,6 +913,7 @@ static struct option long_options[] = {
     { "shmdrv_opts", required_argument, 0, 'o'},
     { "nosighdlr",   no_argument,    0, 'G'},
     { "heapdebug",   no_argument,    0, 'P'},
+    { "ratelimit", required_argument, 0, 'L'},    // msgs/s[,burst] per origin
 
     {0, 0, 0, 0}
 };
@@ -761,6 +925,7 @@ int main(int argc, char **argv)
     pid_t pid, sid;
     size_t argv0_len, procname_len, max_procname_len;
 
+    boot_start = rtapi_span_now();
     inifile = getenv("MACHINEKIT_INI");
 
     // Verify that the version of the library that we linked against is
@@ -788,7 +953,7 @@ int main(int argc, char **argv)
     while (1) {
 	int option_index = 0;
 	int curind = optind;
-	c = getopt_long (argc, argv, "GhI:sFf:i:SW:u:r:T:M:p:",
+	c = getopt_long (argc, argv, "GhI:sFf:i:SW:u:r:T:M:p:L:",
 			 long_options, &option_index);
 	if (c == -1)
 	    break;
@@ -840,6 +1005,19 @@ int main(int argc, char **argv)
 	case 'o':
 	    shmdrv_opts = strdup(optarg);
 	    break;
+	case 'L':
+	    {
+		char *cp;
+		msg_rate = strtol(optarg, &cp, 0);
+		if (*cp == ',')
+		    msg_burst = strtol(cp + 1, &cp, 0);
+		if ((*cp != '\0') || (msg_rate < 0) || (msg_burst < 1)) {
+		    fprintf(stderr, "bad --ratelimit '%s', expected rate[,burst]\n",
+			    optarg);
+		    exit(1);
+		}
+	    }
+	    break;
 	case 'P':
 	    hal_heap_flags |= (RTAPIHEAP_TRACE_MALLOC|RTAPIHEAP_TRACE_FREE);
 	    global_heap_flags |= (RTAPIHEAP_TRACE_MALLOC|RTAPIHEAP_TRACE_FREE);
@@ -1122,6 +1300,7 @@ int main(int argc, char **argv)
     polltimer_id = zloop_timer (netopts.z_loop, msg_poll, 0, message_poll_cb, NULL);
     global_data->rtapi_msgd_pid = getpid();
     global_data->magic = GLOBAL_READY;
+    rtapi_span_record("msgd startup", boot_start, rtapi_span_now());
 
     do {
 	retval = zloop_start(netopts.z_loop);
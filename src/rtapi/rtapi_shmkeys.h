@@ -44,10 +44,6 @@
 // from scope_shm.h
 #define SCOPE_SHM_KEY  0x000CF406
 
-// from streamer.h
-#define STREAMER_SHMEM_KEY 	0x00535430
-#define SAMPLER_SHMEM_KEY	0x00534130
-
 // from hal/classicladder/arrays.c
 #define CL_SHMEM_KEY 0x004C522b // "CLR+"
 
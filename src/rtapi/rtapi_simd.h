@@ -0,0 +1,50 @@
+#ifndef _RTAPI_SIMD_H
+#define _RTAPI_SIMD_H
+
+// Support for RT functs which process all channels of a component in
+// one pass over per-field arrays. The component keeps its plain funct,
+// and next to it, under #if RTAPI_SIMD, a branch free variant marked
+// RTAPI_SIMD_TARGET which the compiler vectorizes for AVX2. The funct
+// to export is picked at load time:
+//
+//   static void update(void *arg, long period) { ... }
+//   #if RTAPI_SIMD
+//   static RTAPI_SIMD_TARGET void update_simd(void *arg, long period) { ... }
+//   #endif
+//   ...
+//   #if RTAPI_SIMD
+//   if (rtapi_simd_supported()) fn = update_simd;
+//   #endif
+//
+// Only userland flavors get the variant. Kernel flavors must not touch
+// the vector registers from RT context, so there RTAPI_SIMD is 0 and
+// the plain funct is used on every CPU.
+
+#if defined(BUILD_SYS_USER_DSO) && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (__GNUC__*100 + __GNUC_MINOR__ >= 409))
+#define RTAPI_SIMD 1
+
+#if defined(__clang__)
+#define RTAPI_SIMD_TARGET __attribute__((target("avx2")))
+#else
+// -O2 doesn't vectorize on older gcc
+#define RTAPI_SIMD_TARGET __attribute__((target("avx2"), optimize("tree-vectorize")))
+#endif
+
+static inline int rtapi_simd_supported(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+#define RTAPI_SIMD 0
+#define RTAPI_SIMD_TARGET
+
+static inline int rtapi_simd_supported(void)
+{
+    return 0;
+}
+#endif
+
+#endif // _RTAPI_SIMD_H
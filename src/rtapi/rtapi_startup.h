@@ -0,0 +1,97 @@
+#ifndef _RTAPI_STARTUP_H
+#define _RTAPI_STARTUP_H
+
+// Startup trace: the userland processes bringing up an instance -
+// rtapi_msgd, rtapi_app, halcmd, task - record what they spend time on
+// as spans in global_data->startup_spans. 'halcmd show startup' renders
+// them as a timeline, with the critical path.
+//
+//   rtapi_span_t s;
+//   rtapi_span_begin(&s, "loadrt %s", name);
+//   ...
+//   rtapi_span_end(&s);
+//
+// The span is written to the global segment by rtapi_span_end(), so
+// a span may begin before the process attached it; if it still is not
+// attached at the end, the span is dropped. A process attaching late
+// can rtapi_span_stop() its spans and rtapi_span_write() them once
+// attached. Userland only.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "rtapi_global.h"
+#include "shmdrv.h"       // MMAP_OK
+
+typedef struct {
+    char name[RTAPI_SPAN_NAME];
+    long long start, end;
+} rtapi_span_t;
+
+static inline long long rtapi_span_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// record a span measured by other means
+static inline void rtapi_span_record(const char *name,
+				     long long start, long long end)
+{
+    if (!MMAP_OK(global_data) ||
+	(global_data->layout_version != GLOBAL_LAYOUT_VERSION))
+	return;
+
+    unsigned long seq = __sync_fetch_and_add(&global_data->next_span, 1);
+    rtapi_span_rec_t *r =
+	&global_data->startup_spans[seq % RTAPI_STARTUP_SPANS];
+
+    // readers skip the record while seq is 0
+    r->seq = 0;
+    __sync_synchronize();
+    r->pid = getpid();
+    memset(r->proc, 0, sizeof(r->proc));
+    prctl(PR_GET_NAME, r->proc, 0, 0, 0);
+    strncpy(r->name, name, sizeof(r->name) - 1);
+    r->name[sizeof(r->name) - 1] = '\0';
+    r->start = start;
+    r->end = end;
+    __sync_synchronize();
+    r->seq = seq + 1;
+}
+
+static inline void rtapi_span_begin(rtapi_span_t *s, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static inline void rtapi_span_begin(rtapi_span_t *s, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(s->name, sizeof(s->name), fmt, ap);
+    va_end(ap);
+    s->start = rtapi_span_now();
+    s->end = 0;
+}
+
+static inline void rtapi_span_stop(rtapi_span_t *s)
+{
+    s->end = rtapi_span_now();
+}
+
+static inline void rtapi_span_write(rtapi_span_t *s)
+{
+    if (s->end)
+	rtapi_span_record(s->name, s->start, s->end);
+}
+
+static inline void rtapi_span_end(rtapi_span_t *s)
+{
+    rtapi_span_stop(s);
+    rtapi_span_write(s);
+}
+
+#endif // _RTAPI_STARTUP_H
@@ -0,0 +1,151 @@
+// arithm-test: compiled ClassicLadder expressions give what the text
+// evaluation gives, and a new version is not compiled into a buffer
+// a scan may still be running
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "classicladder.h"
+#include "global.h"
+#include "arithm_eval.h"
+
+static StrInfosGene infos;
+static TYPE_FOR_BOOL_VAR bits[100];
+static int words[100];
+static double floats[10];
+static StrCounter counters[10];
+static StrTimerIEC timers[10];
+static StrArithmExpr exprs[4];
+
+StrInfosGene *InfosGene = &infos;
+TYPE_FOR_BOOL_VAR *VarArray = bits;
+int *VarWordArray = words;
+double *VarFloatArray = floats;
+StrCounter *CounterArray = counters;
+StrTimerIEC *NewTimerArray = timers;
+StrArithmExpr *ArithmExpr = exprs;
+StrRung *RungArray;
+
+static const char *compares[] = {
+    "@200/0@>5",
+    "@200/0@*2+1<=@200/1@-3",
+    "(@200/0@&6)<>(@200/1@|1)",
+    "ABS(@200/2@)>=MINI(@200/0@,@200/1@,@200/3@)",
+    "MAXI(@200/0@,@200/1@)>=AVG(@200/0@,@200/1@,@200/2@)",
+    "@200/0[200/4]@>@200/3@-@200/1@/3",
+    NULL
+};
+
+static const char *operates[] = {
+    "@200/10@:=@200/0@*3+@200/1@%4-(@200/2@/2)",
+    "@200/11@:=(@200/0@-@200/1@)*@200/3@",
+    "@200/12[200/4]@:=MAXI(@200/0@,@200/2@)+ABS(@200/2@)",
+    NULL
+};
+
+static const int values[][5] = {
+    { 7, 20, -3, 9, 1 },
+    { 2, 2, 4, -1, 3 },
+    { -6, 5, 0, 13, 0 },
+};
+
+void rtapi_print(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+static unsigned int pauses;
+static StrArithmCode running;
+
+// the compiler waits for the scan to end: check it didn't touch the
+// buffer the scan runs, then end the scan
+void DoPauseMilliSecs(int Time)
+{
+    if (pauses++ == 0)
+        printf("waiting for the scan, running code %s\n",
+               memcmp(&exprs[0].Code[0], &running, sizeof(running)) ?
+               "overwritten" : "intact");
+    InfosGene->ScanSequence++;
+}
+
+static void set_words(const int *v)
+{
+    memset(words, 0, sizeof(words));
+    memcpy(words, v, 5 * sizeof(int));
+}
+
+int main(void)
+{
+    unsigned int i, j;
+
+    InfosGene->GeneralParams.SizesInfos.nbr_words = 50;
+    InfosGene->GeneralParams.SizesInfos.nbr_arithm_expr = 4;
+
+    for (i = 0; compares[i]; i++) {
+        strcpy(exprs[0].Expr, compares[i]);
+        exprs[0].CodeInUse = -1;
+        CompileArithmExpr(0, FALSE);
+        printf("%s:", compares[i]);
+        for (j = 0; j < sizeof(values) / sizeof(values[0]); j++) {
+            set_words(values[j]);
+            int text = EvalCompare(exprs[0].Expr);
+            int code = EvalCompareExpr(0);
+            printf(" %d%s", code, text == code ? "" : "(text differs)");
+        }
+        printf("%s\n", exprs[0].CodeInUse < 0 ? " not compiled" : "");
+    }
+    for (i = 0; operates[i]; i++) {
+        strcpy(exprs[0].Expr, operates[i]);
+        exprs[0].CodeInUse = -1;
+        CompileArithmExpr(0, TRUE);
+        printf("%s:", operates[i]);
+        for (j = 0; j < sizeof(values) / sizeof(values[0]); j++) {
+            int text[50];
+            set_words(values[j]);
+            MakeCalc(exprs[0].Expr, FALSE);
+            memcpy(text, words, sizeof(text));
+            set_words(values[j]);
+            MakeCalcExpr(0);
+            printf(" %d,%d,%d%s", words[10], words[11], words[12 + words[4]],
+                   memcmp(text, words, sizeof(text)) ? "(text differs)" : "");
+        }
+        printf("%s\n", exprs[0].CodeInUse < 0 ? " not compiled" : "");
+    }
+
+    // a syntax error falls back to the text
+    strcpy(exprs[1].Expr, "@200/0@+>3");
+    CompileArithmExpr(1, FALSE);
+    printf("syntax error: CodeInUse %d\n", exprs[1].CodeInUse);
+
+    // a scan begins running Code[0], a new version is published in
+    // Code[1] meanwhile. The next one goes to Code[0] once the scan ended.
+    strcpy(exprs[0].Expr, "@200/10@:=@200/0@+1");
+    CompileArithmExpr(0, TRUE);
+    while (exprs[0].CodeLast != 0) {
+        strcat(exprs[0].Expr, "+1");
+        CompileArithmExpr(0, TRUE);
+    }
+    running = exprs[0].Code[0];
+    InfosGene->ScanSequence = 1;
+    strcpy(exprs[0].Expr, "@200/10@:=@200/0@*4");
+    CompileArithmExpr(0, TRUE);
+    printf("compiled while scanning: in use %d, %d pauses\n", exprs[0].CodeInUse, pauses);
+    strcpy(exprs[0].Expr, "@200/10@:=@200/0@*5");
+    CompileArithmExpr(0, TRUE);
+    printf("compiled after: in use %d, %d pauses\n", exprs[0].CodeInUse, pauses);
+    set_words(values[0]);
+    MakeCalcExpr(0);
+    printf("result %d\n", words[10]);
+
+    // no scan running: no wait
+    pauses = 0;
+    strcpy(exprs[0].Expr, "@200/10@:=@200/0@*6");
+    CompileArithmExpr(0, TRUE);
+    strcpy(exprs[0].Expr, "@200/10@:=@200/0@*7");
+    CompileArithmExpr(0, TRUE);
+    printf("compiled while stopped: in use %d, %d pauses\n", exprs[0].CodeInUse, pauses);
+    return 0;
+}
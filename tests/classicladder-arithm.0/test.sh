@@ -0,0 +1,7 @@
+#!/bin/sh
+rm -f arithm-test
+set -e
+CL=../../src/hal/classicladder
+gcc -DULAPI -DSEQUENTIAL_SUPPORT -DDYNAMIC_PLCSIZE -I../../src -I../../src/rtapi -I$CL \
+    arithm-test.c $CL/arithm_eval.c $CL/vars_access.c -o arithm-test
+./arithm-test
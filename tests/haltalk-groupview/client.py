@@ -0,0 +1,127 @@
+# subscribe to views of group g, change its signals with halcmd and
+# print the updates the views get
+import struct
+import subprocess
+import sys
+import zmq
+
+from machinetalk.protobuf.message_pb2 import Container
+from machinetalk.protobuf.types_pb2 import *
+
+ctx = zmq.Context()
+uri = sys.argv[1]
+
+def subscribe(topic):
+    s = ctx.socket(zmq.SUB)
+    s.connect(uri)
+    s.setsockopt(zmq.SUBSCRIBE, topic)
+    return s
+
+def receive(s, timeout=1000):
+    # the next update, or None; keepalives are skipped
+    while True:
+        if not s.poll(timeout):
+            return None
+        topic, msg = s.recv_multipart()
+        c = Container()
+        c.ParseFromString(msg)
+        if c.type != MT_PING:
+            return c
+
+def sets(name, value):
+    subprocess.check_call(["halcmd", "sets", name, str(value)])
+
+def sets_together(*pairs):
+    # one halcmd, so that one scan sees all the changes
+    p = subprocess.Popen(["halcmd", "-f"], stdin=subprocess.PIPE)
+    p.communicate("".join("sets %s %s\n" % nv for nv in pairs))
+
+def value(sig):
+    if sig.type == HAL_BIT:
+        return int(sig.halbit)
+    if sig.type == HAL_FLOAT:
+        return sig.halfloat
+    if sig.type == HAL_S32:
+        return sig.hals32
+    return sig.halu32
+
+members = []
+
+def show_full(c):
+    del members[:]
+    print "full update, timer %d" % c.pparams.group_timer
+    for sig in c.signal:
+        members.append((sig.name, sig.type))
+        print "  %s = %s" % (sig.name, value(sig))
+
+def show_delta(c):
+    if c is None:
+        print "no update"
+        return
+    if c.type != MT_HALGROUP_DELTA_UPDATE:
+        print "unexpected type %d" % c.type
+        return
+    mask = bytearray(c.delta_mask)
+    values = c.delta_values
+    out = []
+    for i, (name, type) in enumerate(members):
+        if not mask[i / 8] & (1 << (i % 8)):
+            continue
+        if type == HAL_BIT:
+            v, values = struct.unpack("<B", values[:1])[0], values[1:]
+        elif type == HAL_FLOAT:
+            v, values = struct.unpack("<d", values[:8])[0], values[8:]
+        elif type == HAL_S32:
+            v, values = struct.unpack("<i", values[:4])[0], values[4:]
+        else:
+            v, values = struct.unpack("<I", values[:4])[0], values[4:]
+        out.append("%s = %s" % (name, v))
+    if values:
+        out.append("%d bytes left over" % len(values))
+    print "delta %d mask bytes: %s" % (len(c.delta_mask), ", ".join(out))
+
+def step(s, name, v):
+    sets(name, v)
+    print "sets %s %s:" % (name, v),
+    show_delta(receive(s, 500))
+
+# deadband 0.5 for all floats, delta frames
+s = subscribe("@g?eps=0.5&delta#")
+show_full(receive(s))
+step(s, "pos", 0.2)
+step(s, "count", -3)
+step(s, "pos", 0.45)
+# drift is measured from the value last sent, 0
+step(s, "pos", 0.7)
+step(s, "on", 1)
+sets_together(("pos", 2.5), ("count", 7))
+print "two changes:",
+show_delta(receive(s))
+s.close()
+
+# a member deadband; rate limits the scan timer
+s = subscribe("@g?rate=4&eps.pos=10&delta#")
+show_full(receive(s))
+step(s, "pos", 9)
+step(s, "pos", 13)
+s.close()
+
+# incremental updates for a view without delta
+s = subscribe("@g?eps=0#")
+show_full(receive(s))
+sets("pos", 13.25)
+c = receive(s)
+print "incremental:", c.type == MT_HALGROUP_INCREMENTAL_UPDATE, \
+    [(sig.handle != 0, value(sig)) for sig in c.signal]
+s.close()
+
+for topic in ["@nosuch#", "@g?eps.nosuch=1#", "@g?rate=0#", "@g?eps=x#",
+              "@g?fast#", "@g"]:
+    s = subscribe(topic)
+    c = receive(s)
+    if c is None:
+        print "%s: no reply" % topic
+    else:
+        print "%s: error %s, %s" % (topic, c.type == MT_HALGROUP_ERROR,
+                                    "; ".join(c.note))
+    s.close()
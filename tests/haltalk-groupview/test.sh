@@ -0,0 +1,21 @@
+#!/bin/bash
+# group views of haltalk (haltalk_groupview.cc): deadband relative to
+# the value last sent, delta frames, rate, and errors in view topics
+
+export MACHINEKIT_INI=$(pwd)/machinekit.ini
+MKUUID=6d7b5d0e-1d9c-4c55-9a0b-2b1f1b6c0a38
+
+realtime start
+halcmd -f setup.hal
+haltalk &
+HALTALK=$!
+sleep 2
+
+# REMOTE=0: haltalk binds an IPC socket in its RUNDIR, /tmp by default
+python2 client.py "ipc://${RUNDIR:-/tmp}/0.halgroup.$MKUUID"
+RESULT=$?
+
+kill $HALTALK
+wait $HALTALK
+realtime stop
+exit $RESULT
@@ -0,0 +1,73 @@
+// inifile-test: values stay valid while the file changes, and the
+// indexes of old versions of the file are freed
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "inifile.hh"
+
+static void write_ini(const char *name, const char *value)
+{
+    FILE *f = fopen(name, "w");
+    fprintf(f, "[EMC]\nMACHINE = %s\n[TRAJ]\nLINEAR_UNITS = mm\n", value);
+    fclose(f);
+}
+
+static void show(const char *what, const char *v)
+{
+    printf("%s: %s, %lu indexes\n", what, v ? v : "(null)", iniIndexCount());
+}
+
+int main(void)
+{
+    const char *name = "test.ini";
+
+    write_ini(name, "first");
+    IniFile a;
+    a.Open(name);
+    const char *va = a.Find("MACHINE", "EMC");
+    show("a", va);
+
+    // a second IniFile sees the new file, a's value stays
+    write_ini(name, "second version");
+    IniFile b;
+    b.Open(name);
+    const char *vb = b.Find("MACHINE", "EMC");
+    show("b", vb);
+    show("a", va);
+    show("a again", a.Find("MACHINE", "EMC"));
+
+    // the first version goes with the last IniFile that used it
+    a.Close();
+    show("a closed", vb);
+    b.Close();
+    show("b closed", NULL);
+
+    // nothing holds the old version when nothing is open
+    for (int i = 0; i < 3; i++) {
+        char value[32];
+        snprintf(value, sizeof(value), "version %d%s", i, i == 1 ? "!" : "");
+        write_ini(name, value);
+        FILE *fp = fopen(name, "r");
+        show("iniFind", iniFind(fp, "MACHINE", "EMC"));
+        fclose(fp);
+    }
+
+    // a pipe is read once and parsed once per IniFile
+    FILE *fp = popen("cat test.ini", "r");
+    IniFile p(0, fp);
+    show("pipe", p.Find("MACHINE", "EMC"));
+    show("pipe", p.Find("LINEAR_UNITS", "TRAJ"));
+    p.Close();
+    pclose(fp);
+    show("pipe closed", NULL);
+
+    // and iniFind's value outlives its parse
+    fp = popen("cat test.ini", "r");
+    const char *v = iniFind(fp, "LINEAR_UNITS", "TRAJ");
+    show("iniFind pipe", v);
+    pclose(fp);
+
+    unlink(name);
+    return 0;
+}
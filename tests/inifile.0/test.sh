@@ -0,0 +1,6 @@
+#!/bin/sh
+rm -f inifile-test
+set -e
+g++ -I../../src -I../../src/libnml/inifile inifile-test.cc ../../src/libnml/inifile/inifile.cc \
+    -lpthread -o inifile-test
+./inifile-test
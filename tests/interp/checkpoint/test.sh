@@ -0,0 +1,43 @@
+#!/bin/bash
+set -e
+rm -f test.ngc.ckpt sub.ngc changed.var changed.var.bak
+
+run () {
+    echo "-- $*"
+    rs274 -i test.ini "$@" -g test.ngc 2>/dev/null | grep MESSAGE | awk '{$1=""; print}'
+    return ${PIPESTATUS[0]}
+}
+
+cat > sub.ngc <<EOS
+o<sub> sub
+(debug,sub A #1)
+o<sub> endsub
+M2
+EOS
+
+# from the top, writing checkpoints at lines 5, 10 and 15
+run -r 1
+# starts after line 10
+run -r 12
+
+# an edited sub is read again, not found at its old offset
+cat > sub.ngc <<EOS
+(the sub moved
+ down by two lines)
+o<sub> sub
+(debug,sub B #1)
+o<sub> endsub
+M2
+EOS
+run -r 12
+
+# a damaged checkpoint leaves the interpreter as it was: from the top
+size=$(stat -c %s test.ngc.ckpt)
+printf 'Z' | dd of=test.ngc.ckpt bs=1 seek=$((size - 1)) conv=notrunc 2>/dev/null
+run -r 17
+
+# a parameter the checkpoints were not taken with: from the top
+echo "200 5.000000" > changed.var
+run -v changed.var -r 17
+
+rm -f test.ngc.ckpt sub.ngc changed.var changed.var.bak
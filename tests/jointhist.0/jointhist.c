@@ -0,0 +1,92 @@
+// feed jointhist_stats_update() synthetic records and print the moves
+// it reports
+
+#include <stdio.h>
+#include "jointhist.h"
+
+#define PERIOD 0.001
+
+static jointhist_stats_t stats;
+static __u32 cycle;
+
+static struct {
+    jointhist_record_t r;
+    jointhist_sample_t js[EMCMOT_MAX_JOINTS];
+} rec;
+
+static void print_move(const jointhist_move_t *mv)
+{
+    int j;
+
+    printf("move line %d: %u samples from cycle %u\n", mv->line,
+	   mv->samples, mv->start_cycle);
+    for (j = 0; j < mv->joints; j++)
+	printf("  joint %d: rms %.6f peak %.6f at %u settle %.6f\n", j,
+	       mv->rms_ferror[j], mv->peak_ferror[j], mv->peak_cycle[j],
+	       mv->settle_time[j]);
+}
+
+/* one record of two joints, joint 1 follows joint 0 with half its
+   following error */
+static int sample(int line, double vel, double ferror)
+{
+    jointhist_move_t mv;
+    int j, retval;
+
+    rec.r.cycle = ++cycle;
+    rec.r.line = line;
+    rec.r.joints = 2;
+    for (j = 0; j < 2; j++) {
+	rec.js[j].vel_cmd = vel;
+	rec.js[j].ferror = ferror / (j + 1);
+    }
+    retval = jointhist_stats_update(&stats, &rec,
+	sizeof(rec.r) + 2 * sizeof(jointhist_sample_t), &mv);
+    if (retval == 1)
+	print_move(&mv);
+    return retval;
+}
+
+int main()
+{
+    jointhist_stats_init(&stats, PERIOD, 0.001, 0.0025);
+
+    /* standing still is no move */
+    sample(9, 0.0, 0.5);
+    sample(9, 0.0, 0.5);
+
+    /* a new line tag ends the move, rms and signed peak */
+    printf("-- line change\n");
+    sample(10, 1.0, 0.1);
+    sample(10, 1.0, -0.3);
+    sample(10, 1.0, 0.2);
+    sample(10, 1.0, 0.0);
+    sample(11, 1.0, 0.01);
+
+    /* stopped, settles two samples after the stop */
+    printf("-- settle\n");
+    sample(11, 0.0, 0.005);
+    sample(11, 0.0, 0.002);
+    sample(11, 0.0, 0.0005);
+
+    /* already within the band when stopped */
+    printf("-- in band\n");
+    sample(12, 1.0, 0.0005);
+    sample(12, 0.0, 0.0002);
+
+    /* never settles: timed out after 2.5ms */
+    printf("-- timeout\n");
+    sample(13, 1.0, 0.01);
+    sample(13, 0.0, 0.01);
+    sample(13, 0.0, 0.01);
+    sample(13, 0.0, 0.01);
+    sample(13, 0.0, 0.01);
+
+    /* malformed records */
+    printf("-- malformed\n");
+    printf("short %d\n", jointhist_stats_update(&stats, &rec, 4, NULL));
+    rec.r.joints = EMCMOT_MAX_JOINTS + 1;
+    printf("joints %d\n", jointhist_stats_update(&stats, &rec,
+	sizeof(rec.r) + 2 * sizeof(jointhist_sample_t), NULL));
+    return 0;
+}
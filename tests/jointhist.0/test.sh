@@ -0,0 +1,6 @@
+#!/bin/sh
+rm -f jointhist
+set -e
+gcc -DULAPI -I../../src -I../../src/rtapi -I../../src/emc/motion \
+    jointhist.c -o jointhist -lm
+./jointhist
@@ -0,0 +1,62 @@
+#!/usr/bin/python2
+#
+# submit 25 MDI lines with command.mdi_batch() while task works on a
+# dwell: the first call fills the MDI queue of 10, a call into the full
+# queue takes nothing, and the rest goes out as the queue drains
+
+import linuxcnc
+import time
+import sys
+
+c = linuxcnc.command()
+s = linuxcnc.stat()
+
+def wait_for(cond, what, timeout=10.0):
+    start = time.time()
+    while time.time() - start < timeout:
+        s.poll()
+        if cond():
+            return
+        time.sleep(0.01)
+    print "timed out waiting for", what
+    sys.exit(1)
+
+def check(what, got, want):
+    print "%s: %d" % (what, got)
+    if got != want:
+        print "expected %d" % want
+        sys.exit(1)
+
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.state(linuxcnc.STATE_ON)
+c.mode(linuxcnc.MODE_MDI)
+wait_for(lambda: s.task_state == linuxcnc.STATE_ON and
+         s.task_mode == linuxcnc.MODE_MDI, "machine on in MDI mode")
+
+c.mdi("m100 p-1")
+c.wait_complete()
+
+# keep task busy so that nothing leaves the queue for a while
+c.mdi("g4 p2")
+wait_for(lambda: s.queued_mdi_commands == 0 and
+         s.interp_state != linuxcnc.INTERP_IDLE, "the dwell to start")
+
+lines = ["m100 p%d" % i for i in range(25)]
+check("mdi queue max", s.mdi_queue_max, 10)
+first = c.serial
+sent = c.mdi_batch(lines)
+check("first batch", sent, 10)
+check("serial numbers used", c.serial - first, 10)
+check("into the full queue", c.mdi_batch(lines[sent:]), 0)
+
+while sent < len(lines):
+    sent += c.mdi_batch(lines[sent:])
+    time.sleep(0.05)
+wait_for(lambda: s.mdi_serial == c.serial, "the last line to run", 30.0)
+
+c.mdi("m100 p-2")
+c.wait_complete()
+
+c.state(linuxcnc.STATE_OFF)
+c.state(linuxcnc.STATE_ESTOP)
+sys.exit(0)
@@ -0,0 +1,12 @@
+#!/bin/bash
+
+rm -f gcode-output expected-gcode-output
+
+printf "P is %.6f\n" -1 >> expected-gcode-output
+for i in $(seq 0 24); do
+    printf "P is %.6f\n" $i >> expected-gcode-output
+done
+printf "P is %.6f\n" -2 >> expected-gcode-output
+
+linuxcnc -r batch-test.ini
+exit $?
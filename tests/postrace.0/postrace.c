@@ -0,0 +1,116 @@
+// encode a synthetic position trace with postrace_encode() the way
+// motion writes it, decode it with postrace_decode() and compare
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "postrace.h"
+
+#define QUANTUM 1e-6
+#define SAMPLES 20000
+
+static postrace_reader_t writer, reader;
+static __u8 buf[sizeof(postrace_key_t)];
+static unsigned seed = 1;
+
+/* the same numbers on every run */
+static double noise(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+}
+
+static int key(const double cmd[], const double act[], int line,
+	       int motion_type, __u32 cycle)
+{
+    postrace_key_t *k = (postrace_key_t *) buf;
+    int i;
+
+    memset(k, 0, sizeof(*k));
+    k->kind = POSTRACE_KEY;
+    k->motion_type = motion_type;
+    k->line = line;
+    k->cycle = cycle;
+    k->quantum = QUANTUM;
+    for (i = 0; i < POSTRACE_AXES; i++) {
+	k->cmd[i] = cmd[i];
+	k->act[i] = act[i];
+    }
+    postrace_decode(&writer, k, sizeof(*k));
+    return sizeof(*k);
+}
+
+int main(void)
+{
+    double cmd[POSTRACE_AXES], act[POSTRACE_AXES], err, max_err = 0;
+    unsigned records = 0, keys = 0, bytes = 0, wrong = 0;
+    int line = 10, motion_type = 1, size, i;
+    __u32 cycle;
+
+    memset(cmd, 0, sizeof(cmd));
+    memset(act, 0, sizeof(act));
+    for (cycle = 1; cycle <= SAMPLES; cycle++) {
+	/* X and Y move, A creeps below a quantum a cycle, the rest stand */
+	cmd[0] += 0.001 + 0.0001 * noise();
+	cmd[1] -= 0.0005;
+	cmd[3] += 0.3 * QUANTUM;
+	if (cycle == SAMPLES / 2)
+	    cmd[2] += 5000.0;		/* out of range for a delta */
+	for (i = 0; i < POSTRACE_AXES; i++)
+	    act[i] = cmd[i] + 0.00002 * noise();
+	if (cycle % 1000 == 0)
+	    line++;
+	if (cycle % 3000 == 0)
+	    motion_type = 3 - motion_type;
+
+	size = cycle == 1 ? -1 : postrace_encode(&writer, buf, cmd, act,
+						 line, motion_type, cycle);
+	if (size < 0) {
+	    size = key(cmd, act, line, motion_type, cycle);
+	    keys++;
+	} else if (size == 0) {
+	    continue;
+	} else {
+	    postrace_decode(&writer, buf, size);
+	}
+	records++;
+	bytes += size;
+
+	if (postrace_decode(&reader, buf, size) != 1)
+	    wrong++;
+	if (reader.line != line || reader.motion_type != motion_type
+	    || reader.cycle != cycle)
+	    wrong++;
+	for (i = 0; i < POSTRACE_AXES; i++) {
+	    err = fabs(reader.cmd[i] - cmd[i]);
+	    if (err > max_err)
+		max_err = err;
+	    err = fabs(reader.act[i] - act[i]);
+	    if (err > max_err)
+		max_err = err;
+	}
+    }
+    printf("%d samples: %u records, %u keys, %u bytes\n", SAMPLES,
+	   records, keys, bytes);
+    printf("wrong line, motion type or cycle: %u\n", wrong);
+    printf("error within half a quantum: %s\n",
+	   max_err <= 0.5 * QUANTUM * (1 + 1e-6) ? "yes" : "no");
+
+    /* a reader skips deltas until its first key */
+    memset(&reader, 0, sizeof(reader));
+    cmd[0] += 0.001;
+    size = postrace_encode(&writer, buf, cmd, act, line, motion_type, cycle);
+    printf("delta before a key: %d\n", postrace_decode(&reader, buf, size));
+    postrace_decode(&writer, buf, size);
+
+    /* truncated and unknown records are refused */
+    memcpy(&reader, &writer, sizeof(reader));
+    cmd[0] += 0.001;
+    size = postrace_encode(&writer, buf, cmd, act, line, motion_type, cycle);
+    printf("truncated delta: %d\n", postrace_decode(&reader, buf, size - 1));
+    buf[0] = 7;
+    printf("unknown kind: %d\n", postrace_decode(&reader, buf, size));
+    size = key(cmd, act, line, motion_type, cycle);
+    printf("truncated key: %d\n", postrace_decode(&reader, buf, size - 1));
+    return 0;
+}
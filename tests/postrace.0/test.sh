@@ -0,0 +1,6 @@
+#!/bin/sh
+rm -f postrace
+set -e
+gcc -DULAPI -I../../src -I../../src/rtapi -I../../src/emc/motion \
+    postrace.c -o postrace -lm
+./postrace
@@ -0,0 +1,40 @@
+#!/bin/sh
+python2 <<EOF
+import linuxcnc
+
+def P(x, y, z):
+    return (x, y, z, 0., 0., 0., 0., 0., 0.)
+
+lines = [
+    (1, P(0, 0, 0), P(1, 0, 0), (0, 0, 0)),
+    (1, P(1, 0, 0), P(1, 1, 0), (0, 0, 0)),
+    (2, P(1, 1, 0), P(0, 1, 0), (0, 0, 0)),
+    (3, P(5, 5, 5), P(6, 5, -1), (0, 0, 0)),
+]
+s = linuxcnc.segments("XYZ")
+s.extend(lines)
+print "len", len(s)
+print "stats", s.stats()
+print "extents", s.extents()
+for l in 1, 2, 3, 7:
+    print "highlight", l, s.highlight(l, 0)
+
+lines.append((3, P(6, 5, -1), P(6, 6, -1), (0, 0, 0)))
+s.extend(lines, len(s))
+print "len", len(s)
+print "stats", s.stats()
+print "extents", s.extents()
+print "highlight", 3, s.highlight(3, 0)
+
+print "empty", linuxcnc.segments("XYZ").extents()
+
+from rs274.glcanon import GLCanon
+c = GLCanon({}, "XYZ")
+a = c.segments(c.feed)
+print "cached", c.segments(c.feed) is a
+c.feed.extend(lines[:2])
+print "grown", c.segments(c.feed) is a, len(a)
+print "other list", c.segments(c.traverse) is a
+del c.feed[:]
+print "shrunk", c.segments(c.feed) is a, len(c.segments(c.feed))
+EOF
@@ -0,0 +1,74 @@
+#!/usr/bin/python2
+#
+# run programs with [TASK] READAHEAD_THREAD = 1: while task waits out a
+# dwell the thread fills the interp list to INTERP_MAX_LEN, where
+# reading in the task cycle stops at two thirds of it. Lines after a
+# sync point run in order, an interpreter error found by the thread
+# aborts the program, and the next program runs as before.
+
+import linuxcnc
+import time
+import sys
+
+interp_max_len = 20
+
+c = linuxcnc.command()
+s = linuxcnc.stat()
+e = linuxcnc.error_channel()
+
+def wait_for(cond, what, timeout=10.0):
+    start = time.time()
+    while time.time() - start < timeout:
+        s.poll()
+        if cond():
+            return
+        time.sleep(0.01)
+    print "timed out waiting for", what
+    sys.exit(1)
+
+def run(program):
+    c.mode(linuxcnc.MODE_AUTO)
+    c.wait_complete()
+    c.program_open(program)
+    c.auto(linuxcnc.AUTO_RUN, 0)
+    wait_for(lambda: s.interp_state != linuxcnc.INTERP_IDLE,
+             "%s to start" % program)
+
+def idle():
+    return (s.interp_state == linuxcnc.INTERP_IDLE and
+            s.exec_state == linuxcnc.EXEC_DONE)
+
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.state(linuxcnc.STATE_ON)
+wait_for(lambda: s.task_state == linuxcnc.STATE_ON, "machine on")
+
+for n in range(2):
+    run("readahead.ngc")
+    wait_for(lambda: s.exec_state == linuxcnc.EXEC_WAITING_FOR_DELAY,
+             "the dwell")
+    time.sleep(0.3)
+    s.poll()
+    print "readahead depth during the dwell: %d" % s.readahead_depth
+    if s.readahead_depth < interp_max_len:
+        print "expected at least %d" % interp_max_len
+        sys.exit(1)
+    wait_for(idle, "readahead.ngc to finish", 30.0)
+    s.poll()
+    if s.readahead_depth != 0:
+        print "readahead depth after the program: %d" % s.readahead_depth
+        sys.exit(1)
+
+    if n == 0:
+        run("error.ngc")
+        wait_for(idle, "error.ngc to abort")
+        msg = e.poll()
+        while msg and "zero feed rate" not in msg[1]:
+            msg = e.poll()
+        if not msg:
+            print "no interpreter error from error.ngc"
+            sys.exit(1)
+        print "error.ngc: %s" % msg[1]
+
+c.state(linuxcnc.STATE_OFF)
+c.state(linuxcnc.STATE_ESTOP)
+sys.exit(0)
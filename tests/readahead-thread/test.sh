@@ -0,0 +1,21 @@
+#!/bin/bash
+
+rm -f gcode-output readahead.ngc
+
+# a dwell, then more moves than the interp list holds
+{
+    echo "m100 p1"
+    echo "g20 g90 g1 f120 x0 y0 z0"
+    echo "g4 p1"
+    for i in $(seq 1 50); do
+        echo "g1 x0.$((i % 2))1"
+    done
+    echo "m66 p0 l0"
+    echo "m100 p2"
+    echo "g1 x0"
+    echo "m100 p3"
+    echo "m2"
+} > readahead.ngc
+
+linuxcnc -r readahead-test.ini
+exit $?
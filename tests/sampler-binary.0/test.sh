@@ -0,0 +1,10 @@
+#!/bin/bash
+# record six samples with halsampler -b -t, then play the binary file
+# back through halstreamer -b, mapped and from a pipe, and print them
+# as text
+rm -f samples.bin
+halrun -f record.hal > samples.bin || exit 1
+echo "file:"
+REPLAY=replay-file halrun -f replay.hal || exit 1
+echo "pipe:"
+REPLAY=replay-pipe halrun -f replay.hal || exit 1
@@ -0,0 +1,106 @@
+// envelope-test: the min/max envelopes of the halscope stream mode
+// against the samples they were built from
+//
+// Two channels: a ramp, where the envelope of a column shows how far
+// its buckets reach beyond the column, and a pseudo random signal
+// with a gap of NaN samples. For each view the columns are checked
+// to contain the exact min/max of their samples.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "scope_env.h"
+
+#define COUNT 3000000LL
+#define GAP_START 2000000LL
+#define GAP_END 2000500LL
+#define COLS 200
+
+static scope_env_t ramp, noise;
+static float *samples;
+
+static float noise_value(long long i)
+{
+    if (i >= GAP_START && i < GAP_END)
+	return NAN;
+    return (float) ((i * 7919) % 1000);
+}
+
+static void alloc(scope_env_t *e)
+{
+    for (int k = 0; k < ENV_LEVELS; k++)
+	e->level[k] = malloc(ENV_LEN * sizeof(env_bucket_t));
+}
+
+static void view(const char *what, double first, double span)
+{
+    float rmin[COLS], rmax[COLS], nmin[COLS], nmax[COLS];
+    double per = span / COLS, reach = 0;
+    int bad = 0, missing = 0, gaps = 0;
+
+    env_query(&ramp, COUNT, first, span, COLS, rmin, rmax);
+    env_query(&noise, COUNT, first, span, COLS, nmin, nmax);
+    for (int c = 0; c < COLS; c++) {
+	long long s0 = ceil(first + c * per), s1 = ceil(first + (c + 1) * per);
+	float lo = NAN, hi = NAN;
+
+	if (s0 < 0)
+	    s0 = 0;
+	if (s1 > COUNT)
+	    s1 = COUNT;
+	for (long long i = s0; i < s1; i++) {
+	    lo = fminf(lo, samples[i]);
+	    hi = fmaxf(hi, samples[i]);
+	}
+	if (isnan(nmin[c])) {
+	    if (!isnan(lo))
+		missing++;
+	    else if (s0 < s1)
+		gaps++;
+	    continue;
+	}
+	// a coarse bucket may show samples next to a column in the gap
+	if (!isnan(lo) && !(nmin[c] <= lo && nmax[c] >= hi))
+	    bad++;
+	// the ramp's value is the sample number
+	if (s0 < s1) {
+	    double r = ((s0 - rmin[c]) + (rmax[c] - (s1 - 1))) / per;
+	    if (r > reach)
+		reach = r;
+	}
+    }
+    printf("%-26s %9.0f per column: %d wrong, %d missing, %d gap columns,"
+	   " reach %.1f columns\n", what, per, bad, missing, gaps, reach);
+}
+
+int main(void)
+{
+    long long first, end;
+
+    alloc(&ramp);
+    alloc(&noise);
+    samples = malloc(COUNT * sizeof(float));
+    for (long long i = 0; i < COUNT; i++) {
+	samples[i] = noise_value(i);
+	env_push(&ramp, i, i);
+	env_push(&noise, i, samples[i]);
+    }
+    env_span(COUNT, &first, &end);
+    printf("span %lld to %lld\n", first, end);
+
+    // the newest samples, at every zoom
+    for (double span = 400; span <= COUNT; span *= 4) {
+	char what[40];
+	snprintf(what, sizeof(what), "last %.0f", span);
+	view(what, COUNT - span, span);
+    }
+    view("all", 0, COUNT);
+    // old samples only the coarse levels still hold
+    view("oldest 800", 0, 800);
+    view("oldest 200000", 0, 200000);
+    // the gap, where the finest levels still reach
+    view("around the gap", GAP_START - 1000, 3000);
+    // off the ends
+    view("before and after", -1000000, COUNT + 2000000);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#!/bin/sh
+rm -f envelope-test
+set -e
+gcc -std=gnu99 -O2 -I../../src/hal/utils envelope-test.c ../../src/hal/utils/scope_env.c \
+    -lm -o envelope-test
+./envelope-test
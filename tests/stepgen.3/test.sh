@@ -0,0 +1,6 @@
+#!/bin/bash
+# the stepgen.0 setup once with the plain kernel and once with the
+# vector kernel, checkresult compares both with stepgen.0/expected
+rm -f plain vector
+SIMD=0 halrun -f stepgen.hal > plain || exit 1
+SIMD=1 halrun -f stepgen.hal > vector || exit 1
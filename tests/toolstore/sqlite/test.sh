@@ -0,0 +1,12 @@
+#!/bin/sh
+rm -f toolstore-test tool.db
+set -e
+g++ -DULAPI -I../../../src -I../../../src/rtapi -I../../../src/emc/nml_intf -I../../../src/emc/rs274ngc -I../../../src/emc/motion \
+    -I../../../src/emc/toolstore -I../../../src/libnml/posemath \
+    $(pkg-config --cflags sqlite3) \
+    ../toolstore-test.cc ../../../src/emc/toolstore/toolstore.cc \
+    ../../../src/emc/rs274ngc/tool_parse.cc $(pkg-config --libs sqlite3) \
+    -o toolstore-test
+./toolstore-test tool.db test.tbl 0
+rm -f tool.db
+./toolstore-test tool.db test.tbl 1
@@ -0,0 +1,77 @@
+// exercise a ToolStore backend: toolstore-test <store> <import> <random>
+//
+// imports the text tool table <import> into <store>, changes a pocket,
+// flushes, and prints the table as a fresh ToolStore reads it back
+// after each step
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "toolstore.hh"
+
+static CANON_TOOL_TABLE toolTable[CANON_POCKETS_MAX];
+static int fms[CANON_POCKETS_MAX];
+static char comments[CANON_POCKETS_MAX][CANON_TOOL_COMMENT_LEN];
+static char *ttcomments[CANON_POCKETS_MAX];
+
+static void print_table(const char *what)
+{
+    printf("%s\n", what);
+    for (int p = 0; p < CANON_POCKETS_MAX; p++) {
+	CANON_TOOL_TABLE &t = toolTable[p];
+	if (t.toolno == -1 || (p == 0 && t.toolno == 0))
+	    continue;
+	printf("  %d: T%d P%d D%.3f X%.3f Z%.3f ;%s\n", p, t.toolno, fms[p],
+	       t.diameter, t.offset.tran.x, t.offset.tran.z, ttcomments[p]);
+    }
+}
+
+static ToolStore *reopen(const char *store, int random)
+{
+    memset(toolTable, 0, sizeof(toolTable));
+    memset(fms, 0, sizeof(fms));
+    for (int p = 0; p < CANON_POCKETS_MAX; p++)
+	comments[p][0] = '\0';
+    ToolStore *ts = ToolStore::create(store, random, toolTable, fms, ttcomments);
+    if (ts == NULL || ts->load()) {
+	printf("can't load %s\n", store);
+	exit(1);
+    }
+    return ts;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+	fprintf(stderr, "usage: %s <store> <import> <random>\n", argv[0]);
+	return 2;
+    }
+    const char *store = argv[1];
+    int random = atoi(argv[3]);
+    for (int p = 0; p < CANON_POCKETS_MAX; p++)
+	ttcomments[p] = comments[p];
+
+    ToolStore *ts = reopen(store, random);
+    if (ts->load(argv[2]) || ts->flush())
+	return 1;
+    delete ts;
+    ts = reopen(store, random);
+    print_table("imported");
+
+    // what G10 L1 does to pocket 2
+    toolTable[2].diameter = 0.5;
+    toolTable[2].offset.tran.z = -1.25;
+    strcpy(ttcomments[2], "changed");
+    ts->update(2);
+    if (ts->flush())
+	return 1;
+    delete ts;
+    ts = reopen(store, random);
+    print_table("updated");
+
+    // nothing pending: flush doesn't write
+    if (ts->flush())
+	return 1;
+    delete ts;
+    return 0;
+}
@@ -0,0 +1,25 @@
+#!/usr/bin/python2
+# open SESSIONS websocket sessions subscribing through the json policy
+# and check that every session gets the same MESSAGES frames, in order
+
+import sys
+import json
+import websocket
+
+port, zmquri = sys.argv[1], sys.argv[2]
+sessions, messages = int(sys.argv[3]), int(sys.argv[4])
+
+url = ("ws://127.0.0.1:%s/?connect=%s&type=sub&policy=json"
+       "&subscribe=status" % (port, zmquri))
+ws = [websocket.create_connection(url, timeout=20) for i in range(sessions)]
+
+received = []
+for w in ws:
+    received.append([w.recv() for i in range(messages)])
+    w.close()
+
+print "%d sessions, %d messages each" % (sessions, messages)
+print "identical in all sessions:", all(r == received[0] for r in received)
+tscs = [int(json.loads(frame)["tsc"]) for frame in received[0]]
+print "in order:", tscs == range(1000, 1000 + messages)
+print "first:", json.dumps(json.loads(received[0][0]), sort_keys=True)
@@ -0,0 +1,38 @@
+#!/usr/bin/python2
+# publish MESSAGES pings on topic 'status' once SESSIONS subscribers
+# are connected, each with a different tsc so consecutive messages
+# differ
+
+import sys
+import time
+import zmq
+from machinetalk.protobuf.message_pb2 import Container
+from machinetalk.protobuf.types_pb2 import MT_PING
+
+uri, sessions, messages = sys.argv[1], int(sys.argv[2]), int(sys.argv[3])
+
+ctx = zmq.Context()
+s = ctx.socket(zmq.XPUB)
+s.setsockopt(zmq.XPUB_VERBOSE, 1)	# see every session subscribe
+s.bind(uri)
+
+subscribed = 0
+poller = zmq.Poller()
+poller.register(s, zmq.POLLIN)
+deadline = time.time() + 20
+while subscribed < sessions:
+    if time.time() > deadline:
+        print >> sys.stderr, "publisher: %d of %d sessions subscribed" % (
+            subscribed, sessions)
+        sys.exit(1)
+    if poller.poll(100):
+        if s.recv() == "\x01status":
+            subscribed += 1
+
+c = Container()
+for i in range(messages):
+    c.type = MT_PING
+    c.tsc = 1000 + i
+    s.send_multipart(["status", c.SerializeToString()])
+    time.sleep(0.02)
+time.sleep(1)
@@ -0,0 +1,22 @@
+#!/bin/bash
+# fan-out of one zeroMQ publisher to many websocket sessions: webtalk
+# converts each message once (webtalk_txcache.cc) and every session
+# must still get the same frames
+
+ZMQ=tcp://127.0.0.1:6691
+SESSIONS=5
+MESSAGES=20
+
+webtalk --foreground --ini webtalk.ini &
+WEBTALK=$!
+python2 publisher.py $ZMQ $SESSIONS $MESSAGES &
+PUBLISHER=$!
+sleep 1
+
+python2 clients.py 7691 $ZMQ $SESSIONS $MESSAGES
+RESULT=$?
+
+wait $PUBLISHER
+kill $WEBTALK
+wait $WEBTALK
+exit $RESULT